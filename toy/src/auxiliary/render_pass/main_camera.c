@@ -4,6 +4,7 @@
 #include "../../include/toy_allocator.h"
 #include "../../toy_assert.h"
 #include <string.h>
+#include <math.h>
 #include "../vulkan_pipeline/base.h"
 
 
@@ -68,20 +69,90 @@ static void prepare_instance (
 	TODO_ASSERT(VK_WHOLE_SIZE != uniform_offset);
 
 	struct instance_data_t* inst_mem = (struct instance_data_t*)((uintptr_t)frame_res->mapping_memory + uniform_offset);
-	uint32_t last_mesh_index = UINT32_MAX;
-	uint32_t vertex_base = 0;
-	for (uint32_t i = 0; i < scene->object_count; ++i) {
-		if (scene->meshes[i] != last_mesh_index) {
-			toy_mesh_t* mesh = toy_get_asset_item(&asset_mgr->asset_pools.mesh, scene->meshes[i]);
-			TOY_ASSERT(NULL != mesh && UINT32_MAX != mesh->primitive_index);
-			toy_vulkan_mesh_primitive_p vk_primitive = toy_get_asset_item(&asset_mgr->asset_pools.mesh_primitive, mesh->primitive_index);
-			TOY_ASSERT(NULL != vk_primitive);
-			vertex_base = vk_primitive->first_index;
+	for (uint32_t batch_i = 0; batch_i < ctx->draw_batch_count; ++batch_i) {
+		const toy_built_in_vulkan_draw_batch_t* batch = &ctx->draw_batches[batch_i];
+		toy_mesh_t* mesh = toy_get_asset_item(&asset_mgr->asset_pools.mesh, batch->mesh_index);
+		TOY_ASSERT(NULL != mesh && UINT32_MAX != mesh->primitive_index);
+		const toy_vulkan_mesh_primitive_draw_t* primitive_draw = toy_get_asset_hot_item(&asset_mgr->asset_pools.mesh_primitive, mesh->primitive_index);
+		for (uint32_t i = batch->first_instance; i < batch->first_instance + batch->instance_count; ++i) {
+			inst_mem[i].vertex_base = primitive_draw->first_index;
+			inst_mem[i].instance_index = i;
 		}
+	}
+}
+
+
+// Assets of a batch nearer to camera are evicted later after their release, by the nearest instance
+static void prepare_residency_priority (
+	toy_built_in_vulkan_render_pass_context_t* ctx,
+	toy_scene_t* scene,
+	toy_asset_manager_t* asset_mgr)
+{
+	const toy_fvec3_t* eye = &scene->main_camera.eye;
+	for (uint32_t batch_i = 0; batch_i < ctx->draw_batch_count; ++batch_i) {
+		const toy_built_in_vulkan_draw_batch_t* batch = &ctx->draw_batches[batch_i];
+		float min_distance_sq = INFINITY;
+		for (uint32_t i = batch->first_instance; i < batch->first_instance + batch->instance_count; ++i) {
+			const float* m = scene->inst_matrices[i].v;
+#if TOY_MATRIX_ROW_MAJOR
+			float dx = m[3] - eye->x, dy = m[7] - eye->y, dz = m[11] - eye->z;
+#else
+			float dx = m[12] - eye->x, dy = m[13] - eye->y, dz = m[14] - eye->z;
+#endif
+			float distance_sq = dx * dx + dy * dy + dz * dz;
+			if (distance_sq < min_distance_sq)
+				min_distance_sq = distance_sq;
+		}
+		toy_set_mesh_residency_priority(asset_mgr, batch->mesh_index, -sqrtf(min_distance_sq));
+	}
+}
+
+
+// Objects of same mesh in a row are one batch
+static void prepare_draw_batch (
+	toy_built_in_vulkan_render_pass_context_t* ctx,
+	toy_scene_t* scene,
+	const toy_allocator_t* frame_alc,
+	toy_error_t* error)
+{
+	ctx->draw_batches = NULL;
+	ctx->draw_batch_count = 0;
+	if (0 == scene->object_count) {
+		toy_ok(error);
+		return;
+	}
 
-		inst_mem[i].vertex_base = vertex_base;
-		inst_mem[i].instance_index = i;
+	uint32_t batch_count = 1;
+	for (uint32_t i = 1; i < scene->object_count; ++i) {
+		if (scene->meshes[i] != scene->meshes[i - 1])
+			++batch_count;
 	}
+
+	toy_built_in_vulkan_draw_batch_t* batches = toy_alloc(frame_alc, sizeof(toy_built_in_vulkan_draw_batch_t) * batch_count);
+	if (NULL == batches) {
+		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Frame memory is full for draw batches", error);
+		return;
+	}
+
+	uint32_t batch_index = 0;
+	batches[0].mesh_index = scene->meshes[0];
+	batches[0].first_instance = 0;
+	batches[0].instance_count = 1;
+	for (uint32_t i = 1; i < scene->object_count; ++i) {
+		if (scene->meshes[i] == batches[batch_index].mesh_index) {
+			++batches[batch_index].instance_count;
+			continue;
+		}
+		++batch_index;
+		batches[batch_index].mesh_index = scene->meshes[i];
+		batches[batch_index].first_instance = i;
+		batches[batch_index].instance_count = 1;
+	}
+	TOY_ASSERT(batch_index + 1 == batch_count);
+
+	ctx->draw_batches = batches;
+	ctx->draw_batch_count = batch_count;
+	toy_ok(error);
 }
 
 
@@ -89,14 +160,21 @@ void toy_prepare_render_pass_main_camera (
 	toy_vulkan_driver_t* vk_driver,
 	toy_built_in_pipeline_t* pipeline,
 	toy_scene_t* scene,
-	toy_asset_manager_t* asset_mgr)
+	toy_asset_manager_t* asset_mgr,
+	const toy_allocator_t* frame_alc,
+	toy_error_t* error)
 {
 	uint32_t current_frame = vk_driver->swapchain.current_frame;
 	toy_built_in_vulkan_frame_resource_t* frame_res = &pipeline->frame_res[current_frame];
 
+	prepare_draw_batch(&pipeline->pass_context, scene, frame_alc, error);
+	if (toy_is_failed(*error))
+		return;
+
 	prepare_camera(&pipeline->pass_context, frame_res, scene);
 	prepare_model(&pipeline->pass_context, frame_res, scene);
 	prepare_instance(&pipeline->pass_context, frame_res, scene, asset_mgr);
+	prepare_residency_priority(&pipeline->pass_context, scene, asset_mgr);
 }
 
 
@@ -228,9 +306,8 @@ static void draw_mesh (
 			0, NULL);
 		*last_material_index = mesh->material_index;
 	}
-	toy_vulkan_mesh_primitive_p vk_primitive = toy_get_asset_item(&asset_mgr->asset_pools.mesh_primitive, mesh->primitive_index);
-	TOY_ASSERT(NULL != vk_primitive);
-	vkCmdDrawIndexed(draw_cmd, vk_primitive->index_count, instance_count, vk_primitive->first_index, 0, first_instance);
+	const toy_vulkan_mesh_primitive_draw_t* primitive_draw = toy_get_asset_hot_item(&asset_mgr->asset_pools.mesh_primitive, mesh->primitive_index);
+	vkCmdDrawIndexed(draw_cmd, primitive_draw->index_count, instance_count, primitive_draw->first_index, 0, first_instance);
 }
 
 
@@ -286,24 +363,12 @@ void toy_run_render_pass_main_camera (
 		0,
 		VK_INDEX_TYPE_UINT16);
 
-	uint32_t obj_i;
-	uint32_t last_inst;
 	uint32_t last_material_index = UINT32_MAX;
-	uint32_t last_mesh = scene->meshes[0];
-	uint32_t instance_count = 0;
-	for (obj_i = 0, last_inst = obj_i; obj_i < scene->object_count; ++obj_i) {
-		if (scene->meshes[obj_i] == last_mesh) {
-			++instance_count;
-			continue;
-		}
-		draw_mesh(pipeline, draw_cmd, built_in_desc_set_layouts, frame_res, vk_driver, asset_mgr, last_mesh, &last_material_index, instance_count, last_inst);
-		last_mesh = scene->meshes[obj_i];
-		instance_count = 1;
-		last_inst = obj_i;
+	for (uint32_t batch_i = 0; batch_i < ctx->draw_batch_count; ++batch_i) {
+		const toy_built_in_vulkan_draw_batch_t* batch = &ctx->draw_batches[batch_i];
+		draw_mesh(pipeline, draw_cmd, built_in_desc_set_layouts, frame_res, vk_driver, asset_mgr, batch->mesh_index, &last_material_index, batch->instance_count, batch->first_instance);
 	}
 
-	draw_mesh(pipeline, draw_cmd, built_in_desc_set_layouts, frame_res, vk_driver, asset_mgr, last_mesh, &last_material_index, instance_count, last_inst);
-
 	vkCmdEndRenderPass(draw_cmd);
 
 	toy_ok(error);
@@ -12,7 +12,9 @@ void toy_prepare_render_pass_main_camera (
 	toy_vulkan_driver_t* vk_driver,
 	toy_built_in_pipeline_t* pipeline,
 	toy_scene_t* scene,
-	toy_asset_manager_t* asset_mgr
+	toy_asset_manager_t* asset_mgr,
+	const toy_allocator_t* frame_alc,
+	toy_error_t* error
 );
 
 void toy_run_render_pass_main_camera (
@@ -8,7 +8,7 @@
 
 struct _toy_mesh_only_entity_t {
 	toy_fmat4x4_t location;
-	toy_asset_pool_item_ref_t mesh_ref;
+	toy_asset_handle_t mesh_handle;
 	uint32_t object_id;
 };
 static constexpr uint32_t MAX_MESH_COUNT = ((TOY_MEMORY_CHUNK_SIZE - sizeof(toy_scene_entity_chunk_header_t)) / sizeof(_toy_mesh_only_entity_t));
@@ -17,7 +17,7 @@ struct toy_scene_entity_chunk_mesh_only_t {
 	toy_scene_entity_chunk_header_t header;
 	toy_fmat4x4_t location[MAX_MESH_COUNT];
 	uint32_t object_id[MAX_MESH_COUNT];
-	toy_asset_pool_item_ref_t mesh_refs[MAX_MESH_COUNT];
+	toy_asset_handle_t mesh_handles[MAX_MESH_COUNT];
 };
 
 static_assert(sizeof(struct toy_scene_entity_chunk_mesh_only_t) <= TOY_MEMORY_CHUNK_SIZE, "Size of toy_scene_entity_chunk_mesh_only_t error");
@@ -32,7 +32,7 @@ static ptrdiff_t toy_get_mesh_only_entity_chunk_component_offset (
 	case TOY_SCENE_COMPONENT_TYPE_OBJECT_ID:
 		return offsetof(struct toy_scene_entity_chunk_mesh_only_t, object_id);
 	case TOY_SCENE_COMPONENT_TYPE_MESH:
-		return offsetof(struct toy_scene_entity_chunk_mesh_only_t, mesh_refs);
+		return offsetof(struct toy_scene_entity_chunk_mesh_only_t, mesh_handles);
 	case TOY_SCENE_COMPONENT_TYPE_LOCATION:
 		return offsetof(struct toy_scene_entity_chunk_mesh_only_t, location);
 	default:
@@ -59,11 +59,7 @@ static uint32_t toy_destroy_mesh_only_entity (
 {
 	auto mesh_chunk = reinterpret_cast<toy_scene_entity_chunk_mesh_only_t*>(chunk);
 
-	toy_asset_pool_p asset_pool = mesh_chunk->mesh_refs[index].pool;
-	uint32_t asset_index = mesh_chunk->mesh_refs[index].index;
-	toy_sub_asset_ref(asset_pool, asset_index, 1);
-	if (0 == toy_get_asset_ref(asset_pool, asset_index))
-		toy_free_asset_item(asset_pool, asset_index);
+	toy_release_asset_handle(mesh_chunk->mesh_handles[index]);
 	return mesh_chunk->object_id[index];
 }
 
@@ -76,7 +72,7 @@ static uint32_t toy_move_mesh_only_entity (
 	TOY_ASSERT(src_index < chunk->chunk_desc->max_entity_count && dst_index < chunk->chunk_desc->max_entity_count);
 	auto mesh_chunk = reinterpret_cast<toy_scene_entity_chunk_mesh_only_t*>(chunk);
 
-	mesh_chunk->mesh_refs[dst_index] = mesh_chunk->mesh_refs[src_index];
+	mesh_chunk->mesh_handles[dst_index] = mesh_chunk->mesh_handles[src_index];
 	mesh_chunk->location[dst_index] = mesh_chunk->location[src_index];
 	mesh_chunk->object_id[dst_index] = mesh_chunk->object_id[src_index];
 	return mesh_chunk->object_id[dst_index];
@@ -100,9 +96,7 @@ static toy_scene_entity_chunk_header_t* toy_create_mesh_only_entity_chunk (
 	for (uint32_t i = 0; i < MAX_MESH_COUNT; ++i) {
 		chunk->object_id[i] = UINT32_MAX;
 		chunk->location[i] = toy::identity_matrix();
-		chunk->mesh_refs[i].pool = NULL;
-		chunk->mesh_refs[i].index = UINT32_MAX;
-		chunk->mesh_refs[i].next_ref = UINT32_MAX;
+		chunk->mesh_handles[i] = TOY_ASSET_HANDLE_NULL;
 	}
 
 	toy_scene_entity_chunk_header_t* header = &chunk->header;
@@ -123,9 +117,7 @@ static void toy_destroy_mesh_only_entity_chunk (
 	toy_scene_entity_chunk_descriptor_t* chunk_desc = chunk->chunk_desc;
 	
 	for (uint32_t i = 0; i < mesh_chunk->header.entity_count; ++i) {
-		toy_sub_asset_ref(mesh_chunk->mesh_refs[i].pool, mesh_chunk->mesh_refs[i].index, 1);
-		if (0 == toy_get_asset_ref(mesh_chunk->mesh_refs[i].pool, mesh_chunk->mesh_refs[i].index))
-			toy_free_asset_item(mesh_chunk->mesh_refs[i].pool, mesh_chunk->mesh_refs[i].index);
+		toy_release_asset_handle(mesh_chunk->mesh_handles[i]);
 	}
 
 	if (NULL != mesh_chunk->header.prev)
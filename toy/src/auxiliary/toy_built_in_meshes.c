@@ -85,8 +85,7 @@ uint32_t toy_load_built_in_mesh (
 		asset_mgr, primitive, error);
 	if (toy_is_failed(*error))
 		goto FAIL_LOAD_PRIMITIVE;
-	
-	toy_add_asset_ref(&asset_mgr->asset_pools.mesh_primitive, mesh->primitive_index, 1);
+
 	mesh->material_index = UINT32_MAX;
 
 	toy_ok(error);
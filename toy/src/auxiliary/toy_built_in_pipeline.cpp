@@ -52,10 +52,11 @@ toy_built_in_pipeline_p toy_create_built_in_vulkan_pipeline (
 	toy_file_interface_t file_api = toy_std_file_interface();
 	toy_vulkan_shader_loader_t shader_loader;
 	shader_loader.file_api = &file_api;
-	shader_loader.alc = &alc->list_alc;
+	toy_allocator_t render_alc = toy_get_tagged_allocator(alc, &alc->list_alc, TOY_MEMORY_TAG_RENDER);
+	shader_loader.alc = &render_alc;
 	shader_loader.tmp_alc = &alc->buddy_alc;
 
-	toy_built_in_pipeline_p pipeline = (toy_built_in_pipeline_p)toy_alloc_aligned(&alc->list_alc, sizeof(toy_built_in_pipeline_t), sizeof(void*));
+	toy_built_in_pipeline_p pipeline = (toy_built_in_pipeline_p)toy_alloc_aligned(&render_alc, sizeof(toy_built_in_pipeline_t), sizeof(void*));
 	if (NULL == pipeline) {
 		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Alloc built in render pipeline failed", error);
 		goto FAIL_ALLOC_PIPELINE;
@@ -79,12 +80,12 @@ toy_built_in_pipeline_p toy_create_built_in_vulkan_pipeline (
 	}
 
 	toy_creaet_built_in_vulkan_descriptor_set_layouts(
-		dev, vk_alc_cb, &pipeline->desc_set_layouts, error);
+		&vk_driver->state_cache, dev, vk_alc_cb, &pipeline->desc_set_layouts, error);
 	if (toy_is_failed(*error))
 		goto FAIL_DESC_SET_LAYOUT;
 
 	toy_create_built_in_vulkan_pipeline_layouts(
-		dev, &pipeline->desc_set_layouts, vk_alc_cb, &pipeline->pipelline_layouts, error);
+		&vk_driver->state_cache, dev, &pipeline->desc_set_layouts, vk_alc_cb, &pipeline->pipelline_layouts, error);
 	if (toy_is_failed(*error))
 		goto FAIL_PIPELINE_LAYOUT;
 
@@ -128,17 +129,17 @@ FAIL_PIPELINE:
 		vk_driver, &alc->buddy_alc, &pipeline->render_passes);
 FAIL_RENDER_PASS:
 	toy_destroy_built_in_vulkan_pipeine_layouts(
-		dev, vk_alc_cb, &pipeline->pipelline_layouts);
+		&vk_driver->state_cache, dev, vk_alc_cb, &pipeline->pipelline_layouts);
 FAIL_PIPELINE_LAYOUT:
 	toy_destroy_built_in_vulkan_descriptor_set_layouts(
-		dev, vk_alc_cb, &pipeline->desc_set_layouts);
+		&vk_driver->state_cache, dev, vk_alc_cb, &pipeline->desc_set_layouts);
 FAIL_DESC_SET_LAYOUT:
 	for (uint32_t i = vk_driver->swapchain.frame_count; i > 0; --i) {
 		toy_destroy_built_in_vulkan_frame_resource(
 			&vk_driver->device, &vk_driver->vk_allocator, vk_driver->vk_alc_cb_p, &pipeline->frame_res[i - 1]);
 	}
 FAIL_FRAME_RESOURCES:
-	toy_free_aligned(&alc->list_alc, pipeline);
+	toy_free_aligned(&render_alc, pipeline);
 FAIL_ALLOC_PIPELINE:
 	return NULL;
 }
@@ -164,9 +165,9 @@ void toy_destroy_built_in_vulkan_pipeline (
 	toy_destroy_built_in_vulkan_render_passes(
 		vk_driver, &alc->buddy_alc, &pipeline->render_passes);
 	toy_destroy_built_in_vulkan_pipeine_layouts(
-		dev, vk_alc_cb, &pipeline->pipelline_layouts);
+		&vk_driver->state_cache, dev, vk_alc_cb, &pipeline->pipelline_layouts);
 	toy_destroy_built_in_vulkan_descriptor_set_layouts(
-		dev, vk_alc_cb, &pipeline->desc_set_layouts);
+		&vk_driver->state_cache, dev, vk_alc_cb, &pipeline->desc_set_layouts);
 	for (uint32_t i = vk_driver->swapchain.frame_count; i > 0; --i) {
 		toy_destroy_built_in_vulkan_frame_resource(
 			&vk_driver->device, &vk_driver->vk_allocator, vk_driver->vk_alc_cb_p, &pipeline->frame_res[i - 1]);
@@ -204,6 +205,7 @@ void toy_draw_scene (
 	toy_scene_t* scene,
 	toy_asset_manager_t* asset_mgr,
 	toy_built_in_pipeline_p pipeline,
+	const toy_allocator_t* frame_alc,
 	toy_error_t* error)
 {
 	VkResult vk_err;
@@ -216,12 +218,15 @@ void toy_draw_scene (
 		goto FAIL_RESET_FRAME_RESOURCE;
 
 	toy_prepare_render_pass_main_camera(
-		vk_driver, pipeline, scene, asset_mgr);
+		vk_driver, pipeline, scene, asset_mgr, frame_alc, error);
 
+	toy_error_t unmap_err;
 	toy_unmap_vulkan_buffer_memory(
-		vk_driver->device.handle, &frame_res->uniform_stack.buffer, error);
-	TODO_ASSERT(toy_is_ok(*error));
+		vk_driver->device.handle, &frame_res->uniform_stack.buffer, &unmap_err);
+	TODO_ASSERT(toy_is_ok(unmap_err));
 	frame_res->mapping_memory = NULL;
+	if (toy_is_failed(*error))
+		goto FAIL_RESET_FRAME_RESOURCE;
 
 	VkCommandBufferBeginInfo cmd_buffer_bi;
 	cmd_buffer_bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -3,6 +3,7 @@
 #include "../../toy_assert.h"
 
 static VkResult create_single_texture (
+	toy_vulkan_state_cache_t* cache,
 	VkDevice dev,
 	const VkAllocationCallbacks* vk_alc_cb,
 	toy_vulkan_descriptor_set_layout_t* output)
@@ -17,7 +18,7 @@ static VkResult create_single_texture (
 		},
 	};
 	static const binding_count = sizeof(bindings) / sizeof(bindings[0]);
-	return toy_create_vulkan_descriptor_set_layout(dev, bindings, binding_count, vk_alc_cb, output);
+	return toy_create_vulkan_descriptor_set_layout(cache, dev, bindings, binding_count, vk_alc_cb, output);
 }
 
 
@@ -25,8 +26,8 @@ static const toy_vulkan_descriptor_set_binding_t s_single_texture[] = {
 	{
 		.desc_type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 		.binding = 0,
-		.offset = offsetof(struct toy_built_in_descriptor_set_single_texture_t, image_ref),
-		.size = sizeof(toy_asset_pool_item_ref_t) * 2,
+		.offset = offsetof(struct toy_built_in_descriptor_set_single_texture_t, image_handle),
+		.size = sizeof(toy_asset_handle_t) * 2,
 	},
 };
 
@@ -47,13 +48,8 @@ uint32_t toy_alloc_vulkan_descriptor_set_single_texture (
 	desc_set_data->header.desc_set_layout = desc_set_layout;
 	desc_set_data->header.bindings = s_single_texture;
 
-	toy_asset_pool_item_ref_t empty_ref;
-	empty_ref.pool = NULL;
-	empty_ref.index = UINT32_MAX;
-	empty_ref.next_ref = UINT32_MAX;
-
-	desc_set_data->image_ref = empty_ref;
-	desc_set_data->sampler_ref = empty_ref;
+	desc_set_data->image_handle = TOY_ASSET_HANDLE_NULL;
+	desc_set_data->sampler_handle = TOY_ASSET_HANDLE_NULL;
 	toy_ok(error);
 	return material_index;
 }
@@ -61,6 +57,7 @@ uint32_t toy_alloc_vulkan_descriptor_set_single_texture (
 
 
 static VkResult create_main_camera (
+	toy_vulkan_state_cache_t* cache,
 	VkDevice dev,
 	const VkAllocationCallbacks* vk_alc_cb,
 	toy_vulkan_descriptor_set_layout_t* output)
@@ -93,34 +90,38 @@ static VkResult create_main_camera (
 		},
 	};
 	static const binding_count = sizeof(layout_bindings) / sizeof(layout_bindings[0]);
-	return toy_create_vulkan_descriptor_set_layout(dev, layout_bindings, binding_count, vk_alc_cb, output);
+	return toy_create_vulkan_descriptor_set_layout(cache, dev, layout_bindings, binding_count, vk_alc_cb, output);
 }
 
 
 void toy_creaet_built_in_vulkan_descriptor_set_layouts (
+	toy_vulkan_state_cache_t* cache,
 	VkDevice dev,
 	const VkAllocationCallbacks* vk_alc_cb,
 	toy_built_in_vulkan_descriptor_set_layout_t* output,
 	toy_error_t* error)
 {
-	VkResult vk_err = create_main_camera(dev, vk_alc_cb, &output->main_camera);
+	memset(output, 0, sizeof(*output));
+
+	VkResult vk_err = create_main_camera(cache, dev, vk_alc_cb, &output->main_camera);
 	if (VK_SUCCESS != vk_err)
 		goto FAIL;
 
-	vk_err = create_single_texture(dev, vk_alc_cb, &output->single_texture);
+	vk_err = create_single_texture(cache, dev, vk_alc_cb, &output->single_texture);
 	if (VK_SUCCESS != vk_err)
 		goto FAIL;
 
 	toy_ok(error);
 	return;
 FAIL:
-	toy_destroy_built_in_vulkan_descriptor_set_layouts(dev, vk_alc_cb, output);
+	toy_destroy_built_in_vulkan_descriptor_set_layouts(cache, dev, vk_alc_cb, output);
 	toy_err_vkerr(TOY_ERROR_CREATE_OBJECT_FAILED, vk_err, "Create descriptor set layout failed", error);
 	return;
 }
 
 
 void toy_destroy_built_in_vulkan_descriptor_set_layouts (
+	toy_vulkan_state_cache_t* cache,
 	VkDevice dev,
 	const VkAllocationCallbacks* vk_alc_cb,
 	toy_built_in_vulkan_descriptor_set_layout_t* desc_set_layouts)
@@ -129,7 +130,7 @@ void toy_destroy_built_in_vulkan_descriptor_set_layouts (
 	const int layout_count = sizeof(*desc_set_layouts) / sizeof(toy_vulkan_descriptor_set_layout_t);
 
 	for (int i = 0; i < layout_count; ++i) {
-		vkDestroyDescriptorSetLayout(dev, layouts[i].handle, vk_alc_cb);
+		toy_release_vulkan_descriptor_set_layout(cache, dev, vk_alc_cb, layouts[i].handle);
 		layouts[i].handle = VK_NULL_HANDLE;
 	}
 }
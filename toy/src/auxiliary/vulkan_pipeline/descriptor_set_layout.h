@@ -17,8 +17,8 @@ typedef void (*toy_create_built_in_vulkan_descriptor_set_layouts_fp) (
 
 typedef struct toy_built_in_descriptor_set_single_texture_t {
 	toy_vulkan_descriptor_set_data_header_t header;
-	toy_asset_pool_item_ref_t image_ref;
-	toy_asset_pool_item_ref_t sampler_ref;
+	toy_asset_handle_t image_handle;
+	toy_asset_handle_t sampler_handle; // Must follow image_handle
 }toy_built_in_descriptor_set_single_texture_t;
 
 
@@ -38,6 +38,7 @@ uint32_t toy_alloc_vulkan_descriptor_set_single_texture (
 );
 
 void toy_creaet_built_in_vulkan_descriptor_set_layouts (
+	toy_vulkan_state_cache_t* cache,
 	VkDevice dev,
 	const VkAllocationCallbacks* vk_alc_cb,
 	toy_built_in_vulkan_descriptor_set_layout_t* output,
@@ -45,6 +46,7 @@ void toy_creaet_built_in_vulkan_descriptor_set_layouts (
 );
 
 void toy_destroy_built_in_vulkan_descriptor_set_layouts (
+	toy_vulkan_state_cache_t* cache,
 	VkDevice dev,
 	const VkAllocationCallbacks* vk_alc_cb,
 	toy_built_in_vulkan_descriptor_set_layout_t* desc_set_layouts
@@ -1,5 +1,27 @@
 #include "pipeline.h"
 
+#include "../../include/toy_log.h"
+#include "../../toy_assert.h"
+
+
+#define TOY_BUILT_IN_SHADER_PATH_MAX 64
+
+// Every parameter of a built-in graphic pipeline, key of the pipeline in state cache.
+// Zeroed before it is filled, state structs point into the static built-in config, so their pointers are stable
+struct toy_built_in_vulkan_pipeline_key_t {
+	char vertex_shader[TOY_BUILT_IN_SHADER_PATH_MAX];
+	char fragment_shader[TOY_BUILT_IN_SHADER_PATH_MAX];
+	VkPipelineLayout layout;
+	VkRenderPass render_pass;
+	VkExtent2D extent;
+	VkPipelineInputAssemblyStateCreateInfo input_assembly;
+	VkPipelineRasterizationStateCreateInfo rasterization;
+	VkPipelineMultisampleStateCreateInfo multisample;
+	VkPipelineDepthStencilStateCreateInfo depth_stencil;
+	VkPipelineColorBlendAttachmentState color_blend_attachment;
+	VkPipelineColorBlendStateCreateInfo color_blend;
+};
+
 
 static struct toy_built_in_vulkan_pipeline_config_t s_built_in_pipeline_cfg;
 
@@ -99,6 +121,32 @@ const struct toy_built_in_vulkan_pipeline_config_t* toy_get_built_in_vulkan_grap
 }
 
 
+static void make_pipeline_key (
+	const char* vertex_shader,
+	const char* fragment_shader,
+	const struct toy_built_in_vulkan_pipeline_config_t* built_in_vk_pipeline_cfg,
+	VkPipelineLayout layout,
+	VkRenderPass render_pass,
+	VkExtent2D extent,
+	struct toy_built_in_vulkan_pipeline_key_t* output)
+{
+	TOY_ASSERT(strlen(vertex_shader) < TOY_BUILT_IN_SHADER_PATH_MAX && strlen(fragment_shader) < TOY_BUILT_IN_SHADER_PATH_MAX);
+
+	memset(output, 0, sizeof(*output));
+	strncpy(output->vertex_shader, vertex_shader, TOY_BUILT_IN_SHADER_PATH_MAX - 1);
+	strncpy(output->fragment_shader, fragment_shader, TOY_BUILT_IN_SHADER_PATH_MAX - 1);
+	output->layout = layout;
+	output->render_pass = render_pass;
+	output->extent = extent;
+	output->input_assembly = built_in_vk_pipeline_cfg->input_assembly.triangle_list;
+	output->rasterization = built_in_vk_pipeline_cfg->rasterization.full_back_cclock;
+	output->multisample = built_in_vk_pipeline_cfg->multisample.no_msaa;
+	output->depth_stencil = built_in_vk_pipeline_cfg->depth_stencil.le_no;
+	output->color_blend_attachment = built_in_vk_pipeline_cfg->color_blend.fix_blend.attachment;
+	output->color_blend = built_in_vk_pipeline_cfg->color_blend.fix_blend.state;
+}
+
+
 static void create_mesh (
 	toy_vulkan_driver_t* vk_driver,
 	toy_vulkan_shader_loader_t* shader_loader,
@@ -112,11 +160,21 @@ static void create_mesh (
 	VkResult vk_err;
 	VkDevice dev = vk_driver->device.handle;
 	const VkAllocationCallbacks* vk_alc_cb = vk_driver->vk_alc_cb_p;
+	const char* vertex_path = "assets/SPIR_V/mesh_indirect_glsl_vt.spv";
+	const char* fragment_path = "assets/SPIR_V/mesh_indirect_glsl_fg.spv";
+
+	// Shaders are not loaded when a pipeline of the same parameters is cached
+	struct toy_built_in_vulkan_pipeline_key_t key;
+	make_pipeline_key(vertex_path, fragment_path, built_in_vk_pipeline_cfg, layout->handle, render_pass, vk_driver->swapchain.extent, &key);
+	if (toy_find_vulkan_pipeline(&vk_driver->state_cache, &key, sizeof(key), output)) {
+		toy_ok(error);
+		return;
+	}
 
-	VkShaderModule vertex_shader = toy_create_vulkan_shader_module("assets/SPIR_V/mesh_indirect_glsl_vt.spv", dev, shader_loader, vk_alc_cb, error);
+	VkShaderModule vertex_shader = toy_create_vulkan_shader_module(vertex_path, dev, shader_loader, vk_alc_cb, error);
 	if (toy_is_failed(*error))
 		goto FAIL_VERTEX_SHADER;
-	VkShaderModule fragment_shader = toy_create_vulkan_shader_module("assets/SPIR_V/mesh_indirect_glsl_fg.spv", dev, shader_loader, vk_alc_cb, error);
+	VkShaderModule fragment_shader = toy_create_vulkan_shader_module(fragment_path, dev, shader_loader, vk_alc_cb, error);
 	if (toy_is_failed(*error))
 		goto FAIL_FRAGMENT_SHADER;
 
@@ -203,6 +261,8 @@ static void create_mesh (
 	vkDestroyShaderModule(dev, fragment_shader, vk_alc_cb);
 	vkDestroyShaderModule(dev, vertex_shader, vk_alc_cb);
 
+	if (!toy_add_vulkan_pipeline(&vk_driver->state_cache, &key, sizeof(key), pipeline_handle))
+		toy_log_w("Failed to cache pipeline, it will not be shared");
 	*output = pipeline_handle;
 
 	toy_ok(error);
@@ -230,11 +290,21 @@ static void create_shadow (
 	VkResult vk_err;
 	VkDevice dev = vk_driver->device.handle;
 	const VkAllocationCallbacks* vk_alc_cb = vk_driver->vk_alc_cb_p;
+	const char* vertex_path = "assets/SPIR_V/shadow_glsl_vt.spv";
+	const char* fragment_path = "assets/SPIR_V/shadow_glsl_fg.spv";
+
+	// Shaders are not loaded when a pipeline of the same parameters is cached
+	struct toy_built_in_vulkan_pipeline_key_t key;
+	make_pipeline_key(vertex_path, fragment_path, built_in_vk_pipeline_cfg, layout->handle, render_pass, vk_driver->swapchain.extent, &key);
+	if (toy_find_vulkan_pipeline(&vk_driver->state_cache, &key, sizeof(key), output)) {
+		toy_ok(error);
+		return;
+	}
 
-	VkShaderModule vertex_shader = toy_create_vulkan_shader_module("assets/SPIR_V/shadow_glsl_vt.spv", dev, shader_loader, vk_alc_cb, error);
+	VkShaderModule vertex_shader = toy_create_vulkan_shader_module(vertex_path, dev, shader_loader, vk_alc_cb, error);
 	if (toy_is_failed(*error))
 		goto FAIL_VERTEX_SHADER;
-	VkShaderModule fragment_shader = toy_create_vulkan_shader_module("assets/SPIR_V/shadow_glsl_fg.spv", dev, shader_loader, vk_alc_cb, error);
+	VkShaderModule fragment_shader = toy_create_vulkan_shader_module(fragment_path, dev, shader_loader, vk_alc_cb, error);
 	if (toy_is_failed(*error))
 		goto FAIL_FRAGMENT_SHADER;
 
@@ -321,6 +391,8 @@ static void create_shadow (
 	vkDestroyShaderModule(dev, fragment_shader, vk_alc_cb);
 	vkDestroyShaderModule(dev, vertex_shader, vk_alc_cb);
 
+	if (!toy_add_vulkan_pipeline(&vk_driver->state_cache, &key, sizeof(key), pipeline_handle))
+		toy_log_w("Failed to cache pipeline, it will not be shared");
 	*output = pipeline_handle;
 
 	toy_ok(error);
@@ -379,7 +451,7 @@ void toy_destroy_built_in_vulkan_pipelines (
 	const VkAllocationCallbacks* vk_alc_cb = vk_driver->vk_alc_cb_p;
 
 	for (int i = 0; i < shader_count; ++i) {
-		if (VK_NULL_HANDLE != pipelines[i])
-			vkDestroyPipeline(dev, pipelines[i], vk_alc_cb);
+		toy_release_vulkan_pipeline(&vk_driver->state_cache, dev, vk_alc_cb, pipelines[i]);
+		pipelines[i] = VK_NULL_HANDLE;
 	}
 }
@@ -2,6 +2,7 @@
 
 
 static void create_mesh (
+	toy_vulkan_state_cache_t* cache,
 	VkDevice dev,
 	const toy_built_in_vulkan_descriptor_set_layout_t* built_in_layouts,
 	const VkAllocationCallbacks* vk_alc_cb,
@@ -16,15 +17,8 @@ static void create_mesh (
 	};
 
 	VkPipelineLayout layout;
-	VkPipelineLayoutCreateInfo layout_ci;
-	layout_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	layout_ci.pNext = NULL;
-	layout_ci.flags = 0;
-	layout_ci.setLayoutCount = sizeof(desc_set_layouts) / sizeof(*desc_set_layouts);
-	layout_ci.pSetLayouts = desc_set_layouts;
-	layout_ci.pushConstantRangeCount = 0;
-	layout_ci.pPushConstantRanges = NULL;
-	vk_err = vkCreatePipelineLayout(dev, &layout_ci, vk_alc_cb, &layout);
+	vk_err = toy_acquire_vulkan_pipeline_layout(
+		cache, dev, desc_set_layouts, sizeof(desc_set_layouts) / sizeof(*desc_set_layouts), vk_alc_cb, &layout);
 	if (VK_SUCCESS != vk_err) {
 		toy_err_vkerr(TOY_ERROR_CREATE_OBJECT_FAILED, vk_err, "vkCreatePipelineLayout failed", error);
 		return;
@@ -40,6 +34,7 @@ static void create_mesh (
 
 
 static void create_shadow (
+	toy_vulkan_state_cache_t* cache,
 	VkDevice dev,
 	const toy_built_in_vulkan_descriptor_set_layout_t* built_in_layouts,
 	const VkAllocationCallbacks* vk_alc_cb,
@@ -53,15 +48,8 @@ static void create_shadow (
 	};
 
 	VkPipelineLayout layout;
-	VkPipelineLayoutCreateInfo layout_ci;
-	layout_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	layout_ci.pNext = NULL;
-	layout_ci.flags = 0;
-	layout_ci.setLayoutCount = sizeof(desc_set_layouts) / sizeof(*desc_set_layouts);
-	layout_ci.pSetLayouts = desc_set_layouts;
-	layout_ci.pushConstantRangeCount = 0;
-	layout_ci.pPushConstantRanges = NULL;
-	vk_err = vkCreatePipelineLayout(dev, &layout_ci, vk_alc_cb, &layout);
+	vk_err = toy_acquire_vulkan_pipeline_layout(
+		cache, dev, desc_set_layouts, sizeof(desc_set_layouts) / sizeof(*desc_set_layouts), vk_alc_cb, &layout);
 	if (VK_SUCCESS != vk_err) {
 		toy_err_vkerr(TOY_ERROR_CREATE_OBJECT_FAILED, vk_err, "vkCreatePipelineLayout failed", error);
 		return;
@@ -77,6 +65,7 @@ static void create_shadow (
 
 
 void toy_create_built_in_vulkan_pipeline_layouts (
+	toy_vulkan_state_cache_t* cache,
 	VkDevice dev,
 	const toy_built_in_vulkan_descriptor_set_layout_t* built_in_layouts,
 	const VkAllocationCallbacks* vk_alc_cb,
@@ -85,22 +74,23 @@ void toy_create_built_in_vulkan_pipeline_layouts (
 {
 	memset(output, 0, sizeof(*output));
 
-	create_mesh(dev, built_in_layouts, vk_alc_cb, &output->mesh, error);
+	create_mesh(cache, dev, built_in_layouts, vk_alc_cb, &output->mesh, error);
 	if (toy_is_failed(*error))
 		goto FAIL;
 
-	create_shadow(dev, built_in_layouts, vk_alc_cb, &output->shadow, error);
+	create_shadow(cache, dev, built_in_layouts, vk_alc_cb, &output->shadow, error);
 	if (toy_is_failed(*error))
 		goto FAIL;
 
 	toy_ok(error);
 	return;
 FAIL:
-	toy_destroy_built_in_vulkan_pipeine_layouts(dev, vk_alc_cb, output);
+	toy_destroy_built_in_vulkan_pipeine_layouts(cache, dev, vk_alc_cb, output);
 }
 
 
 void toy_destroy_built_in_vulkan_pipeine_layouts (
+	toy_vulkan_state_cache_t* cache,
 	VkDevice dev,
 	const VkAllocationCallbacks* vk_alc_cb,
 	toy_built_in_vulkan_pipeline_layouts_t* pipeline_layouts)
@@ -109,7 +99,7 @@ void toy_destroy_built_in_vulkan_pipeine_layouts (
 	const int layout_count = sizeof(*pipeline_layouts) / sizeof(toy_vulkan_pipeline_layout_t);
 
 	for (int i = 0; i < layout_count; ++i) {
-		if (VK_NULL_HANDLE != layouts[i].handle)
-			vkDestroyPipelineLayout(dev, layouts[i].handle, vk_alc_cb);
+		toy_release_vulkan_pipeline_layout(cache, dev, vk_alc_cb, layouts[i].handle);
+		layouts[i].handle = VK_NULL_HANDLE;
 	}
 }
@@ -18,6 +18,7 @@ typedef struct toy_built_in_vulkan_pipeline_layouts_t {
 TOY_EXTERN_C_START
 
 void toy_create_built_in_vulkan_pipeline_layouts (
+	toy_vulkan_state_cache_t* cache,
 	VkDevice dev,
 	const toy_built_in_vulkan_descriptor_set_layout_t* built_in_layouts,
 	const VkAllocationCallbacks* vk_alc_cb,
@@ -26,6 +27,7 @@ void toy_create_built_in_vulkan_pipeline_layouts (
 );
 
 void toy_destroy_built_in_vulkan_pipeine_layouts (
+	toy_vulkan_state_cache_t* cache,
 	VkDevice dev,
 	const VkAllocationCallbacks* vk_alc_cb,
 	toy_built_in_vulkan_pipeline_layouts_t* pipeline_layouts
@@ -13,6 +13,13 @@ typedef struct toy_built_in_vulkan_render_passes_t {
 }toy_built_in_vulkan_render_passes_t;
 
 
+typedef struct toy_built_in_vulkan_draw_batch_t {
+	uint32_t mesh_index;
+	uint32_t first_instance;
+	uint32_t instance_count;
+}toy_built_in_vulkan_draw_batch_t;
+
+
 typedef struct toy_built_in_vulkan_render_pass_context_t {
 	toy_vulkan_image_t camera_depth_image;
 	VkFramebuffer* camera_framebuffers;
@@ -22,6 +29,10 @@ typedef struct toy_built_in_vulkan_render_pass_context_t {
 	toy_vulkan_sub_buffer_t vp_buffer;	// camera view, project matrix
 	toy_vulkan_sub_buffer_t m_buffer;	// model matrix
 	toy_vulkan_sub_buffer_t inst_buffer;	// instance data
+
+	// Objects of same mesh in a row are drawn by one instanced draw, batches live in frame memory
+	toy_built_in_vulkan_draw_batch_t* draw_batches;
+	uint32_t draw_batch_count;
 }toy_built_in_vulkan_render_pass_context_t;
 
 
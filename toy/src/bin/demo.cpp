@@ -3,10 +3,12 @@
 #include "../include/auxiliary/toy_built_in_meshes.h"
 #include "../include/auxiliary/toy_built_in_ecs.h"
 #include "../include/auxiliary/toy_built_in_pipeline.h"
+#include "../include/toy_bench.h"
 
 #include "../auxiliary/vulkan_pipeline/base.h"
 
 #include <cassert>
+#include <cstring>
 
 using toy::operator*;
 using toy::operator+;
@@ -27,35 +29,41 @@ void load_scene (toy_app_t* app, game_data_t* gd)
 	assert(NULL != scene);
 	toy_push_scene(app, scene);
 	
+	// Mesh and textures are uploaded by one submit
+	toy_begin_asset_upload_batch(&app->asset_mgr);
+
 	uint32_t mesh_index = toy_load_built_in_mesh(
 		&app->asset_mgr,
 		toy_get_built_in_mesh_rectangle(),
 		&err);
 	assert(toy_is_ok(err));
 
-	toy_asset_pool_item_ref_t tex_ref;
+	toy_asset_handle_t tex_handle;
 	toy_load_texture2d(
 		&app->asset_mgr,
 		"assets/textures/test.jpg",
-		&tex_ref,
+		&tex_handle,
 		&err);
 	assert(toy_is_ok(err));
 
-	toy_asset_pool_item_ref_t tex2_ref;
+	toy_asset_handle_t tex2_handle;
 	toy_load_texture2d(
 		&app->asset_mgr,
 		"assets/textures/test2.jpg",
-		&tex2_ref,
+		&tex2_handle,
 		&err);
 	assert(toy_is_ok(err));
 
+	toy_end_asset_upload_batch(&app->asset_mgr, &err);
+	assert(toy_is_ok(err));
+
 	toy_image_sampler_t img_sampler;
 	img_sampler.mag_filter = TOY_IMAGE_SAMPLER_FILTER_LINEAR;
 	img_sampler.min_filter = TOY_IMAGE_SAMPLER_FILTER_LINEAR;
 	img_sampler.wrap_u = TOY_IMAGE_SAMPLER_WRAP_REPEAT;
 	img_sampler.wrap_v = TOY_IMAGE_SAMPLER_WRAP_REPEAT;
 	img_sampler.wrap_w = TOY_IMAGE_SAMPLER_WRAP_REPEAT;
-	toy_asset_pool_item_ref_t sampler_ref = toy_create_image_sampler(
+	toy_asset_handle_t sampler_handle = toy_create_image_sampler(
 		&app->asset_mgr, &img_sampler, &err);
 	assert(toy_is_ok(err));
 
@@ -66,14 +74,13 @@ void load_scene (toy_app_t* app, game_data_t* gd)
 		&app->asset_mgr.asset_pools.material, material_index);
 	assert(NULL != desc_set_data_p);
 	toy_built_in_descriptor_set_single_texture_t* desc_set_data = *desc_set_data_p;
-	desc_set_data->image_ref = tex_ref;
-	toy_add_asset_ref(tex_ref.pool, tex_ref.index, 1);
-	desc_set_data->sampler_ref = sampler_ref;
-	toy_add_asset_ref(sampler_ref.pool, sampler_ref.index, 1);
+	desc_set_data->image_handle = tex_handle;
+	desc_set_data->sampler_handle = sampler_handle;
 
 	toy_mesh_t* mesh = (toy_mesh_t*)toy_get_asset_item(&app->asset_mgr.asset_pools.mesh, mesh_index);
-	mesh->material_index = material_index;
-	toy_add_asset_ref(&app->asset_mgr.asset_pools.material, material_index, 1);
+	mesh->material_index = toy_share_material(
+		&app->asset_mgr, material_index, sizeof(toy_built_in_descriptor_set_single_texture_t), &err);
+	assert(toy_is_ok(err));
 
 	uint32_t mesh2_index = toy_alloc_asset_item(&app->asset_mgr.asset_pools.mesh, &err);
 	toy_mesh_t* mesh2 = (toy_mesh_t*)toy_get_asset_item(&app->asset_mgr.asset_pools.mesh, mesh2_index);
@@ -86,12 +93,12 @@ void load_scene (toy_app_t* app, game_data_t* gd)
 		&app->asset_mgr.asset_pools.material, material2_index);
 	assert(NULL != desc_set2_data_p);
 	toy_built_in_descriptor_set_single_texture_t* desc_set2_data = *desc_set2_data_p;
-	desc_set2_data->image_ref = tex2_ref;
-	toy_add_asset_ref(tex2_ref.pool, tex2_ref.index, 1);
-	desc_set2_data->sampler_ref = sampler_ref;
-	toy_add_asset_ref(sampler_ref.pool, sampler_ref.index, 1);
-	mesh2->material_index = material2_index;
-	toy_add_asset_ref(&app->asset_mgr.asset_pools.material, material2_index, 1);
+	desc_set2_data->image_handle = tex2_handle;
+	desc_set2_data->sampler_handle = sampler_handle;
+	toy_add_asset_handle_ref(sampler_handle, 1);
+	mesh2->material_index = toy_share_material(
+		&app->asset_mgr, material2_index, sizeof(toy_built_in_descriptor_set_single_texture_t), &err);
+	assert(toy_is_ok(err));
 	
 
 	for (uint32_t i = 0; i < sizeof(scene->object_ids) / sizeof(scene->object_ids[0]); ++i) {
@@ -265,6 +272,12 @@ FAIL_INIT:
 int main (int argc, const char* argv[])
 {
 	//test();
+	// Replay a trace recorded with toy_memory_config_t::trace_path, without window
+	if (3 == argc && 0 == strcmp(argv[1], "--replay-memory-trace"))
+		return toy_replay_memory_trace_main(argv[2]);
+	// Allocator benchmarks, without window
+	if (3 == argc && 0 == strcmp(argv[1], "--bench"))
+		return toy_run_bench_main(argv[2]);
 	return demo_main(NULL);
 }
 
@@ -23,11 +23,13 @@ void toy_destroy_built_in_vulkan_pipeline (
 	toy_built_in_pipeline_p pipeline
 );
 
+// Temporary draw data is allocated from frame_alc, it must live until the frame is submitted
 void toy_draw_scene (
 	toy_vulkan_driver_t* vk_driver,
 	toy_scene_t* scene,
 	toy_asset_manager_t* asset_mgr,
 	toy_built_in_pipeline_p pipeline,
+	const toy_allocator_t* frame_alc,
 	toy_error_t* error
 );
 
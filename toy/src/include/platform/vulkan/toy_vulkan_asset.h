@@ -17,6 +17,12 @@ typedef struct toy_vulkan_mesh_primitive_t {
 	uint32_t index_count;
 }toy_vulkan_mesh_primitive_t, *toy_vulkan_mesh_primitive_p;
 
+// Fields of toy_vulkan_mesh_primitive_t read by every draw, hot data of mesh primitive pool
+typedef struct toy_vulkan_mesh_primitive_draw_t {
+	uint32_t first_index;
+	uint32_t index_count;
+}toy_vulkan_mesh_primitive_draw_t;
+
 
 typedef struct toy_vulkan_mesh_primitive_asset_pool_t {
 	toy_vulkan_buffer_list_pool_t vbo_pool;
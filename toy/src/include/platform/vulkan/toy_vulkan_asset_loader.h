@@ -7,23 +7,63 @@
 #include "toy_vulkan_device.h"
 
 
-typedef struct toy_vulkan_asset_loader_t {
+#define TOY_VULKAN_STAGE_BATCH_MAX_IMAGE 64
+#define TOY_VULKAN_STAGE_SLOT_COUNT 3 // Submits in flight at most, staging of next batch overlaps them
+
+// Rows [first_row, first_row + row_count) of an image, its copy and layout barriers are recorded when stage batch is submitted.
+// Image larger than stage ring is split into rows of several submits
+typedef struct toy_vulkan_stage_image_t {
+	toy_vulkan_sub_buffer_t src_buffer;
+	VkImage image;
+	uint32_t width;
+	uint32_t height;
+	uint32_t mipmap_level;
+	uint32_t first_row;
+	uint32_t row_count;
+}toy_vulkan_stage_image_t;
+
+// Commands of one submit, its region of stage ring is free after fence is signaled
+typedef struct toy_vulkan_stage_slot_t {
 	VkCommandPool transfer_pool;
 	VkCommandPool graphic_pool;
 
 	VkCommandBuffer transfer_cmd;
 	VkCommandBuffer graphic_cmd;
 
-	VkQueue transfer_queue;
-	VkQueue graphic_queue;
-
-	VkPipelineStageFlags semaphore_wait_stage;
 	VkSemaphore semaphore;
 	VkFence fence;
 
+	uint64_t serial; // Serial of last submit by this slot
+	VkDeviceSize ring_end; // Ring head after data of the submit
+	VkDeviceSize ring_size; // Bytes of ring used by the submit, including alignment and skipped end of ring
+}toy_vulkan_stage_slot_t;
+
+
+typedef struct toy_vulkan_asset_loader_t {
+	VkQueue transfer_queue;
+	VkQueue graphic_queue;
+
 	toy_vulkan_memory_allocator_p vk_alc;
-	toy_vulkan_buffer_stack_t stage_stack;
+
+	// Stage ring, mapped while loader is alive. Data lives in [ring_tail, ring_head) and may wrap to 0
+	toy_vulkan_buffer_t stage_buffer;
 	void* mapping_memory;
+	VkDeviceSize ring_head;
+	VkDeviceSize ring_tail;
+	VkDeviceSize ring_used;
+
+	// Submit of serial s uses slots[(s - 1) % TOY_VULKAN_STAGE_SLOT_COUNT], serials finish in order
+	toy_vulkan_stage_slot_t slots[TOY_VULKAN_STAGE_SLOT_COUNT];
+	uint64_t submit_serial; // Last submit, 0 before first one
+	uint64_t complete_serial; // Submits up to it are finished and their ring regions are reused
+
+	// Stage batch, recorded by slot of submit_serial + 1, see toy_begin_vulkan_stage_batch()
+	bool batch_recording;
+	uint32_t batch_buffer_count; // Buffer copies recorded into transfer_cmd
+	uint32_t batch_image_count;
+	VkDeviceSize batch_ring_start;
+	VkDeviceSize batch_ring_size;
+	toy_vulkan_stage_image_t batch_images[TOY_VULKAN_STAGE_BATCH_MAX_IMAGE];
 }toy_vulkan_asset_loader_t;
 
 
@@ -37,68 +77,91 @@ void toy_create_vulkan_asset_loader (
 	toy_error_t* error
 );
 
+// Wait for submits in flight
 void toy_destroy_vulkan_asset_loader (
 	VkDevice dev,
 	toy_vulkan_asset_loader_t* loader
 );
 
-void toy_reset_vulkan_asset_loader (
+// Stage batch uploads many buffers and images:
+//   toy_begin_vulkan_stage_batch(), toy_stage_vulkan_buffer() or toy_stage_vulkan_image() for each asset,
+//   then toy_submit_vulkan_stage_batch(). Uploads are finished when loader->submit_serial after submit is complete.
+// When stage ring is full, staging submits the batch and goes on in a new submit, so a batch may take several serials.
+// Begin waits only when its slot is still in flight
+void toy_begin_vulkan_stage_batch (
 	VkDevice dev,
 	toy_vulkan_asset_loader_t* loader,
 	toy_error_t* error
 );
 
-void toy_map_vulkan_stage_memory (
-	VkDevice dev,
+// Copy data to stage ring and record its copy to dst_buffer, data larger than ring is split into several submits
+void toy_stage_vulkan_buffer (
 	toy_vulkan_asset_loader_t* loader,
+	const toy_stage_data_block_t* data,
+	const toy_vulkan_sub_buffer_t* dst_buffer,
 	toy_error_t* error
 );
 
-void toy_unmap_vulkan_stage_memory (
-	VkDevice dev,
+// Copy pixels to stage ring, copy and layout barriers of dst_image are recorded by submit.
+// Pixels larger than ring are split by rows into several submits
+void toy_stage_vulkan_image (
 	toy_vulkan_asset_loader_t* loader,
+	const toy_stage_data_block_t* pixels,
+	toy_vulkan_image_p dst_image,
+	uint32_t width,
+	uint32_t height,
+	uint32_t mipmap_level,
 	toy_error_t* error
 );
 
-void toy_clear_vulkan_stage_memory (toy_vulkan_asset_loader_t* loader);
+toy_inline bool toy_is_vulkan_stage_batch_empty (const toy_vulkan_asset_loader_t* loader) {
+	return 0 == loader->batch_buffer_count && 0 == loader->batch_image_count;
+}
+
+// Begin does not wait for GPU
+toy_inline bool toy_has_free_vulkan_stage_slot (const toy_vulkan_asset_loader_t* loader) {
+	return loader->submit_serial - loader->complete_serial < TOY_VULKAN_STAGE_SLOT_COUNT;
+}
 
-void toy_copy_data_to_vulkan_stage_memory (
-	toy_stage_data_block_t* data_blocks,
-	uint32_t block_count,
+// Record image barriers and copies, submit with fence of the slot and increase loader->submit_serial
+void toy_submit_vulkan_stage_batch (
+	VkDevice dev,
 	toy_vulkan_asset_loader_t* loader,
-	toy_vulkan_sub_buffer_t* output_buffers,
 	toy_error_t* error
 );
 
-VkResult toy_start_vkcmd_stage_mesh_primitive (
+// Drop recorded commands and stage ring data of a batch which is not submitted
+void toy_cancel_vulkan_stage_batch (
+	VkDevice dev,
 	toy_vulkan_asset_loader_t* loader
 );
 
-void toy_submit_vkcmd_stage_mesh_primitive (
+// Free ring regions of finished submits without blocking, return loader->complete_serial
+uint64_t toy_poll_vulkan_stage_submits (
 	VkDevice dev,
 	toy_vulkan_asset_loader_t* loader,
 	toy_error_t* error
 );
 
-VkResult toy_start_vkcmd_stage_image (
-	toy_vulkan_asset_loader_t* loader
-);
-
-// vkspec.html#synchronization-pipeline-barriers
-// vkspec.html#synchronization-memory-barriers
-void toy_vkcmd_stage_texture_image (
+// Block until submits up to serial are finished
+void toy_wait_vulkan_stage_submit (
+	VkDevice dev,
 	toy_vulkan_asset_loader_t* loader,
-	toy_vulkan_sub_buffer_p src_buffer,
-	toy_vulkan_image_p dst_image,
-	uint32_t width,
-	uint32_t height,
-	uint32_t mipmap_level
+	uint64_t serial,
+	toy_error_t* error
 );
 
-void toy_submit_vkcmd_stage_image (
+// Largest contiguous free bytes of stage ring after freeing finished submits, counted from an offset aligned to alignment.
+// Blocks staged into it take toy_get_vulkan_stage_ring_size() each, staging that much in total does not wait for ring
+VkDeviceSize toy_get_vulkan_stage_ring_space (
 	VkDevice dev,
 	toy_vulkan_asset_loader_t* loader,
-	toy_error_t* error
+	VkDeviceSize alignment
 );
 
+// Ring bytes a block takes at most, padding which aligns it after the previous block included
+toy_inline VkDeviceSize toy_get_vulkan_stage_ring_size (VkDeviceSize size, VkDeviceSize alignment) {
+	return size + alignment - 1;
+}
+
 TOY_EXTERN_C_END
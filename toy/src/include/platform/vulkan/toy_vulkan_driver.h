@@ -5,6 +5,7 @@
 #include "toy_vulkan_device.h"
 #include "toy_vulkan_memory.h"
 #include "toy_vulkan_swapchain.h"
+#include "toy_vulkan_state_cache.h"
 
 
 typedef struct toy_vulkan_driver_t {
@@ -14,6 +15,8 @@ typedef struct toy_vulkan_driver_t {
 
 	toy_vulkan_swapchain_t swapchain;
 
+	toy_vulkan_state_cache_t state_cache; // Descriptor set layouts, pipeline layouts and pipelines shared by creation parameters
+
 	struct {
 		VkSampleCountFlagBits msaa_count;
 		VkFormat depth_format;
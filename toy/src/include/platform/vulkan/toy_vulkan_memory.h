@@ -241,7 +241,7 @@ typedef struct toy_vulkan_memory_allocator_t {
 	toy_vulkan_binding_allocator_t vk_list_alc;
 	toy_vulkan_binding_allocator_t vk_std_alc;
 
-	toy_memory_pool_p chunk_pools;
+	toy_memory_pool_chain_t chunk_pools;
 	toy_allocator_t chunk_alc;
 	toy_vulkan_memory_list_p vk_mem_list[VK_MAX_MEMORY_TYPES];
 
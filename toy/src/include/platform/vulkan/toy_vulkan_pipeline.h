@@ -3,6 +3,7 @@
 #include "../../toy_platform.h"
 #include "toy_vulkan_device.h"
 #include "toy_vulkan_asset.h"
+#include "toy_vulkan_state_cache.h"
 #include "../../toy_file.h"
 
 
@@ -45,7 +46,9 @@ typedef struct toy_vulkan_shader_loader_t {
 
 TOY_EXTERN_C_START
 
+// Layout is shared through cache with layouts of the same bindings, release it by toy_release_vulkan_descriptor_set_layout()
 VkResult toy_create_vulkan_descriptor_set_layout (
+	toy_vulkan_state_cache_t* cache,
 	VkDevice dev,
 	const VkDescriptorSetLayoutBinding* bindings,
 	uint32_t binding_count,
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "../../toy_platform.h"
+#include "../../toy_allocator.h"
+#include "../../toy_error.h"
+#include "toy_vulkan_device.h"
+
+
+#define TOY_VULKAN_STATE_CACHE_MIN_CAPACITY 64
+
+enum toy_vulkan_state_kind_t {
+	TOY_VULKAN_STATE_DESCRIPTOR_SET_LAYOUT = 0,
+	TOY_VULKAN_STATE_PIPELINE_LAYOUT,
+	TOY_VULKAN_STATE_PIPELINE,
+	TOY_VULKAN_STATE_KIND_COUNT,
+};
+
+// Key is (kind, bytes of creation parameters), a copy of the bytes is kept to tell apart keys of the same hash
+typedef struct toy_vulkan_state_entry_t {
+	uint64_t hash; // Hash of key, 0 for empty slot
+	void* key;
+	size_t key_size;
+	union {
+		VkDescriptorSetLayout desc_set_layout;
+		VkPipelineLayout pipeline_layout;
+		VkPipeline pipeline;
+	} object;
+	uint32_t kind; // enum toy_vulkan_state_kind_t
+	uint32_t ref_count; // Object is destroyed when the last reference is released
+}toy_vulkan_state_entry_t;
+
+// Open addressing hash table of immutable state objects by their creation parameters,
+// so the same parameters share one Vulkan object instead of creating another one.
+// NOT thread-safe
+typedef struct toy_vulkan_state_cache_t {
+	toy_vulkan_state_entry_t* entries;
+	uint32_t capacity; // 2^N
+	uint32_t used_count;
+	toy_allocator_t alc;
+}toy_vulkan_state_cache_t;
+
+
+TOY_EXTERN_C_START
+
+void toy_create_vulkan_state_cache (
+	const toy_allocator_t* alc,
+	toy_vulkan_state_cache_t* output,
+	toy_error_t* error
+);
+
+// Destroy objects which are still referenced, device must be idle
+void toy_destroy_vulkan_state_cache (
+	VkDevice dev,
+	const VkAllocationCallbacks* vk_alc_cb,
+	toy_vulkan_state_cache_t* cache
+);
+
+// Return a reference to the layout of bindings, create it when no layout of the same bindings is cached
+VkResult toy_acquire_vulkan_descriptor_set_layout (
+	toy_vulkan_state_cache_t* cache,
+	VkDevice dev,
+	const VkDescriptorSetLayoutBinding* bindings,
+	uint32_t binding_count,
+	const VkAllocationCallbacks* vk_alc_cb,
+	VkDescriptorSetLayout* output
+);
+
+// Return a reference to the layout of descriptor set layouts, create it when no layout of the same sets is cached
+VkResult toy_acquire_vulkan_pipeline_layout (
+	toy_vulkan_state_cache_t* cache,
+	VkDevice dev,
+	const VkDescriptorSetLayout* desc_set_layouts,
+	uint32_t desc_set_layout_count,
+	const VkAllocationCallbacks* vk_alc_cb,
+	VkPipelineLayout* output
+);
+
+// Pipeline is created by caller, key holds every parameter of its creation, shaders included.
+// Look it up before loading shaders, on a hit a reference is added and the creation is skipped
+bool toy_find_vulkan_pipeline (
+	toy_vulkan_state_cache_t* cache,
+	const void* key,
+	size_t key_size,
+	VkPipeline* output
+);
+
+// Cache a pipeline created by caller with one reference, return false when out of memory, pipeline is not cached then
+bool toy_add_vulkan_pipeline (
+	toy_vulkan_state_cache_t* cache,
+	const void* key,
+	size_t key_size,
+	VkPipeline pipeline
+);
+
+// Release a reference, object is destroyed with its last reference. Object which is not cached is destroyed at once
+void toy_release_vulkan_descriptor_set_layout (
+	toy_vulkan_state_cache_t* cache,
+	VkDevice dev,
+	const VkAllocationCallbacks* vk_alc_cb,
+	VkDescriptorSetLayout desc_set_layout
+);
+
+void toy_release_vulkan_pipeline_layout (
+	toy_vulkan_state_cache_t* cache,
+	VkDevice dev,
+	const VkAllocationCallbacks* vk_alc_cb,
+	VkPipelineLayout pipeline_layout
+);
+
+void toy_release_vulkan_pipeline (
+	toy_vulkan_state_cache_t* cache,
+	VkDevice dev,
+	const VkAllocationCallbacks* vk_alc_cb,
+	VkPipeline pipeline
+);
+
+TOY_EXTERN_C_END
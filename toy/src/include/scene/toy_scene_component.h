@@ -72,6 +72,7 @@ struct toy_scene_entity_chunk_descriptor_t {
 
 TOY_EXTERN_C_START
 
+// chunk_alc gives TOY_MEMORY_CHUNK_SIZE blocks, chunk_alc of the scene
 toy_entity_ref_t toy_create_scene_chunk_entity (
 	toy_scene_entity_chunk_descriptor_t* chunk_desc,
 	const toy_allocator_t* chunk_alc,
@@ -27,6 +27,8 @@ typedef struct toy_main_context_t {
 }toy_main_context_t;
 #endif
 
+#define TOY_ASSET_STATS_LOG_SECONDS 10 // Period of asset pool stats in log
+
 typedef struct toy_app_t toy_app_t;
 
 typedef void (*toy_app_on_frame_update_fp) (toy_app_t* app, void* user_data, uint64_t delta_ms);
@@ -38,6 +40,7 @@ typedef struct toy_app_loop_event_t {
 
 struct toy_app_t {
 	lua_State* main_vm;
+	toy_allocator_t lua_alc;
 	toy_hid_t hid;
 	toy_window_t window;
 	toy_memory_allocator_t* alc;
@@ -8,14 +8,35 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 TOY_EXTERN_C_START
 
 typedef void* (*toy_alloc_fp)(void* ctx, size_t size_in_byte);
 typedef void (*toy_free_fp)(void* ctx, void* mem);
+typedef bool (*toy_resize_fp)(void* ctx, void* mem, size_t old_size, size_t new_size);
+typedef size_t (*toy_usable_size_fp)(void* ctx, void* mem);
+typedef void* (*toy_alloc_native_aligned_fp)(void* ctx, size_t size_in_byte, size_t alignment);
+typedef void (*toy_reset_fp)(void* ctx);
+
+// Optional operations of an allocator, NULL when not supported
+typedef struct toy_allocator_ext_t {
+	toy_resize_fp resize; // Resize in place, return false when memory has to move
+	toy_usable_size_fp usable_size; // Bytes can be used from mem, return 0 when unknown
+	// Any 2^N alignment up to the one of backend memory (TOY_MEMORY_CHUNK_SIZE at least), NULL when memory is not enough.
+	// Memory is freed by free(), so an allocator which can not align its blocks natively must find the block
+	// from an address in it. Used by toy_alloc_aligned()
+	toy_alloc_native_aligned_fp alloc_aligned;
+	toy_reset_fp reset; // Free all allocations at once
+}toy_allocator_ext_t;
+
 typedef struct toy_allocator_t {
 	void* ctx; // context
 	toy_alloc_fp alloc;
 	toy_free_fp free;
+	const toy_allocator_ext_t* ext; // NULL when allocator has no optional operations
 }toy_allocator_t;
 
 toy_inline void* toy_alloc (const toy_allocator_t* alc, size_t size_in_byte) {
@@ -26,15 +47,74 @@ toy_inline void toy_free (const toy_allocator_t* alc, void* mem) {
 	alc->free(alc->ctx, mem);
 }
 
+// Memory of toy_alloc_aligned() must be freed by toy_free_aligned() with an allocator of the same ext,
+// it has a uint16 padding prefix unless allocator supports ext->alloc_aligned
 typedef void* toy_aligned_p;
 toy_aligned_p toy_alloc_aligned (const toy_allocator_t* alc, size_t size_in_byte, size_t alignment);
 void toy_free_aligned (const toy_allocator_t* alc, toy_aligned_p mem);
 
+// Return 0 when allocator does not know, otherwise it is not less than the size mem is allocated with
+toy_inline size_t toy_get_usable_size (const toy_allocator_t* alc, void* mem) {
+	if (NULL == alc->ext || NULL == alc->ext->usable_size)
+		return 0;
+	return alc->ext->usable_size(alc->ctx, mem);
+}
+
+// Resize mem in place, return false when mem is not changed
+toy_inline bool toy_resize (const toy_allocator_t* alc, void* mem, size_t old_size, size_t new_size) {
+	if (NULL == alc->ext || NULL == alc->ext->resize)
+		return false;
+	return alc->ext->resize(alc->ctx, mem, old_size, new_size);
+}
+
+// Free all allocations of alc, return false when not supported
+toy_inline bool toy_reset_allocator (const toy_allocator_t* alc) {
+	if (NULL == alc->ext || NULL == alc->ext->reset)
+		return false;
+	alc->ext->reset(alc->ctx);
+	return true;
+}
+
+// Grow or shrink mem of toy_alloc(), it is moved only when it can not be resized in place.
+// mem can be NULL. new_size 0 frees mem and returns NULL, otherwise return NULL when failed and mem is not changed
+void* toy_realloc (const toy_allocator_t* alc, void* mem, size_t old_size, size_t new_size);
+
 // find last bit set
 // toy_fls(1 << 10) == 11
 // toy_fls(1024) == 11
 // toy_fls(1) == 1
 // toy_fls(0) == 0
-int toy_fls (uint64_t x);
+toy_inline int toy_fls (uint64_t x) {
+#if defined(_MSC_VER) && (defined(_WIN64) || defined(WIN64))
+	unsigned long index;
+	return _BitScanReverse64(&index, x) ? (int)index + 1 : 0;
+#elif defined(_MSC_VER)
+	unsigned long index;
+	if (_BitScanReverse(&index, (unsigned long)(x >> 32)))
+		return (int)index + 33;
+	return _BitScanReverse(&index, (unsigned long)x) ? (int)index + 1 : 0;
+#else
+	return x ? 64 - __builtin_clzll(x) : 0;
+#endif
+}
+
+// find first bit set
+// toy_ffs(1 << 10) == 11
+// toy_ffs(0x30) == 5
+// toy_ffs(1) == 1
+// toy_ffs(0) == 0
+toy_inline int toy_ffs (uint64_t x) {
+#if defined(_MSC_VER) && (defined(_WIN64) || defined(WIN64))
+	unsigned long index;
+	return _BitScanForward64(&index, x) ? (int)index + 1 : 0;
+#elif defined(_MSC_VER)
+	unsigned long index;
+	if (_BitScanForward(&index, (unsigned long)x))
+		return (int)index + 1;
+	return _BitScanForward(&index, (unsigned long)(x >> 32)) ? (int)index + 33 : 0;
+#else
+	return x ? __builtin_ctzll(x) + 1 : 0;
+#endif
+}
 
 TOY_EXTERN_C_END
@@ -7,34 +7,77 @@
 
 typedef struct toy_asset_pool_t toy_asset_pool_t, *toy_asset_pool_p;
 
+// Handle of an item: pool id | generation | index.
+// Generation of a slot changes when its item is freed, so a stale handle resolves to NULL.
+// A slot is retired after 255 generations instead of wrapping, its memory comes back when pool is destroyed.
+// Pool with an id fails to allocate item whose index exceeds TOY_ASSET_HANDLE_INDEX_BITS.
+typedef uint32_t toy_asset_handle_t;
+
+#define TOY_ASSET_HANDLE_NULL 0 // Generation 0 is never used
+#define TOY_ASSET_HANDLE_INDEX_BITS 20
+#define TOY_ASSET_HANDLE_GENERATION_BITS 8
+#define TOY_ASSET_HANDLE_POOL_BITS 4
+#define TOY_ASSET_HANDLE_INDEX_MASK ((UINT32_C(1) << TOY_ASSET_HANDLE_INDEX_BITS) - 1)
+#define TOY_ASSET_HANDLE_GENERATION_MASK ((UINT32_C(1) << TOY_ASSET_HANDLE_GENERATION_BITS) - 1)
+#define TOY_ASSET_POOL_MAX_COUNT (1 << TOY_ASSET_HANDLE_POOL_BITS) // Max count of pools which have an id
+#define TOY_ASSET_POOL_ID_NONE UINT32_MAX
+#define TOY_ASSET_REF_FREED UINT32_C(0x80000000) // Ref count bit of an item claimed for freeing and of free blocks
+
 typedef void (*toy_destroy_asset_fp) (toy_asset_pool_p asset_pool, void* asset);
 
 
 typedef struct toy_asset_pool_chunk_t toy_asset_pool_chunk_t, *toy_asset_pool_chunk_p;
+typedef struct toy_asset_release_queue_t toy_asset_release_queue_t, *toy_asset_release_queue_p;
+typedef struct toy_asset_residency_t toy_asset_residency_t, *toy_asset_residency_p;
+typedef struct toy_asset_pool_state_t toy_asset_pool_state_t, *toy_asset_pool_state_p;
+// Items are allocated and freed by any thread without lock, free blocks of all chunks form one lock-free stack,
+// only adding a chunk takes a lock. Items, hot data, ref counts and handles are read without lock.
+// chunks array is replaced when it grows, a replaced array is kept until pool is destroyed, so readers never hold a freed one.
 typedef struct toy_asset_pool_t {
-	toy_asset_pool_chunk_p* chunks;
-	uint32_t chunk_count;
-	uint32_t chunk_block_count; // block count of each chunk, NOT total count
+	toy_asset_pool_state_p state; // Chunks, free stack and counters, all shared by threads, defined in toy_asset.cpp
+	uint32_t chunk_block_count; // block count of each chunk, NOT total count, 2^chunk_block_shift
+	uint32_t chunk_block_shift;
+	uint32_t id; // Pool id in handles, TOY_ASSET_POOL_ID_NONE when all ids are taken
 	size_t asset_size;
 	size_t asset_alignment;
+	size_t hot_size; // Size of hot data of each item, stored densely apart from items, 0 for none
 	toy_allocator_t chunk_alc;
 	toy_allocator_t alc;
 	toy_destroy_asset_fp destroy_fp;
+	toy_asset_release_queue_p release_queue; // NULL to free an item as soon as its last reference is released
+	toy_asset_residency_p residency; // Account memory of items and cache released ones, NULL to free released items
 	void* context;
 	const char* literal_name; // Just a pointer, not a copy
 }toy_asset_pool_t, *toy_asset_pool_p;
 
 
+typedef struct toy_asset_pool_stats_t {
+	uint32_t live_count;
+	uint32_t chunk_count;
+	size_t used_bytes; // Live items and their hot data
+	size_t reserved_bytes; // Chunks and chunk array
+	float fragmentation; // Ratio of free blocks in chunks, 0 when pool has no chunk
+	uint64_t alloc_count; // Since pool is initialized
+	uint64_t free_count;
+	uint32_t retired_count; // Blocks whose generation is exhausted, counted in fragmentation
+}toy_asset_pool_stats_t;
+
+
 typedef struct toy_asset_pool_item_ref_t {
 	toy_asset_pool_p pool;
 	uint32_t index;
 	uint32_t next_ref;
 }toy_asset_pool_item_ref_t;
 
+// Refs are stored in fixed-size blocks which never move, so pointers to refs stay valid while the pool grows.
+// Index of a ref is block index | index in block
 typedef struct toy_asset_item_ref_pool_t {
-	toy_asset_pool_item_ref_t* refs;
-	uint32_t pool_length;
-	uint32_t next_block;
+	toy_asset_pool_item_ref_t** blocks;
+	uint32_t block_count;
+	uint32_t block_capacity; // Length of blocks array, grows geometrically
+	uint32_t block_shift; // Each block has 2^block_shift refs
+	uint32_t pool_length; // Count of refs in all blocks
+	uint32_t next_block; // Head of free refs, UINT32_MAX when every ref is allocated
 	toy_allocator_t alc;
 }toy_asset_item_ref_pool_t;
 
@@ -131,15 +174,18 @@ typedef struct toy_image_sampler_t {
 
 TOY_EXTERN_C_START
 
+// hot_size: Fields read by every frame can be copied to hot data, see toy_get_asset_hot_item()
 void toy_init_asset_pool (
 	size_t asset_size,
 	size_t asset_alignment,
+	size_t hot_size,
 	toy_destroy_asset_fp destroy_asset_fp,
 	const toy_allocator_t* chunk_alc,
 	const toy_allocator_t* alc,
 	void* context,
 	const char* literal_name,
-	toy_asset_pool_t* output
+	toy_asset_pool_t* output,
+	toy_error_t* error
 );
 
 void toy_destroy_asset_pool (
@@ -149,6 +195,9 @@ void toy_destroy_asset_pool (
 
 void* toy_get_asset_item (toy_asset_pool_p pool, uint32_t index);
 
+// Hot data of item, packed by hot_size from a pointer aligned base, owner of the pool keeps it in sync with item
+void* toy_get_asset_hot_item (toy_asset_pool_p pool, uint32_t index);
+
 toy_inline void* toy_get_asset_item2 (toy_asset_pool_item_ref_t* ref) {
 	return toy_get_asset_item(ref->pool, ref->index);
 }
@@ -164,18 +213,79 @@ void toy_raw_free_asset_item (
 	uint32_t index
 );
 
-// Destroy and free asset item
+// Destroy and free asset item, item has no reference
 void toy_free_asset_item (
 	toy_asset_pool_p pool,
 	uint32_t index
 );
 
+// Destroy and free an item which may be referenced again by another thread.
+// Its ref_count is claimed from 0, so a reference added at the same time fails instead of landing on a freed item.
+// Return false when item is referenced, it is kept then
+bool toy_try_free_asset_item (
+	toy_asset_pool_p pool,
+	uint32_t index
+);
+
+void toy_get_asset_pool_stats (toy_asset_pool_p pool, toy_asset_pool_stats_t* output);
+
+// Item of a pool with residency leaves the residency cache when it gets its first reference again.
+// Return ref count before, or TOY_ASSET_REF_FREED when item is being freed, no reference is added then
 uint32_t toy_add_asset_ref (toy_asset_pool_p pool, uint32_t index, uint32_t ref_count);
 
 uint32_t toy_sub_asset_ref (toy_asset_pool_p pool, uint32_t index, uint32_t ref_count);
 
 uint32_t toy_get_asset_ref (toy_asset_pool_p pool, uint32_t index);
 
+// Handle of an allocated item, valid until the item is freed
+toy_asset_handle_t toy_get_asset_handle (toy_asset_pool_p pool, uint32_t index);
+
+// Return NULL when handle is TOY_ASSET_HANDLE_NULL or its item has been freed
+void* toy_resolve_asset_handle (toy_asset_handle_t handle);
+
+// Return NULL when pool of handle is destroyed
+toy_asset_pool_p toy_get_asset_handle_pool (toy_asset_handle_t handle);
+
+toy_inline uint32_t toy_get_asset_handle_index (toy_asset_handle_t handle) {
+	return handle & TOY_ASSET_HANDLE_INDEX_MASK;
+}
+
+// Same as toy_add_asset_ref(), TOY_ASSET_REF_FREED for a stale handle too
+uint32_t toy_add_asset_handle_ref (toy_asset_handle_t handle, uint32_t ref_count);
+
+// True when frames which may use the item up to its latest release are finished, always true for pool without release queue
+bool toy_is_asset_release_complete (toy_asset_pool_p pool, uint32_t index);
+
+// Sub one reference, free item when no reference is left.
+// Item of a pool with release_queue is queued, it is freed by toy_collect_released_assets().
+void toy_release_asset_item (toy_asset_pool_p pool, uint32_t index);
+
+void toy_release_asset_handle (toy_asset_handle_t handle);
+
+
+toy_asset_release_queue_p toy_create_asset_release_queue (
+	const toy_allocator_t* alc,
+	toy_error_t* error
+);
+
+// Free every queued item, device must be idle
+void toy_destroy_asset_release_queue (toy_asset_release_queue_p queue);
+
+// Start next frame, and free items released TOY_CONCURRENT_FRAME_MAX frames ago until budget_us is spent,
+// item of a pool with residency goes to its cache instead.
+// Call once per swapchain frame, after finish fence of the frame slot is waited.
+// Item which gets a new reference after its release is kept until its latest release is old enough. Return count of collected entries.
+uint32_t toy_collect_released_assets (
+	toy_asset_release_queue_p queue,
+	uint32_t budget_us
+);
+
+// Free every queued item now, device must be idle
+void toy_flush_asset_release_queue (toy_asset_release_queue_p queue);
+
+uint32_t toy_get_asset_release_queue_length (toy_asset_release_queue_p queue);
+
+// initial_length is rounded up to 2^N, it is the length of each block too
 void toy_create_asset_item_ref_pool (
 	uint32_t initial_length,
 	const toy_allocator_t* alc,
@@ -185,17 +295,17 @@ void toy_create_asset_item_ref_pool (
 
 void toy_destroy_asset_ref_pool (toy_asset_item_ref_pool_t* ref_pool);
 
-// return UINT32_MAX when failed
+// return UINT32_MAX when failed, returned ref keeps its pointer until it is freed
 uint32_t toy_alloc_asset_item_ref (toy_asset_item_ref_pool_t* ref_pool);
 
 void toy_free_asset_item_ref (toy_asset_item_ref_pool_t* ref_pool, uint32_t index);
 
 toy_inline toy_asset_pool_item_ref_t* toy_get_asset_item_ref (toy_asset_item_ref_pool_t* ref_pool, uint32_t index) {
-	return &ref_pool->refs[index];
+	return &ref_pool->blocks[index >> ref_pool->block_shift][index & ((UINT32_C(1) << ref_pool->block_shift) - 1)];
 }
 
 toy_inline toy_asset_pool_item_ref_t* toy_get_next_asset_item_ref (toy_asset_item_ref_pool_t* ref_pool, toy_asset_pool_item_ref_t* ref) {
-	return ref->next_ref >= ref_pool->pool_length ? NULL : &ref_pool->refs[ref->next_ref];
+	return ref->next_ref >= ref_pool->pool_length ? NULL : toy_get_asset_item_ref(ref_pool, ref->next_ref);
 }
 
 TOY_EXTERN_C_END
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "toy_platform.h"
+
+#include "toy_error.h"
+#include "toy_allocator.h"
+
+
+TOY_EXTERN_C_START
+
+typedef struct toy_asset_load_queue_t toy_asset_load_queue_t, *toy_asset_load_queue_p;
+
+typedef struct toy_asset_load_job_t toy_asset_load_job_t;
+
+// Run on a worker thread, it may alloc and free items of asset pools, but must not touch registry or device
+typedef void (*toy_run_asset_load_job_fp) (toy_asset_load_job_t* job);
+
+// Embedded in a load request, queue allocates nothing per job
+struct toy_asset_load_job_t {
+	toy_asset_load_job_t* next; // Owned by queue
+	toy_run_asset_load_job_fp run_fp;
+};
+
+
+// Worker threads which run jobs in pushed order, finished jobs are popped by owner thread
+toy_asset_load_queue_p toy_create_asset_load_queue (
+	uint32_t worker_count,
+	const toy_allocator_t* alc,
+	toy_error_t* error
+);
+
+// Run every pushed job and join workers, finished jobs can still be popped
+void toy_join_asset_load_queue (toy_asset_load_queue_p queue);
+
+// Join workers if they are running, finished jobs which are not popped are dropped
+void toy_destroy_asset_load_queue (toy_asset_load_queue_p queue);
+
+void toy_push_asset_load_job (toy_asset_load_queue_p queue, toy_asset_load_job_t* job);
+
+// Return NULL when no job is finished
+toy_asset_load_job_t* toy_pop_finished_asset_load_job (toy_asset_load_queue_p queue);
+
+TOY_EXTERN_C_END
@@ -4,6 +4,9 @@
 #include "toy_error.h"
 #include "toy_memory.h"
 #include "toy_asset.h"
+#include "toy_asset_registry.h"
+#include "toy_asset_residency.h"
+#include "toy_asset_load_queue.h"
 #include "toy_file.h"
 
 #include "platform/vulkan/toy_vulkan_asset.h"
@@ -11,6 +14,55 @@
 #include "platform/vulkan/toy_vulkan_asset_loader.h"
 
 
+// Default residency budget, change it by toy_set_asset_residency_budget()
+#define TOY_ASSET_MANAGER_HOST_BUDGET (16 * 1024 * 1024)
+#define TOY_ASSET_MANAGER_DEVICE_BUDGET (256 * 1024 * 1024)
+
+#define TOY_ASSET_MANAGER_POOL_MAX 8 // Pools walked by telemetry, at most every pool of asset_pools
+#define TOY_ASSET_TELEMETRY_RATE_WEIGHT 0.0625f // Weight of the last frame in moving average of rates
+#define TOY_ASSET_MANAGER_LOAD_WORKER_COUNT 2 // Threads which read and decode files of async loads
+
+enum toy_asset_load_state_t {
+	TOY_ASSET_LOAD_STATE_PENDING = 0, // Reading, decoding or uploading
+	TOY_ASSET_LOAD_STATE_DONE,
+	TOY_ASSET_LOAD_STATE_FAILED,
+};
+
+// Called by toy_update_asset_loads() when a load is done or failed, unless the load has been released
+typedef void (*toy_asset_load_callback_fp) (
+	void* user_data,
+	toy_asset_handle_t load,
+	enum toy_asset_load_state_t state,
+	toy_asset_handle_t asset
+);
+
+typedef struct toy_asset_load_request_t toy_asset_load_request_t;
+
+// Sync load staged into the open upload batch, see toy_begin_asset_upload_batch()
+typedef struct toy_asset_upload_batch_item_t {
+	toy_asset_handle_t handle;
+	uint32_t kind; // enum toy_asset_kind_t, image or mesh primitive
+}toy_asset_upload_batch_item_t;
+
+// Counters of a pool sampled by toy_mark_asset_manager_frame()
+typedef struct toy_asset_pool_telemetry_t {
+	uint64_t alloc_count; // Total at last mark
+	uint64_t free_count;
+	uint32_t frame_alloc_count; // During last marked frame
+	uint32_t frame_free_count;
+	float alloc_rate; // Moving average per frame
+	float free_rate;
+}toy_asset_pool_telemetry_t;
+
+typedef struct toy_asset_manager_pool_stats_t {
+	const char* name; // literal_name of pool
+	toy_asset_pool_stats_t pool;
+	uint32_t frame_alloc_count;
+	uint32_t frame_free_count;
+	float alloc_rate;
+	float free_rate;
+}toy_asset_manager_pool_stats_t;
+
 typedef struct toy_asset_manager_vulkan_private_t {
 	toy_vulkan_driver_t* vk_driver;
 	toy_vulkan_asset_loader_t vk_asset_loader;
@@ -27,22 +79,39 @@ typedef struct toy_asset_manager_t {
 	toy_allocator_t stack_alc_L;
 	toy_allocator_t stack_alc_R;
 
-	toy_memory_pool_p chunk_pools;
-	toy_allocator_t chunk_alc;
+	toy_allocator_t chunk_alc; // concurrent_chunk_alc of alc, pools take chunks from load workers as well
 
 	struct {
 		toy_asset_pool_t image;
-		toy_asset_pool_t image_sampler; // Todo: hash sample paremeters as key, and use hash table, add a default sampler
+		toy_asset_pool_t image_sampler; // Shared by parameters through registry, Todo: add a default sampler
 		toy_asset_pool_t material;
 		toy_asset_pool_t mesh_primitive;
 		toy_asset_pool_t mesh;
 		toy_asset_pool_t scene;
 		//toy_asset_pool_t file;
 		toy_asset_pool_t font;
+		toy_asset_pool_t load_request; // Async loads, see toy_load_texture2d_async()
 	} asset_pools;
 
 	toy_asset_item_ref_pool_t item_ref_pool;
 	toy_asset_data_ref_pool_t data_ref_pool;
+	toy_asset_release_queue_p release_queue; // Items of GPU assets are freed after frames which use them are finished
+	toy_asset_registry_t registry; // Loaded images by path, materials and samplers by content
+	toy_asset_residency_p residency; // Memory of images and mesh primitives, released ones are kept until budget is exceeded
+	toy_asset_pool_p pools[TOY_ASSET_MANAGER_POOL_MAX]; // Every initialized pool of asset_pools, in init order
+	uint32_t pool_count;
+	toy_asset_pool_telemetry_t telemetry[TOY_ASSET_MANAGER_POOL_MAX]; // Of pools[i]
+
+	toy_asset_load_queue_p load_queue; // Workers read and decode files of async loads
+	toy_asset_load_request_t* upload_head; // FIFO of decoded loads waiting for the loader
+	toy_asset_load_request_t* upload_tail;
+	toy_asset_load_request_t* uploading_head; // FIFO of submitted loads in serial order, several stage batches may be in flight
+	toy_asset_load_request_t* uploading_tail;
+	bool upload_batch_open; // Between toy_begin_asset_upload_batch() and toy_end_asset_upload_batch()
+	toy_asset_upload_batch_item_t* upload_batch_items; // Loads of the open batch not submitted yet, tracked when uploaded, unregistered when failed
+	uint32_t upload_batch_item_count;
+	uint32_t upload_batch_item_capacity;
+	uint32_t upload_batch_failed_count; // Loads of the open batch whose upload failed, reported by toy_end_asset_upload_batch()
 
 	toy_asset_manager_vulkan_private_t vk_private;
 }toy_asset_manager_t;
@@ -62,6 +131,8 @@ void toy_destroy_asset_manager (
 	toy_asset_manager_t* asset_mgr
 );
 
+// Loads return a reference to the item. An image of the same path is shared rather than loaded again,
+// mesh primitives are not shared, pass a primitive index and add a reference to it to share one
 uint32_t toy_load_mesh_primitive (
 	toy_asset_manager_t* asset_mgr,
 	const toy_host_mesh_primitive_t* primitive_data,
@@ -71,20 +142,99 @@ uint32_t toy_load_mesh_primitive (
 void toy_load_texture2d (
 	toy_asset_manager_t* asset_mgr,
 	const char* utf8_path,
-	toy_asset_pool_item_ref_t* output,
+	toy_asset_handle_t* output,
 	toy_error_t* error
 );
 
+// Sync loads between begin and end are staged into one transfer, end submits it once and waits for it.
+// Their handles are returned at once, but they can not be drawn before end.
+// End fails when upload of any of them failed, then none of them is shared or tracked by residency,
+// their mesh primitives draw nothing and their images have undefined pixels, release them
+void toy_begin_asset_upload_batch (toy_asset_manager_t* asset_mgr);
+
+void toy_end_asset_upload_batch (toy_asset_manager_t* asset_mgr, toy_error_t* error);
+
 uint32_t toy_alloc_material (
 	toy_asset_manager_t* asset_mgr,
 	size_t size,
 	toy_error_t* error
 );
 
-toy_asset_pool_item_ref_t toy_create_image_sampler (
+// Take a reference of a filled material from toy_alloc_material(), size is the size of its data.
+// Return the index of an existing material with the same data and free the given one,
+// or register the given one and return its index
+uint32_t toy_share_material (
+	toy_asset_manager_t* asset_mgr,
+	uint32_t material_index,
+	size_t size,
+	toy_error_t* error
+);
+
+// Residency priority of primitive and images of a drawn mesh, they are evicted in this order after their release.
+// Renderer passes negative distance to camera, see toy_set_asset_residency_priority()
+void toy_set_mesh_residency_priority (
+	toy_asset_manager_t* asset_mgr,
+	uint32_t mesh_index,
+	float priority
+);
+
+// Return a reference to a sampler, samplers of the same parameters are one VkSampler
+toy_asset_handle_t toy_create_image_sampler (
 	toy_asset_manager_t* asset_mgr,
 	toy_image_sampler_t* sampler_params,
 	toy_error_t* error
 );
 
+// Return a load handle at once, file is read and decoded by a worker thread, and uploaded by toy_update_asset_loads().
+// A path which is being loaded is not read again, the new load finishes with the pending one.
+// callback can be NULL, it is called on the thread of toy_update_asset_loads()
+toy_asset_handle_t toy_load_texture2d_async (
+	toy_asset_manager_t* asset_mgr,
+	const char* utf8_path,
+	toy_asset_load_callback_fp callback,
+	void* user_data,
+	toy_error_t* error
+);
+
+// Attributes and indices are copied, attr_desc is not kept
+toy_asset_handle_t toy_load_mesh_primitive_async (
+	toy_asset_manager_t* asset_mgr,
+	const toy_host_mesh_primitive_t* primitive_data,
+	toy_asset_load_callback_fp callback,
+	void* user_data,
+	toy_error_t* error
+);
+
+// output_asset is set when load is done, the load keeps a reference of it until toy_release_asset_load(),
+// take another one by toy_add_asset_handle_ref() to keep the asset
+enum toy_asset_load_state_t toy_get_asset_load_state (
+	toy_asset_manager_t* asset_mgr,
+	toy_asset_handle_t load,
+	toy_asset_handle_t* output_asset
+);
+
+// A pending load is cancelled, its asset is released when it finishes
+void toy_release_asset_load (toy_asset_manager_t* asset_mgr, toy_asset_handle_t load);
+
+// Return false when load is not a live load handle of asset_mgr, or it has been released.
+// Check handles from scripts with it, the other load functions assert
+bool toy_is_asset_load_valid (toy_asset_manager_t* asset_mgr, toy_asset_handle_t load);
+
+// Finish decoded loads and poll submitted transfers. Call once per frame.
+// Decoded loads which fit in free stage ring are uploaded by one submit while earlier ones are in flight,
+// device is waited for only when a load is larger than the whole ring
+void toy_update_asset_loads (toy_asset_manager_t* asset_mgr);
+
+// Sample alloc and free counts of pools, call once per frame
+void toy_mark_asset_manager_frame (toy_asset_manager_t* asset_mgr);
+
+// Fill stats of every pool, return count of them
+uint32_t toy_get_asset_manager_stats (
+	toy_asset_manager_t* asset_mgr,
+	toy_asset_manager_pool_stats_t output[TOY_ASSET_MANAGER_POOL_MAX]
+);
+
+// Log a line of stats for every pool
+void toy_log_asset_manager_stats (toy_asset_manager_t* asset_mgr);
+
 TOY_EXTERN_C_END
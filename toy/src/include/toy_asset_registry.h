@@ -0,0 +1,97 @@
+#pragma once
+
+#include "toy_platform.h"
+
+#include "toy_error.h"
+#include "toy_allocator.h"
+#include "toy_asset.h"
+
+
+TOY_EXTERN_C_START
+
+#define TOY_ASSET_REGISTRY_MIN_CAPACITY 256
+#define TOY_ASSET_REGISTRY_STRING_BLOCK_SIZE 4096
+
+enum toy_asset_kind_t {
+	TOY_ASSET_KIND_IMAGE = 0,
+	TOY_ASSET_KIND_MESH_PRIMITIVE,
+	TOY_ASSET_KIND_MATERIAL,
+	TOY_ASSET_KIND_IMAGE_SAMPLER, // Content is toy_image_sampler_t
+	TOY_ASSET_KIND_IMAGE_LOAD, // Path of an async image load, handle is the load, see toy_load_texture2d_async()
+	TOY_ASSET_KIND_COUNT,
+};
+
+// Key is (kind, path) or (kind, content_hash)
+typedef struct toy_asset_registry_entry_t {
+	uint64_t hash; // Hash of key, 0 for empty slot
+	uint64_t content_hash; // Key when path is NULL
+	const char* path; // Interned path
+	toy_asset_handle_t handle; // May be stale, its item has been freed
+	uint32_t kind; // enum toy_asset_kind_t
+}toy_asset_registry_entry_t;
+
+// Interned strings, rehash copies paths of live entries to new blocks and frees the old ones
+typedef struct toy_asset_registry_string_block_t {
+	struct toy_asset_registry_string_block_t* next;
+	size_t used;
+	size_t size; // Size of characters after this header
+}toy_asset_registry_string_block_t;
+
+// Open addressing hash table from path or content hash to asset handle.
+// An entry of freed item is found by nothing, it is reused when the same key is registered again.
+// NOT thread-safe
+typedef struct toy_asset_registry_t {
+	toy_asset_registry_entry_t* entries;
+	uint32_t capacity; // 2^N
+	uint32_t used_count; // Occupied entries, stale ones included
+	toy_asset_registry_string_block_t* strings;
+	toy_allocator_t alc;
+}toy_asset_registry_t;
+
+
+void toy_create_asset_registry (
+	const toy_allocator_t* alc,
+	toy_asset_registry_t* output,
+	toy_error_t* error
+);
+
+void toy_destroy_asset_registry (toy_asset_registry_t* registry);
+
+// Fast 64-bit hash of bytes, not for security
+uint64_t toy_hash_asset_content (const void* data, size_t size, uint64_t seed);
+
+// Return TOY_ASSET_HANDLE_NULL when key is not registered or its item has been freed
+toy_asset_handle_t toy_find_asset_by_path (
+	toy_asset_registry_t* registry,
+	enum toy_asset_kind_t kind,
+	const char* utf8_path
+);
+
+toy_asset_handle_t toy_find_asset_by_content (
+	toy_asset_registry_t* registry,
+	enum toy_asset_kind_t kind,
+	uint64_t content_hash
+);
+
+// Map key to handle, replace handle of registered key, return false when out of memory
+bool toy_register_asset_path (
+	toy_asset_registry_t* registry,
+	enum toy_asset_kind_t kind,
+	const char* utf8_path,
+	toy_asset_handle_t handle
+);
+
+bool toy_register_asset_content (
+	toy_asset_registry_t* registry,
+	enum toy_asset_kind_t kind,
+	uint64_t content_hash,
+	toy_asset_handle_t handle
+);
+
+// Clear every key mapped to handle, so an item which failed to load is found by nothing. Walks whole table
+void toy_unregister_asset (
+	toy_asset_registry_t* registry,
+	toy_asset_handle_t handle
+);
+
+TOY_EXTERN_C_END
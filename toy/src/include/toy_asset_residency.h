@@ -0,0 +1,87 @@
+#pragma once
+
+#include "toy_platform.h"
+
+#include "toy_error.h"
+#include "toy_allocator.h"
+#include "toy_asset.h"
+
+
+TOY_EXTERN_C_START
+
+#define TOY_ASSET_RESIDENCY_EVICT_SCAN 8 // Count of least recently released items compared by priority in an eviction
+
+typedef struct toy_asset_residency_budget_t {
+	size_t host_bytes;
+	size_t device_bytes;
+}toy_asset_residency_budget_t;
+
+typedef struct toy_asset_residency_stats_t {
+	size_t host_bytes; // Tracked items, cached ones included
+	size_t device_bytes;
+	size_t cached_host_bytes; // Released items which are kept
+	size_t cached_device_bytes;
+	uint32_t item_count;
+	uint32_t cached_count;
+}toy_asset_residency_stats_t;
+
+
+// Account memory of items in pools whose residency field points to it.
+// An item released by the release queue is kept in a LRU cache rather than freed,
+// so it can be referenced again through registry, until toy_trim_asset_residency() evicts it to meet budget.
+// A cached item which gets a reference again leaves the cache, it comes back when its new release is collected.
+toy_asset_residency_p toy_create_asset_residency (
+	const toy_asset_residency_budget_t* budget,
+	const toy_allocator_t* alc,
+	toy_error_t* error
+);
+
+// Cached items must be evicted by toy_flush_asset_residency() first
+void toy_destroy_asset_residency (toy_asset_residency_p residency);
+
+void toy_set_asset_residency_budget (
+	toy_asset_residency_p residency,
+	const toy_asset_residency_budget_t* budget
+);
+
+// Start accounting a loaded item, return false when out of memory, then item is not accounted and not cached
+bool toy_track_asset_residency (
+	toy_asset_residency_p residency,
+	toy_asset_handle_t handle,
+	size_t host_bytes,
+	size_t device_bytes
+);
+
+// Called by toy_free_asset_item(), nothing happens for an untracked item
+void toy_untrack_asset_residency (toy_asset_residency_p residency, toy_asset_handle_t handle);
+
+// Called by the release queue for an item which has no reference, return false when item should be freed now
+bool toy_cache_released_asset (toy_asset_residency_p residency, toy_asset_handle_t handle);
+
+// Called by toy_add_asset_ref() when a released item gets its first reference again, so it is not evicted while used
+void toy_reuse_cached_asset (toy_asset_residency_p residency, toy_asset_handle_t handle);
+
+// Cached item of lower priority is evicted first, e.g. negative distance to camera when it was last drawn. Default is 0.
+// Priority is kept while item is referenced, so renderer sets it for items it draws
+void toy_set_asset_residency_priority (
+	toy_asset_residency_p residency,
+	toy_asset_handle_t handle,
+	float priority
+);
+
+// Free cached items until memory is under budget, return count of freed items.
+// The lowest priority one of TOY_ASSET_RESIDENCY_EVICT_SCAN least recently released items is evicted first.
+// Referenced items and items whose latest release may still be used by GPU are never evicted, so memory can stay over budget.
+uint32_t toy_trim_asset_residency (toy_asset_residency_p residency);
+
+// Free every cached item, device must be idle
+void toy_flush_asset_residency (toy_asset_residency_p residency);
+
+// pool_id is id of a pool, or TOY_ASSET_POOL_ID_NONE for all pools
+void toy_get_asset_residency_stats (
+	toy_asset_residency_p residency,
+	uint32_t pool_id,
+	toy_asset_residency_stats_t* output
+);
+
+TOY_EXTERN_C_END
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "toy_platform.h"
+
+
+TOY_EXTERN_C_START
+
+// Micro benchmarks of engine allocators, results are logged.
+// Run from command line of the demo without window: --bench <name>, or --bench all
+int toy_run_bench_main (const char* name);
+
+TOY_EXTERN_C_END
@@ -111,6 +111,7 @@ enum toy_error_enum_t {
 	TOY_ERROR_MEMORY_MAPPING_FAILED,
 	TOY_ERROR_MEMORY_FLUSH_FAILED,
 	TOY_ERROR_RENDER_RECORD_CMD_FAILED,
+	TOY_ERROR_FILE_WRITE_FAILED,
 };
 
 
@@ -12,10 +12,13 @@
 #include <lauxlib.h>
 #endif
 
+struct toy_asset_manager_t;
+
 TOY_EXTERN_C_START
 
 
-lua_State* toy_lua_new_vm ();
+// alc must be alive until lua_close(), NULL to use the default allocator of Lua
+lua_State* toy_lua_new_vm (const toy_allocator_t* alc);
 
 
 /* call a lua function, fmt only accept:
@@ -54,4 +57,15 @@ toy_inline void toy_lua_rawget_table (lua_State* lua_vm, const char* key) {
 void toy_lua_rawget_string (lua_State* lua_vm, const char* key, char* dst, size_t dst_size);
 lua_Integer toy_lua_rawget_integer (lua_State* lua_vm, const char* key);
 
+/* Set global functions of asset manager:
+   toy_asset_stats() returns a table of pool name to stats:
+   { live, chunks, used_bytes, reserved_bytes, fragmentation, alloc_count, free_count,
+     frame_alloc, frame_free, alloc_rate, free_rate }
+   toy_load_texture_async(path) returns load handle, or nil and error message
+   toy_get_asset_load(load) returns "pending", "done" or "failed", and asset handle when done
+   toy_release_asset_load(load) releases load and its reference of asset
+   asset_mgr must be alive until lua_close()
+ */
+int toy_lua_open_asset_manager (lua_State* lua_vm, struct toy_asset_manager_t* asset_mgr);
+
 TOY_EXTERN_C_END
@@ -4,10 +4,25 @@
 
 #include "toy_error.h"
 #include "toy_allocator.h"
+#include "toy_memory_thread_cache.h"
+#include "toy_memory_profile.h"
+#include "toy_memory_frame.h"
+#include "toy_memory_concurrent_pool.h"
+#include "toy_memory_vm.h"
+#include "toy_memory_slab.h"
+#include "toy_memory_trace.h"
 
 
 TOY_EXTERN_C_START
 
+#define TOY_MEMORY_STACK_ALIGNMENT sizeof(void*) // Alignment of toy_stack_alloc_L() and toy_stack_alloc_R()
+
+// Header of a block taken from overflow allocator when stack is full
+typedef struct toy_memory_stack_overflow_t {
+	struct toy_memory_stack_overflow_t* next;
+	void* memory;
+}toy_memory_stack_overflow_t;
+
 typedef struct toy_memory_stack_t {
 	struct toy_memory_stack_t* next;
 
@@ -16,8 +31,22 @@ typedef struct toy_memory_stack_t {
 
 	uintptr_t left_top;
 	uintptr_t right_top;
+
+	toy_allocator_t overflow_alc; // overflow_alc.alloc is NULL when overflow is disabled
+	toy_memory_stack_overflow_t* overflow_L; // Live overflow blocks of left side, newest first
+	toy_memory_stack_overflow_t* overflow_R;
+
+	toy_memory_vm_t* vm; // Pages are committed on demand when vm is not NULL
+	uintptr_t commit_L; // Memory below commit_L is committed
+	uintptr_t commit_R; // Memory above commit_R is committed
 }toy_memory_stack_t, *toy_memory_stack_p;
 
+// Saved top of one side, see toy_rollback_stack_L() and toy_rollback_stack_R()
+typedef struct toy_memory_stack_marker_t {
+	uintptr_t top;
+	toy_memory_stack_overflow_t* overflow;
+}toy_memory_stack_marker_t;
+
 
 void toy_init_memory_stack (
 	void* memory,
@@ -25,6 +54,20 @@ void toy_init_memory_stack (
 	toy_memory_stack_t* output
 );
 
+// Allocations which do not fit in stack go to overflow_alc, NULL overflow_alc to disable it.
+// overflow_alc is copied, no overflow block may be alive.
+void toy_set_stack_overflow_allocator (
+	toy_memory_stack_t* stack,
+	const toy_allocator_t* overflow_alc
+);
+
+// alignment must be 2^N, no header is stored
+void* toy_stack_alloc_aligned_L (
+	toy_memory_stack_t* stack,
+	size_t size,
+	size_t alignment
+);
+
 void* toy_stack_alloc_L (
 	toy_memory_stack_t* stack,
 	size_t size
@@ -35,6 +78,21 @@ void toy_stack_free_L (
 	void* memory
 );
 
+// Only the top-most allocation of left side can be resized, return false when memory is not changed
+bool toy_stack_resize_L (
+	toy_memory_stack_t* stack,
+	void* memory,
+	size_t old_size,
+	size_t new_size
+);
+
+// alignment must be 2^N, previous top is stored in a uintptr_t before returned memory
+void* toy_stack_alloc_aligned_R (
+	toy_memory_stack_t* stack,
+	size_t size,
+	size_t alignment
+);
+
 void* toy_stack_alloc_R (
 	toy_memory_stack_t* stack,
 	size_t size
@@ -45,23 +103,46 @@ void toy_stack_free_R (
 	void* memory
 );
 
-toy_inline void toy_clear_stack_L (toy_memory_stack_t* stack) {
-	stack->left_top = stack->bottom;
-}
+// Like toy_stack_alloc_aligned_R() without header, released only by toy_rollback_stack_R() or clear
+void* toy_stack_push_R (
+	toy_memory_stack_t* stack,
+	size_t size,
+	size_t alignment
+);
 
-toy_inline void toy_clear_stack_R (toy_memory_stack_t* stack) {
-	stack->right_top = stack->bottom + stack->size;
+toy_inline toy_memory_stack_marker_t toy_get_stack_marker_L (toy_memory_stack_t* stack) {
+	toy_memory_stack_marker_t marker = { stack->left_top, stack->overflow_L };
+	return marker;
 }
 
-toy_inline void toy_clear_stack (toy_memory_stack_t* stack) {
-	stack->left_top = stack->bottom;
-	stack->right_top = stack->bottom + stack->size;
+toy_inline toy_memory_stack_marker_t toy_get_stack_marker_R (toy_memory_stack_t* stack) {
+	toy_memory_stack_marker_t marker = { stack->right_top, stack->overflow_R };
+	return marker;
 }
 
+// Release every allocation of left side after marker was taken
+void toy_rollback_stack_L (
+	toy_memory_stack_t* stack,
+	toy_memory_stack_marker_t marker
+);
+
+// Release every allocation of right side after marker was taken
+void toy_rollback_stack_R (
+	toy_memory_stack_t* stack,
+	toy_memory_stack_marker_t marker
+);
+
+void toy_clear_stack_L (toy_memory_stack_t* stack);
+
+void toy_clear_stack_R (toy_memory_stack_t* stack);
+
+void toy_clear_stack (toy_memory_stack_t* stack);
+
 
 
 typedef struct toy_memory_pool_t {
 	struct toy_memory_pool_t* next;
+	struct toy_memory_pool_t* next_available; // Next pool which has free blocks in toy_memory_pool_chain_t
 
 	size_t alignment;
 	size_t block_size;
@@ -69,6 +150,7 @@ typedef struct toy_memory_pool_t {
 
 	uint32_t next_free_block_index;
 	uint32_t allocated_block_count;
+	uint32_t fresh_block_index; // Blocks from here have never been allocated, they are not linked yet
 
 	uintptr_t block_area;
 	size_t size; // size of block_area
@@ -102,14 +184,33 @@ void* toy_pool_block_alloc (toy_memory_pool_p pool, size_t size);
 void toy_pool_block_free (toy_memory_pool_p pool, void* block);
 
 
+// Growable pools, each pool is a segment aligned to segment_size,
+// so the owner of a block is found by masking the block address
+typedef struct toy_memory_pool_chain_t {
+	toy_memory_pool_p pools; // All pools
+	toy_memory_pool_p available_pools; // Pools which have free blocks
+	size_t segment_size; // 2^N, pool header included
+	size_t block_size;
+	toy_memory_vm_t* vm; // Segments are taken from vm first when it is not NULL
+	uintptr_t vm_top;
+}toy_memory_pool_chain_t, *toy_memory_pool_chain_p;
+
+toy_inline toy_memory_pool_p toy_get_memory_pool_owner (void* memory, toy_memory_pool_chain_p chain) {
+	return (toy_memory_pool_p)((uintptr_t)memory & ~(uintptr_t)(chain->segment_size - 1));
+}
+
+
 
 #define TOY_MEMORY_BUDDY_ORDER_MAX 30
 typedef struct toy_memory_buddy_t {
 	uintptr_t memory;
-	size_t size; // size of buddy block, this header and footer included
-	int shift;
+	size_t size; // size of buddy memory, block state table included
+	int shift; // order of the smallest block
 	int max_order;
+	uint32_t order_bitmap; // bit N is set when heads[N] is not empty
+	uint8_t* block_states; // order and tag of each smallest block, stored at the tail of memory
 	uintptr_t heads[TOY_MEMORY_BUDDY_ORDER_MAX];
+	toy_memory_vm_t* vm; // Pages are committed on demand when vm is not NULL
 }toy_memory_buddy_t, *toy_memory_buddy_p;
 
 
@@ -117,6 +218,7 @@ void toy_init_buddy_allocator (
 	toy_aligned_p memory,
 	size_t memory_size,
 	uint32_t order_shift,
+	toy_memory_vm_t* vm, // NULL when memory is committed
 	toy_memory_buddy_t* output
 );
 
@@ -130,10 +232,34 @@ void toy_buddy_free (
 	void* memory
 );
 
+// alignment must be 2^N, return NULL when it is bigger than the alignment of buddy memory
+void* toy_buddy_alloc_aligned (
+	toy_memory_buddy_t* buddy,
+	size_t size,
+	size_t alignment
+);
+
+// Shrink always succeeds, grow succeeds when the buddies on the way are free
+bool toy_buddy_resize (
+	toy_memory_buddy_t* buddy,
+	void* memory,
+	size_t old_size,
+	size_t new_size
+);
+
+size_t toy_get_buddy_usable_size (
+	toy_memory_buddy_t* buddy,
+	void* memory
+);
+
+// Free all blocks
+void toy_reset_buddy_allocator (toy_memory_buddy_t* buddy);
+
 
 
 typedef struct toy_memory_list_t {
 	struct toy_memory_list_t* next;
+	struct toy_memory_list_t* next_available; // Next list which has free chunks in toy_memory_list_chain_t
 	uintptr_t memory;
 	size_t size; // memory size
 	uintptr_t free_list;
@@ -161,30 +287,169 @@ toy_inline bool toy_is_memory_in_list (void* memory, toy_memory_list_p list) {
 }
 
 
+// Growable lists, each list is a segment aligned to segment_size,
+// so the owner of a chunk is found by masking the chunk address
+typedef struct toy_memory_list_chain_t {
+	toy_memory_list_p lists; // All lists
+	toy_memory_list_p available_lists; // Lists which have free chunks
+	size_t segment_size; // 2^N, list header included
+	toy_memory_vm_t* vm; // Segments are taken from vm first when it is not NULL
+	uintptr_t vm_top;
+}toy_memory_list_chain_t, *toy_memory_list_chain_p;
+
+toy_inline toy_memory_list_p toy_get_memory_list_owner (void* memory, toy_memory_list_chain_p chain) {
+	return (toy_memory_list_p)((uintptr_t)memory & ~(uintptr_t)(chain->segment_size - 1));
+}
+
+
+
+// Two-Level Segregated Fit allocator, O(1) alloc and free
+#define TOY_MEMORY_TLSF_SL_COUNT_LOG2 5
+#define TOY_MEMORY_TLSF_SL_COUNT (1 << TOY_MEMORY_TLSF_SL_COUNT_LOG2)
+#define TOY_MEMORY_TLSF_FL_MAX 32 // Max block size is 2^TOY_MEMORY_TLSF_FL_MAX
+#define TOY_MEMORY_TLSF_FL_SHIFT (TOY_MEMORY_TLSF_SL_COUNT_LOG2 + 3)
+#define TOY_MEMORY_TLSF_FL_COUNT (TOY_MEMORY_TLSF_FL_MAX - TOY_MEMORY_TLSF_FL_SHIFT + 1)
+
+typedef struct toy_memory_tlsf_region_t {
+	struct toy_memory_tlsf_region_t* next;
+	size_t size; // region size, this header included
+}toy_memory_tlsf_region_t;
+
+typedef struct toy_memory_tlsf_t {
+	uint32_t fl_bitmap;
+	uint32_t sl_bitmap[TOY_MEMORY_TLSF_FL_COUNT];
+	uintptr_t heads[TOY_MEMORY_TLSF_FL_COUNT][TOY_MEMORY_TLSF_SL_COUNT];
+	toy_memory_tlsf_region_t* regions; // Regions created by allocator, freed when destroy
+	size_t region_size; // Size of region when growing
+	toy_memory_vm_t* vm; // Regions are taken from vm first and committed on demand when vm is not NULL
+	uintptr_t vm_top;
+}toy_memory_tlsf_t, *toy_memory_tlsf_p;
+
+
+void toy_init_memory_tlsf (toy_memory_tlsf_t* output);
+
+// memory must be aligned as sizeof(void*), caller owns memory
+bool toy_add_memory_tlsf_region (
+	toy_memory_tlsf_t* tlsf,
+	void* memory,
+	size_t memory_size
+);
+
+void* toy_tlsf_alloc (
+	toy_memory_tlsf_t* tlsf,
+	size_t size
+);
+
+void toy_tlsf_free (
+	toy_memory_tlsf_t* tlsf,
+	void* memory
+);
+
+// alignment must be 2^N, leading gap is given back as a free block
+void* toy_tlsf_alloc_aligned (
+	toy_memory_tlsf_t* tlsf,
+	size_t size,
+	size_t alignment
+);
+
+// Shrink always succeeds, grow succeeds when next physical block is free and big enough
+bool toy_tlsf_resize (
+	toy_memory_tlsf_t* tlsf,
+	void* memory,
+	size_t old_size,
+	size_t new_size
+);
+
+size_t toy_get_tlsf_usable_size (void* memory);
+
+
+
+typedef struct toy_memory_free_info_t {
+	size_t total_free_size;
+	size_t largest_free_size;
+	size_t free_block_count;
+}toy_memory_free_info_t;
+
+// 0 means no fragmentation, close to 1 means free memory is scattered in small blocks
+toy_inline float toy_get_memory_fragmentation (const toy_memory_free_info_t* info) {
+	if (0 == info->total_free_size)
+		return 0.0f;
+	return 1.0f - (float)((double)info->largest_free_size / (double)info->total_free_size);
+}
+
+void toy_get_memory_list_free_info (toy_memory_list_p lists, toy_memory_free_info_t* output);
+
+void toy_get_memory_tlsf_free_info (toy_memory_tlsf_p tlsf, toy_memory_free_info_t* output);
+
+void toy_get_memory_buddy_free_info (toy_memory_buddy_p buddy, toy_memory_free_info_t* output);
+
+
 toy_allocator_t toy_std_alc (); // Standard allocator using malloc() and free() in stdlib.h
 
 
 typedef struct toy_memory_allocator_t {
+	// Reserved address ranges of backends, not reserved when virtual memory is disabled or failed
+	toy_memory_vm_t stack_vm;
+	toy_memory_vm_t buddy_vm;
+	toy_memory_vm_t list_vm;
+	toy_memory_vm_t chunk_pool_vm;
+
 	toy_memory_stack_p stack;
 	toy_allocator_t stack_alc_L;
 	toy_allocator_t stack_alc_R;
 
-	toy_memory_list_p lists;
+	toy_memory_list_chain_t lists; // lists.lists is NULL when TOY_MEMORY_LIST_STRATEGY_TLSF
+	toy_memory_tlsf_p tlsf; // NULL when TOY_MEMORY_LIST_STRATEGY_FIRST_FIT
 	toy_allocator_t list_alc;
 	
 	toy_memory_buddy_t buddy;
 	toy_allocator_t buddy_alc;
 
-	toy_memory_pool_p chunk_pools; // Memory chunk pools (TOY_MEMORY_CHUNK_SIZE)
+	toy_memory_pool_chain_t chunk_pools; // Memory chunk pools (TOY_MEMORY_CHUNK_SIZE)
 	toy_allocator_t chunk_pool_alc; // Memory chunk pools (TOY_MEMORY_CHUNK_SIZE)
+
+	toy_memory_slab_t small; // Pages are chunks of chunk_pool_alc
+	toy_allocator_t small_alc; // Small objects up to TOY_MEMORY_SLAB_MAX_SIZE, NOT thread-safe
+
+	// Per-thread caches in front of list_alc, buddy_alc and chunk_pool_alc, NULL when disabled
+	toy_memory_thread_cache_p list_cache;
+	toy_memory_thread_cache_p buddy_cache;
+	toy_memory_thread_cache_p chunk_pool_cache;
+
+	toy_memory_frame_allocator_p frame; // NULL when disabled
+	toy_allocator_t frame_alc; // Per-frame temporary memory, free() does nothing
+
+	toy_memory_concurrent_pool_p concurrent_chunks; // NULL when disabled
+	toy_allocator_t concurrent_chunk_alc; // Lock-free TOY_MEMORY_CHUNK_SIZE blocks for ECS and asset pool chunks, any thread
+
+#if TOY_DEBUG_MEMORY
+	// All allocators above are wrapped by profile, outside of thread caches
+	toy_memory_profile_p profile;
+#endif
+	toy_memory_trace_p trace; // Outside of profile, NULL when disabled
 }toy_memory_allocator_t;
 
 
+enum toy_memory_list_strategy_t {
+	TOY_MEMORY_LIST_STRATEGY_FIRST_FIT = 0, // toy_memory_list_t
+	TOY_MEMORY_LIST_STRATEGY_TLSF, // toy_memory_tlsf_t
+};
+
 typedef struct toy_memory_config_t {
 	size_t stack_size;
 	size_t buddy_size;
 	size_t list_size;
 	size_t chunk_count;
+	enum toy_memory_list_strategy_t list_strategy; // Allocator behind list_alc
+	bool thread_cache; // Make list_alc, buddy_alc and chunk_pool_alc thread-safe with per-thread caches
+	size_t frame_size; // Size of frame_alc per concurrent frame, 0 to disable
+	size_t concurrent_chunk_count; // Chunks of concurrent_chunk_alc before it falls back to malloc, 0 to disable
+	// Reserve address range of each backend once and commit pages on demand,
+	// stack_size and buddy_size are reserved sizes, list and chunk pools grow in reserve_size
+	bool virtual_memory;
+	size_t reserve_size;
+	bool chunk_large_page; // Try large pages for chunk pools when virtual_memory
+	const char* trace_path; // Record allocations to this file for toy_replay_memory_trace(), NULL to disable
 }toy_memory_config_t;
 
 toy_memory_allocator_t* toy_create_memory_allocator (toy_memory_config_t* config);
@@ -192,29 +457,68 @@ toy_memory_allocator_t* toy_create_memory_allocator (toy_memory_config_t* config
 void toy_destroy_memory_allocator (toy_memory_allocator_t* alc);
 
 
+// Backends of toy_memory_allocator_t which are profiled and traced
+enum toy_memory_source_t {
+	TOY_MEMORY_SOURCE_STACK_L = 0, // stack_alc_L
+	TOY_MEMORY_SOURCE_STACK_R, // stack_alc_R
+	TOY_MEMORY_SOURCE_LIST, // list_alc
+	TOY_MEMORY_SOURCE_BUDDY, // buddy_alc
+	TOY_MEMORY_SOURCE_CHUNK_POOL, // chunk_pool_alc
+	TOY_MEMORY_SOURCE_SMALL, // small_alc
+	TOY_MEMORY_SOURCE_COUNT,
+};
+
+// Name of source for profile and trace, eg. "list"
+const char* toy_get_memory_source_name (uint32_t source);
+
+// stack_alc_L, stack_alc_R, list_alc, buddy_alc, chunk_pool_alc, small_alc
+toy_allocator_t* toy_get_memory_source_alc (
+	toy_memory_allocator_t* alc,
+	uint32_t source
+);
+
+// base_alc must be one of allocators in alc, eg. &alc->list_alc
+toy_allocator_t toy_get_tagged_allocator (
+	toy_memory_allocator_t* alc,
+	const toy_allocator_t* base_alc,
+	enum toy_memory_tag_t tag
+);
+
+// Bytes of memory taken by backends from OS, committed pages of reserved ranges and heap segments
+size_t toy_get_memory_footprint (toy_memory_allocator_t* alc);
+
+#if TOY_DEBUG_MEMORY
+// tag == TOY_MEMORY_TAG_COUNT for stats of all tags
+void toy_get_memory_stats (
+	toy_memory_allocator_t* alc,
+	const toy_allocator_t* base_alc,
+	enum toy_memory_tag_t tag,
+	toy_memory_stats_t* output
+);
+
+void toy_mark_memory_frame (toy_memory_allocator_t* alc);
+
+void toy_dump_memory_stats (toy_memory_allocator_t* alc);
+#endif
+
+
+// Stack and pools made here are standalone, they are not profiled or traced with toy_memory_allocator_t
 toy_memory_stack_p toy_create_memory_stack (
 	size_t stack_size,
-	toy_memory_allocator_t* alc, // Just for future profile
 	toy_allocator_t* output_alc_L,
 	toy_allocator_t* output_alc_R
 );
 
-void toy_destroy_memory_stack (
-	toy_memory_stack_p stack,
-	toy_memory_allocator_t* alc // Just for future profile
-);
+void toy_destroy_memory_stack (toy_memory_stack_p stack);
 
+// pool_size is rounded up to 2^N, output_chain->pools is NULL when failed
 void toy_create_memory_pools (
 	size_t pool_size,
 	size_t block_size,
-	toy_memory_allocator_t* alc, // Just for future profile
-	toy_memory_pool_p* output_pools,
+	toy_memory_pool_chain_t* output_chain,
 	toy_allocator_t* output_alc
 );
 
-void toy_destroy_memory_pools (
-	toy_memory_pool_p pools,
-	toy_memory_allocator_t* alc // Just for future profile
-);
+void toy_destroy_memory_pools (toy_memory_pool_chain_t* chain);
 
 TOY_EXTERN_C_END
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "toy_platform.h"
+
+#include "toy_allocator.h"
+
+
+TOY_EXTERN_C_START
+
+// Thread-safe lock-free variant of toy_memory_pool_t.
+// Free blocks form a Treiber stack of block indices, the next index is stored in the block like
+// toy_memory_pool_t, the head index is packed with an ABA tag into 64 bits.
+typedef struct toy_memory_concurrent_pool_t toy_memory_concurrent_pool_t, *toy_memory_concurrent_pool_p;
+
+
+// alignment: 0 for sizeof(void*), otherwise 2^N
+toy_memory_concurrent_pool_p toy_create_memory_concurrent_pool (
+	size_t block_size,
+	uint32_t block_count,
+	size_t alignment,
+	const toy_allocator_t* alc
+);
+
+void toy_destroy_memory_concurrent_pool (
+	toy_memory_concurrent_pool_p pool,
+	const toy_allocator_t* alc
+);
+
+// Blocks which do not fit in a full pool go to overflow_alc, NULL overflow_alc to disable it.
+// overflow_alc must be thread-safe and is copied, call it before the pool is shared by threads.
+void toy_set_concurrent_pool_overflow_allocator (
+	toy_memory_concurrent_pool_p pool,
+	const toy_allocator_t* overflow_alc
+);
+
+// Return NULL when pool is full and overflow is disabled
+void* toy_concurrent_pool_block_alloc (toy_memory_concurrent_pool_p pool, size_t size);
+
+// block may be from overflow allocator
+
+void toy_concurrent_pool_block_free (toy_memory_concurrent_pool_p pool, void* block);
+
+bool toy_is_memory_in_concurrent_pool (void* memory, toy_memory_concurrent_pool_p pool);
+
+// Snapshot, it may be outdated when other threads are allocating. Overflow blocks are not counted
+uint32_t toy_get_concurrent_pool_allocated_count (toy_memory_concurrent_pool_p pool);
+
+void toy_get_memory_concurrent_pool_alc (
+	toy_memory_concurrent_pool_p pool,
+	toy_allocator_t* output_alc
+);
+
+TOY_EXTERN_C_END
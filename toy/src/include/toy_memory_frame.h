@@ -0,0 +1,49 @@
+#pragma once
+
+#include "toy_platform.h"
+
+#include "toy_allocator.h"
+
+
+TOY_EXTERN_C_START
+
+#define TOY_MEMORY_FRAME_ALLOCATOR_MAX 4 // Max count of alive frame allocators
+#define TOY_MEMORY_FRAME_ALIGNMENT 16 // Default alignment of toy_frame_alloc() through toy_allocator_t
+
+typedef struct toy_memory_frame_allocator_t toy_memory_frame_allocator_t, *toy_memory_frame_allocator_p;
+
+
+// Linear allocator with one stack per TOY_CONCURRENT_FRAME_MAX slot, memory of a slot is released
+// as a whole when the slot is reused. Each thread bump-allocates from its own sub-arena of arena_size.
+toy_memory_frame_allocator_p toy_create_memory_frame_allocator (
+	size_t frame_size,
+	size_t arena_size,
+	const toy_allocator_t* alc
+);
+
+void toy_destroy_memory_frame_allocator (
+	toy_memory_frame_allocator_p frame_alc,
+	const toy_allocator_t* alc
+);
+
+// Switch to slot frame_index and reset it, call it with current_frame of swapchain after its finish fence is waited,
+// so memory of the slot is not used by frames in flight. Memory allocated before stays valid until its slot is begun again.
+// No other thread may allocate from frame_alc during this call.
+void toy_begin_memory_frame (toy_memory_frame_allocator_p frame_alc, uint32_t frame_index);
+
+uint32_t toy_get_memory_frame_index (toy_memory_frame_allocator_p frame_alc);
+
+// Thread-safe, return NULL when the frame slot is full
+void* toy_frame_alloc (
+	toy_memory_frame_allocator_p frame_alc,
+	size_t size,
+	size_t alignment
+);
+
+// free() of output_alc does nothing, memory is released by toy_begin_memory_frame()
+void toy_get_memory_frame_alc (
+	toy_memory_frame_allocator_p frame_alc,
+	toy_allocator_t* output_alc
+);
+
+TOY_EXTERN_C_END
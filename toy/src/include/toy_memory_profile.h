@@ -0,0 +1,83 @@
+#pragma once
+
+#include "toy_platform.h"
+
+#include "toy_allocator.h"
+
+
+TOY_EXTERN_C_START
+
+// Subsystem tags of allocations, see toy_get_tagged_allocator()
+enum toy_memory_tag_t {
+	TOY_MEMORY_TAG_UNKNOWN = 0,
+	TOY_MEMORY_TAG_ASSET,
+	TOY_MEMORY_TAG_SCENE,
+	TOY_MEMORY_TAG_RENDER,
+	TOY_MEMORY_TAG_LUA,
+	TOY_MEMORY_TAG_COUNT,
+};
+
+// histogram[N] counts allocations of (2^(N-1), 2^N] bytes, the last one counts all bigger allocations
+#define TOY_MEMORY_HISTOGRAM_SIZE 24
+
+typedef struct toy_memory_stats_t {
+	size_t live_bytes;
+	size_t peak_bytes;
+	size_t live_count;
+	uint64_t alloc_count;
+	uint64_t free_count;
+	uint64_t failed_count;
+	uint64_t frame_alloc_count; // Since last toy_mark_memory_profile_frame()
+	size_t frame_alloc_bytes; // Since last toy_mark_memory_profile_frame()
+	uint64_t histogram[TOY_MEMORY_HISTOGRAM_SIZE];
+}toy_memory_stats_t;
+
+
+#if TOY_DEBUG_MEMORY
+
+#define TOY_MEMORY_PROFILE_SOURCE_MAX 8 // Max count of profiled allocators
+
+typedef struct toy_memory_profile_t toy_memory_profile_t, *toy_memory_profile_p;
+
+
+toy_memory_profile_p toy_create_memory_profile (void);
+
+void toy_destroy_memory_profile (toy_memory_profile_p profile);
+
+// Wrap backing_alc, all allocations through output_alc are recorded with TOY_MEMORY_TAG_UNKNOWN.
+// output_alc can be backing_alc, return index of source, or UINT32_MAX when failed
+uint32_t toy_add_memory_profile_source (
+	toy_memory_profile_p profile,
+	const char* name,
+	const toy_allocator_t* backing_alc,
+	toy_allocator_t* output_alc
+);
+
+// Allocator of a source which records allocations with tag
+void toy_get_memory_profile_allocator (
+	toy_memory_profile_p profile,
+	uint32_t source,
+	enum toy_memory_tag_t tag,
+	toy_allocator_t* output_alc
+);
+
+// tag == TOY_MEMORY_TAG_COUNT for stats of all tags, live_bytes and peak_bytes of all tags are sampled at source level
+void toy_get_memory_profile_stats (
+	toy_memory_profile_p profile,
+	uint32_t source,
+	enum toy_memory_tag_t tag,
+	toy_memory_stats_t* output
+);
+
+// Reset frame_alloc_count and frame_alloc_bytes of all sources
+void toy_mark_memory_profile_frame (toy_memory_profile_p profile);
+
+// Log stats of every source and tag
+void toy_dump_memory_profile (toy_memory_profile_p profile);
+
+// Log every live allocation, return count of them
+size_t toy_report_memory_profile_leaks (toy_memory_profile_p profile);
+
+#endif // TOY_DEBUG_MEMORY
+
+TOY_EXTERN_C_END
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "toy_platform.h"
+
+#include "toy_allocator.h"
+
+
+TOY_EXTERN_C_START
+
+// Size classes: 16 ... 128 in steps of 16, then 4 classes per power of two up to 4096
+#define TOY_MEMORY_SLAB_MIN_SIZE 16
+#define TOY_MEMORY_SLAB_MAX_SIZE 4096
+#define TOY_MEMORY_SLAB_CLASS_COUNT 28
+#define TOY_MEMORY_SLAB_PAGE_SIZE TOY_MEMORY_CHUNK_SIZE // Page of slab is a memory chunk, aligned to its size
+#define TOY_MEMORY_SLAB_PAGE_HEADER_SIZE 64 // Blocks are 16 bytes aligned
+#define TOY_MEMORY_SLAB_SMALL_TABLE_SIZE 64 // Class of size (16 * N, 16 * (N + 1)], up to 1024
+#define TOY_MEMORY_SLAB_LARGE_TABLE_SIZE 32 // Class of size (128 * N, 128 * (N + 1)], up to 4096
+
+// Header at the head of each page, all blocks of a page are in the same size class.
+// Freed blocks are linked through the block in a page-local free list.
+typedef struct toy_memory_slab_page_t {
+	struct toy_memory_slab_page_t* prev;
+	struct toy_memory_slab_page_t* next;
+	void* free_blocks;
+	uintptr_t fresh_block; // Blocks from here have never been allocated, they are not linked yet
+	uint32_t allocated_block_count;
+	uint32_t size_class;
+}toy_memory_slab_page_t, *toy_memory_slab_page_p;
+
+typedef struct toy_memory_slab_class_t {
+	toy_memory_slab_page_p available_pages; // Pages which have free blocks
+	toy_memory_slab_page_p full_pages;
+	uint32_t block_size;
+	uint32_t block_count; // Blocks per page
+}toy_memory_slab_class_t;
+
+// NOT thread-safe
+typedef struct toy_memory_slab_t {
+	toy_allocator_t page_alc; // Allocate TOY_MEMORY_SLAB_PAGE_SIZE bytes aligned to its size
+	size_t page_count;
+	toy_memory_slab_class_t classes[TOY_MEMORY_SLAB_CLASS_COUNT];
+	uint8_t small_class_table[TOY_MEMORY_SLAB_SMALL_TABLE_SIZE];
+	uint8_t large_class_table[TOY_MEMORY_SLAB_LARGE_TABLE_SIZE];
+}toy_memory_slab_t, *toy_memory_slab_p;
+
+
+// page_alc is copied, eg. chunk_pool_alc of toy_memory_allocator_t
+void toy_init_memory_slab (
+	const toy_allocator_t* page_alc,
+	toy_memory_slab_t* output
+);
+
+// Return every page to page_alc, all blocks are freed
+void toy_clear_memory_slab (toy_memory_slab_t* slab);
+
+// Return NULL when size is 0 or bigger than TOY_MEMORY_SLAB_MAX_SIZE
+void* toy_slab_alloc (
+	toy_memory_slab_t* slab,
+	size_t size
+);
+
+void toy_slab_free (
+	toy_memory_slab_t* slab,
+	void* memory
+);
+
+// alignment must be 2^N. Block is taken from the smallest class which block size is a multiple of alignment,
+// alignment bigger than TOY_MEMORY_SLAB_PAGE_HEADER_SIZE takes alignment - TOY_MEMORY_SLAB_PAGE_HEADER_SIZE more bytes.
+void* toy_slab_alloc_aligned (
+	toy_memory_slab_t* slab,
+	size_t size,
+	size_t alignment
+);
+
+size_t toy_get_slab_usable_size (
+	toy_memory_slab_t* slab,
+	void* memory
+);
+
+toy_inline toy_memory_slab_page_p toy_get_memory_slab_page (void* memory) {
+	return (toy_memory_slab_page_p)((uintptr_t)memory & ~(uintptr_t)(TOY_MEMORY_SLAB_PAGE_SIZE - 1));
+}
+
+TOY_EXTERN_C_END
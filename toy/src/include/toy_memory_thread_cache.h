@@ -0,0 +1,44 @@
+#pragma once
+
+#include "toy_platform.h"
+
+#include "toy_allocator.h"
+
+
+TOY_EXTERN_C_START
+
+// Size classes cached by each thread: 2^MIN_SHIFT ... 2^MAX_SHIFT bytes, CLASS_STEPS classes per power of two
+// (eg. 80, 96, 112, 128), so a block wastes 1/CLASS_STEPS of its size at most.
+// Larger blocks and over-aligned blocks are allocated from backing allocator directly (under lock)
+#define TOY_MEMORY_THREAD_CACHE_MIN_SHIFT 4
+#define TOY_MEMORY_THREAD_CACHE_MAX_SHIFT 12
+#define TOY_MEMORY_THREAD_CACHE_CLASS_STEPS_SHIFT 2
+#define TOY_MEMORY_THREAD_CACHE_CLASS_STEPS (1 << TOY_MEMORY_THREAD_CACHE_CLASS_STEPS_SHIFT)
+#define TOY_MEMORY_THREAD_CACHE_CLASS_COUNT ((TOY_MEMORY_THREAD_CACHE_MAX_SHIFT - TOY_MEMORY_THREAD_CACHE_MIN_SHIFT) * TOY_MEMORY_THREAD_CACHE_CLASS_STEPS + 1)
+#define TOY_MEMORY_THREAD_CACHE_MAGAZINE_SIZE 32 // Blocks per class per thread, half of it is refilled/returned at once
+#define TOY_MEMORY_THREAD_CACHE_MAX 16 // Max count of alive thread caches
+
+typedef struct toy_memory_thread_cache_t toy_memory_thread_cache_t, *toy_memory_thread_cache_p;
+
+
+// Wrap a NOT thread-safe allocator with per-thread magazines,
+// after that, all access to backing_alc MUST go through output_alc.
+// block_size: fixed block size of backing_alc (eg. memory pools), 0 when backing_alc accepts any size.
+// output_alc supports resize, usable size and native aligned alloc when backing_alc does (usable size always),
+// reset is never forwarded since other threads may still cache blocks
+// output_alc can be backing_alc, the backing allocator is copied before output_alc is written
+toy_memory_thread_cache_p toy_create_memory_thread_cache (
+	const toy_allocator_t* backing_alc,
+	size_t block_size,
+	toy_allocator_t* output_alc
+);
+
+// Blocks cached by calling thread are returned before destroy,
+// blocks cached by other threads are dropped, call toy_flush_memory_thread_cache() in workers first
+void toy_destroy_memory_thread_cache (toy_memory_thread_cache_p cache);
+
+// Return all blocks cached by calling thread to their backing allocators.
+// It is also called automatically when a thread exits.
+void toy_flush_memory_thread_cache (void);
+
+TOY_EXTERN_C_END
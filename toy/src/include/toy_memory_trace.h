@@ -0,0 +1,103 @@
+#pragma once
+
+#include "toy_platform.h"
+
+#include "toy_error.h"
+#include "toy_allocator.h"
+#include "toy_memory_profile.h"
+
+
+TOY_EXTERN_C_START
+
+#define TOY_MEMORY_TRACE_MAGIC 0x54594f54 // "TOYT"
+#define TOY_MEMORY_TRACE_VERSION 2
+#define TOY_MEMORY_TRACE_SOURCE_MAX 8 // Max count of traced allocators
+#define TOY_MEMORY_TRACE_BUFFER_SIZE 4096 // Records are written to file when buffer is full
+
+enum toy_memory_trace_op_t {
+	TOY_MEMORY_TRACE_OP_ALLOC = 0, // address is 0 when allocation failed
+	TOY_MEMORY_TRACE_OP_FREE,
+	TOY_MEMORY_TRACE_OP_SOURCE, // size is length of name, name follows in the next records
+	TOY_MEMORY_TRACE_OP_RESIZE, // Resized in place, size is the new size
+	TOY_MEMORY_TRACE_OP_RESET, // All allocations of source are freed
+};
+
+// File layout: toy_memory_trace_header_t, then toy_memory_trace_record_t until the end of file
+typedef struct toy_memory_trace_header_t {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t reserved;
+}toy_memory_trace_header_t;
+
+typedef struct toy_memory_trace_record_t {
+	uint64_t address; // Identity of allocation in recorded session
+	uint64_t time; // Nanoseconds since trace was created
+	uint32_t size; // UINT32_MAX for allocations bigger than that
+	uint8_t op; // enum toy_memory_trace_op_t
+	uint8_t tag; // enum toy_memory_tag_t
+	uint8_t source;
+	uint8_t alignment_log2; // 0 when allocator default alignment is used
+	uint16_t thread; // Small id of recording thread
+	uint16_t reserved;
+}toy_memory_trace_record_t;
+
+typedef struct toy_memory_trace_t toy_memory_trace_t, *toy_memory_trace_p;
+
+struct toy_memory_allocator_t;
+
+
+toy_memory_trace_p toy_create_memory_trace (const char* utf8_path, toy_error_t* error);
+
+// Flush records and close file
+void toy_destroy_memory_trace (toy_memory_trace_p trace);
+
+void toy_flush_memory_trace (toy_memory_trace_p trace);
+
+// Wrap backing_alc, all allocations through output_alc are recorded with TOY_MEMORY_TAG_UNKNOWN.
+// output_alc can be backing_alc, return index of source, or UINT32_MAX when failed
+uint32_t toy_add_memory_trace_source (
+	toy_memory_trace_p trace,
+	const char* name,
+	const toy_allocator_t* backing_alc,
+	toy_allocator_t* output_alc
+);
+
+// Allocator of a source which records allocations with tag, thread-safe.
+// backing_alc is NULL to allocate from backing allocator of source, it is bound by the first call of source and tag
+// and later calls must pass the same one
+void toy_get_memory_trace_allocator (
+	toy_memory_trace_p trace,
+	uint32_t source,
+	enum toy_memory_tag_t tag,
+	const toy_allocator_t* backing_alc,
+	toy_allocator_t* output_alc
+);
+
+
+typedef struct toy_memory_replay_report_t {
+	uint64_t alloc_count;
+	uint64_t free_count;
+	uint64_t resize_count;
+	uint64_t failed_count; // Allocations and resizes which succeeded in recorded session but failed in replay
+	uint64_t alloc_ns; // Time spent in alloc() and resize
+	uint64_t free_ns; // Time spent in free()
+	size_t peak_live_bytes; // Requested bytes
+	size_t footprint_growth; // Growth of toy_get_memory_footprint(alc), backends never shrink
+	float peak_fragmentation; // Worst sampled fragmentation of list and buddy backends of alc
+}toy_memory_replay_report_t;
+
+// Replay trace_data (whole content of a trace file) single-threaded in recorded order.
+// target_alc: every source goes to target_alc, or NULL to send each source to the backend of alc with the same name
+bool toy_replay_memory_trace (
+	const void* trace_data,
+	size_t trace_size,
+	struct toy_memory_allocator_t* alc,
+	const toy_allocator_t* target_alc,
+	toy_memory_replay_report_t* output
+);
+
+// Standalone replay: run trace file against every backend with default config and log reports
+int toy_replay_memory_trace_main (const char* utf8_path);
+
+TOY_EXTERN_C_END
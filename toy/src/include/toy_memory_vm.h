@@ -0,0 +1,64 @@
+#pragma once
+
+#include "toy_platform.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+TOY_EXTERN_C_START
+
+#define TOY_MEMORY_VM_GRANULE_SIZE (64 * 1024) // Smallest commit size with normal pages
+
+#if TOY_OS_WINDOWS
+#	define TOY_MEMORY_VM_LAZY_LARGE_PAGE 0 // Large pages must be committed when reserved
+#else
+#	define TOY_MEMORY_VM_LAZY_LARGE_PAGE 1
+#endif
+
+// Reserved address range, pages are committed on demand
+typedef struct toy_memory_vm_t {
+	uintptr_t base; // Aligned start of the range
+	size_t size;
+	uintptr_t raw_base; // Address range returned by OS
+	size_t raw_size;
+	size_t granule_size; // 2^N, commit granularity
+	size_t committed_size;
+	uint64_t* commit_bitmap; // One bit per granule, NULL when the whole range is committed
+	bool large_page;
+}toy_memory_vm_t, *toy_memory_vm_p;
+
+
+size_t toy_get_memory_page_size (void);
+
+// Return 0 when large page is not supported
+size_t toy_get_memory_large_page_size (void);
+
+// alignment must be 2^N, size is rounded up to granule size.
+// Fall back to normal pages when large pages are not available.
+bool toy_reserve_memory_vm (
+	size_t size,
+	size_t alignment,
+	bool large_page,
+	toy_memory_vm_t* output
+);
+
+void toy_release_memory_vm (toy_memory_vm_t* vm);
+
+// Commit every granule which overlaps [address, address + size), committed granules are skipped
+bool toy_commit_memory_vm (
+	toy_memory_vm_t* vm,
+	uintptr_t address,
+	size_t size
+);
+
+toy_inline bool toy_is_memory_vm_reserved (const toy_memory_vm_t* vm) {
+	return (uintptr_t)NULL != vm->base;
+}
+
+toy_inline bool toy_is_memory_in_vm (const toy_memory_vm_t* vm, uintptr_t address) {
+	return address - vm->base < vm->size;
+}
+
+TOY_EXTERN_C_END
@@ -24,6 +24,7 @@ typedef struct toy_scene_t {
 	toy_scene_camera_t main_camera;
 
 	toy_memory_allocator_t* alc;
+	const toy_allocator_t* chunk_alc; // Entity chunks, concurrent_chunk_alc of alc
 }toy_scene_t;
 
 
@@ -53,7 +53,7 @@ static void toy_create_vulkan_asset_loader_cmd (
 
 static void toy_create_vulkan_asset_loader_synchronized_objs (
 	VkDevice dev,
-	toy_vulkan_asset_loader_t* loader,
+	toy_vulkan_stage_slot_t* slot,
 	const VkAllocationCallbacks* vk_alc_cb,
 	toy_error_t* error)
 {
@@ -62,7 +62,7 @@ static void toy_create_vulkan_asset_loader_synchronized_objs (
 	fence_ci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
 	fence_ci.pNext = NULL;
 	fence_ci.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-	vk_err = vkCreateFence(dev, &fence_ci, vk_alc_cb, &loader->fence);
+	vk_err = vkCreateFence(dev, &fence_ci, vk_alc_cb, &slot->fence);
 	if (VK_SUCCESS != vk_err) {
 		toy_err_vkerr(TOY_ERROR_CREATE_OBJECT_FAILED, vk_err, "vkCreateFence for asset loader failed", error);
 		return;
@@ -72,17 +72,73 @@ static void toy_create_vulkan_asset_loader_synchronized_objs (
 	sem_ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 	sem_ci.pNext = NULL;
 	sem_ci.flags = 0;
-	vk_err = vkCreateSemaphore(dev, &sem_ci, vk_alc_cb, &loader->semaphore);
+	vk_err = vkCreateSemaphore(dev, &sem_ci, vk_alc_cb, &slot->semaphore);
 	if (VK_SUCCESS != vk_err) {
 		toy_err_vkerr(TOY_ERROR_CREATE_OBJECT_FAILED, vk_err, "vkCreateSemaphore for asset loader failed", error);
-		vkDestroyFence(dev, loader->fence, vk_alc_cb);
+		vkDestroyFence(dev, slot->fence, vk_alc_cb);
 		return;
 	}
 
-	loader->semaphore_wait_stage = 0;
+	toy_ok(error);
+	return;
+}
+
+
+static void toy_create_vulkan_stage_slot (
+	VkDevice dev,
+	uint32_t transfer_family_index,
+	uint32_t graphic_family_index,
+	const VkAllocationCallbacks* vk_alc_cb,
+	toy_vulkan_stage_slot_t* output,
+	toy_error_t* error)
+{
+	output->transfer_pool = VK_NULL_HANDLE;
+	toy_create_vulkan_asset_loader_cmd(
+		dev, transfer_family_index, vk_alc_cb, &output->transfer_pool, &output->transfer_cmd, error);
+	if (toy_is_failed(*error))
+		goto FAIL_TRANSFER_CMD;
+
+	output->graphic_pool = (transfer_family_index == graphic_family_index ? output->transfer_pool : VK_NULL_HANDLE);
+	toy_create_vulkan_asset_loader_cmd(
+		dev, graphic_family_index, vk_alc_cb, &output->graphic_pool, &output->graphic_cmd, error);
+	if (toy_is_failed(*error))
+		goto FAIL_GRAPHIC_CMD;
+
+	toy_create_vulkan_asset_loader_synchronized_objs(dev, output, vk_alc_cb, error);
+	if (toy_is_failed(*error))
+		goto FAIL_SYNC_OBJ;
+
+	output->serial = 0;
+	output->ring_end = 0;
+	output->ring_size = 0;
 
 	toy_ok(error);
 	return;
+
+FAIL_SYNC_OBJ:
+	if (output->graphic_pool != output->transfer_pool)
+		vkDestroyCommandPool(dev, output->graphic_pool, vk_alc_cb);
+FAIL_GRAPHIC_CMD:
+	vkDestroyCommandPool(dev, output->transfer_pool, vk_alc_cb);
+FAIL_TRANSFER_CMD:
+	return;
+}
+
+
+static void toy_destroy_vulkan_stage_slots (
+	VkDevice dev,
+	toy_vulkan_stage_slot_t* slots,
+	uint32_t slot_count,
+	const VkAllocationCallbacks* vk_alc_cb)
+{
+	for (uint32_t i = 0; i < slot_count; ++i) {
+		vkDestroySemaphore(dev, slots[i].semaphore, vk_alc_cb);
+		vkDestroyFence(dev, slots[i].fence, vk_alc_cb);
+
+		if (slots[i].transfer_pool != slots[i].graphic_pool)
+			vkDestroyCommandPool(dev, slots[i].graphic_pool, vk_alc_cb);
+		vkDestroyCommandPool(dev, slots[i].transfer_pool, vk_alc_cb);
+	}
 }
 
 
@@ -96,27 +152,18 @@ void toy_create_vulkan_asset_loader (
 	uint32_t transfer_family_index = vk_device->device_queue_families.transfer.family;
 	uint32_t graphic_family_index = vk_device->device_queue_families.graphic.family;
 	VkDevice dev = vk_device->handle;
-	
-	output->transfer_pool = VK_NULL_HANDLE;
-	toy_create_vulkan_asset_loader_cmd(
-		dev, transfer_family_index, vk_alc->vk_alc_cb_p, &output->transfer_pool, &output->transfer_cmd, error);
-	if (toy_is_failed(*error))
-		goto FAIL_TRANSFER_CMD;
 
-	output->graphic_pool = (transfer_family_index == graphic_family_index ? output->transfer_pool : VK_NULL_HANDLE);
-	toy_create_vulkan_asset_loader_cmd(
-		dev, graphic_family_index, vk_alc->vk_alc_cb_p, &output->graphic_pool, &output->graphic_cmd, error);
-	if (toy_is_failed(*error))
-		goto FAIL_GRAPHIC_CMD;
+	uint32_t slot_count;
+	for (slot_count = 0; slot_count < TOY_VULKAN_STAGE_SLOT_COUNT; ++slot_count) {
+		toy_create_vulkan_stage_slot(
+			dev, transfer_family_index, graphic_family_index, vk_alc->vk_alc_cb_p, &output->slots[slot_count], error);
+		if (toy_is_failed(*error))
+			goto FAIL_SLOT;
+	}
 
 	vkGetDeviceQueue(dev, transfer_family_index, vk_device->device_queue_families.transfer.offset, &output->transfer_queue);
 	vkGetDeviceQueue(dev, graphic_family_index, vk_device->device_queue_families.graphic.offset, &output->graphic_queue);
 
-	toy_create_vulkan_asset_loader_synchronized_objs(
-		dev, output, vk_alc->vk_alc_cb_p, error);
-	if (toy_is_failed(*error))
-		goto FAIL_SYNC_OBJ;
-
 	output->vk_alc = vk_alc;
 
 	const VkMemoryPropertyFlags property_flags[] = {
@@ -130,25 +177,35 @@ void toy_create_vulkan_asset_loader (
 		property_flags, flag_count, uniform_size,
 		&vk_device->physical_device.memory_properties,
 		&vk_alc->vk_list_alc, vk_alc->vk_alc_cb_p,
-		&output->stage_stack.buffer,
+		&output->stage_buffer,
 		error);
 	if (toy_is_failed(*error))
-		goto FAIL_STAGE_STACK;
-	toy_init_vulkan_buffer_stack(&output->stage_stack.buffer, &output->stage_stack);
-	output->mapping_memory = NULL;
+		goto FAIL_STAGE_BUFFER;
+
+	// Persistent mapping, staging is a memcpy into ring
+	output->mapping_memory = toy_map_vulkan_buffer_memory(dev, &output->stage_buffer, error);
+	if (toy_is_failed(*error))
+		goto FAIL_MAP;
+
+	output->ring_head = 0;
+	output->ring_tail = 0;
+	output->ring_used = 0;
+	output->submit_serial = 0;
+	output->complete_serial = 0;
+	output->batch_recording = false;
+	output->batch_buffer_count = 0;
+	output->batch_image_count = 0;
+	output->batch_ring_start = 0;
+	output->batch_ring_size = 0;
 
 	toy_ok(error);
 	return;
 
-FAIL_STAGE_STACK:
-	vkDestroySemaphore(dev, output->semaphore, vk_alc->vk_alc_cb_p);
-	vkDestroyFence(dev, output->fence, vk_alc->vk_alc_cb_p);
-FAIL_SYNC_OBJ:
-	if (output->graphic_pool != output->transfer_pool)
-		vkDestroyCommandPool(dev, output->graphic_pool, vk_alc->vk_alc_cb_p);
-FAIL_GRAPHIC_CMD:
-	vkDestroyCommandPool(dev, output->transfer_pool, vk_alc->vk_alc_cb_p);
-FAIL_TRANSFER_CMD:
+FAIL_MAP:
+	toy_destroy_vulkan_buffer(dev, &output->stage_buffer, vk_alc->vk_alc_cb_p);
+FAIL_STAGE_BUFFER:
+FAIL_SLOT:
+	toy_destroy_vulkan_stage_slots(dev, output->slots, slot_count, vk_alc->vk_alc_cb_p);
 	toy_log_error(error);
 	return;
 }
@@ -158,172 +215,248 @@ void toy_destroy_vulkan_asset_loader (
 	VkDevice dev,
 	toy_vulkan_asset_loader_t* loader)
 {
-	TOY_ASSERT(NULL == loader->mapping_memory);
+	TOY_ASSERT(!loader->batch_recording);
 
 	const VkAllocationCallbacks* vk_alc_cb = loader->vk_alc->vk_alc_cb_p;
+	toy_error_t err;
 
-	toy_destroy_vulkan_buffer(dev, &loader->stage_stack.buffer, vk_alc_cb);
+	toy_wait_vulkan_stage_submit(dev, loader, loader->submit_serial, &err);
+	if (toy_is_failed(err))
+		toy_log_error(&err);
 
-	vkDestroySemaphore(dev, loader->semaphore, vk_alc_cb);
-	vkDestroyFence(dev, loader->fence, vk_alc_cb);
+	toy_unmap_vulkan_buffer_memory(dev, &loader->stage_buffer, &err);
+	loader->mapping_memory = NULL;
+	toy_destroy_vulkan_buffer(dev, &loader->stage_buffer, vk_alc_cb);
 
-	if (loader->transfer_pool != loader->graphic_pool)
-		vkDestroyCommandPool(dev, loader->graphic_pool, vk_alc_cb);
-	vkDestroyCommandPool(dev, loader->transfer_pool, vk_alc_cb);
+	toy_destroy_vulkan_stage_slots(dev, loader->slots, TOY_VULKAN_STAGE_SLOT_COUNT, vk_alc_cb);
 }
 
 
-void toy_reset_vulkan_asset_loader (
-	VkDevice dev,
+static toy_vulkan_stage_slot_t* toy_get_vulkan_stage_slot (
 	toy_vulkan_asset_loader_t* loader,
-	toy_error_t* error)
+	uint64_t serial)
 {
-	VkResult vk_err;
-	const uint64_t timeout = 500 * 1000 * 1000; // 500 ms
-	vk_err = vkWaitForFences(dev, 1, &loader->fence, VK_TRUE, timeout);
-	if (toy_unlikely(VK_SUCCESS != vk_err)) {
-		// Todo: recreate command fences and semaphores
-		toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkWaitForFences failed when reset asset loader", error);
-		return;
-	}
-
-	vk_err = vkResetCommandPool(dev, loader->transfer_pool, VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
-	if (toy_unlikely(VK_SUCCESS != vk_err)) {
-		toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkResetCommandPool for transfer cmd pool failed when reset asset loader", error);
-		return;
-	}
+	TOY_ASSERT(serial > 0);
+	return &loader->slots[(serial - 1) % TOY_VULKAN_STAGE_SLOT_COUNT];
+}
 
-	if (loader->graphic_pool != loader->transfer_pool) {
-		vk_err = vkResetCommandPool(dev, loader->graphic_pool, VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
-		if (toy_unlikely(VK_SUCCESS != vk_err)) {
-			toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkResetCommandPool for graphic cmd pool failed when reset asset loader", error);
-			return;
-		}
-	}
 
-	if (NULL != loader->mapping_memory) {
-		toy_unmap_vulkan_buffer_memory(dev, &loader->stage_stack.buffer, error);
-		if (toy_is_ok(*error))
-			loader->mapping_memory = NULL;
+// Fence of oldest submit in flight is signaled, its ring region is free
+static void toy_complete_vulkan_stage_slot (toy_vulkan_asset_loader_t* loader)
+{
+	toy_vulkan_stage_slot_t* slot = toy_get_vulkan_stage_slot(loader, loader->complete_serial + 1);
+	TOY_ASSERT(slot->serial == loader->complete_serial + 1);
+	TOY_ASSERT(loader->ring_used >= slot->ring_size);
+
+	// Ring may have been rewound to 0 after a submit without data
+	loader->complete_serial = slot->serial;
+	if (slot->ring_size > 0) {
+		loader->ring_tail = slot->ring_end;
+		loader->ring_used -= slot->ring_size;
 	}
-
-	toy_ok(error);
-	return;
 }
 
 
-void toy_map_vulkan_stage_memory (
+uint64_t toy_poll_vulkan_stage_submits (
 	VkDevice dev,
 	toy_vulkan_asset_loader_t* loader,
 	toy_error_t* error)
 {
-	TOY_ASSERT(NULL == loader->mapping_memory);
+	while (loader->complete_serial < loader->submit_serial) {
+		toy_vulkan_stage_slot_t* slot = toy_get_vulkan_stage_slot(loader, loader->complete_serial + 1);
+		VkResult vk_err = vkGetFenceStatus(dev, slot->fence);
+		if (VK_NOT_READY == vk_err)
+			break;
+		if (toy_unlikely(VK_SUCCESS != vk_err)) {
+			toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkGetFenceStatus for stage submit failed", error);
+			return loader->complete_serial;
+		}
+		toy_complete_vulkan_stage_slot(loader);
+	}
 
-	loader->mapping_memory = toy_map_vulkan_buffer_memory(dev, &loader->stage_stack.buffer, error);
+	toy_ok(error);
+	return loader->complete_serial;
 }
 
 
-void toy_unmap_vulkan_stage_memory (
+void toy_wait_vulkan_stage_submit (
 	VkDevice dev,
 	toy_vulkan_asset_loader_t* loader,
+	uint64_t serial,
 	toy_error_t* error)
 {
-	TOY_ASSERT(NULL != loader->mapping_memory);
-
-	toy_unmap_vulkan_buffer_memory(dev, &loader->stage_stack.buffer, error);
-	if (toy_is_ok(*error))
-		loader->mapping_memory = NULL;
-}
+	TOY_ASSERT(serial <= loader->submit_serial);
 
+	while (loader->complete_serial < serial) {
+		toy_vulkan_stage_slot_t* slot = toy_get_vulkan_stage_slot(loader, loader->complete_serial + 1);
+		VkResult vk_err = vkWaitForFences(dev, 1, &slot->fence, VK_TRUE, UINT64_MAX);
+		if (toy_unlikely(VK_SUCCESS != vk_err)) {
+			toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkWaitForFences for stage submit failed", error);
+			return;
+		}
+		toy_complete_vulkan_stage_slot(loader);
+	}
 
-void toy_clear_vulkan_stage_memory (toy_vulkan_asset_loader_t* loader)
-{
-	toy_clear_vulkan_buffer_stack(&loader->stage_stack);
+	toy_ok(error);
 }
 
 
-void toy_copy_data_to_vulkan_stage_memory (
-	toy_stage_data_block_t* data_blocks,
-	uint32_t block_count,
+VkDeviceSize toy_get_vulkan_stage_ring_space (
+	VkDevice dev,
 	toy_vulkan_asset_loader_t* loader,
-	toy_vulkan_sub_buffer_t* output_buffers,
-	toy_error_t* error)
+	VkDeviceSize alignment)
 {
-	size_t total_size = 0;
-	for (uint32_t i = 0; i < block_count; ++i)
-		total_size += data_blocks[i].size + data_blocks[i].alignment;
-	if (loader->stage_stack.buffer.size < total_size) {
-		// Todo: recreate stage buffer stack
-		toy_err(TOY_ERROR_MEMORY_DEVICE_ALLOCATION_FAILED, "Loader stage stack too small", error);
-		return;
+	TOY_ASSERT(alignment > 0);
+	toy_error_t err;
+	toy_poll_vulkan_stage_submits(dev, loader, &err);
+	if (toy_is_failed(err))
+		toy_log_error(&err);
+
+	// Same regions as toy_alloc_vulkan_stage_ring(), a block at ring head starts at the next aligned offset
+	if (0 == loader->ring_used)
+		return loader->stage_buffer.size;
+	if (loader->ring_head == loader->ring_tail)
+		return 0;
+	VkDeviceSize offset = (loader->ring_head + alignment - 1) / alignment * alignment;
+	if (loader->ring_head > loader->ring_tail) {
+		VkDeviceSize end_space = loader->stage_buffer.size > offset ? loader->stage_buffer.size - offset : 0;
+		return end_space > loader->ring_tail ? end_space : loader->ring_tail;
 	}
+	return loader->ring_tail > offset ? loader->ring_tail - offset : 0;
+}
 
-	TOY_ASSERT(NULL != loader->mapping_memory);
 
-	for (uint32_t i = 0; i < block_count; ++i) {
-		VkDeviceSize buffer_size = toy_vulkan_sub_buffer_alloc_L(
-			&loader->stage_stack, data_blocks[i].alignment, data_blocks[i].size, &output_buffers[i]);
-		if (VK_WHOLE_SIZE == buffer_size) {
-			toy_err(TOY_ERROR_MEMORY_DEVICE_ALLOCATION_FAILED, "Loader stage stack too small", error);
-			for (uint32_t j = i; j > 0; --j)
-				toy_vulkan_sub_buffer_free_L(&loader->stage_stack, &output_buffers[j-1]);
-			return;
+// Alloc contiguous region at ring head, it wraps to 0 when end of ring is too small.
+// Return false when free space of ring is not enough
+static bool toy_alloc_vulkan_stage_ring (
+	toy_vulkan_asset_loader_t* loader,
+	VkDeviceSize alignment,
+	VkDeviceSize size,
+	toy_vulkan_sub_buffer_t* output)
+{
+	TOY_ASSERT(alignment > 0);
+	VkDeviceSize ring_size = loader->stage_buffer.size;
+	VkDeviceSize head = loader->ring_head;
+	VkDeviceSize tail = loader->ring_tail;
+
+	if (0 == loader->ring_used)
+		head = tail = 0;
+	else if (head == tail)
+		return false;
+
+	VkDeviceSize offset = (head + alignment - 1) / alignment * alignment;
+	VkDeviceSize used_size;
+	if (head > tail || 0 == loader->ring_used) {
+		// Free space is [head, ring_size) and [0, tail)
+		if (offset + size <= ring_size) {
+			used_size = offset + size - head;
+		}
+		else if (size <= tail) {
+			offset = 0;
+			used_size = ring_size - head + size;
+		}
+		else {
+			return false;
 		}
-
-		uintptr_t start = (uintptr_t)loader->mapping_memory + output_buffers[i].offset + output_buffers[i].source->binding.offset;
-		memcpy((void*)start, data_blocks[i].data, data_blocks[i].size);
+	}
+	else {
+		if (offset + size > tail)
+			return false;
+		used_size = offset + size - head;
 	}
 
-	toy_ok(error);
-	return;
+	if (0 == loader->batch_ring_size)
+		loader->batch_ring_start = head;
+	loader->ring_head = offset + size;
+	loader->ring_tail = tail;
+	loader->ring_used += used_size;
+	loader->batch_ring_size += used_size;
+
+	output->handle = loader->stage_buffer.handle;
+	output->offset = offset;
+	output->size = size;
+	output->padding = used_size - size;
+	output->source = &loader->stage_buffer;
+	return true;
 }
 
 
-VkResult toy_start_vkcmd_stage_mesh_primitive (
-	toy_vulkan_asset_loader_t* loader)
+// Give ring region of recording batch back, its data is the newest of ring
+static void toy_free_vulkan_stage_batch_ring (toy_vulkan_asset_loader_t* loader)
 {
-	VkCommandBufferBeginInfo cmd_bi;
-	cmd_bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	cmd_bi.pNext = NULL;
-	cmd_bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-	cmd_bi.pInheritanceInfo = NULL;
-	return vkBeginCommandBuffer(loader->transfer_cmd, &cmd_bi);
+	if (loader->batch_ring_size > 0) {
+		loader->ring_head = loader->batch_ring_start;
+		loader->ring_used -= loader->batch_ring_size;
+		loader->batch_ring_size = 0;
+	}
 }
 
 
-void toy_submit_vkcmd_stage_mesh_primitive (
+// Graphic_cmd waits for transfer_cmd by semaphore, fence of slot is signaled after both
+static void toy_submit_vulkan_stage_cmd (
 	VkDevice dev,
 	toy_vulkan_asset_loader_t* loader,
+	toy_vulkan_stage_slot_t* slot,
+	bool with_graphic_cmd,
 	toy_error_t* error)
 {
 	VkResult vk_err;
 
-	vk_err = vkEndCommandBuffer(loader->transfer_cmd);
+	vk_err = vkResetFences(dev, 1, &slot->fence);
 	if (toy_unlikely(VK_SUCCESS != vk_err)) {
-		toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkEndCommandBuffer for load mesh primitive failed", error);
+		toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkResetFences for submit cmd failed", error);
 		return;
 	}
 
-	vk_err = vkResetFences(dev, 1, &loader->fence);
-	if (toy_unlikely(VK_SUCCESS != vk_err)) {
-		toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkResetFences for submit cmd of mesh primitive failed", error);
-		return;
-	}
+	VkSubmitInfo submit_infos[2];
+	submit_infos[0].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_infos[0].pNext = NULL;
+	submit_infos[0].waitSemaphoreCount = 0;
+	submit_infos[0].pWaitSemaphores = NULL;
+	submit_infos[0].pWaitDstStageMask = NULL;
+	submit_infos[0].commandBufferCount = 1;
+	submit_infos[0].pCommandBuffers = &slot->transfer_cmd;
+	submit_infos[0].signalSemaphoreCount = 1;
+	submit_infos[0].pSignalSemaphores = &slot->semaphore;
 
-	VkSubmitInfo transfer_submit_info;
-	transfer_submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	transfer_submit_info.pNext = NULL;
-	transfer_submit_info.waitSemaphoreCount = 0;
-	transfer_submit_info.pWaitSemaphores = NULL;
-	transfer_submit_info.pWaitDstStageMask = NULL;
-	transfer_submit_info.commandBufferCount = 1;
-	transfer_submit_info.pCommandBuffers = &loader->transfer_cmd;
-	transfer_submit_info.signalSemaphoreCount = 0;
-	transfer_submit_info.pSignalSemaphores = NULL;
-	vk_err = vkQueueSubmit(loader->transfer_queue, 1, &transfer_submit_info, loader->fence);
-	if (toy_unlikely(VK_SUCCESS != vk_err)) {
-		toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkQueueSubmit for submit cmd of mesh primitive failed", error);
-		return;
+	VkPipelineStageFlags wait_stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	submit_infos[1].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_infos[1].pNext = NULL;
+	submit_infos[1].waitSemaphoreCount = 1;
+	submit_infos[1].pWaitSemaphores = &slot->semaphore;
+	submit_infos[1].pWaitDstStageMask = &wait_stages;
+	submit_infos[1].commandBufferCount = 1;
+	submit_infos[1].pCommandBuffers = &slot->graphic_cmd;
+	submit_infos[1].signalSemaphoreCount = 0;
+	submit_infos[1].pSignalSemaphores = NULL;
+
+	if (!with_graphic_cmd) {
+		submit_infos[0].signalSemaphoreCount = 0;
+		submit_infos[0].pSignalSemaphores = NULL;
+		vk_err = vkQueueSubmit(loader->transfer_queue, 1, &submit_infos[0], slot->fence);
+		if (toy_unlikely(VK_SUCCESS != vk_err)) {
+			toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkQueueSubmit for submit transfer cmd failed", error);
+			return;
+		}
+	}
+	else if (loader->transfer_queue == loader->graphic_queue) {
+		vk_err = vkQueueSubmit(loader->graphic_queue, 2, submit_infos, slot->fence);
+		if (toy_unlikely(VK_SUCCESS != vk_err)) {
+			toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkQueueSubmit for submit cmd failed", error);
+			return;
+		}
+	}
+	else {
+		vk_err = vkQueueSubmit(loader->transfer_queue, 1, &submit_infos[0], VK_NULL_HANDLE);
+		if (toy_unlikely(VK_SUCCESS != vk_err)) {
+			toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkQueueSubmit for submit cmd failed", error);
+			return;
+		}
+		vk_err = vkQueueSubmit(loader->graphic_queue, 1, &submit_infos[1], slot->fence);
+		if (toy_unlikely(VK_SUCCESS != vk_err)) {
+			toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkQueueSubmit for submit cmd failed", error);
+			return;
+		}
 	}
 
 	toy_ok(error);
@@ -331,62 +464,37 @@ void toy_submit_vkcmd_stage_mesh_primitive (
 }
 
 
-VkResult toy_start_vkcmd_stage_image (
-	toy_vulkan_asset_loader_t* loader)
+static void toy_fill_vulkan_stage_image_barrier (
+	VkImage image,
+	VkAccessFlags src_access,
+	VkAccessFlags dst_access,
+	VkImageLayout old_layout,
+	VkImageLayout new_layout,
+	VkImageMemoryBarrier* output)
 {
-	VkResult vk_err;
-	VkCommandBufferBeginInfo cmd_bi;
-	cmd_bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	cmd_bi.pNext = NULL;
-	cmd_bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-	cmd_bi.pInheritanceInfo = NULL;
-	vk_err = vkBeginCommandBuffer(loader->transfer_cmd, &cmd_bi);
-	if (VK_SUCCESS != vk_err)
-		return vk_err;
-
-	vk_err = vkBeginCommandBuffer(loader->graphic_cmd, &cmd_bi);
-	if (VK_SUCCESS != vk_err) {
-		vkEndCommandBuffer(loader->transfer_cmd);
-		return vk_err;
-	}
-	return vk_err;
+	output->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	output->pNext = NULL;
+	output->srcAccessMask = src_access;
+	output->dstAccessMask = dst_access;
+	output->oldLayout = old_layout;
+	output->newLayout = new_layout;
+	output->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	output->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	output->image = image;
+	output->subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	output->subresourceRange.baseMipLevel = 0;
+	output->subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+	output->subresourceRange.baseArrayLayer = 0;
+	output->subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
 }
 
 
-// vkspec.html#synchronization-pipeline-barriers
-// vkspec.html#synchronization-memory-barriers
-void toy_vkcmd_stage_texture_image (
-	toy_vulkan_asset_loader_t* loader,
-	toy_vulkan_sub_buffer_p src_buffer,
-	toy_vulkan_image_p dst_image,
-	uint32_t width,
-	uint32_t height,
-	uint32_t mipmap_level)
+static void toy_vkcmd_copy_stage_image (
+	VkCommandBuffer cmd,
+	const toy_vulkan_stage_image_t* stage_image)
 {
-	VkImageMemoryBarrier transfer_mem_barrier;
-	transfer_mem_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	transfer_mem_barrier.pNext = NULL;
-	transfer_mem_barrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-	transfer_mem_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	transfer_mem_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	transfer_mem_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	transfer_mem_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	transfer_mem_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	transfer_mem_barrier.image = dst_image->handle;
-	transfer_mem_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	transfer_mem_barrier.subresourceRange.baseMipLevel = 0;
-	transfer_mem_barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
-	transfer_mem_barrier.subresourceRange.baseArrayLayer = 0;
-	transfer_mem_barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
-	vkCmdPipelineBarrier(
-		loader->transfer_cmd,
-		VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
-		0,
-		0, NULL,
-		0, NULL,
-		1, &transfer_mem_barrier);
-
 	VkBufferImageCopy copy_regions[TOY_MAX_VULKAN_MIPMAP_LAVEL];
+	uint32_t mipmap_level = stage_image->mipmap_level;
 	TOY_ASSERT(TOY_MAX_VULKAN_MIPMAP_LAVEL >= mipmap_level);
 	for (uint32_t mipmap_lv_i = 0; mipmap_lv_i < mipmap_level; ++mipmap_lv_i) {
 		//VkImageSubresource img_sub_res;
@@ -396,120 +504,352 @@ void toy_vkcmd_stage_texture_image (
 		//VkSubresourceLayout sub_res_layout;
 		//vkGetImageSubresourceLayout(dev, dst_image->handle, &img_sub_res, &sub_res_layout);
 
-		copy_regions[mipmap_lv_i].bufferOffset = src_buffer->offset;
-		copy_regions[mipmap_lv_i].bufferRowLength = width; // or 0 when tightly packed
-		copy_regions[mipmap_lv_i].bufferImageHeight = height; // or 0 when tightly packed
+		copy_regions[mipmap_lv_i].bufferOffset = stage_image->src_buffer.offset;
+		copy_regions[mipmap_lv_i].bufferRowLength = stage_image->width; // or 0 when tightly packed
+		copy_regions[mipmap_lv_i].bufferImageHeight = stage_image->row_count; // or 0 when tightly packed
 		copy_regions[mipmap_lv_i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		copy_regions[mipmap_lv_i].imageSubresource.mipLevel = mipmap_lv_i;
 		copy_regions[mipmap_lv_i].imageSubresource.baseArrayLayer = 0;
 		copy_regions[mipmap_lv_i].imageSubresource.layerCount = 1;
 		copy_regions[mipmap_lv_i].imageOffset.x = 0;
-		copy_regions[mipmap_lv_i].imageOffset.y = 0;
+		copy_regions[mipmap_lv_i].imageOffset.y = (int32_t)stage_image->first_row;
 		copy_regions[mipmap_lv_i].imageOffset.z = 0;
-		copy_regions[mipmap_lv_i].imageExtent.width = width;
-		copy_regions[mipmap_lv_i].imageExtent.height = height;
+		copy_regions[mipmap_lv_i].imageExtent.width = stage_image->width;
+		copy_regions[mipmap_lv_i].imageExtent.height = stage_image->row_count;
 		copy_regions[mipmap_lv_i].imageExtent.depth = 1;
 	}
 
 	vkCmdCopyBufferToImage(
-		loader->transfer_cmd,
-		src_buffer->handle,
-		dst_image->handle,
+		cmd,
+		stage_image->src_buffer.handle,
+		stage_image->image,
 		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 		mipmap_level, copy_regions);
-
-	VkImageMemoryBarrier fmt_mem_barrier;
-	fmt_mem_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	fmt_mem_barrier.pNext = NULL;
-	fmt_mem_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	fmt_mem_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-	fmt_mem_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	fmt_mem_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	fmt_mem_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	fmt_mem_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	fmt_mem_barrier.image = dst_image->handle;
-	fmt_mem_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	fmt_mem_barrier.subresourceRange.baseMipLevel = 0;
-	fmt_mem_barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
-	fmt_mem_barrier.subresourceRange.baseArrayLayer = 0;
-	fmt_mem_barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
-	vkCmdPipelineBarrier(
-		loader->graphic_cmd,
-		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-		0,
-		0, NULL,
-		0, NULL,
-		1, &fmt_mem_barrier);
 }
 
 
-void toy_submit_vkcmd_stage_image (
+void toy_begin_vulkan_stage_batch (
 	VkDevice dev,
 	toy_vulkan_asset_loader_t* loader,
 	toy_error_t* error)
 {
+	TOY_ASSERT(!loader->batch_recording);
 	VkResult vk_err;
 
-	vk_err = vkEndCommandBuffer(loader->transfer_cmd);
+	// Slot was last used by submit of serial + 1 - TOY_VULKAN_STAGE_SLOT_COUNT
+	uint64_t serial = loader->submit_serial + 1;
+	if (serial > TOY_VULKAN_STAGE_SLOT_COUNT) {
+		toy_wait_vulkan_stage_submit(dev, loader, serial - TOY_VULKAN_STAGE_SLOT_COUNT, error);
+		if (toy_is_failed(*error))
+			return;
+	}
+
+	toy_vulkan_stage_slot_t* slot = toy_get_vulkan_stage_slot(loader, serial);
+	vk_err = vkResetCommandPool(dev, slot->transfer_pool, VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
 	if (toy_unlikely(VK_SUCCESS != vk_err)) {
-		toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkEndCommandBuffer for transfer command failed", error);
+		toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkResetCommandPool for transfer cmd pool of stage batch failed", error);
 		return;
 	}
 
-	vk_err = vkEndCommandBuffer(loader->graphic_cmd);
+	if (slot->graphic_pool != slot->transfer_pool) {
+		vk_err = vkResetCommandPool(dev, slot->graphic_pool, VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
+		if (toy_unlikely(VK_SUCCESS != vk_err)) {
+			toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkResetCommandPool for graphic cmd pool of stage batch failed", error);
+			return;
+		}
+	}
+
+	VkCommandBufferBeginInfo cmd_bi;
+	cmd_bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cmd_bi.pNext = NULL;
+	cmd_bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	cmd_bi.pInheritanceInfo = NULL;
+	vk_err = vkBeginCommandBuffer(slot->transfer_cmd, &cmd_bi);
 	if (toy_unlikely(VK_SUCCESS != vk_err)) {
-		toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkEndCommandBuffer for graphic command failed", error);
+		toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkBeginCommandBuffer for stage batch failed", error);
 		return;
 	}
 
-	vk_err = vkResetFences(dev, 1, &loader->fence);
-	if (toy_unlikely(VK_SUCCESS != vk_err)) {
-		toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkResetFences for submit cmd failed", error);
+	loader->batch_recording = true;
+	loader->batch_buffer_count = 0;
+	loader->batch_image_count = 0;
+	loader->batch_ring_start = loader->ring_head;
+	loader->batch_ring_size = 0;
+	toy_ok(error);
+}
+
+
+// Stage ring or image list of recording batch is full, submit it and go on staging in next slot
+static void toy_continue_vulkan_stage_batch (
+	VkDevice dev,
+	toy_vulkan_asset_loader_t* loader,
+	toy_error_t* error)
+{
+	toy_submit_vulkan_stage_batch(dev, loader, error);
+	if (toy_is_failed(*error))
 		return;
+	toy_begin_vulkan_stage_batch(dev, loader, error);
+}
+
+
+// Reserve size bytes of ring, or the largest multiple of unit which a ring can hold when size is larger than ring.
+// Free space is made by finished submits, submitting recording batch, or waiting for oldest submit.
+// Return reserved size
+static VkDeviceSize toy_reserve_vulkan_stage_memory (
+	toy_vulkan_asset_loader_t* loader,
+	VkDeviceSize alignment,
+	VkDeviceSize size,
+	VkDeviceSize unit,
+	toy_vulkan_sub_buffer_t* output,
+	toy_error_t* error)
+{
+	VkDevice dev = loader->vk_alc->device;
+
+	if (size > loader->stage_buffer.size) {
+		size = loader->stage_buffer.size / unit * unit;
+		if (0 == size) {
+			toy_err(TOY_ERROR_MEMORY_DEVICE_ALLOCATION_FAILED, "Loader stage ring too small", error);
+			return 0;
+		}
 	}
 
-	VkSubmitInfo submit_infos[2];
-	submit_infos[0].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submit_infos[0].pNext = NULL;
-	submit_infos[0].waitSemaphoreCount = 0;
-	submit_infos[0].pWaitSemaphores = NULL;
-	submit_infos[0].pWaitDstStageMask = NULL;
-	submit_infos[0].commandBufferCount = 1;
-	submit_infos[0].pCommandBuffers = &loader->transfer_cmd;
-	submit_infos[0].signalSemaphoreCount = 1;
-	submit_infos[0].pSignalSemaphores = &loader->semaphore;
+	while (!toy_alloc_vulkan_stage_ring(loader, alignment, size, output)) {
+		toy_poll_vulkan_stage_submits(dev, loader, error);
+		if (toy_is_failed(*error))
+			return 0;
+		if (toy_alloc_vulkan_stage_ring(loader, alignment, size, output))
+			break;
+
+		if (!toy_is_vulkan_stage_batch_empty(loader)) {
+			toy_continue_vulkan_stage_batch(dev, loader, error);
+		}
+		else {
+			// Ring is empty when nothing is in flight, and size fits an empty ring
+			TOY_ASSERT(loader->complete_serial < loader->submit_serial);
+			toy_wait_vulkan_stage_submit(dev, loader, loader->complete_serial + 1, error);
+		}
+		if (toy_is_failed(*error))
+			return 0;
+	}
+
+	toy_ok(error);
+	return size;
+}
+
+
+void toy_stage_vulkan_buffer (
+	toy_vulkan_asset_loader_t* loader,
+	const toy_stage_data_block_t* data,
+	const toy_vulkan_sub_buffer_t* dst_buffer,
+	toy_error_t* error)
+{
+	TOY_ASSERT(loader->batch_recording);
+	TOY_ASSERT(data->size <= dst_buffer->size);
+
+	VkDeviceSize staged_size = 0;
+	while (staged_size < data->size) {
+		toy_vulkan_sub_buffer_t src_buffer;
+		VkDeviceSize size = toy_reserve_vulkan_stage_memory(
+			loader, data->alignment, data->size - staged_size, data->alignment, &src_buffer, error);
+		if (toy_is_failed(*error))
+			return;
+
+		memcpy((uint8_t*)loader->mapping_memory + src_buffer.offset, (const uint8_t*)data->data + staged_size, size);
+
+		// Reserving may have submitted last slot
+		toy_vulkan_stage_slot_t* slot = toy_get_vulkan_stage_slot(loader, loader->submit_serial + 1);
+		VkBufferCopy region;
+		region.srcOffset = src_buffer.offset;
+		region.dstOffset = dst_buffer->offset + staged_size;
+		region.size = size;
+		vkCmdCopyBuffer(slot->transfer_cmd, src_buffer.handle, dst_buffer->handle, 1, &region);
+
+		++loader->batch_buffer_count;
+		staged_size += size;
+	}
+
+	toy_ok(error);
+}
 
-	VkPipelineStageFlags wait_stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
-	submit_infos[1].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submit_infos[1].pNext = NULL;
-	submit_infos[1].waitSemaphoreCount = 1;
-	submit_infos[1].pWaitSemaphores = &loader->semaphore;
-	submit_infos[1].pWaitDstStageMask = &wait_stages;
-	submit_infos[1].commandBufferCount = 1;
-	submit_infos[1].pCommandBuffers = &loader->graphic_cmd;
-	submit_infos[1].signalSemaphoreCount = 0;
-	submit_infos[1].pSignalSemaphores = NULL;
 
-	if (loader->transfer_queue == loader->graphic_queue) {
-		vk_err = vkQueueSubmit(loader->graphic_queue, 2, submit_infos, loader->fence);
+void toy_stage_vulkan_image (
+	toy_vulkan_asset_loader_t* loader,
+	const toy_stage_data_block_t* pixels,
+	toy_vulkan_image_p dst_image,
+	uint32_t width,
+	uint32_t height,
+	uint32_t mipmap_level,
+	toy_error_t* error)
+{
+	TOY_ASSERT(loader->batch_recording && height > 0);
+
+	// Rows of mipmaps are not split
+	VkDeviceSize row_size = pixels->size / height;
+	VkDeviceSize unit = 1 == mipmap_level ? row_size : pixels->size;
+
+	uint32_t first_row = 0;
+	while (first_row < height) {
+		if (TOY_VULKAN_STAGE_BATCH_MAX_IMAGE == loader->batch_image_count) {
+			toy_continue_vulkan_stage_batch(loader->vk_alc->device, loader, error);
+			if (toy_is_failed(*error))
+				return;
+		}
+
+		toy_vulkan_sub_buffer_t src_buffer;
+		VkDeviceSize size = toy_reserve_vulkan_stage_memory(
+			loader, pixels->alignment, pixels->size - row_size * first_row, unit, &src_buffer, error);
+		if (toy_is_failed(*error))
+			return;
+
+		memcpy((uint8_t*)loader->mapping_memory + src_buffer.offset, (const uint8_t*)pixels->data + row_size * first_row, size);
+
+		// Reserving may have submitted images staged before
+		toy_vulkan_stage_image_t* stage_image = &loader->batch_images[loader->batch_image_count];
+		stage_image->src_buffer = src_buffer;
+		stage_image->image = dst_image->handle;
+		stage_image->width = width;
+		stage_image->height = height;
+		stage_image->mipmap_level = mipmap_level;
+		stage_image->first_row = first_row;
+		stage_image->row_count = 1 == mipmap_level ? (uint32_t)(size / row_size) : height;
+		++loader->batch_image_count;
+		first_row += stage_image->row_count;
+	}
+
+	toy_ok(error);
+}
+
+
+// vkspec.html#synchronization-pipeline-barriers
+// vkspec.html#synchronization-memory-barriers
+void toy_submit_vulkan_stage_batch (
+	VkDevice dev,
+	toy_vulkan_asset_loader_t* loader,
+	toy_error_t* error)
+{
+	TOY_ASSERT(loader->batch_recording);
+	VkResult vk_err;
+	uint32_t image_count = loader->batch_image_count;
+	uint32_t barrier_count;
+	VkImageMemoryBarrier barriers[TOY_VULKAN_STAGE_BATCH_MAX_IMAGE];
+	toy_vulkan_stage_slot_t* slot = toy_get_vulkan_stage_slot(loader, loader->submit_serial + 1);
+	loader->batch_recording = false;
+
+	if (0 == (loader->stage_buffer.binding.property_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+		VkMappedMemoryRange range;
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.pNext = NULL;
+		range.memory = loader->stage_buffer.binding.memory;
+		range.offset = loader->stage_buffer.binding.offset; // VkPhysicalDeviceLimits::nonCoherentAtomSize
+		range.size = loader->stage_buffer.size;
+		vk_err = vkFlushMappedMemoryRanges(dev, 1, &range);
 		if (toy_unlikely(VK_SUCCESS != vk_err)) {
-			toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkQueueSubmit for submit cmd failed", error);
+			toy_err_vkerr(TOY_ERROR_MEMORY_FLUSH_FAILED, vk_err, "vkFlushMappedMemoryRanges for stage batch failed", error);
+			goto FAIL;
 		}
-		return;
 	}
-	else {
-		vk_err = vkQueueSubmit(loader->transfer_queue, 1, &submit_infos[0], VK_NULL_HANDLE);
+
+	// One barrier command for layouts of all images, rows of split image after first submit are in transfer layout
+	barrier_count = 0;
+	for (uint32_t i = 0; i < image_count; ++i) {
+		if (0 != loader->batch_images[i].first_row)
+			continue;
+		toy_fill_vulkan_stage_image_barrier(
+			loader->batch_images[i].image,
+			VK_ACCESS_HOST_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			&barriers[barrier_count++]);
+	}
+	if (barrier_count > 0) {
+		vkCmdPipelineBarrier(
+			slot->transfer_cmd,
+			VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			0, NULL,
+			0, NULL,
+			barrier_count, barriers);
+	}
+
+	for (uint32_t i = 0; i < image_count; ++i)
+		toy_vkcmd_copy_stage_image(slot->transfer_cmd, &loader->batch_images[i]);
+
+	vk_err = vkEndCommandBuffer(slot->transfer_cmd);
+	if (toy_unlikely(VK_SUCCESS != vk_err)) {
+		toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkEndCommandBuffer for stage batch failed", error);
+		goto FAIL;
+	}
+
+	// Images whose last rows are in this submit are ready for shaders
+	barrier_count = 0;
+	for (uint32_t i = 0; i < image_count; ++i) {
+		const toy_vulkan_stage_image_t* stage_image = &loader->batch_images[i];
+		if (stage_image->first_row + stage_image->row_count != stage_image->height)
+			continue;
+		toy_fill_vulkan_stage_image_barrier(
+			stage_image->image,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			&barriers[barrier_count++]);
+	}
+
+	if (barrier_count > 0) {
+		VkCommandBufferBeginInfo cmd_bi;
+		cmd_bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		cmd_bi.pNext = NULL;
+		cmd_bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		cmd_bi.pInheritanceInfo = NULL;
+		vk_err = vkBeginCommandBuffer(slot->graphic_cmd, &cmd_bi);
 		if (toy_unlikely(VK_SUCCESS != vk_err)) {
-			toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkQueueSubmit for submit cmd failed", error);
-			return;
+			toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkBeginCommandBuffer for graphic command of stage batch failed", error);
+			goto FAIL;
 		}
-		vk_err = vkQueueSubmit(loader->graphic_queue, 1, &submit_infos[1], loader->fence);
+
+		vkCmdPipelineBarrier(
+			slot->graphic_cmd,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0,
+			0, NULL,
+			0, NULL,
+			barrier_count, barriers);
+
+		vk_err = vkEndCommandBuffer(slot->graphic_cmd);
 		if (toy_unlikely(VK_SUCCESS != vk_err)) {
-			toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkQueueSubmit for submit cmd failed", error);
-			return;
+			toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "vkEndCommandBuffer for graphic command of stage batch failed", error);
+			goto FAIL;
 		}
 	}
 
+	toy_submit_vulkan_stage_cmd(dev, loader, slot, barrier_count > 0, error);
+	if (toy_is_failed(*error))
+		goto FAIL;
+
+	slot->serial = ++loader->submit_serial;
+	slot->ring_end = loader->ring_head;
+	slot->ring_size = loader->batch_ring_size;
+	loader->batch_ring_size = 0;
+	loader->batch_buffer_count = 0;
+	loader->batch_image_count = 0;
 	toy_ok(error);
 	return;
+
+FAIL:
+	// Command buffers are reset with command pools when slot begins next batch
+	toy_free_vulkan_stage_batch_ring(loader);
+	loader->batch_buffer_count = 0;
+	loader->batch_image_count = 0;
+	return;
+}
+
+
+void toy_cancel_vulkan_stage_batch (
+	VkDevice dev,
+	toy_vulkan_asset_loader_t* loader)
+{
+	TOY_ASSERT(loader->batch_recording);
+
+	// Recording command buffers are reset with command pools when slot begins next batch
+	toy_free_vulkan_stage_batch_ring(loader);
+	loader->batch_recording = false;
+	loader->batch_buffer_count = 0;
+	loader->batch_image_count = 0;
 }
@@ -42,6 +42,14 @@ void toy_create_vulkan_driver (
 		return;
 	}
 
+	toy_create_vulkan_state_cache(&alc->list_alc, &output->state_cache, error);
+	if (toy_unlikely(toy_is_failed(*error))) {
+		toy_destroy_vulkan_swapchain(output->device.handle, &output->swapchain, &alc->buddy_alc, vk_alc_cb);
+		toy_destroy_vulkan_memory_allocator(&output->vk_allocator);
+		toy_destroy_vulkan_device(&output->device, alc, vk_alc_cb);
+		return;
+	}
+
 	output->render_config.msaa_count = toy_select_vulkan_msaa(
 		setup_info->msaa_count, &output->device.physical_device.properties.limits);
 	output->render_config.depth_format = toy_select_vulkan_depth_image_format(output->device.physical_device.handle);
@@ -76,6 +84,8 @@ void toy_create_vulkan_driver (
 
 void toy_destroy_vulkan_driver (toy_vulkan_driver_t* vk_driver, const toy_memory_allocator_t* alc)
 {
+	toy_destroy_vulkan_state_cache(vk_driver->device.handle, vk_driver->vk_alc_cb_p, &vk_driver->state_cache);
+
 	toy_destroy_vulkan_swapchain(vk_driver->device.handle, &vk_driver->swapchain, &alc->buddy_alc, vk_driver->vk_alc_cb_p);
 
 	toy_destroy_vulkan_memory_allocator(&vk_driver->vk_allocator);
@@ -654,7 +654,7 @@ static void toy_alloc_vulkan_binding_memory_via_lists (
 		return;
 	}
 
-	toy_allocator_t* mem_alc = &alc->mem_alc->buddy_alc;
+	toy_allocator_t* mem_alc = &alc->mem_alc->small_alc;
 	toy_vulkan_memory_list_p new_list = (toy_vulkan_memory_list_p)toy_alloc_aligned(mem_alc, sizeof(toy_vulkan_memory_list_t), sizeof(void*));
 	if (toy_unlikely(NULL == new_list)) {
 		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "failed to create toy_vulkan_memory_list_t", error);
@@ -727,10 +727,9 @@ void toy_create_vulkan_memory_allocator (
 	toy_create_memory_pools(
 		sizeof(toy_vulkan_memory_list_chunk_t) * 2048,
 		sizeof(toy_vulkan_memory_list_chunk_t),
-		mem_alc,
 		&output->chunk_pools,
 		&output->chunk_alc);
-	if (toy_unlikely(NULL == output->chunk_pools)) {
+	if (toy_unlikely(NULL == output->chunk_pools.pools)) {
 		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Malloc vulkan allocator chunk pool failed", error);
 		return;
 	}
@@ -754,7 +753,7 @@ void toy_create_vulkan_memory_allocator (
 void toy_destroy_vulkan_memory_allocator (
 	toy_vulkan_memory_allocator_t* alc)
 {
-	toy_allocator_t* mem_alc = &alc->mem_alc->buddy_alc;
+	toy_allocator_t* mem_alc = &alc->mem_alc->small_alc;
 
 	for (int i = 0; i < VK_MAX_MEMORY_TYPES; ++i) {
 		toy_vulkan_memory_list_p list = alc->vk_mem_list[i];
@@ -766,7 +765,7 @@ void toy_destroy_vulkan_memory_allocator (
 		}
 	}
 
-	toy_destroy_memory_pools(alc->chunk_pools, alc->mem_alc);
+	toy_destroy_memory_pools(&alc->chunk_pools);
 }
 
 
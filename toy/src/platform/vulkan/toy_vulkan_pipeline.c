@@ -5,32 +5,20 @@
 
 
 VkResult toy_create_vulkan_descriptor_set_layout (
+	toy_vulkan_state_cache_t* cache,
 	VkDevice dev,
 	const VkDescriptorSetLayoutBinding* layout_bindings,
 	uint32_t binding_count,
 	const VkAllocationCallbacks* vk_alc_cb,
 	toy_vulkan_descriptor_set_layout_t* output)
 {
-	if (VK_NULL_HANDLE != output->handle) {
-		if ((output->binding_count == binding_count) && (0 == memcmp(output->layout_bindings, layout_bindings, sizeof(layout_bindings))))
-			return VK_SUCCESS;
-		return VK_ERROR_FORMAT_NOT_SUPPORTED;
-	}
-
-	VkDescriptorSetLayoutCreateInfo ci;
-	ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	ci.pNext = NULL;
-	// PUSH_DESCRIPTOR need extension VK_KHR_push_descriptor
-	ci.flags = 0; // VkDescriptorSetLayoutCreateFlags: 0 | UPDATE_AFTER_BIND_POOL | PUSH_DESCRIPTOR
-	ci.bindingCount = binding_count;
-	ci.pBindings = layout_bindings;
-	VkResult vk_err = vkCreateDescriptorSetLayout(dev, &ci, vk_alc_cb, &output->handle);
+	VkResult vk_err = toy_acquire_vulkan_descriptor_set_layout(cache, dev, layout_bindings, binding_count, vk_alc_cb, &output->handle);
 	if (VK_SUCCESS != vk_err) {
 		output->handle = VK_NULL_HANDLE;
 		return vk_err;
 	}
 	output->layout_bindings = layout_bindings;
-	output->binding_count = ci.bindingCount;
+	output->binding_count = binding_count;
 	return VK_SUCCESS;
 }
 
@@ -64,10 +52,10 @@ void toy_update_vulkan_descriptor_set (
 		switch (layout_bindings[i].descriptorType) {
 		case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
 		{
-			toy_asset_pool_item_ref_t* image_ref = (toy_asset_pool_item_ref_t*)((uintptr_t)desc_set_data + bindings[i].offset);
-			toy_asset_pool_item_ref_t* sampler_ref = image_ref + 1;
-			toy_vulkan_image_p vk_image = toy_get_asset_item2(image_ref);
-			toy_vulkan_sampler_t* vk_sampler = toy_get_asset_item2(sampler_ref);
+			toy_asset_handle_t* image_handle = (toy_asset_handle_t*)((uintptr_t)desc_set_data + bindings[i].offset);
+			toy_vulkan_image_p vk_image = toy_resolve_asset_handle(image_handle[0]);
+			toy_vulkan_sampler_t* vk_sampler = toy_resolve_asset_handle(image_handle[1]);
+			TOY_ASSERT(NULL != vk_image && NULL != vk_sampler);
 			info[i].img_info.sampler = vk_sampler->handle;
 			info[i].img_info.imageView = vk_image->view;
 			info[i].img_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
@@ -0,0 +1,384 @@
+#include "../../include/platform/vulkan/toy_vulkan_state_cache.h"
+
+#include "../../include/toy_asset_registry.h"
+#include "../../toy_assert.h"
+#include <string.h>
+
+
+#define TOY_VULKAN_STATE_EMPTY UINT64_C(0)
+
+
+// Never TOY_VULKAN_STATE_EMPTY
+static toy_inline uint64_t toy_get_vulkan_state_hash (enum toy_vulkan_state_kind_t kind, const void* key, size_t key_size)
+{
+	uint64_t h = toy_hash_asset_content(key, key_size, (uint64_t)kind + 1);
+	return TOY_VULKAN_STATE_EMPTY != h ? h : 1;
+}
+
+
+void toy_create_vulkan_state_cache (
+	const toy_allocator_t* alc,
+	toy_vulkan_state_cache_t* output,
+	toy_error_t* error)
+{
+	TOY_ASSERT(NULL != alc && NULL != output);
+
+	output->entries = (toy_vulkan_state_entry_t*)toy_alloc(alc, sizeof(toy_vulkan_state_entry_t) * TOY_VULKAN_STATE_CACHE_MIN_CAPACITY);
+	if (NULL == output->entries) {
+		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Failed to alloc vulkan state cache", error);
+		return;
+	}
+	for (uint32_t i = 0; i < TOY_VULKAN_STATE_CACHE_MIN_CAPACITY; ++i)
+		output->entries[i].hash = TOY_VULKAN_STATE_EMPTY;
+	output->capacity = TOY_VULKAN_STATE_CACHE_MIN_CAPACITY;
+	output->used_count = 0;
+	output->alc = *alc;
+	toy_ok(error);
+}
+
+
+static void toy_destroy_vulkan_state_object (
+	VkDevice dev,
+	const VkAllocationCallbacks* vk_alc_cb,
+	const toy_vulkan_state_entry_t* entry)
+{
+	switch (entry->kind) {
+	case TOY_VULKAN_STATE_DESCRIPTOR_SET_LAYOUT:
+		vkDestroyDescriptorSetLayout(dev, entry->object.desc_set_layout, vk_alc_cb);
+		break;
+	case TOY_VULKAN_STATE_PIPELINE_LAYOUT:
+		vkDestroyPipelineLayout(dev, entry->object.pipeline_layout, vk_alc_cb);
+		break;
+	case TOY_VULKAN_STATE_PIPELINE:
+		vkDestroyPipeline(dev, entry->object.pipeline, vk_alc_cb);
+		break;
+	default:
+		TOY_ASSERT(0);
+		break;
+	}
+}
+
+
+void toy_destroy_vulkan_state_cache (
+	VkDevice dev,
+	const VkAllocationCallbacks* vk_alc_cb,
+	toy_vulkan_state_cache_t* cache)
+{
+	TOY_ASSERT(NULL != cache);
+	if (NULL == cache->entries)
+		return;
+
+	for (uint32_t i = 0; i < cache->capacity; ++i) {
+		toy_vulkan_state_entry_t* entry = &cache->entries[i];
+		if (TOY_VULKAN_STATE_EMPTY == entry->hash)
+			continue;
+		toy_destroy_vulkan_state_object(dev, vk_alc_cb, entry);
+		toy_free(&cache->alc, entry->key);
+	}
+
+	toy_free(&cache->alc, cache->entries);
+	cache->entries = NULL;
+	cache->capacity = 0;
+	cache->used_count = 0;
+}
+
+
+static toy_vulkan_state_entry_t* toy_find_vulkan_state_entry (
+	toy_vulkan_state_cache_t* cache,
+	uint64_t hash,
+	enum toy_vulkan_state_kind_t kind,
+	const void* key,
+	size_t key_size)
+{
+	uint32_t index = (uint32_t)hash & (cache->capacity - 1);
+	while (TOY_VULKAN_STATE_EMPTY != cache->entries[index].hash) {
+		toy_vulkan_state_entry_t* entry = &cache->entries[index];
+		if (entry->hash == hash && entry->kind == (uint32_t)kind && entry->key_size == key_size && 0 == memcmp(entry->key, key, key_size))
+			return entry;
+		index = (index + 1) & (cache->capacity - 1);
+	}
+	return NULL;
+}
+
+
+static bool toy_grow_vulkan_state_cache (toy_vulkan_state_cache_t* cache)
+{
+	uint32_t capacity = cache->capacity * 2;
+	toy_vulkan_state_entry_t* entries = (toy_vulkan_state_entry_t*)toy_alloc(&cache->alc, sizeof(toy_vulkan_state_entry_t) * capacity);
+	if (NULL == entries)
+		return false;
+	for (uint32_t i = 0; i < capacity; ++i)
+		entries[i].hash = TOY_VULKAN_STATE_EMPTY;
+
+	for (uint32_t i = 0; i < cache->capacity; ++i) {
+		toy_vulkan_state_entry_t* entry = &cache->entries[i];
+		if (TOY_VULKAN_STATE_EMPTY == entry->hash)
+			continue;
+		uint32_t index = (uint32_t)entry->hash & (capacity - 1);
+		while (TOY_VULKAN_STATE_EMPTY != entries[index].hash)
+			index = (index + 1) & (capacity - 1);
+		entries[index] = *entry;
+	}
+
+	toy_free(&cache->alc, cache->entries);
+	cache->entries = entries;
+	cache->capacity = capacity;
+	return true;
+}
+
+
+// Return new entry with no object and no reference, or NULL when out of memory
+static toy_vulkan_state_entry_t* toy_add_vulkan_state_entry (
+	toy_vulkan_state_cache_t* cache,
+	uint64_t hash,
+	enum toy_vulkan_state_kind_t kind,
+	const void* key,
+	size_t key_size)
+{
+	// Keep load factor under 1/2
+	if ((cache->used_count + 1) * 2 > cache->capacity && !toy_grow_vulkan_state_cache(cache))
+		return NULL;
+
+	void* key_copy = toy_alloc(&cache->alc, key_size);
+	if (NULL == key_copy)
+		return NULL;
+	memcpy(key_copy, key, key_size);
+
+	uint32_t index = (uint32_t)hash & (cache->capacity - 1);
+	while (TOY_VULKAN_STATE_EMPTY != cache->entries[index].hash)
+		index = (index + 1) & (cache->capacity - 1);
+	toy_vulkan_state_entry_t* entry = &cache->entries[index];
+	++(cache->used_count);
+
+	entry->hash = hash;
+	entry->key = key_copy;
+	entry->key_size = key_size;
+	entry->kind = (uint32_t)kind;
+	entry->ref_count = 0;
+	return entry;
+}
+
+
+// Linear probing without tombstones, entries after the removed one move back to their nearest free slot
+static void toy_remove_vulkan_state_entry (toy_vulkan_state_cache_t* cache, toy_vulkan_state_entry_t* entry)
+{
+	uint32_t mask = cache->capacity - 1;
+	uint32_t hole = (uint32_t)(entry - cache->entries);
+	toy_free(&cache->alc, entry->key);
+
+	uint32_t index = (hole + 1) & mask;
+	while (TOY_VULKAN_STATE_EMPTY != cache->entries[index].hash) {
+		uint32_t home = (uint32_t)cache->entries[index].hash & mask;
+		// Entry stays when its home lies cyclically in (hole, index]
+		bool stays = hole <= index ? (hole < home && home <= index) : (hole < home || home <= index);
+		if (!stays) {
+			cache->entries[hole] = cache->entries[index];
+			hole = index;
+		}
+		index = (index + 1) & mask;
+	}
+	cache->entries[hole].hash = TOY_VULKAN_STATE_EMPTY;
+	--(cache->used_count);
+}
+
+
+// Objects are released rarely, at teardown or when a pipeline is rebuilt, so they are found by a scan
+static toy_vulkan_state_entry_t* toy_find_vulkan_state_object (
+	toy_vulkan_state_cache_t* cache,
+	enum toy_vulkan_state_kind_t kind,
+	const void* object,
+	size_t object_size)
+{
+	for (uint32_t i = 0; i < cache->capacity; ++i) {
+		toy_vulkan_state_entry_t* entry = &cache->entries[i];
+		if (TOY_VULKAN_STATE_EMPTY != entry->hash && entry->kind == (uint32_t)kind && 0 == memcmp(&entry->object, object, object_size))
+			return entry;
+	}
+	return NULL;
+}
+
+
+static void toy_release_vulkan_state (
+	toy_vulkan_state_cache_t* cache,
+	VkDevice dev,
+	const VkAllocationCallbacks* vk_alc_cb,
+	enum toy_vulkan_state_kind_t kind,
+	const void* object,
+	size_t object_size)
+{
+	toy_vulkan_state_entry_t* entry = toy_find_vulkan_state_object(cache, kind, object, object_size);
+	if (NULL == entry) {
+		toy_vulkan_state_entry_t uncached;
+		uncached.kind = (uint32_t)kind;
+		memcpy(&uncached.object, object, object_size);
+		toy_destroy_vulkan_state_object(dev, vk_alc_cb, &uncached);
+		return;
+	}
+
+	TOY_ASSERT(entry->ref_count > 0);
+	if (--(entry->ref_count) > 0)
+		return;
+	toy_destroy_vulkan_state_object(dev, vk_alc_cb, entry);
+	toy_remove_vulkan_state_entry(cache, entry);
+}
+
+
+VkResult toy_acquire_vulkan_descriptor_set_layout (
+	toy_vulkan_state_cache_t* cache,
+	VkDevice dev,
+	const VkDescriptorSetLayoutBinding* bindings,
+	uint32_t binding_count,
+	const VkAllocationCallbacks* vk_alc_cb,
+	VkDescriptorSetLayout* output)
+{
+	TOY_ASSERT(NULL != cache && NULL != output);
+
+	size_t key_size = sizeof(*bindings) * binding_count;
+	uint64_t hash = toy_get_vulkan_state_hash(TOY_VULKAN_STATE_DESCRIPTOR_SET_LAYOUT, bindings, key_size);
+	toy_vulkan_state_entry_t* entry = toy_find_vulkan_state_entry(cache, hash, TOY_VULKAN_STATE_DESCRIPTOR_SET_LAYOUT, bindings, key_size);
+	if (NULL != entry) {
+		++(entry->ref_count);
+		*output = entry->object.desc_set_layout;
+		return VK_SUCCESS;
+	}
+
+	VkDescriptorSetLayoutCreateInfo ci;
+	ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	ci.pNext = NULL;
+	// PUSH_DESCRIPTOR need extension VK_KHR_push_descriptor
+	ci.flags = 0; // VkDescriptorSetLayoutCreateFlags: 0 | UPDATE_AFTER_BIND_POOL | PUSH_DESCRIPTOR
+	ci.bindingCount = binding_count;
+	ci.pBindings = bindings;
+	VkDescriptorSetLayout layout;
+	VkResult vk_err = vkCreateDescriptorSetLayout(dev, &ci, vk_alc_cb, &layout);
+	if (VK_SUCCESS != vk_err)
+		return vk_err;
+
+	entry = toy_add_vulkan_state_entry(cache, hash, TOY_VULKAN_STATE_DESCRIPTOR_SET_LAYOUT, bindings, key_size);
+	if (NULL == entry) {
+		vkDestroyDescriptorSetLayout(dev, layout, vk_alc_cb);
+		return VK_ERROR_OUT_OF_HOST_MEMORY;
+	}
+	entry->object.desc_set_layout = layout;
+	entry->ref_count = 1;
+	*output = layout;
+	return VK_SUCCESS;
+}
+
+
+VkResult toy_acquire_vulkan_pipeline_layout (
+	toy_vulkan_state_cache_t* cache,
+	VkDevice dev,
+	const VkDescriptorSetLayout* desc_set_layouts,
+	uint32_t desc_set_layout_count,
+	const VkAllocationCallbacks* vk_alc_cb,
+	VkPipelineLayout* output)
+{
+	TOY_ASSERT(NULL != cache && NULL != output);
+
+	// Descriptor set layouts come from the cache too, the same handles mean the same sets
+	size_t key_size = sizeof(*desc_set_layouts) * desc_set_layout_count;
+	uint64_t hash = toy_get_vulkan_state_hash(TOY_VULKAN_STATE_PIPELINE_LAYOUT, desc_set_layouts, key_size);
+	toy_vulkan_state_entry_t* entry = toy_find_vulkan_state_entry(cache, hash, TOY_VULKAN_STATE_PIPELINE_LAYOUT, desc_set_layouts, key_size);
+	if (NULL != entry) {
+		++(entry->ref_count);
+		*output = entry->object.pipeline_layout;
+		return VK_SUCCESS;
+	}
+
+	VkPipelineLayoutCreateInfo layout_ci;
+	layout_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layout_ci.pNext = NULL;
+	layout_ci.flags = 0;
+	layout_ci.setLayoutCount = desc_set_layout_count;
+	layout_ci.pSetLayouts = desc_set_layouts;
+	layout_ci.pushConstantRangeCount = 0;
+	layout_ci.pPushConstantRanges = NULL;
+	VkPipelineLayout layout;
+	VkResult vk_err = vkCreatePipelineLayout(dev, &layout_ci, vk_alc_cb, &layout);
+	if (VK_SUCCESS != vk_err)
+		return vk_err;
+
+	entry = toy_add_vulkan_state_entry(cache, hash, TOY_VULKAN_STATE_PIPELINE_LAYOUT, desc_set_layouts, key_size);
+	if (NULL == entry) {
+		vkDestroyPipelineLayout(dev, layout, vk_alc_cb);
+		return VK_ERROR_OUT_OF_HOST_MEMORY;
+	}
+	entry->object.pipeline_layout = layout;
+	entry->ref_count = 1;
+	*output = layout;
+	return VK_SUCCESS;
+}
+
+
+bool toy_find_vulkan_pipeline (
+	toy_vulkan_state_cache_t* cache,
+	const void* key,
+	size_t key_size,
+	VkPipeline* output)
+{
+	TOY_ASSERT(NULL != cache && NULL != key && NULL != output);
+
+	uint64_t hash = toy_get_vulkan_state_hash(TOY_VULKAN_STATE_PIPELINE, key, key_size);
+	toy_vulkan_state_entry_t* entry = toy_find_vulkan_state_entry(cache, hash, TOY_VULKAN_STATE_PIPELINE, key, key_size);
+	if (NULL == entry)
+		return false;
+	++(entry->ref_count);
+	*output = entry->object.pipeline;
+	return true;
+}
+
+
+bool toy_add_vulkan_pipeline (
+	toy_vulkan_state_cache_t* cache,
+	const void* key,
+	size_t key_size,
+	VkPipeline pipeline)
+{
+	TOY_ASSERT(NULL != cache && NULL != key && VK_NULL_HANDLE != pipeline);
+
+	uint64_t hash = toy_get_vulkan_state_hash(TOY_VULKAN_STATE_PIPELINE, key, key_size);
+	TOY_ASSERT(NULL == toy_find_vulkan_state_entry(cache, hash, TOY_VULKAN_STATE_PIPELINE, key, key_size));
+	toy_vulkan_state_entry_t* entry = toy_add_vulkan_state_entry(cache, hash, TOY_VULKAN_STATE_PIPELINE, key, key_size);
+	if (NULL == entry)
+		return false;
+	entry->object.pipeline = pipeline;
+	entry->ref_count = 1;
+	return true;
+}
+
+
+void toy_release_vulkan_descriptor_set_layout (
+	toy_vulkan_state_cache_t* cache,
+	VkDevice dev,
+	const VkAllocationCallbacks* vk_alc_cb,
+	VkDescriptorSetLayout desc_set_layout)
+{
+	TOY_ASSERT(NULL != cache);
+	if (VK_NULL_HANDLE != desc_set_layout)
+		toy_release_vulkan_state(cache, dev, vk_alc_cb, TOY_VULKAN_STATE_DESCRIPTOR_SET_LAYOUT, &desc_set_layout, sizeof(desc_set_layout));
+}
+
+
+void toy_release_vulkan_pipeline_layout (
+	toy_vulkan_state_cache_t* cache,
+	VkDevice dev,
+	const VkAllocationCallbacks* vk_alc_cb,
+	VkPipelineLayout pipeline_layout)
+{
+	TOY_ASSERT(NULL != cache);
+	if (VK_NULL_HANDLE != pipeline_layout)
+		toy_release_vulkan_state(cache, dev, vk_alc_cb, TOY_VULKAN_STATE_PIPELINE_LAYOUT, &pipeline_layout, sizeof(pipeline_layout));
+}
+
+
+void toy_release_vulkan_pipeline (
+	toy_vulkan_state_cache_t* cache,
+	VkDevice dev,
+	const VkAllocationCallbacks* vk_alc_cb,
+	VkPipeline pipeline)
+{
+	TOY_ASSERT(NULL != cache);
+	if (VK_NULL_HANDLE != pipeline)
+		toy_release_vulkan_state(cache, dev, vk_alc_cb, TOY_VULKAN_STATE_PIPELINE, &pipeline, sizeof(pipeline));
+}
@@ -21,6 +21,14 @@ toy_app_t* toy_create_app (
 	mem_cfg.buddy_size = 64 * 1024 * 1024; // 64M
 	mem_cfg.list_size = 64 * 1024 * 1024; // 64M
 	mem_cfg.chunk_count = 256;
+	mem_cfg.list_strategy = TOY_MEMORY_LIST_STRATEGY_TLSF;
+	mem_cfg.thread_cache = true;
+	mem_cfg.frame_size = 4 * 1024 * 1024; // 4M
+	mem_cfg.concurrent_chunk_count = 256; // 8M
+	mem_cfg.virtual_memory = true;
+	mem_cfg.reserve_size = (size_t)1 << (sizeof(void*) >= 8 ? 32 : 28); // 4G, 256M on 32-bit
+	mem_cfg.chunk_large_page = false;
+	mem_cfg.trace_path = NULL;
 	app->alc = toy_create_memory_allocator(&mem_cfg);
 	if (NULL == app->alc) {
 		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Failed to create memory allocator", error);
@@ -30,7 +38,8 @@ toy_app_t* toy_create_app (
 	toy_init_timer_env();
 	toy_init_hid(&app->hid);
 
-	app->main_vm = toy_lua_new_vm();
+	app->lua_alc = toy_get_tagged_allocator(app->alc, &app->alc->list_alc, TOY_MEMORY_TAG_LUA);
+	app->main_vm = toy_lua_new_vm(&app->lua_alc);
 	if (NULL == app->main_vm) {
 		toy_err(TOY_ERROR_OPERATION_FAILED, "Init main LUA vm failed", error);
 		goto FAIL_MAIN_LUA_VM;
@@ -70,6 +79,7 @@ toy_app_t* toy_create_app (
 		error);
 	if (toy_is_failed(*error))
 		goto FAIL_ASSET_MANAGER;
+	toy_lua_open_asset_manager(app->main_vm, &app->asset_mgr);
 
 	app->vk_built_in_pipeline = toy_create_built_in_vulkan_pipeline(
 		&app->vk_driver, app->alc, error);
@@ -163,6 +173,7 @@ void toy_main_loop (toy_app_t* app, toy_app_loop_event_t* loop_evt)
 	uint32_t sleep_ms = 1000 / target_fps;
 
 	toy_error_t err;
+	TOY_ASSERT(NULL != app->alc->frame); // Draw data of scenes is allocated from frame memory
 	while (true) {
 		toy_synchronize_hid(&app->hid);
 
@@ -175,8 +186,14 @@ void toy_main_loop (toy_app_t* app, toy_app_loop_event_t* loop_evt)
 
 		frame_begin = toy_get_timer_during_ms(&frame_timer);
 		uint64_t delta_time = frame_begin - frame_end;
+#if TOY_DEBUG_MEMORY
+		toy_mark_memory_frame(app->alc);
+#endif
 
 		loop_evt->on_update(app, loop_evt->user_data, delta_time);
+
+		// Poll transfer of async loads and call their callbacks, never waits for device
+		toy_update_asset_loads(&app->asset_mgr);
 		
 		toy_scene_t* scene = app->top_scene;
 		while (NULL != scene) {
@@ -186,7 +203,12 @@ void toy_main_loop (toy_app_t* app, toy_app_loop_event_t* loop_evt)
 				&err);
 			TODO_ASSERT(toy_is_ok(err));
 
-			toy_draw_scene(&app->vk_driver, scene, &app->asset_mgr, app->vk_built_in_pipeline, &err);
+			// Finish fence of this frame slot is waited, assets released and frame memory allocated frames ago are not in use
+			toy_begin_memory_frame(app->alc->frame, app->vk_driver.swapchain.current_frame);
+			toy_collect_released_assets(app->asset_mgr.release_queue, 1000);
+			toy_trim_asset_residency(app->asset_mgr.residency);
+
+			toy_draw_scene(&app->vk_driver, scene, &app->asset_mgr, app->vk_built_in_pipeline, &app->alc->frame_alc, &err);
 			TODO_ASSERT(toy_is_ok(err));
 
 			toy_present_vulkan_swapchain(
@@ -199,6 +221,8 @@ void toy_main_loop (toy_app_t* app, toy_app_loop_event_t* loop_evt)
 			scene = scene->next;
 		}
 
+		toy_mark_asset_manager_frame(&app->asset_mgr);
+
 		frame_end = toy_get_timer_during_ms(&frame_timer);
 		++fps_cnt;
 
@@ -213,6 +237,11 @@ void toy_main_loop (toy_app_t* app, toy_app_loop_event_t* loop_evt)
 			else if (fps_cnt < target_fps && sleep_ms > 0)
 				--sleep_ms;
 			fps_cnt = 0;
+#if TOY_DEBUG_MEMORY
+			toy_dump_memory_stats(app->alc);
+#endif
+			if (0 == (frame_ms / 1000) % TOY_ASSET_STATS_LOG_SECONDS)
+				toy_log_asset_manager_stats(&app->asset_mgr);
 		}
 
 		toy_sleep(sleep_ms);
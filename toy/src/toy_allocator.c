@@ -1,6 +1,7 @@
 #include "include/toy_allocator.h"
 
 #include "toy_assert.h"
+#include <string.h>
 
 
 toy_aligned_p toy_alloc_aligned (const toy_allocator_t* alc, size_t size_in_byte, size_t alignment) {
@@ -9,6 +10,9 @@ toy_aligned_p toy_alloc_aligned (const toy_allocator_t* alc, size_t size_in_byte
 	if (0 == size_in_byte)
 		return NULL;
 
+	if (NULL != alc->ext && NULL != alc->ext->alloc_aligned)
+		return alc->ext->alloc_aligned(alc->ctx, size_in_byte, alignment);
+
 	if (alignment < sizeof(uint16_t))
 		alignment = sizeof(uint16_t);
 
@@ -32,6 +36,11 @@ toy_aligned_p toy_alloc_aligned (const toy_allocator_t* alc, size_t size_in_byte
 void toy_free_aligned (const toy_allocator_t* alc, toy_aligned_p mem) {
 	TOY_ASSERT(NULL != alc && NULL != mem);
 
+	if (NULL != alc->ext && NULL != alc->ext->alloc_aligned) {
+		alc->free(alc->ctx, mem);
+		return;
+	}
+
 	uintptr_t ptr = (uintptr_t)mem;
 	uint16_t padding = *((uint16_t*)(ptr - sizeof(uint16_t)));
 	uintptr_t raw_ptr = ptr - padding;
@@ -39,40 +48,29 @@ void toy_free_aligned (const toy_allocator_t* alc, toy_aligned_p mem) {
 }
 
 
-// find last bit set
-// toy_fls(1 << 10) == 11
-// toy_fls(1024) == 11
-// toy_fls(1) == 1
-// toy_fls(0) == 0
-int toy_fls (uint64_t x)
-{
-	if (!x)
-		return 0;
-
-	int r = 64;
-	if (!(x & UINT64_C(0xffffffff00000000))) {
-		x <<= 32;
-		r -= 32;
-	}
-	if (!(x & UINT64_C(0xffff000000000000))) {
-		x <<= 16;
-		r -= 16;
-	}
-	if (!(x & UINT64_C(0xff00000000000000))) {
-		x <<= 8;
-		r -= 8;
-	}
-	if (!(x & UINT64_C(0xf000000000000000))) {
-		x <<= 4;
-		r -= 4;
-	}
-	if (!(x & UINT64_C(0xc000000000000000))) {
-		x <<= 2;
-		r -= 2;
+void* toy_realloc (const toy_allocator_t* alc, void* mem, size_t old_size, size_t new_size) {
+	TOY_ASSERT(NULL != alc);
+
+	if (NULL == mem)
+		return toy_alloc(alc, new_size);
+	if (0 == new_size) {
+		toy_free(alc, mem);
+		return NULL;
 	}
-	if (!(x & UINT64_C(0x8000000000000000))) {
-		x <<= 1;
-		r -= 1;
+
+	// Shrink never fails, memory is kept when allocator can not give the tail back
+	if (new_size <= old_size) {
+		toy_resize(alc, mem, old_size, new_size);
+		return mem;
 	}
-	return r;
+
+	if (toy_get_usable_size(alc, mem) >= new_size || toy_resize(alc, mem, old_size, new_size))
+		return mem;
+
+	void* ret = toy_alloc(alc, new_size);
+	if (NULL == ret)
+		return NULL;
+	memcpy(ret, mem, old_size);
+	toy_free(alc, mem);
+	return ret;
 }
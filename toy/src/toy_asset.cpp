@@ -1,40 +1,124 @@
 #include "include/toy_asset.h"
+#include "include/toy_asset_residency.h"
 
 #include "toy_assert.h"
 #include "include/toy_log.h"
 #include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <new>
 
-struct toy_asset_pool_chunk_t {
-	uint32_t next_free_block_index;
-	uint32_t allocated_block_count;
+#define TOY_ASSET_POOL_FREE_END (TOY_ASSET_REF_FREED - 1) // Item index of empty free stack
+#define TOY_ASSET_POOL_CACHE_LINE 64
 
-	std::atomic_uint32_t* ref_counts;
+struct toy_asset_pool_chunk_t {
+	std::atomic_uint32_t* ref_counts; // TOY_ASSET_REF_FREED | item index of the next free block while block is free
+	std::atomic_uint32_t* release_serials; // Low 32 bits of frame serial of the latest release of each block
+	std::atomic<uint8_t>* generations; // Generation of each block in handles, read without lock, 0 when block is retired
+	uintptr_t hot_area; // Dense hot data of blocks, pool->hot_size for each
 	uintptr_t data_area;
 };
 
+typedef struct toy_asset_release_entry_t {
+	uint64_t frame_serial; // Last frame which may use the item
+	toy_asset_handle_t handle;
+}toy_asset_release_entry_t;
+
+// FIFO of released items, frame_serial of entries never decreases
+struct toy_asset_release_queue_t {
+	std::mutex lock; // Guard entries
+	toy_asset_release_entry_t* entries;
+	uint32_t begin;
+	uint32_t end;
+	uint32_t capacity;
+	std::atomic<uint64_t> frame_serial;
+	toy_allocator_t alc;
+};
+
+// free_head: high 32 bits are ABA tag, low 32 bits are the item index of the first free block.
+// Alloc and free only touch free_head and counters, grow_lock is taken when the stack is empty and a chunk is added
+struct toy_asset_pool_state_t {
+	toy_alignas(TOY_ASSET_POOL_CACHE_LINE) std::atomic<uint64_t> free_head;
+	toy_alignas(TOY_ASSET_POOL_CACHE_LINE) std::atomic<toy_asset_pool_chunk_p*> chunks; // Published after its slots are copied
+	std::atomic<uint32_t> chunk_count; // Published after the new chunk is stored in chunks
+	uint32_t chunk_capacity; // Length of chunks array, grows geometrically, guarded by grow_lock
+	std::mutex grow_lock;
+	toy_alignas(TOY_ASSET_POOL_CACHE_LINE) std::atomic<uint64_t> alloc_count;
+	std::atomic<uint64_t> free_count;
+	std::atomic<uint32_t> retired_count; // Blocks never reused, their generation is exhausted
+};
+
+static std::mutex s_asset_pool_registry_lock;
+static std::atomic<toy_asset_pool_p> s_asset_pools[TOY_ASSET_POOL_MAX_COUNT];
+
+static_assert(sizeof(std::atomic<uint8_t>) == sizeof(uint8_t), "Generation of each block is 1 byte");
+
+
+// Chunk array is allocated after a link to the array it replaced
+static toy_inline void* toy_get_asset_chunk_array_base (toy_asset_pool_chunk_p* chunks)
+{
+	return (void*)((void**)chunks - 1);
+}
+
+
+// Lock free read of a chunk, chunk_index is from an item index which has been allocated
+static toy_inline toy_asset_pool_chunk_p toy_load_asset_chunk (toy_asset_pool_p pool, uint32_t chunk_index)
+{
+	TOY_ASSERT(chunk_index < pool->state->chunk_count.load(std::memory_order_relaxed));
+	return pool->state->chunks.load(std::memory_order_acquire)[chunk_index];
+}
+
+
+static toy_inline uint64_t toy_pack_asset_free_head (uint64_t tag, uint32_t index)
+{
+	return (tag << 32) | index;
+}
+
+
+// chunk_block_count is 2^chunk_block_shift, so item index splits by shift and mask
+static toy_inline uint32_t toy_get_asset_chunk_index (toy_asset_pool_p pool, uint32_t index)
+{
+	return index >> pool->chunk_block_shift;
+}
+
+
+static toy_inline uint32_t toy_get_asset_chunk_item_index (toy_asset_pool_p pool, uint32_t index)
+{
+	return index & (pool->chunk_block_count - 1);
+}
+
 TOY_EXTERN_C_START
 
+// Blocks of the new chunk are linked in order, the last one is linked when the chunk is pushed to free stack
 static toy_asset_pool_chunk_p toy_alloc_asset_chunk (
 	toy_asset_pool_t* pool,
+	uint32_t chunk_index,
 	const toy_allocator_t* chunk_alc)
 {
 	toy_asset_pool_chunk_p chunk = (toy_asset_pool_chunk_p)toy_alloc(chunk_alc, TOY_MEMORY_CHUNK_SIZE);
 	if (NULL == chunk)
 		return NULL;
 
-	chunk->next_free_block_index = 0;
-	chunk->allocated_block_count = 0;
 	chunk->ref_counts = (std::atomic_uint32_t*)((uintptr_t)chunk + sizeof(toy_asset_pool_chunk_t));
-	chunk->data_area = (uintptr_t)chunk->ref_counts + sizeof(*(chunk->ref_counts)) * pool->chunk_block_count;
+	chunk->release_serials = (std::atomic_uint32_t*)((uintptr_t)chunk->ref_counts + sizeof(*(chunk->ref_counts)) * pool->chunk_block_count);
+	chunk->generations = (std::atomic<uint8_t>*)((uintptr_t)chunk->release_serials + sizeof(*(chunk->release_serials)) * pool->chunk_block_count);
+	chunk->hot_area = ((uintptr_t)chunk->generations + sizeof(*(chunk->generations)) * pool->chunk_block_count + sizeof(void*) - 1) & ~(uintptr_t)(sizeof(void*) - 1);
+	chunk->data_area = chunk->hot_area + pool->hot_size * pool->chunk_block_count;
 	if (pool->asset_alignment > 0) {
 		size_t mask = pool->asset_alignment - 1;
 		size_t padding = (pool->asset_alignment - (chunk->data_area & mask)) & mask;
 		chunk->data_area += padding;
 	}
 	TOY_ASSERT(chunk->data_area + pool->asset_size * pool->chunk_block_count <= (uintptr_t)chunk + TOY_MEMORY_CHUNK_SIZE);
+	uint32_t first_index = chunk_index << pool->chunk_block_shift;
 	for (uint32_t i = 0; i < pool->chunk_block_count - 1; ++i)
-		chunk->ref_counts[i].store(i + 1);
-	chunk->ref_counts[pool->chunk_block_count - 1].store(UINT32_MAX);
+		chunk->ref_counts[i].store(TOY_ASSET_REF_FREED | (first_index + i + 1), std::memory_order_relaxed);
+	chunk->ref_counts[pool->chunk_block_count - 1].store(TOY_ASSET_REF_FREED | TOY_ASSET_POOL_FREE_END, std::memory_order_relaxed);
+	for (uint32_t i = 0; i < pool->chunk_block_count; ++i) {
+		chunk->generations[i].store(1, std::memory_order_relaxed);
+		chunk->release_serials[i].store(0, std::memory_order_relaxed);
+	}
 
 	return chunk;
 }
@@ -45,24 +129,17 @@ static void toy_destroy_asset_pool_chunk (
 	toy_asset_pool_chunk_p chunk)
 {
 	if (NULL != pool->destroy_fp) {
-		// Set all free block ref_count = 0
-		uint32_t free_index = chunk->next_free_block_index;
-		while (UINT32_MAX != free_index) {
-			uint32_t next_free_index = chunk->ref_counts[free_index].load();
-			chunk->ref_counts[free_index].store(0);
-			free_index = next_free_index;
-		}
-
-		// Destroy all block which ref_count != 0
+		// Destroy all block which ref_count != 0, free and retired blocks are marked by TOY_ASSET_REF_FREED
 		for (uint32_t i = 0; i < pool->chunk_block_count; ++i) {
-			if (0 != chunk->ref_counts[i].load()) {
+			uint32_t ref_count = chunk->ref_counts[i].load();
+			if (0 != ref_count && 0 == (ref_count & TOY_ASSET_REF_FREED)) {
 				void* asset_item = (void*)(chunk->data_area + pool->asset_size * i);
 				pool->destroy_fp(pool, asset_item);
 				if (NULL != pool->literal_name)
-					toy_log_w("Destroy asset pool (%s) without clean all items, item ref_count: %u", pool->literal_name, chunk->ref_counts[i].load());
+					toy_log_w("Destroy asset pool (%s) without clean all items, item ref_count: %u", pool->literal_name, ref_count);
 				else
 					toy_log_w("Destroy asset pool without clean all items (asset_size = %u, chunk_block_count = %u, item ref_count: %u)",
-						pool->asset_size, pool->chunk_block_count, chunk->ref_counts[i].load());
+						pool->asset_size, pool->chunk_block_count, ref_count);
 			}
 		}
 	}
@@ -74,25 +151,65 @@ static void toy_destroy_asset_pool_chunk (
 void toy_init_asset_pool (
 	size_t asset_size,
 	size_t asset_alignment,
+	size_t hot_size,
 	toy_destroy_asset_fp destroy_asset_fp,
 	const toy_allocator_t* chunk_alc,
 	const toy_allocator_t* alc,
 	void* context,
 	const char* literal_name,
-	toy_asset_pool_t* output)
+	toy_asset_pool_t* output,
+	toy_error_t* error)
 {
-	output->chunks = NULL;
-	output->chunk_count = 0;
+	void* state_object = toy_alloc_aligned(alc, sizeof(toy_asset_pool_state_t), alignof(toy_asset_pool_state_t));
+	if (NULL == state_object) {
+		output->state = NULL;
+		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Failed to alloc asset pool state", error);
+		return;
+	}
+	toy_asset_pool_state_p state = new (state_object) toy_asset_pool_state_t();
+	state->free_head.store(toy_pack_asset_free_head(0, TOY_ASSET_POOL_FREE_END), std::memory_order_relaxed);
+	state->chunks.store(NULL, std::memory_order_relaxed);
+	state->chunk_count.store(0, std::memory_order_relaxed);
+	state->chunk_capacity = 0;
+	state->alloc_count.store(0, std::memory_order_relaxed);
+	state->free_count.store(0, std::memory_order_relaxed);
+	state->retired_count.store(0, std::memory_order_relaxed);
+	output->state = state;
+
 	size_t data_area_size = TOY_MEMORY_CHUNK_SIZE - sizeof(toy_asset_pool_chunk_t);
-	output->chunk_block_count = (data_area_size - asset_alignment) / (sizeof(*((output->chunks[0])->ref_counts)) + asset_size);
+	size_t max_block_count = (data_area_size - asset_alignment - sizeof(void*)) /
+		(sizeof(*(((toy_asset_pool_chunk_p)NULL)->ref_counts)) + sizeof(*(((toy_asset_pool_chunk_p)NULL)->release_serials)) +
+		sizeof(*(((toy_asset_pool_chunk_p)NULL)->generations)) + hot_size + asset_size);
+	// Round down to 2^N
+	output->chunk_block_shift = 0;
+	while ((size_t)2 << output->chunk_block_shift <= max_block_count)
+		++(output->chunk_block_shift);
+	output->chunk_block_count = UINT32_C(1) << output->chunk_block_shift;
 	TOY_ASSERT(output->chunk_block_count > 16);
 	output->asset_size = asset_size;
+	output->hot_size = hot_size;
 	output->asset_alignment = asset_alignment;
 	output->chunk_alc = *chunk_alc;
 	output->alc = *alc;
 	output->destroy_fp = destroy_asset_fp;
+	output->release_queue = NULL;
+	output->residency = NULL;
 	output->context = context;
 	output->literal_name = literal_name;
+
+	std::lock_guard<std::mutex> guard(s_asset_pool_registry_lock);
+	uint32_t id = 0;
+	while (id < TOY_ASSET_POOL_MAX_COUNT && NULL != s_asset_pools[id].load(std::memory_order_relaxed))
+		++id;
+	if (id < TOY_ASSET_POOL_MAX_COUNT) {
+		output->id = id;
+		s_asset_pools[id].store(output, std::memory_order_release);
+	}
+	else {
+		output->id = TOY_ASSET_POOL_ID_NONE;
+		toy_log_w("Asset pool (%s) has no id, its items have no handle", NULL != literal_name ? literal_name : "");
+	}
+	toy_ok(error);
 }
 
 
@@ -100,83 +217,222 @@ void toy_destroy_asset_pool (
 	const toy_allocator_t* alc,
 	toy_asset_pool_p pool)
 {
-	if (NULL != pool->chunks) {
-		for (uint16_t i = 0; i < pool->chunk_count; ++i) {
-			TOY_ASSERT(NULL != pool->chunks[i]);
-			toy_destroy_asset_pool_chunk(pool, pool->chunks[i]);
+	if (TOY_ASSET_POOL_ID_NONE != pool->id) {
+		std::lock_guard<std::mutex> guard(s_asset_pool_registry_lock);
+		TOY_ASSERT(s_asset_pools[pool->id].load(std::memory_order_relaxed) == pool);
+		s_asset_pools[pool->id].store(NULL, std::memory_order_release);
+		pool->id = TOY_ASSET_POOL_ID_NONE;
+	}
+
+	toy_asset_pool_state_p state = pool->state;
+	if (NULL == state)
+		return;
+
+	toy_asset_pool_chunk_p* chunks = state->chunks.load(std::memory_order_acquire);
+	if (NULL != chunks) {
+		uint32_t chunk_count = state->chunk_count.load(std::memory_order_acquire);
+		for (uint32_t i = 0; i < chunk_count; ++i) {
+			TOY_ASSERT(NULL != chunks[i]);
+			toy_destroy_asset_pool_chunk(pool, chunks[i]);
+		}
+		// Current array and arrays replaced by growth
+		void* chunk_array = toy_get_asset_chunk_array_base(chunks);
+		while (NULL != chunk_array) {
+			void* retired = *(void**)chunk_array;
+			toy_free(&pool->alc, chunk_array);
+			chunk_array = retired;
 		}
-		toy_free_aligned(alc, pool->chunks);
 	}
+
+	state->~toy_asset_pool_state_t();
+	toy_free_aligned(&pool->alc, state);
+	pool->state = NULL;
 }
 
 
 void* toy_get_asset_item (toy_asset_pool_p pool, uint32_t index)
 {
-	TOY_ASSERT(index < pool->chunk_block_count * pool->chunk_count);
+	uintptr_t data = toy_load_asset_chunk(pool, toy_get_asset_chunk_index(pool, index))->data_area;
 
-	uint64_t pool_index = index / pool->chunk_block_count;
-	TOY_ASSERT(pool_index < pool->chunk_count);
-	uintptr_t data = pool->chunks[pool_index]->data_area;
+	return (void*)(data + toy_get_asset_chunk_item_index(pool, index) * pool->asset_size);
+}
+
+
+void* toy_get_asset_hot_item (toy_asset_pool_p pool, uint32_t index)
+{
+	TOY_ASSERT(pool->hot_size > 0);
+	uintptr_t hot_data = toy_load_asset_chunk(pool, toy_get_asset_chunk_index(pool, index))->hot_area;
 
-	return (void*)(data + (index % pool->chunk_block_count) * pool->asset_size);
+	return (void*)(hot_data + toy_get_asset_chunk_item_index(pool, index) * pool->hot_size);
 }
 
 
-static uint32_t toy_alloc_asset_chunk_item (toy_asset_pool_chunk_p chunk)
+// Block may be taken by another thread after head is read, then tag changes and CAS fails.
+// Chunks are never freed before pool, so reading next index of a taken block is safe
+static uint32_t toy_pop_asset_free_block (toy_asset_pool_p pool)
 {
-	uint32_t index = chunk->next_free_block_index;
-	chunk->next_free_block_index = chunk->ref_counts[index].load();
-	chunk->ref_counts[index].store(0);
-	++(chunk->allocated_block_count);
+	toy_asset_pool_state_p state = pool->state;
+	uint64_t head = state->free_head.load(std::memory_order_acquire);
+	uint32_t index;
+	uint64_t new_head;
+	do {
+		index = (uint32_t)head;
+		if (TOY_ASSET_POOL_FREE_END == index)
+			return TOY_ASSET_POOL_FREE_END;
+		uint32_t next_index = toy_load_asset_chunk(pool, toy_get_asset_chunk_index(pool, index))->ref_counts[
+			toy_get_asset_chunk_item_index(pool, index)].load(std::memory_order_relaxed) & ~TOY_ASSET_REF_FREED;
+		new_head = toy_pack_asset_free_head((head >> 32) + 1, next_index);
+	} while (!state->free_head.compare_exchange_weak(head, new_head, std::memory_order_acquire, std::memory_order_acquire));
+
+	toy_load_asset_chunk(pool, toy_get_asset_chunk_index(pool, index))->ref_counts[
+		toy_get_asset_chunk_item_index(pool, index)].store(0, std::memory_order_relaxed);
 	return index;
 }
 
 
-static void toy_free_asset_chunk_item (toy_asset_pool_chunk_p chunk, uint32_t index) {
-	TOY_ASSERT(0 == chunk->ref_counts[index].load());
+// Push blocks first_index ... last_index which are linked already, last block is linked to old head
+static void toy_push_asset_free_blocks (
+	toy_asset_pool_p pool,
+	uint32_t first_index,
+	uint32_t last_index)
+{
+	toy_asset_pool_state_p state = pool->state;
+	std::atomic_uint32_t* last_next = &toy_load_asset_chunk(pool, toy_get_asset_chunk_index(pool, last_index))->ref_counts[
+		toy_get_asset_chunk_item_index(pool, last_index)];
+	uint64_t head = state->free_head.load(std::memory_order_relaxed);
+	uint64_t new_head;
+	do {
+		last_next->store(TOY_ASSET_REF_FREED | (uint32_t)head, std::memory_order_relaxed);
+		new_head = toy_pack_asset_free_head((head >> 32) + 1, first_index);
+	} while (!state->free_head.compare_exchange_weak(head, new_head, std::memory_order_release, std::memory_order_relaxed));
+}
+
 
-	chunk->ref_counts[index].store(chunk->next_free_block_index);
-	chunk->next_free_block_index = index;
-	TOY_ASSERT(chunk->allocated_block_count > 0);
-	--(chunk->allocated_block_count);
+// Claim an item which has no reference for freeing, adding a reference fails from now on.
+// Return false when item is referenced
+static toy_inline bool toy_claim_asset_chunk_item (toy_asset_pool_chunk_p chunk, uint32_t index) {
+	uint32_t ref_count = 0;
+	return chunk->ref_counts[index].compare_exchange_strong(ref_count, TOY_ASSET_REF_FREED, std::memory_order_acq_rel);
 }
 
 
-uint32_t toy_alloc_asset_item (
+// Handles of freed item become stale. A block whose generation would wrap is retired instead of reused,
+// else a handle kept over 255 reuses would resolve to a new item. Retired block stays allocated until pool is destroyed,
+// its ref_count keeps the claim. Return false when block is retired
+static bool toy_free_asset_chunk_item (toy_asset_pool_chunk_p chunk, uint32_t index) {
+	TOY_ASSERT(TOY_ASSET_REF_FREED == chunk->ref_counts[index].load());
+
+	uint32_t generation = chunk->generations[index].load(std::memory_order_relaxed);
+	TOY_ASSERT(0 != generation);
+	if (toy_unlikely(TOY_ASSET_HANDLE_GENERATION_MASK == generation)) {
+		chunk->generations[index].store(0, std::memory_order_relaxed);
+		return false;
+	}
+
+	chunk->generations[index].store((uint8_t)(generation + 1), std::memory_order_relaxed);
+	return true;
+}
+
+
+// Chunk array doubles, so adding a chunk to a pool of many items does not copy the array each time.
+// Readers may still hold the old array, so it is not freed but linked from the new one,
+// retired arrays sum to less than the current one. Caller holds grow_lock
+static bool toy_reserve_asset_chunk_array (toy_asset_pool_p pool)
+{
+	toy_asset_pool_state_p state = pool->state;
+	uint32_t chunk_count = state->chunk_count.load(std::memory_order_relaxed);
+	if (chunk_count < state->chunk_capacity)
+		return true;
+
+	uint32_t new_capacity = state->chunk_capacity > 0 ? state->chunk_capacity * 2 : 4;
+	void** chunk_array_base = (void**)toy_alloc(&pool->alc, sizeof(void*) + sizeof(toy_asset_pool_chunk_p) * new_capacity);
+	if (toy_unlikely(NULL == chunk_array_base))
+		return false;
+
+	toy_asset_pool_chunk_p* chunk_array = (toy_asset_pool_chunk_p*)(chunk_array_base + 1);
+	toy_asset_pool_chunk_p* old_chunk_array = state->chunks.load(std::memory_order_relaxed);
+	if (NULL != old_chunk_array) {
+		memcpy(chunk_array, old_chunk_array, sizeof(toy_asset_pool_chunk_p) * chunk_count);
+		*chunk_array_base = toy_get_asset_chunk_array_base(old_chunk_array);
+	}
+	else {
+		*chunk_array_base = NULL;
+	}
+
+	state->chunks.store(chunk_array, std::memory_order_release);
+	state->chunk_capacity = new_capacity;
+	return true;
+}
+
+
+// Add a chunk and push its blocks when free stack is empty
+static bool toy_grow_asset_pool (
 	toy_asset_pool_p pool,
 	toy_error_t* error)
 {
-	for (uint32_t chunk_i = 0; chunk_i < pool->chunk_count; ++chunk_i) {
-		toy_asset_pool_chunk_p chunk = pool->chunks[chunk_i];
-		if (chunk->allocated_block_count < pool->chunk_block_count) {
-			toy_ok(error);
-			return pool->chunk_block_count * chunk_i + toy_alloc_asset_chunk_item(chunk);
-		}
+	toy_asset_pool_state_p state = pool->state;
+	std::lock_guard<std::mutex> guard(state->grow_lock);
+	// Blocks may be freed or another chunk added while this thread waits for the lock
+	if (TOY_ASSET_POOL_FREE_END != (uint32_t)state->free_head.load(std::memory_order_relaxed))
+		return true;
+
+	uint32_t chunk_count = state->chunk_count.load(std::memory_order_relaxed);
+	// Index of every item fits in handle, also in release builds
+	if (toy_unlikely(TOY_ASSET_POOL_ID_NONE != pool->id &&
+		((uint64_t)chunk_count + 1) << pool->chunk_block_shift > (uint64_t)TOY_ASSET_HANDLE_INDEX_MASK + 1)) {
+		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Asset pool is full, item index exceeds handle index bits", error);
+		return false;
 	}
 
-	toy_asset_pool_chunk_p* chunk_array = (toy_asset_pool_chunk_p*)toy_alloc_aligned(&pool->alc, sizeof(toy_asset_pool_chunk_p) * (pool->chunk_count + 1), sizeof(void*));
-	if (toy_unlikely(NULL == chunk_array)) {
+	if (toy_unlikely(!toy_reserve_asset_chunk_array(pool))) {
 		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Extend asset chunk array failed", error);
-		return UINT32_MAX;
+		return false;
 	}
 
-	toy_asset_pool_chunk_p chunk = toy_alloc_asset_chunk(pool, &pool->chunk_alc);
+	toy_asset_pool_chunk_p chunk = toy_alloc_asset_chunk(pool, chunk_count, &pool->chunk_alc);
 	if (toy_unlikely(NULL == chunk)) {
-		toy_free_aligned(&pool->alc, chunk_array);
 		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Malloc asset chunk failed", error);
-		return UINT32_MAX;
+		return false;
 	}
+	// Chunk is visible before the count which covers it, and the count before its blocks are in free stack
+	state->chunks.load(std::memory_order_relaxed)[chunk_count] = chunk;
+	state->chunk_count.store(chunk_count + 1, std::memory_order_release);
+	uint32_t first_index = chunk_count << pool->chunk_block_shift;
+	toy_push_asset_free_blocks(pool, first_index, first_index + pool->chunk_block_count - 1);
+	return true;
+}
 
-	for (size_t i = 0; i < pool->chunk_count; ++i)
-		chunk_array[i] = pool->chunks[i];
-	chunk_array[pool->chunk_count] = chunk;
 
-	if (NULL != pool->chunks)
-		toy_free_aligned(&pool->alc, pool->chunks);
-	pool->chunks = chunk_array;
+uint32_t toy_alloc_asset_item (
+	toy_asset_pool_p pool,
+	toy_error_t* error)
+{
+	uint32_t index;
+	while (TOY_ASSET_POOL_FREE_END == (index = toy_pop_asset_free_block(pool))) {
+		if (toy_unlikely(!toy_grow_asset_pool(pool, error)))
+			return UINT32_MAX;
+	}
 
+	pool->state->alloc_count.fetch_add(1, std::memory_order_relaxed);
 	toy_ok(error);
-	return pool->chunk_block_count * ((pool->chunk_count)++) + toy_alloc_asset_chunk_item(chunk);
+	return index;
+}
+
+
+static void toy_free_asset_pool_item (
+	toy_asset_pool_p pool,
+	uint32_t chunk_index,
+	uint32_t item_index)
+{
+	toy_asset_pool_state_p state = pool->state;
+	if (toy_free_asset_chunk_item(toy_load_asset_chunk(pool, chunk_index), item_index)) {
+		uint32_t index = (chunk_index << pool->chunk_block_shift) | item_index;
+		toy_push_asset_free_blocks(pool, index, index);
+	}
+	else {
+		state->retired_count.fetch_add(1, std::memory_order_relaxed);
+	}
+	state->free_count.fetch_add(1, std::memory_order_relaxed);
 }
 
 
@@ -186,12 +442,35 @@ void toy_raw_free_asset_item (
 {
 	TOY_ASSERT(NULL != pool && UINT32_MAX != index);
 
-	uint32_t pool_index = index / pool->chunk_block_count;
-	uint32_t item_index = index % pool->chunk_block_count;
-	TOY_ASSERT(pool_index < pool->chunk_count&& index < pool->chunk_block_count);
+	uint32_t pool_index = toy_get_asset_chunk_index(pool, index);
+	uint32_t item_index = toy_get_asset_chunk_item_index(pool, index);
+	TOY_ASSERT(pool_index < pool->state->chunk_count.load(std::memory_order_relaxed));
+
+	bool is_claimed = toy_claim_asset_chunk_item(toy_load_asset_chunk(pool, pool_index), item_index);
+	TOY_ASSERT(is_claimed && "Free referenced asset item");
+	(void)is_claimed;
+	toy_free_asset_pool_item(pool, pool_index, item_index);
+}
+
+
+// Item is claimed by caller
+static void toy_free_claimed_asset_item (
+	toy_asset_pool_p pool,
+	uint32_t pool_index,
+	uint32_t item_index)
+{
+	uint32_t index = (pool_index << pool->chunk_block_shift) | item_index;
+
+	// destroy_fp may release items of this pool, so it runs before the block is pushed to free stack
+	if (NULL != pool->residency)
+		toy_untrack_asset_residency(pool->residency, toy_get_asset_handle(pool, index));
+
+	if (toy_likely(NULL != pool->destroy_fp)) {
+		void* asset_item = (void*)(toy_load_asset_chunk(pool, pool_index)->data_area + pool->asset_size * item_index);
+		pool->destroy_fp(pool, asset_item);
+	}
 
-	toy_asset_pool_chunk_p chunk = pool->chunks[pool_index];
-	toy_free_asset_chunk_item(chunk, item_index);
+	toy_free_asset_pool_item(pool, pool_index, item_index);
 }
 
 
@@ -201,18 +480,73 @@ void toy_free_asset_item (
 {
 	TOY_ASSERT(NULL != pool && UINT32_MAX != index);
 
-	uint32_t pool_index = index / pool->chunk_block_count;
-	uint32_t item_index = index % pool->chunk_block_count;
-	TOY_ASSERT(pool_index < pool->chunk_count&& index < pool->chunk_block_count);
+	uint32_t pool_index = toy_get_asset_chunk_index(pool, index);
+	uint32_t item_index = toy_get_asset_chunk_item_index(pool, index);
 
-	toy_asset_pool_chunk_p chunk = pool->chunks[pool_index];
+	bool is_claimed = toy_claim_asset_chunk_item(toy_load_asset_chunk(pool, pool_index), item_index);
+	TOY_ASSERT(is_claimed && "Free referenced asset item");
+	(void)is_claimed;
+	toy_free_claimed_asset_item(pool, pool_index, item_index);
+}
 
-	if (toy_likely(NULL != pool->destroy_fp)) {
-		void* asset_item = (void*)(chunk->data_area + pool->asset_size * item_index);
-		pool->destroy_fp(pool, asset_item);
+
+bool toy_try_free_asset_item (
+	toy_asset_pool_p pool,
+	uint32_t index)
+{
+	TOY_ASSERT(NULL != pool && UINT32_MAX != index);
+
+	uint32_t pool_index = toy_get_asset_chunk_index(pool, index);
+	uint32_t item_index = toy_get_asset_chunk_item_index(pool, index);
+
+	if (!toy_claim_asset_chunk_item(toy_load_asset_chunk(pool, pool_index), item_index))
+		return false;
+	toy_free_claimed_asset_item(pool, pool_index, item_index);
+	return true;
+}
+
+
+// Counters are loaded one by one, so stats of a pool used by other threads may be a little inconsistent
+void toy_get_asset_pool_stats (toy_asset_pool_p pool, toy_asset_pool_stats_t* output)
+{
+	TOY_ASSERT(NULL != pool && NULL != output);
+
+	toy_asset_pool_state_p state = pool->state;
+	uint32_t chunk_count;
+	uint32_t chunk_capacity;
+	{
+		std::lock_guard<std::mutex> guard(state->grow_lock);
+		chunk_count = state->chunk_count.load(std::memory_order_relaxed);
+		chunk_capacity = state->chunk_capacity;
 	}
+	uint64_t free_count = state->free_count.load(std::memory_order_relaxed);
+	uint64_t alloc_count = state->alloc_count.load(std::memory_order_relaxed);
+	uint32_t live_count = alloc_count > free_count ? (uint32_t)(alloc_count - free_count) : 0;
+
+	output->live_count = live_count;
+	output->chunk_count = chunk_count;
+	output->used_bytes = (pool->asset_size + pool->hot_size) * live_count;
+	output->reserved_bytes = (size_t)TOY_MEMORY_CHUNK_SIZE * chunk_count;
+	if (chunk_capacity > 0)
+		output->reserved_bytes += sizeof(void*) + sizeof(toy_asset_pool_chunk_p) * chunk_capacity;
+	uint64_t block_count = (uint64_t)pool->chunk_block_count * chunk_count;
+	output->fragmentation = block_count > 0 ? (float)(block_count - live_count) / (float)block_count : 0.0f;
+	output->alloc_count = alloc_count;
+	output->free_count = free_count;
+	output->retired_count = state->retired_count.load(std::memory_order_relaxed);
+}
 
-	toy_free_asset_chunk_item(chunk, item_index);
+
+// Add references unless item is claimed for freeing, or is a free block. Return count before, or TOY_ASSET_REF_FREED
+static uint32_t toy_add_asset_chunk_ref (toy_asset_pool_chunk_p chunk, uint32_t item_index, uint32_t ref_count)
+{
+	std::atomic_uint32_t* count = &chunk->ref_counts[item_index];
+	uint32_t count_before = count->load(std::memory_order_relaxed);
+	do {
+		if (0 != (count_before & TOY_ASSET_REF_FREED))
+			return TOY_ASSET_REF_FREED;
+	} while (!count->compare_exchange_weak(count_before, count_before + ref_count, std::memory_order_acquire, std::memory_order_relaxed));
+	return count_before;
 }
 
 
@@ -220,12 +554,12 @@ uint32_t toy_add_asset_ref (toy_asset_pool_p pool, uint32_t index, uint32_t ref_
 {
 	TOY_ASSERT(NULL != pool && UINT32_MAX != index);
 
-	uint32_t pool_index = index / pool->chunk_block_count;
-	uint32_t item_index = index % pool->chunk_block_count;
-
-	TOY_ASSERT(pool_index < pool->chunk_count && index < pool->chunk_block_count);
+	uint32_t pool_index = toy_get_asset_chunk_index(pool, index);
+	uint32_t item_index = toy_get_asset_chunk_item_index(pool, index);
 
-	uint32_t count_before = pool->chunks[pool_index]->ref_counts[item_index].fetch_add(ref_count);
+	uint32_t count_before = toy_add_asset_chunk_ref(toy_load_asset_chunk(pool, pool_index), item_index, ref_count);
+	if (0 == count_before && NULL != pool->residency)
+		toy_reuse_cached_asset(pool->residency, toy_get_asset_handle(pool, index));
 	return count_before;
 }
 
@@ -234,12 +568,10 @@ uint32_t toy_sub_asset_ref (toy_asset_pool_p pool, uint32_t index, uint32_t ref_
 {
 	TOY_ASSERT(NULL != pool && UINT32_MAX != index);
 
-	uint32_t pool_index = index / pool->chunk_block_count;
-	uint32_t item_index = index % pool->chunk_block_count;
+	uint32_t pool_index = toy_get_asset_chunk_index(pool, index);
+	uint32_t item_index = toy_get_asset_chunk_item_index(pool, index);
 
-	TOY_ASSERT(pool_index < pool->chunk_count && index < pool->chunk_block_count);
-
-	uint32_t count_before = pool->chunks[pool_index]->ref_counts[item_index].fetch_sub(ref_count);
+	uint32_t count_before = toy_load_asset_chunk(pool, pool_index)->ref_counts[item_index].fetch_sub(ref_count);
 	TOY_ASSERT(count_before >= ref_count);
 	return count_before;
 }
@@ -249,11 +581,320 @@ uint32_t toy_get_asset_ref (toy_asset_pool_p pool, uint32_t index)
 {
 	TOY_ASSERT(NULL != pool && UINT32_MAX != index);
 
-	uint32_t pool_index = index / pool->chunk_block_count;
-	uint32_t item_index = index % pool->chunk_block_count;
+	uint32_t pool_index = toy_get_asset_chunk_index(pool, index);
+	uint32_t item_index = toy_get_asset_chunk_item_index(pool, index);
+
+	return toy_load_asset_chunk(pool, pool_index)->ref_counts[item_index].load();
+}
+
+
+toy_asset_handle_t toy_get_asset_handle (toy_asset_pool_p pool, uint32_t index)
+{
+	TOY_ASSERT(NULL != pool && TOY_ASSET_POOL_ID_NONE != pool->id);
+	TOY_ASSERT(index <= TOY_ASSET_HANDLE_INDEX_MASK);
+	if (toy_unlikely(index > TOY_ASSET_HANDLE_INDEX_MASK))
+		return TOY_ASSET_HANDLE_NULL;
+
+	uint32_t pool_index = toy_get_asset_chunk_index(pool, index);
+	uint32_t item_index = toy_get_asset_chunk_item_index(pool, index);
+
+	uint32_t generation = toy_load_asset_chunk(pool, pool_index)->generations[item_index].load(std::memory_order_relaxed);
+	return (pool->id << (TOY_ASSET_HANDLE_INDEX_BITS + TOY_ASSET_HANDLE_GENERATION_BITS)) |
+		(generation << TOY_ASSET_HANDLE_INDEX_BITS) | index;
+}
+
+
+toy_asset_pool_p toy_get_asset_handle_pool (toy_asset_handle_t handle)
+{
+	return s_asset_pools[handle >> (TOY_ASSET_HANDLE_INDEX_BITS + TOY_ASSET_HANDLE_GENERATION_BITS)].load(std::memory_order_acquire);
+}
+
+
+// Return chunk of a live handle and set item index in chunk, or NULL when handle is stale
+static toy_asset_pool_chunk_p toy_get_asset_handle_chunk (
+	toy_asset_pool_p pool,
+	toy_asset_handle_t handle,
+	uint32_t* item_index)
+{
+	uint32_t index = handle & TOY_ASSET_HANDLE_INDEX_MASK;
+	uint32_t pool_index = toy_get_asset_chunk_index(pool, index);
+	// Handle may be forged or from another pool layout, count is loaded before the array which covers it
+	if (toy_unlikely(pool_index >= pool->state->chunk_count.load(std::memory_order_acquire)))
+		return NULL;
+
+	*item_index = toy_get_asset_chunk_item_index(pool, index);
+	toy_asset_pool_chunk_p chunk = pool->state->chunks.load(std::memory_order_acquire)[pool_index];
+	// Generation 0 of a handle matches only retired blocks
+	uint32_t generation = (handle >> TOY_ASSET_HANDLE_INDEX_BITS) & TOY_ASSET_HANDLE_GENERATION_MASK;
+	if (0 == generation || chunk->generations[*item_index].load(std::memory_order_relaxed) != generation)
+		return NULL;
+	return chunk;
+}
+
+
+void* toy_resolve_asset_handle (toy_asset_handle_t handle)
+{
+	toy_asset_pool_p pool = toy_get_asset_handle_pool(handle);
+	if (NULL == pool)
+		return NULL;
+
+	uint32_t item_index;
+	toy_asset_pool_chunk_p chunk = toy_get_asset_handle_chunk(pool, handle, &item_index);
+	if (NULL == chunk)
+		return NULL;
+	return (void*)(chunk->data_area + item_index * pool->asset_size);
+}
+
+
+uint32_t toy_add_asset_handle_ref (toy_asset_handle_t handle, uint32_t ref_count)
+{
+	toy_asset_pool_p pool = toy_get_asset_handle_pool(handle);
+	TOY_ASSERT(NULL != pool);
+	uint32_t item_index;
+	toy_asset_pool_chunk_p chunk = toy_get_asset_handle_chunk(pool, handle, &item_index);
+	// Handle found in registry may be freed by another thread meanwhile
+	if (NULL == chunk)
+		return TOY_ASSET_REF_FREED;
+	uint32_t count_before = toy_add_asset_chunk_ref(chunk, item_index, ref_count);
+	if (TOY_ASSET_REF_FREED == count_before)
+		return TOY_ASSET_REF_FREED;
+	// Block is freed and allocated again between the generation check and the add, the references are not for this item
+	if (toy_unlikely(chunk->generations[item_index].load(std::memory_order_relaxed) !=
+		((handle >> TOY_ASSET_HANDLE_INDEX_BITS) & TOY_ASSET_HANDLE_GENERATION_MASK))) {
+		chunk->ref_counts[item_index].fetch_sub(ref_count);
+		return TOY_ASSET_REF_FREED;
+	}
+	if (0 == count_before && NULL != pool->residency)
+		toy_reuse_cached_asset(pool->residency, handle);
+	return count_before;
+}
+
+
+bool toy_is_asset_release_complete (toy_asset_pool_p pool, uint32_t index)
+{
+	TOY_ASSERT(NULL != pool && UINT32_MAX != index);
+	if (NULL == pool->release_queue)
+		return true;
+
+	uint32_t release_serial = toy_load_asset_chunk(pool, toy_get_asset_chunk_index(pool, index))->release_serials[
+		toy_get_asset_chunk_item_index(pool, index)].load(std::memory_order_relaxed);
+	// Same bound as toy_collect_released_assets(), serials are compared in 32 bits across wrap
+	uint32_t max_serial = (uint32_t)(pool->release_queue->frame_serial.load(std::memory_order_relaxed) - TOY_CONCURRENT_FRAME_MAX);
+	return (int32_t)(max_serial - release_serial) >= 0;
+}
+
+
+// Entry of an item released again later is skipped by toy_free_released_asset(), the latest one decides
+static bool toy_push_asset_release_entry (
+	toy_asset_pool_p pool,
+	uint32_t index)
+{
+	toy_asset_release_queue_p queue = pool->release_queue;
+	std::lock_guard<std::mutex> guard(queue->lock);
+	if (queue->end == queue->capacity) {
+		if (queue->begin > 0) {
+			memmove(queue->entries, queue->entries + queue->begin, sizeof(toy_asset_release_entry_t) * (queue->end - queue->begin));
+			queue->end -= queue->begin;
+			queue->begin = 0;
+		}
+		else {
+			uint32_t new_capacity = queue->capacity * 2;
+			toy_asset_release_entry_t* entries = (toy_asset_release_entry_t*)toy_realloc(&queue->alc, queue->entries,
+				sizeof(toy_asset_release_entry_t) * queue->capacity, sizeof(toy_asset_release_entry_t) * new_capacity);
+			if (toy_unlikely(NULL == entries))
+				return false;
+			queue->entries = entries;
+			queue->capacity = new_capacity;
+		}
+	}
+
+	toy_asset_release_entry_t* entry = &queue->entries[(queue->end)++];
+	entry->frame_serial = queue->frame_serial.load(std::memory_order_relaxed);
+	entry->handle = toy_get_asset_handle(pool, index);
+	toy_load_asset_chunk(pool, toy_get_asset_chunk_index(pool, index))->release_serials[toy_get_asset_chunk_item_index(pool, index)].store(
+		(uint32_t)entry->frame_serial, std::memory_order_relaxed);
+	return true;
+}
+
+
+void toy_release_asset_item (toy_asset_pool_p pool, uint32_t index)
+{
+	TOY_ASSERT(NULL != pool && UINT32_MAX != index);
+
+	uint32_t pool_index = toy_get_asset_chunk_index(pool, index);
+	uint32_t item_index = toy_get_asset_chunk_item_index(pool, index);
+
+	// Only the caller which takes the last reference goes on
+	uint32_t count_before = toy_load_asset_chunk(pool, pool_index)->ref_counts[item_index].fetch_sub(1);
+	TOY_ASSERT(count_before > 0);
+	if (1 != count_before)
+		return;
+
+	if (NULL != pool->release_queue && toy_push_asset_release_entry(pool, index))
+		return;
+	// No queue, or queue can not grow
+	toy_free_asset_item(pool, index);
+}
+
+
+void toy_release_asset_handle (toy_asset_handle_t handle)
+{
+	toy_asset_pool_p pool = toy_get_asset_handle_pool(handle);
+	TOY_ASSERT(NULL != pool);
+	TOY_ASSERT(NULL != toy_resolve_asset_handle(handle) && "Stale asset handle");
+	toy_release_asset_item(pool, handle & TOY_ASSET_HANDLE_INDEX_MASK);
+}
+
+
+// Free item of a queued entry, unless it is referenced again, released again by a later entry or already freed
+static void toy_free_released_asset (const toy_asset_release_entry_t* entry, bool can_cache)
+{
+	toy_asset_handle_t handle = entry->handle;
+	toy_asset_pool_p pool = toy_get_asset_handle_pool(handle);
+	if (NULL == pool)
+		return;
+	uint32_t item_index;
+	toy_asset_pool_chunk_p chunk = toy_get_asset_handle_chunk(pool, handle, &item_index);
+	if (NULL == chunk || 0 != chunk->ref_counts[item_index].load())
+		return;
+	// GPU may still use the item in frames up to its latest release
+	if (chunk->release_serials[item_index].load(std::memory_order_relaxed) != (uint32_t)entry->frame_serial)
+		return;
+	if (can_cache && NULL != pool->residency && toy_cache_released_asset(pool->residency, handle))
+		return;
+	// Referenced again after the check above, the claim fails and the latest release decides
+	toy_try_free_asset_item(pool, handle & TOY_ASSET_HANDLE_INDEX_MASK);
+}
+
+
+// Pop the first entry which frame_serial <= max_serial, destroy_fp may push entries, so lock is not held while freeing
+static bool toy_pop_asset_release_entry (
+	toy_asset_release_queue_p queue,
+	uint64_t max_serial,
+	toy_asset_release_entry_t* output)
+{
+	std::lock_guard<std::mutex> guard(queue->lock);
+	if (queue->begin == queue->end || queue->entries[queue->begin].frame_serial > max_serial)
+		return false;
+	*output = queue->entries[(queue->begin)++];
+	if (queue->begin == queue->end)
+		queue->begin = queue->end = 0;
+	return true;
+}
+
+
+toy_asset_release_queue_p toy_create_asset_release_queue (
+	const toy_allocator_t* alc,
+	toy_error_t* error)
+{
+	TOY_ASSERT(NULL != alc);
+
+	void* object = toy_alloc_aligned(alc, sizeof(toy_asset_release_queue_t), alignof(toy_asset_release_queue_t));
+	if (NULL == object) {
+		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Failed to alloc asset release queue", error);
+		return NULL;
+	}
+
+	toy_asset_release_queue_p queue = new (object) toy_asset_release_queue_t();
+	queue->alc = *alc;
+	queue->capacity = 256;
+	queue->begin = 0;
+	queue->end = 0;
+	queue->frame_serial.store(TOY_CONCURRENT_FRAME_MAX, std::memory_order_relaxed);
+	queue->entries = (toy_asset_release_entry_t*)toy_alloc(alc, sizeof(toy_asset_release_entry_t) * queue->capacity);
+	if (NULL == queue->entries) {
+		queue->~toy_asset_release_queue_t();
+		toy_free_aligned(alc, object);
+		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Failed to alloc asset release entries", error);
+		return NULL;
+	}
+
+	toy_ok(error);
+	return queue;
+}
+
+
+void toy_flush_asset_release_queue (toy_asset_release_queue_p queue)
+{
+	TOY_ASSERT(NULL != queue);
+	toy_asset_release_entry_t entry;
+	while (toy_pop_asset_release_entry(queue, UINT64_MAX, &entry))
+		toy_free_released_asset(&entry, false);
+}
+
+
+void toy_destroy_asset_release_queue (toy_asset_release_queue_p queue)
+{
+	TOY_ASSERT(NULL != queue);
+	toy_flush_asset_release_queue(queue);
+
+	toy_allocator_t alc = queue->alc;
+	toy_free(&alc, queue->entries);
+	queue->~toy_asset_release_queue_t();
+	toy_free_aligned(&alc, queue);
+}
+
+
+uint32_t toy_collect_released_assets (
+	toy_asset_release_queue_p queue,
+	uint32_t budget_us)
+{
+	TOY_ASSERT(NULL != queue);
+	// Frames up to (serial - TOY_CONCURRENT_FRAME_MAX) are finished once the fence of current slot is waited
+	uint64_t serial = queue->frame_serial.fetch_add(1, std::memory_order_relaxed) + 1;
+	uint64_t max_serial = serial - TOY_CONCURRENT_FRAME_MAX;
+
+	auto begin_time = std::chrono::steady_clock::now();
+	auto budget = std::chrono::microseconds(budget_us);
+	uint32_t freed_count = 0;
+	toy_asset_release_entry_t entry;
+	while (toy_pop_asset_release_entry(queue, max_serial, &entry)) {
+		toy_free_released_asset(&entry, true);
+		++freed_count;
+		if (std::chrono::steady_clock::now() - begin_time >= budget)
+			break;
+	}
+	return freed_count;
+}
+
+
+uint32_t toy_get_asset_release_queue_length (toy_asset_release_queue_p queue)
+{
+	TOY_ASSERT(NULL != queue);
+	std::lock_guard<std::mutex> guard(queue->lock);
+	return queue->end - queue->begin;
+}
+
+
+// Add a block and put its refs in free list, blocks array doubles, refs are never copied
+static bool toy_add_asset_item_ref_block (toy_asset_item_ref_pool_t* ref_pool)
+{
+	if (ref_pool->block_count == ref_pool->block_capacity) {
+		uint32_t new_capacity = ref_pool->block_capacity > 0 ? ref_pool->block_capacity * 2 : 4;
+		toy_asset_pool_item_ref_t** blocks = (toy_asset_pool_item_ref_t**)toy_realloc(&ref_pool->alc, ref_pool->blocks,
+			sizeof(toy_asset_pool_item_ref_t*) * ref_pool->block_capacity, sizeof(toy_asset_pool_item_ref_t*) * new_capacity);
+		if (toy_unlikely(NULL == blocks))
+			return false;
+		ref_pool->blocks = blocks;
+		ref_pool->block_capacity = new_capacity;
+	}
 
-	TOY_ASSERT(pool_index < pool->chunk_count && index < pool->chunk_block_count);
-	return pool->chunks[pool_index]->ref_counts[item_index].load();
+	uint32_t block_length = UINT32_C(1) << ref_pool->block_shift;
+	if (toy_unlikely(ref_pool->pool_length > UINT32_MAX - block_length - 1))
+		return false;
+	toy_asset_pool_item_ref_t* block = (toy_asset_pool_item_ref_t*)toy_alloc(&ref_pool->alc, sizeof(toy_asset_pool_item_ref_t) * block_length);
+	if (toy_unlikely(NULL == block))
+		return false;
+
+	uint32_t first_index = ref_pool->pool_length;
+	for (uint32_t i = 0; i < block_length - 1; ++i)
+		block[i].next_ref = first_index + i + 1;
+	block[block_length - 1].next_ref = ref_pool->next_block;
+
+	ref_pool->blocks[(ref_pool->block_count)++] = block;
+	ref_pool->pool_length += block_length;
+	ref_pool->next_block = first_index;
+	return true;
 }
 
 
@@ -264,19 +905,24 @@ void toy_create_asset_item_ref_pool (
 	toy_error_t* error)
 {
 	TOY_ASSERT(0 < initial_length && NULL != alc);
-	output->refs = (toy_asset_pool_item_ref_t*)toy_alloc_aligned(alc, sizeof(toy_asset_pool_item_ref_t) * initial_length, sizeof(void*));
-	if (toy_unlikely(NULL == output->refs)) {
-		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Failed to alloc asset references", error);
-		return;
-	}
 
-	output->pool_length = initial_length;
-	output->next_block = 0;
+	output->blocks = NULL;
+	output->block_count = 0;
+	output->block_capacity = 0;
+	output->block_shift = 0;
+	while ((UINT32_C(1) << output->block_shift) < initial_length)
+		++(output->block_shift);
+	output->pool_length = 0;
+	output->next_block = UINT32_MAX;
 	output->alc = *alc;
 
-	for (uint32_t i = 0; i < initial_length; ++i)
-		output->refs[i].next_ref = i + 1;
-	output->refs[initial_length - 1].next_ref = UINT32_MAX;
+	if (toy_unlikely(!toy_add_asset_item_ref_block(output))) {
+		if (NULL != output->blocks)
+			toy_free(alc, output->blocks);
+		output->blocks = NULL;
+		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Failed to alloc asset references", error);
+		return;
+	}
 
 	toy_ok(error);
 	return;
@@ -285,33 +931,25 @@ void toy_create_asset_item_ref_pool (
 
 void toy_destroy_asset_ref_pool (toy_asset_item_ref_pool_t* ref_pool)
 {
-	toy_free_aligned(&ref_pool->alc, ref_pool->refs);
+	for (uint32_t i = 0; i < ref_pool->block_count; ++i)
+		toy_free(&ref_pool->alc, ref_pool->blocks[i]);
+	if (NULL != ref_pool->blocks)
+		toy_free(&ref_pool->alc, ref_pool->blocks);
+	ref_pool->blocks = NULL;
+	ref_pool->block_count = 0;
+	ref_pool->block_capacity = 0;
+	ref_pool->pool_length = 0;
+	ref_pool->next_block = UINT32_MAX;
 }
 
 
 uint32_t toy_alloc_asset_item_ref (toy_asset_item_ref_pool_t* ref_pool)
 {
-	if (ref_pool->pool_length <= ref_pool->next_block) {
-		uint32_t new_length = ref_pool->pool_length * 2;
-		toy_asset_pool_item_ref_t* refs = (toy_asset_pool_item_ref_t*)toy_alloc_aligned(
-			&ref_pool->alc, sizeof(toy_asset_pool_item_ref_t) * new_length, sizeof(void*));
-		if (NULL == refs)
-			return UINT32_MAX;
-
-		for (uint32_t i = 0; i < ref_pool->pool_length; ++i)
-			refs[i] = ref_pool->refs[i];
-		for (uint32_t i = ref_pool->pool_length; i < new_length - 1; ++i)
-			refs[i].next_ref = i + 1;
-		refs[new_length - 1].next_ref = UINT32_MAX;
-
-		toy_free_aligned(&ref_pool->alc, ref_pool->refs);
-		ref_pool->refs = refs;
-		ref_pool->next_block = ref_pool->pool_length;
-		ref_pool->pool_length = new_length;
-	}
+	if (UINT32_MAX == ref_pool->next_block && !toy_add_asset_item_ref_block(ref_pool))
+		return UINT32_MAX;
 
 	uint32_t ret = ref_pool->next_block;
-	ref_pool->next_block = ref_pool->refs[ref_pool->next_block].next_ref;
+	ref_pool->next_block = toy_get_asset_item_ref(ref_pool, ret)->next_ref;
 	return ret;
 }
 
@@ -320,7 +958,8 @@ void toy_free_asset_item_ref (toy_asset_item_ref_pool_t* ref_pool, uint32_t inde
 {
 	TOY_ASSERT(NULL != ref_pool && index < ref_pool->pool_length);
 
-	ref_pool->refs[index].next_ref = ref_pool->next_block;
+	toy_get_asset_item_ref(ref_pool, index)->next_ref = ref_pool->next_block;
+	ref_pool->next_block = index;
 }
 
 TOY_EXTERN_C_END
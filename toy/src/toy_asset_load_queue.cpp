@@ -0,0 +1,158 @@
+#include "include/toy_asset_load_queue.h"
+
+#include "toy_assert.h"
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+
+
+// Intrusive FIFO of jobs
+typedef struct toy_asset_load_job_list_t {
+	toy_asset_load_job_t* head;
+	toy_asset_load_job_t* tail;
+}toy_asset_load_job_list_t;
+
+struct toy_asset_load_queue_t {
+	std::mutex lock; // Guard lists and stop
+	std::condition_variable wake;
+	toy_asset_load_job_list_t waiting;
+	toy_asset_load_job_list_t finished;
+	bool stop;
+	uint32_t worker_count;
+	std::thread* workers;
+	toy_allocator_t alc;
+};
+
+
+static void toy_push_asset_load_job_list (toy_asset_load_job_list_t* list, toy_asset_load_job_t* job)
+{
+	job->next = NULL;
+	if (NULL != list->tail)
+		list->tail->next = job;
+	else
+		list->head = job;
+	list->tail = job;
+}
+
+
+static toy_asset_load_job_t* toy_pop_asset_load_job_list (toy_asset_load_job_list_t* list)
+{
+	toy_asset_load_job_t* job = list->head;
+	if (NULL != job) {
+		list->head = job->next;
+		if (NULL == list->head)
+			list->tail = NULL;
+		job->next = NULL;
+	}
+	return job;
+}
+
+
+static void toy_run_asset_load_worker (toy_asset_load_queue_p queue)
+{
+	std::unique_lock<std::mutex> guard(queue->lock);
+	while (true) {
+		toy_asset_load_job_t* job = toy_pop_asset_load_job_list(&queue->waiting);
+		if (NULL == job) {
+			// Jobs pushed before stop are still run
+			if (queue->stop)
+				return;
+			queue->wake.wait(guard);
+			continue;
+		}
+
+		guard.unlock();
+		job->run_fp(job);
+		guard.lock();
+		toy_push_asset_load_job_list(&queue->finished, job);
+	}
+}
+
+
+TOY_EXTERN_C_START
+
+toy_asset_load_queue_p toy_create_asset_load_queue (
+	uint32_t worker_count,
+	const toy_allocator_t* alc,
+	toy_error_t* error)
+{
+	TOY_ASSERT(worker_count > 0 && NULL != alc);
+
+	void* object = toy_alloc_aligned(alc, sizeof(toy_asset_load_queue_t), alignof(toy_asset_load_queue_t));
+	if (NULL == object) {
+		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Failed to alloc asset load queue", error);
+		return NULL;
+	}
+
+	toy_asset_load_queue_p queue = new (object) toy_asset_load_queue_t();
+	queue->waiting.head = queue->waiting.tail = NULL;
+	queue->finished.head = queue->finished.tail = NULL;
+	queue->stop = false;
+	queue->alc = *alc;
+	queue->workers = (std::thread*)toy_alloc_aligned(alc, sizeof(std::thread) * worker_count, alignof(std::thread));
+	if (NULL == queue->workers) {
+		queue->~toy_asset_load_queue_t();
+		toy_free_aligned(alc, object);
+		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Failed to alloc asset load workers", error);
+		return NULL;
+	}
+
+	for (uint32_t i = 0; i < worker_count; ++i)
+		new (&queue->workers[i]) std::thread(toy_run_asset_load_worker, queue);
+	queue->worker_count = worker_count;
+
+	toy_ok(error);
+	return queue;
+}
+
+
+void toy_join_asset_load_queue (toy_asset_load_queue_p queue)
+{
+	TOY_ASSERT(NULL != queue);
+
+	{
+		std::lock_guard<std::mutex> guard(queue->lock);
+		queue->stop = true;
+	}
+	queue->wake.notify_all();
+	for (uint32_t i = 0; i < queue->worker_count; ++i) {
+		queue->workers[i].join();
+		queue->workers[i].~thread();
+	}
+	queue->worker_count = 0;
+}
+
+
+void toy_destroy_asset_load_queue (toy_asset_load_queue_p queue)
+{
+	TOY_ASSERT(NULL != queue);
+	toy_join_asset_load_queue(queue);
+
+	toy_allocator_t alc = queue->alc;
+	toy_free_aligned(&alc, queue->workers);
+	queue->~toy_asset_load_queue_t();
+	toy_free_aligned(&alc, queue);
+}
+
+
+void toy_push_asset_load_job (toy_asset_load_queue_p queue, toy_asset_load_job_t* job)
+{
+	TOY_ASSERT(NULL != queue && NULL != job && NULL != job->run_fp);
+	{
+		std::lock_guard<std::mutex> guard(queue->lock);
+		TOY_ASSERT(!queue->stop);
+		toy_push_asset_load_job_list(&queue->waiting, job);
+	}
+	queue->wake.notify_one();
+}
+
+
+toy_asset_load_job_t* toy_pop_finished_asset_load_job (toy_asset_load_queue_p queue)
+{
+	TOY_ASSERT(NULL != queue);
+	std::lock_guard<std::mutex> guard(queue->lock);
+	return toy_pop_asset_load_job_list(&queue->finished);
+}
+
+TOY_EXTERN_C_END
@@ -27,15 +27,9 @@ static void destroy_mesh (
 	toy_asset_pool_t* material_pool = &asset_mgr->asset_pools.material;
 	toy_mesh_t* mesh = asset;
 
-	toy_sub_asset_ref(primitive_pool, mesh->primitive_index, 1);
-	if (0 == toy_get_asset_ref(primitive_pool, mesh->primitive_index))
-		toy_free_asset_item(primitive_pool, mesh->primitive_index);
-
-	if (UINT32_MAX != mesh->material_index) {
-		toy_sub_asset_ref(material_pool, mesh->material_index, 1);
-		if (0 == toy_get_asset_ref(material_pool, mesh->material_index))
-			toy_free_asset_item(material_pool, mesh->material_index);
-	}
+	toy_release_asset_item(primitive_pool, mesh->primitive_index);
+	if (UINT32_MAX != mesh->material_index)
+		toy_release_asset_item(material_pool, mesh->material_index);
 }
 
 static void destroy_image (
@@ -76,18 +70,12 @@ static void destroy_material (
 		switch (layout_bindings[i].descriptorType) {
 		case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
 		{
-			toy_asset_pool_item_ref_t* image_ref = (toy_asset_pool_item_ref_t*)((uintptr_t)desc_set_data + bindings[i].offset);
-			toy_asset_pool_item_ref_t* sampler_ref = image_ref + 1;
-			if (NULL != image_ref->pool && UINT32_MAX != image_ref->index) {
-				toy_sub_asset_ref(image_ref->pool, image_ref->index, 1);
-				if (0 == toy_get_asset_ref(image_ref->pool, image_ref->index))
-					toy_free_asset_item(image_ref->pool, image_ref->index);
-			}
-			if (NULL != sampler_ref->pool && UINT32_MAX != sampler_ref->index) {
-				toy_sub_asset_ref(sampler_ref->pool, sampler_ref->index, 1);
-				if (0 == toy_get_asset_ref(sampler_ref->pool, sampler_ref->index))
-					toy_free_asset_item(sampler_ref->pool, sampler_ref->index);
-			}
+			toy_asset_handle_t* image_handle = (toy_asset_handle_t*)((uintptr_t)desc_set_data + bindings[i].offset);
+			toy_asset_handle_t* sampler_handle = image_handle + 1;
+			if (TOY_ASSET_HANDLE_NULL != *image_handle)
+				toy_release_asset_handle(*image_handle);
+			if (TOY_ASSET_HANDLE_NULL != *sampler_handle)
+				toy_release_asset_handle(*sampler_handle);
 			break;
 		}
 		case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
@@ -99,7 +87,94 @@ static void destroy_material (
 		}
 	}
 
-	toy_free_aligned(&asset_mgr->alc->list_alc, desc_set_data);
+	toy_allocator_t material_alc = toy_get_tagged_allocator(asset_mgr->alc, &asset_mgr->alc->small_alc, TOY_MEMORY_TAG_ASSET);
+	toy_free_aligned(&material_alc, desc_set_data);
+}
+
+
+enum toy_asset_load_stage_t {
+	TOY_ASSET_LOAD_STAGE_DECODING = 0, // Queued or running on a worker
+	TOY_ASSET_LOAD_STAGE_DECODED, // Waiting for loader
+	TOY_ASSET_LOAD_STAGE_UPLOADING,
+	TOY_ASSET_LOAD_STAGE_FOLLOWING, // Waiting for a pending load of the same path
+	TOY_ASSET_LOAD_STAGE_FINISHED,
+};
+
+// Item of load_request pool, referenced by caller until toy_release_asset_load(), and by manager until load finishes
+struct toy_asset_load_request_t {
+	toy_asset_load_job_t job; // Must be the first field
+	toy_asset_manager_t* asset_mgr;
+	toy_asset_load_request_t* next; // In upload or uploading FIFO, or in followers of another request
+	toy_asset_load_request_t* followers; // Loads of the same path, finished with this one
+	uint32_t index; // In load_request pool
+	uint32_t kind; // enum toy_asset_kind_t
+	uint32_t stage; // enum toy_asset_load_stage_t
+	enum toy_asset_load_state_t state;
+	bool is_released; // Caller has released the load handle
+	toy_error_t error;
+	toy_asset_load_callback_fp callback;
+	void* user_data;
+	uint32_t asset_index; // Item being uploaded
+	uint64_t upload_serial; // Stage submit which finishes upload of item
+	toy_asset_handle_t asset; // A reference of it is kept by request
+
+	char* path; // Image
+	stbi_uc* pixels;
+	int width;
+	int height;
+
+	toy_host_mesh_primitive_t primitive; // Mesh primitive, attributes and indices point to data
+	void* data;
+};
+
+
+static void destroy_asset_load_request (
+	toy_asset_pool_t* pool,
+	void* asset)
+{
+	toy_asset_load_request_t* request = asset;
+	toy_allocator_t std_alc = toy_std_alc();
+	TOY_ASSERT(TOY_ASSET_LOAD_STAGE_UPLOADING != request->stage);
+
+	if (TOY_ASSET_HANDLE_NULL != request->asset)
+		toy_release_asset_handle(request->asset);
+	if (NULL != request->pixels)
+		stbi_image_free(request->pixels);
+	if (NULL != request->path)
+		toy_free(&std_alc, request->path);
+	if (NULL != request->data)
+		toy_free(&std_alc, request->data);
+}
+
+
+static void toy_wait_asset_upload (toy_asset_manager_t* asset_mgr);
+
+static void toy_drop_asset_loads (toy_asset_manager_t* asset_mgr);
+
+
+// Pools of asset manager are initialized by this, so telemetry and stats walk every one of them
+static void toy_init_asset_manager_pool (
+	toy_asset_manager_t* asset_mgr,
+	size_t asset_size,
+	size_t asset_alignment,
+	size_t hot_size,
+	toy_destroy_asset_fp destroy_asset_fp,
+	const toy_allocator_t* alc,
+	void* context,
+	const char* literal_name,
+	toy_asset_pool_t* output,
+	toy_error_t* error)
+{
+	TOY_ASSERT(asset_mgr->pool_count < TOY_ASSET_MANAGER_POOL_MAX);
+
+	toy_init_asset_pool(
+		asset_size, asset_alignment, hot_size, destroy_asset_fp,
+		&asset_mgr->chunk_alc, alc, context, literal_name, output, error);
+	if (toy_is_failed(*error))
+		return;
+
+	asset_mgr->pools[asset_mgr->pool_count] = output;
+	++(asset_mgr->pool_count);
 }
 
 
@@ -116,26 +191,45 @@ void toy_create_asset_manager (
 	memset(output, 0, sizeof(*output));
 
 	output->alc = alc;
+	toy_allocator_t asset_alc = toy_get_tagged_allocator(alc, &alc->buddy_alc, TOY_MEMORY_TAG_ASSET);
 
-	output->cache_stack = toy_create_memory_stack(cache_size + sizeof(toy_memory_stack_t), alc, &output->stack_alc_L, &output->stack_alc_R);
+	output->cache_stack = toy_create_memory_stack(cache_size + sizeof(toy_memory_stack_t), &output->stack_alc_L, &output->stack_alc_R);
 	if (NULL == output->cache_stack) {
 		toy_err(TOY_ERROR_MEMORY_DEVICE_ALLOCATION_FAILED, "Failed to create asset cache stack", error);
 		goto FAIL_MEMORY_STACK;
 	}
 	output->cache_size = cache_size;
+	// A file bigger than cache goes to heap rather than fails
+	toy_allocator_t std_alc = toy_std_alc();
+	toy_set_stack_overflow_allocator(output->cache_stack, &std_alc);
 
 	output->file_api = toy_std_file_interface();
 
-	toy_create_memory_pools(8 * 1024 * 1024, TOY_MEMORY_CHUNK_SIZE, alc, &output->chunk_pools, &output->chunk_alc);
-	if (NULL == output->chunk_pools) {
-		toy_err(TOY_ERROR_MEMORY_DEVICE_ALLOCATION_FAILED, "Failed to create asset chunk pool", error);
+	if (NULL == alc->concurrent_chunks) {
+		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Asset manager needs concurrent chunks of memory allocator", error);
 		goto FAIL_MEMORY_POOL;
 	}
+	output->chunk_alc = alc->concurrent_chunk_alc;
 
-	toy_create_asset_item_ref_pool(256, &alc->buddy_alc, &output->item_ref_pool, error);
+	toy_create_asset_item_ref_pool(256, &asset_alc, &output->item_ref_pool, error);
 	if (toy_is_failed(*error))
 		goto FAIL_ITEM_REF_POOL;
 
+	output->release_queue = toy_create_asset_release_queue(&asset_alc, error);
+	if (toy_is_failed(*error))
+		goto FAIL_RELEASE_QUEUE;
+
+	toy_create_asset_registry(&asset_alc, &output->registry, error);
+	if (toy_is_failed(*error))
+		goto FAIL_REGISTRY;
+
+	toy_asset_residency_budget_t residency_budget;
+	residency_budget.host_bytes = TOY_ASSET_MANAGER_HOST_BUDGET;
+	residency_budget.device_bytes = TOY_ASSET_MANAGER_DEVICE_BUDGET;
+	output->residency = toy_create_asset_residency(&residency_budget, &asset_alc, error);
+	if (toy_is_failed(*error))
+		goto FAIL_RESIDENCY;
+
 	output->vk_private.vk_driver = vk_driver;
 
 	toy_create_vulkan_asset_loader(
@@ -158,69 +252,134 @@ void toy_create_asset_manager (
 	if (toy_is_failed(*error))
 		goto FAIL_VK_MESH_PRIMITIVE;
 
-	toy_init_asset_pool(
+	output->load_queue = toy_create_asset_load_queue(TOY_ASSET_MANAGER_LOAD_WORKER_COUNT, &asset_alc, error);
+	if (toy_is_failed(*error))
+		goto FAIL_LOAD_QUEUE;
+
+	toy_init_asset_manager_pool(
+		output,
 		sizeof(toy_vulkan_mesh_primitive_t),
 		sizeof(void*),
+		sizeof(toy_vulkan_mesh_primitive_draw_t),
 		destroy_vulkan_mesh_primitive,
-		&output->chunk_alc,
-		&alc->buddy_alc,
+		&asset_alc,
 		&output->vk_private.vk_mesh_primitive_pool,
 		"Vulkan mesh primitive",
-		&output->asset_pools.mesh_primitive);
+		&output->asset_pools.mesh_primitive,
+		error);
+	if (toy_is_failed(*error))
+		goto FAIL_MESH_PRIMITIVE_POOL;
 
-	toy_init_asset_pool(
+	toy_init_asset_manager_pool(
+		output,
 		sizeof(toy_mesh_t),
 		sizeof(void*),
+		0,
 		destroy_mesh,
-		&output->chunk_alc,
-		&alc->buddy_alc,
+		&asset_alc,
 		output,
 		"Mesh",
-		&output->asset_pools.mesh);
+		&output->asset_pools.mesh,
+		error);
+	if (toy_is_failed(*error))
+		goto FAIL_MESH_POOL;
 
-	toy_init_asset_pool(
+	toy_init_asset_manager_pool(
+		output,
 		sizeof(toy_vulkan_image_t),
 		sizeof(void*),
+		0,
 		destroy_image,
-		&output->chunk_alc,
-		&alc->buddy_alc,
+		&asset_alc,
 		&output->vk_private.vk_driver->vk_allocator,
 		"Vulkan image",
-		&output->asset_pools.image);
+		&output->asset_pools.image,
+		error);
+	if (toy_is_failed(*error))
+		goto FAIL_IMAGE_POOL;
 
-	toy_init_asset_pool(
+	toy_init_asset_manager_pool(
+		output,
 		sizeof(void*),
 		sizeof(void*),
+		0,
 		destroy_material,
-		&output->chunk_alc,
-		&alc->buddy_alc,
+		&asset_alc,
 		output,
 		"Material Pointer",
-		&output->asset_pools.material);
+		&output->asset_pools.material,
+		error);
+	if (toy_is_failed(*error))
+		goto FAIL_MATERIAL_POOL;
 
-	toy_init_asset_pool(
+	toy_init_asset_manager_pool(
+		output,
+		sizeof(toy_asset_load_request_t),
+		sizeof(void*),
+		0,
+		destroy_asset_load_request,
+		&asset_alc,
+		output,
+		"Asset load request",
+		&output->asset_pools.load_request,
+		error);
+	if (toy_is_failed(*error))
+		goto FAIL_LOAD_REQUEST_POOL;
+
+	toy_init_asset_manager_pool(
+		output,
 		sizeof(toy_vulkan_sampler_t),
 		sizeof(uint32_t),
+		0,
 		destroy_image_sampler,
-		&output->chunk_alc,
-		&alc->buddy_alc,
+		&asset_alc,
 		output,
 		"Vulkan image sampler",
-		&output->asset_pools.image_sampler);
+		&output->asset_pools.image_sampler,
+		error);
+	if (toy_is_failed(*error))
+		goto FAIL_IMAGE_SAMPLER_POOL;
+
+	output->asset_pools.mesh_primitive.release_queue = output->release_queue;
+	output->asset_pools.mesh.release_queue = output->release_queue;
+	output->asset_pools.image.release_queue = output->release_queue;
+	output->asset_pools.material.release_queue = output->release_queue;
+	output->asset_pools.image_sampler.release_queue = output->release_queue;
+	output->asset_pools.mesh_primitive.residency = output->residency;
+	output->asset_pools.image.residency = output->residency;
 	
 	toy_ok(error);
 	return;
 
+FAIL_IMAGE_SAMPLER_POOL:
+	toy_destroy_asset_pool(&asset_alc, &output->asset_pools.load_request);
+FAIL_LOAD_REQUEST_POOL:
+	toy_destroy_asset_pool(&asset_alc, &output->asset_pools.material);
+FAIL_MATERIAL_POOL:
+	toy_destroy_asset_pool(&asset_alc, &output->asset_pools.image);
+FAIL_IMAGE_POOL:
+	toy_destroy_asset_pool(&asset_alc, &output->asset_pools.mesh);
+FAIL_MESH_POOL:
+	toy_destroy_asset_pool(&asset_alc, &output->asset_pools.mesh_primitive);
+FAIL_MESH_PRIMITIVE_POOL:
+	toy_destroy_asset_load_queue(output->load_queue);
+FAIL_LOAD_QUEUE:
+	toy_destroy_vulkan_mesh_primitive_asset_pool(&output->vk_private.vk_mesh_primitive_pool);
 FAIL_VK_MESH_PRIMITIVE:
 	toy_destroy_vulkan_asset_loader(
 		output->vk_private.vk_driver->device.handle,
 		&output->vk_private.vk_asset_loader);
 FAIL_VK_ASSET_LOADER:
+	toy_destroy_asset_residency(output->residency);
+FAIL_RESIDENCY:
+	toy_destroy_asset_registry(&output->registry);
+FAIL_REGISTRY:
+	toy_destroy_asset_release_queue(output->release_queue);
+FAIL_RELEASE_QUEUE:
 	toy_destroy_asset_ref_pool(&output->item_ref_pool);
 FAIL_ITEM_REF_POOL:
-	toy_destroy_memory_pools(output->chunk_pools, alc);
 FAIL_MEMORY_POOL:
-	toy_destroy_memory_stack(output->cache_stack, alc);
+	toy_destroy_memory_stack(output->cache_stack);
 FAIL_MEMORY_STACK:
 	return;
 }
@@ -231,7 +390,26 @@ void toy_destroy_asset_manager (
 {
 	toy_memory_allocator_t* alc = asset_mgr->alc;
 
+	// Loads held by manager finish before anything they reference is destroyed
+	toy_wait_asset_upload(asset_mgr);
+	toy_join_asset_load_queue(asset_mgr->load_queue);
+	toy_drop_asset_loads(asset_mgr);
+	toy_destroy_asset_load_queue(asset_mgr->load_queue);
+	toy_destroy_asset_pool(&alc->buddy_alc, &asset_mgr->asset_pools.load_request);
+
+	// Items released while pools are destroyed are freed at once
+	toy_flush_asset_release_queue(asset_mgr->release_queue);
+	toy_flush_asset_residency(asset_mgr->residency);
+	asset_mgr->asset_pools.mesh_primitive.residency = NULL;
+	asset_mgr->asset_pools.image.residency = NULL;
+	asset_mgr->asset_pools.mesh_primitive.release_queue = NULL;
+	asset_mgr->asset_pools.mesh.release_queue = NULL;
+	asset_mgr->asset_pools.image.release_queue = NULL;
+	asset_mgr->asset_pools.material.release_queue = NULL;
+	asset_mgr->asset_pools.image_sampler.release_queue = NULL;
+
 	toy_destroy_asset_pool(&alc->buddy_alc, &asset_mgr->asset_pools.material);
+	toy_destroy_asset_pool(&alc->buddy_alc, &asset_mgr->asset_pools.image_sampler);
 	toy_destroy_asset_pool(&alc->buddy_alc, &asset_mgr->asset_pools.image);
 	toy_destroy_asset_pool(&alc->buddy_alc, &asset_mgr->asset_pools.mesh);
 	toy_destroy_asset_pool(&alc->buddy_alc, &asset_mgr->asset_pools.mesh_primitive);
@@ -241,13 +419,28 @@ void toy_destroy_asset_manager (
 		asset_mgr->vk_private.vk_driver->device.handle,
 		&asset_mgr->vk_private.vk_asset_loader);
 
+	toy_destroy_asset_residency(asset_mgr->residency);
+	toy_destroy_asset_registry(&asset_mgr->registry);
+	toy_destroy_asset_release_queue(asset_mgr->release_queue);
 	toy_destroy_asset_ref_pool(&asset_mgr->item_ref_pool);
-	toy_destroy_memory_pools(asset_mgr->chunk_pools, asset_mgr->alc);
-	toy_destroy_memory_stack(asset_mgr->cache_stack, asset_mgr->alc);
+	toy_destroy_memory_stack(asset_mgr->cache_stack);
+
+	if (NULL != asset_mgr->upload_batch_items) {
+		toy_allocator_t asset_alc = toy_get_tagged_allocator(alc, &alc->buddy_alc, TOY_MEMORY_TAG_ASSET);
+		toy_free(&asset_alc, asset_mgr->upload_batch_items);
+	}
 }
 
 
 
+// Item found in registry may have no reference and be freed by residency or release queue meanwhile,
+// return false when it is being freed, then it is not shared
+static toy_inline bool toy_ref_registered_asset (toy_asset_handle_t handle)
+{
+	return TOY_ASSET_REF_FREED != toy_add_asset_handle_ref(handle, 1);
+}
+
+
 static uint32_t alloc_mesh_primitive_item (
 	toy_asset_manager_t* asset_mgr,
 	const toy_host_mesh_primitive_t* primitive_data,
@@ -274,6 +467,11 @@ static uint32_t alloc_mesh_primitive_item (
 	if (toy_is_failed(*error))
 		goto FAIL_ALLOC_MESH_PRIMITIVE;
 
+	// Hot data of a reused block is stale, item draws nothing until its upload is committed
+	toy_vulkan_mesh_primitive_draw_t* primitive_draw = toy_get_asset_hot_item(&asset_mgr->asset_pools.mesh_primitive, primitive_index);
+	primitive_draw->first_index = 0;
+	primitive_draw->index_count = 0;
+
 	toy_ok(error);
 	return primitive_index;
 
@@ -284,136 +482,338 @@ FAIL_ALLOC_REF:
 }
 
 
-uint32_t toy_load_mesh_primitive (
+// Stage data of an allocated item into the open stage batch and record its copies, no post process command.
+// Data can be freed after return, item can be drawn after last submit of the batch is finished
+static void toy_stage_mesh_primitive (
 	toy_asset_manager_t* asset_mgr,
 	const toy_host_mesh_primitive_t* primitive_data,
+	uint32_t primitive_index,
 	toy_error_t* error)
 {
 	toy_asset_manager_vulkan_private_t* vk_private = &asset_mgr->vk_private;
-	VkResult vk_err;
-
-	// Alloc asset item
-	uint32_t primitive_index = alloc_mesh_primitive_item(asset_mgr, primitive_data, error);
-	if (toy_is_failed(*error))
-		goto FAIL_ALLOC_ITEM;
 
 	toy_vulkan_mesh_primitive_t* vk_primitive = toy_get_asset_item(&asset_mgr->asset_pools.mesh_primitive, primitive_index);
 	TOY_ASSERT(NULL != vk_primitive);
 
-	toy_reset_vulkan_asset_loader(
-		vk_private->vk_driver->device.handle,
-		&vk_private->vk_asset_loader,
-		error);
-	if (toy_is_failed(*error))
-		goto FAIL_RESET_LOADER;
-
-	// Copy data to stage memory
-	toy_stage_data_block_t data_blocks[2];
-	toy_vulkan_sub_buffer_t stage_sub_buffers[2];
-	data_blocks[0].data = primitive_data->attributes;
-	data_blocks[0].size = primitive_data->attribute_size;
-	data_blocks[0].alignment = primitive_data->attribute_size / primitive_data->vertex_count;
-	data_blocks[1].data = primitive_data->indices;
-	data_blocks[1].size = primitive_data->index_size;
-	data_blocks[1].alignment = primitive_data->index_count > UINT16_MAX ? sizeof(uint32_t) : sizeof(uint16_t);
-
-	toy_map_vulkan_stage_memory(
-		vk_private->vk_driver->device.handle,
-		&vk_private->vk_asset_loader,
-		error);
-	if (toy_is_failed(*error))
-		goto FAIL_MAP_STAGE_MEMORY;
+	toy_stage_data_block_t data_block;
+	toy_vulkan_sub_buffer_t dst_buffer;
+	data_block.data = primitive_data->attributes;
+	data_block.size = primitive_data->attribute_size;
+	data_block.alignment = primitive_data->attribute_size / primitive_data->vertex_count;
+	toy_vulkan_look_up_vertex_sub_buffer(&vk_private->vk_mesh_primitive_pool, vk_primitive, &dst_buffer);
+	toy_stage_vulkan_buffer(&vk_private->vk_asset_loader, &data_block, &dst_buffer, error);
+	if (toy_is_failed(*error) || NULL == primitive_data->indices)
+		return;
+
+	data_block.data = primitive_data->indices;
+	data_block.size = primitive_data->index_size;
+	data_block.alignment = primitive_data->index_count > UINT16_MAX ? sizeof(uint32_t) : sizeof(uint16_t);
+	toy_vulkan_look_up_index_sub_buffer(&vk_private->vk_mesh_primitive_pool, vk_primitive, &dst_buffer);
+	toy_stage_vulkan_buffer(&vk_private->vk_asset_loader, &data_block, &dst_buffer, error);
+}
 
-	toy_copy_data_to_vulkan_stage_memory(
-		data_blocks,
-		NULL != primitive_data->indices ? 2 : 1,
-		&vk_private->vk_asset_loader,
-		stage_sub_buffers,
-		error);
-	if (toy_is_failed(*error))
-		goto FAIL_COPY_TO_STAGE_MEMORY;
 
-	toy_unmap_vulkan_stage_memory(
-		vk_private->vk_driver->device.handle,
-		&vk_private->vk_asset_loader,
-		error);
-	if (toy_is_failed(*error))
-		goto FAIL_UNMAP_STAGE_MEMORY;
+// Item is staged, return handle of a reference to it, it draws nothing before toy_commit_uploaded_asset().
+// Not registered, its bytes are on device only and could not be compared on a content hash hit
+static toy_asset_handle_t toy_finish_mesh_primitive (
+	toy_asset_manager_t* asset_mgr,
+	uint32_t primitive_index)
+{
+	toy_add_asset_ref(&asset_mgr->asset_pools.mesh_primitive, primitive_index, 1);
+	return toy_get_asset_handle(&asset_mgr->asset_pools.mesh_primitive, primitive_index);
+}
 
-	// Copy stage memory to gpu local memory
-	vk_err = toy_start_vkcmd_stage_mesh_primitive(
-		&vk_private->vk_asset_loader);
-	if (VK_SUCCESS != vk_err) {
-		toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "Failed to record vkcmd of loading mesh primitive", error);
-		goto FAIL_START_CMD;
+
+// Item reached device, a mesh primitive draws from now and residency may evict it once released
+static void toy_commit_uploaded_asset (
+	toy_asset_manager_t* asset_mgr,
+	toy_asset_handle_t handle,
+	enum toy_asset_kind_t kind)
+{
+	uint32_t index = toy_get_asset_handle_index(handle);
+	if (TOY_ASSET_KIND_MESH_PRIMITIVE == kind) {
+		toy_vulkan_mesh_primitive_t* vk_primitive = toy_get_asset_item(&asset_mgr->asset_pools.mesh_primitive, index);
+		toy_vulkan_mesh_primitive_draw_t* primitive_draw = toy_get_asset_hot_item(&asset_mgr->asset_pools.mesh_primitive, index);
+		primitive_draw->first_index = vk_primitive->first_index;
+		primitive_draw->index_count = vk_primitive->index_count;
+		toy_track_asset_residency(asset_mgr->residency, handle, sizeof(toy_vulkan_mesh_primitive_t),
+			(size_t)vk_primitive->vertex_stride * vk_primitive->vertex_count + (size_t)vk_primitive->index_stride * vk_primitive->index_count);
 	}
+	else {
+		TOY_ASSERT(TOY_ASSET_KIND_IMAGE == kind);
+		toy_vulkan_image_t* vk_image = toy_get_asset_item(&asset_mgr->asset_pools.image, index);
+		toy_track_asset_residency(asset_mgr->residency, handle, sizeof(toy_vulkan_image_t), vk_image->binding.size);
+	}
+}
 
-	toy_vkcmd_copy_mesh_primitive_data(
-		vk_private->vk_asset_loader.transfer_cmd,
-		&vk_private->vk_mesh_primitive_pool,
-		&stage_sub_buffers[0],
-		NULL != primitive_data->indices ? &stage_sub_buffers[1] : NULL,
-		vk_primitive);
 
-	// Post process commands, for mesh primitive, it's nothing
+// Room for one more load of the open batch, taken before its item is allocated so a staged load is always listed
+static void toy_reserve_asset_upload_batch_item (toy_asset_manager_t* asset_mgr, toy_error_t* error)
+{
+	if (asset_mgr->upload_batch_item_count < asset_mgr->upload_batch_item_capacity) {
+		toy_ok(error);
+		return;
+	}
 
-	toy_submit_vkcmd_stage_mesh_primitive(
-		vk_private->vk_driver->device.handle,
-		&vk_private->vk_asset_loader,
-		error);
+	toy_allocator_t asset_alc = toy_get_tagged_allocator(asset_mgr->alc, &asset_mgr->alc->buddy_alc, TOY_MEMORY_TAG_ASSET);
+	uint32_t capacity = asset_mgr->upload_batch_item_capacity > 0 ? asset_mgr->upload_batch_item_capacity * 2 : 16;
+	toy_asset_upload_batch_item_t* items = (toy_asset_upload_batch_item_t*)toy_alloc(&asset_alc, sizeof(toy_asset_upload_batch_item_t) * capacity);
+	if (NULL == items) {
+		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Alloc upload batch items failed", error);
+		return;
+	}
+	if (NULL != asset_mgr->upload_batch_items) {
+		memcpy(items, asset_mgr->upload_batch_items, sizeof(toy_asset_upload_batch_item_t) * asset_mgr->upload_batch_item_count);
+		toy_free(&asset_alc, asset_mgr->upload_batch_items);
+	}
+	asset_mgr->upload_batch_items = items;
+	asset_mgr->upload_batch_item_capacity = capacity;
+	toy_ok(error);
+}
+
+
+static void toy_push_asset_upload_batch_item (
+	toy_asset_manager_t* asset_mgr,
+	toy_asset_handle_t handle,
+	enum toy_asset_kind_t kind)
+{
+	TOY_ASSERT(asset_mgr->upload_batch_item_count < asset_mgr->upload_batch_item_capacity);
+	toy_asset_upload_batch_item_t* item = &asset_mgr->upload_batch_items[asset_mgr->upload_batch_item_count++];
+	item->handle = handle;
+	item->kind = (uint32_t)kind;
+}
+
+
+// Loads listed by the open batch are uploaded or failed with its flush.
+// Failed ones are found by nothing and never tracked, their references are released by caller and free them
+static void toy_settle_asset_upload_batch (toy_asset_manager_t* asset_mgr, bool uploaded)
+{
+	for (uint32_t i = 0; i < asset_mgr->upload_batch_item_count; ++i) {
+		const toy_asset_upload_batch_item_t* item = &asset_mgr->upload_batch_items[i];
+		if (uploaded)
+			toy_commit_uploaded_asset(asset_mgr, item->handle, (enum toy_asset_kind_t)item->kind);
+		else if (TOY_ASSET_KIND_IMAGE == item->kind)
+			toy_unregister_asset(&asset_mgr->registry, item->handle);
+	}
+	if (!uploaded)
+		asset_mgr->upload_batch_failed_count += asset_mgr->upload_batch_item_count;
+	asset_mgr->upload_batch_item_count = 0;
+}
+
+
+// Async batches in flight keep their ring regions, sync loads stage beside them
+static void toy_open_asset_upload_batch (toy_asset_manager_t* asset_mgr, toy_error_t* error)
+{
+	toy_vulkan_asset_loader_t* vk_asset_loader = &asset_mgr->vk_private.vk_asset_loader;
+	TOY_ASSERT(!vk_asset_loader->batch_recording);
+
+	toy_begin_vulkan_stage_batch(vk_asset_loader->vk_alc->device, vk_asset_loader, error);
+}
+
+
+// Submit batch of sync loads and wait for it, with submits before it
+static void toy_flush_asset_upload_batch (toy_asset_manager_t* asset_mgr, toy_error_t* error)
+{
+	toy_vulkan_asset_loader_t* vk_asset_loader = &asset_mgr->vk_private.vk_asset_loader;
+	TOY_ASSERT(vk_asset_loader->batch_recording);
+
+	// Batch may be empty after staging submitted it when stage ring was full
+	if (toy_is_vulkan_stage_batch_empty(vk_asset_loader)) {
+		toy_cancel_vulkan_stage_batch(vk_asset_loader->vk_alc->device, vk_asset_loader);
+	}
+	else {
+		toy_submit_vulkan_stage_batch(vk_asset_loader->vk_alc->device, vk_asset_loader, error);
+		if (toy_is_failed(*error)) {
+			if (vk_asset_loader->batch_recording)
+				toy_cancel_vulkan_stage_batch(vk_asset_loader->vk_alc->device, vk_asset_loader);
+			return;
+		}
+	}
+
+	toy_wait_vulkan_stage_submit(vk_asset_loader->vk_alc->device, vk_asset_loader, vk_asset_loader->submit_serial, error);
+}
+
+
+void toy_begin_asset_upload_batch (toy_asset_manager_t* asset_mgr)
+{
+	TOY_ASSERT(NULL != asset_mgr && !asset_mgr->upload_batch_open);
+	asset_mgr->upload_batch_open = true;
+}
+
+
+void toy_end_asset_upload_batch (toy_asset_manager_t* asset_mgr, toy_error_t* error)
+{
+	TOY_ASSERT(NULL != asset_mgr && asset_mgr->upload_batch_open);
+	asset_mgr->upload_batch_open = false;
+
+	if (asset_mgr->vk_private.vk_asset_loader.batch_recording) {
+		toy_flush_asset_upload_batch(asset_mgr, error);
+		toy_settle_asset_upload_batch(asset_mgr, toy_is_ok(*error));
+		if (toy_is_failed(*error))
+			toy_log_error(error);
+	}
+	TOY_ASSERT(0 == asset_mgr->upload_batch_item_count);
+
+	// A flush by a failed load may have failed earlier loads of the batch as well
+	uint32_t failed_count = asset_mgr->upload_batch_failed_count;
+	asset_mgr->upload_batch_failed_count = 0;
+	if (failed_count > 0) {
+		toy_log_e("%u loads of upload batch are not uploaded", failed_count);
+		toy_err(TOY_ERROR_OPERATION_FAILED, "Upload batch failed, release its loads", error);
+		return;
+	}
+	toy_ok(error);
+}
+
+
+// Staging of a sync load failed after some copies of its item were recorded, or submitted when stage ring was full.
+// A batch of this load only is cancelled, an open batch of other loads is submitted with them, item is freed after its copies
+static void toy_free_unstaged_asset_item (
+	toy_asset_manager_t* asset_mgr,
+	toy_asset_pool_t* pool,
+	uint32_t index)
+{
+	toy_vulkan_asset_loader_t* vk_asset_loader = &asset_mgr->vk_private.vk_asset_loader;
+	toy_error_t err;
+
+	if (vk_asset_loader->batch_recording) {
+		if (asset_mgr->upload_batch_open) {
+			toy_flush_asset_upload_batch(asset_mgr, &err);
+			toy_settle_asset_upload_batch(asset_mgr, toy_is_ok(err));
+			if (toy_is_failed(err))
+				toy_log_error(&err);
+		}
+		else {
+			toy_cancel_vulkan_stage_batch(vk_asset_loader->vk_alc->device, vk_asset_loader);
+		}
+	}
+
+	toy_wait_vulkan_stage_submit(vk_asset_loader->vk_alc->device, vk_asset_loader, vk_asset_loader->submit_serial, &err);
+	if (toy_is_failed(err))
+		toy_log_error(&err);
+	toy_free_asset_item(pool, index);
+}
+
+
+uint32_t toy_load_mesh_primitive (
+	toy_asset_manager_t* asset_mgr,
+	const toy_host_mesh_primitive_t* primitive_data,
+	toy_error_t* error)
+{
+	toy_vulkan_asset_loader_t* vk_asset_loader = &asset_mgr->vk_private.vk_asset_loader;
+
+	if (asset_mgr->upload_batch_open) {
+		toy_reserve_asset_upload_batch_item(asset_mgr, error);
+		if (toy_is_failed(*error))
+			goto FAIL_OPEN_BATCH;
+	}
+
+	if (!vk_asset_loader->batch_recording) {
+		toy_open_asset_upload_batch(asset_mgr, error);
+		if (toy_is_failed(*error))
+			goto FAIL_OPEN_BATCH;
+	}
+
+	// Alloc asset item
+	uint32_t primitive_index = alloc_mesh_primitive_item(asset_mgr, primitive_data, error);
 	if (toy_is_failed(*error))
-		goto FAIL_SUBMIT_CMD;
-
-	vk_err = vkWaitForFences(
-		vk_private->vk_driver->device.handle,
-		1,
-		&vk_private->vk_asset_loader.fence,
-		VK_TRUE,
-		UINT64_MAX);
-	if (VK_SUCCESS != vk_err) {
-		toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "Wait for asset loading failed", error);
-		goto FAIL_WAIT_SUBMIT;
+		goto FAIL_ALLOC_ITEM;
+
+	toy_stage_mesh_primitive(asset_mgr, primitive_data, primitive_index, error);
+	if (toy_is_failed(*error))
+		goto FAIL_STAGE;
+
+	// Out of toy_begin_asset_upload_batch(), a sync load is a batch of its own
+	if (asset_mgr->upload_batch_open) {
+		toy_asset_handle_t handle = toy_finish_mesh_primitive(asset_mgr, primitive_index);
+		toy_push_asset_upload_batch_item(asset_mgr, handle, TOY_ASSET_KIND_MESH_PRIMITIVE);
+	}
+	else {
+		toy_flush_asset_upload_batch(asset_mgr, error);
+		if (toy_is_failed(*error))
+			goto FAIL_STAGE;
+		toy_asset_handle_t handle = toy_finish_mesh_primitive(asset_mgr, primitive_index);
+		toy_commit_uploaded_asset(asset_mgr, handle, TOY_ASSET_KIND_MESH_PRIMITIVE);
 	}
 
 	toy_ok(error);
 	return primitive_index;
 
-FAIL_WAIT_SUBMIT:
-FAIL_SUBMIT_CMD:
-FAIL_START_CMD:
-FAIL_UNMAP_STAGE_MEMORY:
-	toy_clear_vulkan_stage_memory(&vk_private->vk_asset_loader);
-FAIL_COPY_TO_STAGE_MEMORY:
-FAIL_MAP_STAGE_MEMORY:
-FAIL_RESET_LOADER:
+FAIL_STAGE:
+	toy_free_unstaged_asset_item(asset_mgr, &asset_mgr->asset_pools.mesh_primitive, primitive_index);
 FAIL_ALLOC_ITEM:
-	toy_free_asset_item(&asset_mgr->asset_pools.mesh_primitive, primitive_index);
+	if (!asset_mgr->upload_batch_open && vk_asset_loader->batch_recording)
+		toy_cancel_vulkan_stage_batch(vk_asset_loader->vk_alc->device, vk_asset_loader);
+FAIL_OPEN_BATCH:
 	return UINT32_MAX;
 }
 
 
-void toy_load_texture2d (
+// Load whole file to left side of cache stack, release it by rolling back left side.
+// File structure is a temporary on right side.
+static void* toy_load_cached_file (
 	toy_asset_manager_t* asset_mgr,
 	const char* utf8_path,
-	toy_asset_pool_item_ref_t* output,
+	size_t* output_size,
 	toy_error_t* error)
 {
-	toy_vulkan_asset_loader_t* vk_asset_loader = &asset_mgr->vk_private.vk_asset_loader;
+	toy_memory_stack_p stack = asset_mgr->cache_stack;
+	const toy_file_interface_t* file_api = &asset_mgr->file_api;
+	toy_memory_stack_marker_t marker_R = toy_get_stack_marker_R(stack);
+
+	void* file = toy_stack_push_R(stack, file_api->file_struct_size, sizeof(void*));
+	if (NULL == file) {
+		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Alloc file structure failed", error);
+		goto FAIL_ALLOC_FILE_STRUCT;
+	}
 
-	size_t size_read;
-	void* file_content = toy_load_whole_file(utf8_path, &asset_mgr->file_api, &asset_mgr->stack_alc_L, &asset_mgr->stack_alc_R, &size_read, error);
+	file_api->open_file(file_api->context, utf8_path, "rb", file, error);
 	if (toy_is_failed(*error))
-		goto FAIL_LOAD_FILE;
+		goto FAIL_OPEN;
 
-	int image_width, image_height, image_component_num;
-	stbi_uc* pixels = stbi_load_from_memory((stbi_uc*)file_content, (int)size_read, &image_width, &image_height, &image_component_num, STBI_rgb_alpha);
-	toy_free_aligned(&asset_mgr->stack_alc_L, file_content);
-	if (NULL == pixels) {
-		toy_err(TOY_ERROR_OPERATION_FAILED, "Decode texture failed", error);
-		goto FAIL_DECODE;
+	size_t file_size = 0;
+	file_api->get_file_size(file, &file_size, error);
+	if (toy_unlikely(toy_is_failed(*error)))
+		goto FAIL_GET_SIZE;
+
+	void* file_content = toy_stack_alloc_aligned_L(stack, file_size, sizeof(uint64_t));
+	if (NULL == file_content) {
+		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Alloc file content failed", error);
+		goto FAIL_ALLOC_CONTENT;
 	}
 
-	size_t image_size = image_width * image_height * sizeof(uint32_t);
+	size_t size_read = 0;
+	file_api->read_file(file, file_content, file_size, &size_read, error);
+	if (toy_is_failed(*error))
+		goto FAIL_READ;
+
+	file_api->close_file(file);
+	toy_rollback_stack_R(stack, marker_R);
+
+	*output_size = size_read;
+	toy_ok(error);
+	return file_content;
+
+FAIL_READ:
+	toy_stack_free_L(stack, file_content);
+FAIL_ALLOC_CONTENT:
+FAIL_GET_SIZE:
+	file_api->close_file(file);
+FAIL_OPEN:
+FAIL_ALLOC_FILE_STRUCT:
+	toy_rollback_stack_R(stack, marker_R);
+	return NULL;
+}
+
+
+// Alloc image item and create its image, free it by toy_free_asset_item()
+static uint32_t alloc_texture2d_item (
+	toy_asset_manager_t* asset_mgr,
+	uint32_t image_width,
+	uint32_t image_height,
+	toy_error_t* error)
+{
+	toy_vulkan_asset_loader_t* vk_asset_loader = &asset_mgr->vk_private.vk_asset_loader;
 
 	uint32_t image_index = toy_alloc_asset_item(&asset_mgr->asset_pools.image, error);
 	if (toy_is_failed(*error))
@@ -422,12 +822,8 @@ void toy_load_texture2d (
 	toy_vulkan_image_t* vk_image = toy_get_asset_item(&asset_mgr->asset_pools.image, image_index);
 	TOY_ASSERT(NULL != vk_image);
 
-	output->pool = &asset_mgr->asset_pools.image;
-	output->index = image_index;
-	output->next_ref = UINT32_MAX;
-
 	toy_create_vulkan_image_texture2d(
-		asset_mgr->vk_private.vk_asset_loader.vk_alc,
+		vk_asset_loader->vk_alc,
 		VK_FORMAT_R8G8B8A8_UNORM,
 		image_width, image_height, 1,
 		vk_image,
@@ -435,86 +831,137 @@ void toy_load_texture2d (
 	if (toy_is_failed(*error))
 		goto FAIL_CREATE_IMAGE;
 
-	toy_reset_vulkan_asset_loader(
-		vk_asset_loader->vk_alc->device,
-		vk_asset_loader,
-		error);
-	if (toy_is_failed(*error))
-		goto FAIL_RESET_LOADER;
+	toy_ok(error);
+	return image_index;
+
+FAIL_CREATE_IMAGE:
+	toy_raw_free_asset_item(&asset_mgr->asset_pools.image, image_index);
+FAIL_ALLOC_ITEM:
+	return UINT32_MAX;
+}
+
+
+// Stage pixels of an image item into the open stage batch, its copy and layout barriers are recorded when batch is submitted.
+// Pixels can be freed after return, item can be sampled after last submit of the batch is finished
+static void toy_stage_texture2d (
+	toy_asset_manager_t* asset_mgr,
+	const void* pixels,
+	uint32_t image_width,
+	uint32_t image_height,
+	uint32_t image_index,
+	toy_error_t* error)
+{
+	toy_vulkan_image_t* vk_image = toy_get_asset_item(&asset_mgr->asset_pools.image, image_index);
+	TOY_ASSERT(NULL != vk_image);
 
-	// Copy data to stage memory
 	toy_stage_data_block_t data_block;
-	toy_vulkan_sub_buffer_t stage_sub_buffer;
 	data_block.data = pixels;
-	data_block.size = image_size;
+	data_block.size = (size_t)image_width * image_height * sizeof(uint32_t);
 	data_block.alignment = sizeof(uint32_t);
 
-	toy_map_vulkan_stage_memory(
-		vk_asset_loader->vk_alc->device,
-		vk_asset_loader,
+	toy_stage_vulkan_image(
+		&asset_mgr->vk_private.vk_asset_loader,
+		&data_block,
+		vk_image,
+		image_width, image_height, 1,
 		error);
+}
+
+
+// Item is staged, return handle of a reference to it, it is tracked by toy_commit_uploaded_asset().
+// Registered by path only, its pixels are on device only and could not be compared on a content hash hit
+static toy_asset_handle_t toy_finish_texture2d (
+	toy_asset_manager_t* asset_mgr,
+	uint32_t image_index,
+	const char* utf8_path)
+{
+	toy_asset_registry_t* registry = &asset_mgr->registry;
+
+	toy_add_asset_ref(&asset_mgr->asset_pools.image, image_index, 1);
+	toy_asset_handle_t handle = toy_get_asset_handle(&asset_mgr->asset_pools.image, image_index);
+	if (!toy_register_asset_path(registry, TOY_ASSET_KIND_IMAGE, utf8_path, handle))
+		toy_log_w("Failed to register texture %s, it will not be shared", utf8_path);
+	return handle;
+}
+
+
+void toy_load_texture2d (
+	toy_asset_manager_t* asset_mgr,
+	const char* utf8_path,
+	toy_asset_handle_t* output,
+	toy_error_t* error)
+{
+	toy_vulkan_asset_loader_t* vk_asset_loader = &asset_mgr->vk_private.vk_asset_loader;
+	toy_asset_registry_t* registry = &asset_mgr->registry;
+	*output = TOY_ASSET_HANDLE_NULL;
+
+	toy_asset_handle_t handle = toy_find_asset_by_path(registry, TOY_ASSET_KIND_IMAGE, utf8_path);
+	if (TOY_ASSET_HANDLE_NULL != handle && toy_ref_registered_asset(handle)) {
+		*output = handle;
+		toy_ok(error);
+		return;
+	}
+
+	toy_memory_stack_marker_t marker_L = toy_get_stack_marker_L(asset_mgr->cache_stack);
+	size_t size_read;
+	void* file_content = toy_load_cached_file(asset_mgr, utf8_path, &size_read, error);
 	if (toy_is_failed(*error))
-		goto FAIL_MAP_STAGE_MEMORY;
+		goto FAIL_LOAD_FILE;
 
-	toy_copy_data_to_vulkan_stage_memory(
-		&data_block, 1,
-		vk_asset_loader,
-		&stage_sub_buffer,
-		error);
+	int image_width, image_height, image_component_num;
+	stbi_uc* pixels = stbi_load_from_memory((stbi_uc*)file_content, (int)size_read, &image_width, &image_height, &image_component_num, STBI_rgb_alpha);
+	toy_rollback_stack_L(asset_mgr->cache_stack, marker_L);
+	if (NULL == pixels) {
+		toy_err(TOY_ERROR_OPERATION_FAILED, "Decode texture failed", error);
+		goto FAIL_DECODE;
+	}
+
+	if (asset_mgr->upload_batch_open) {
+		toy_reserve_asset_upload_batch_item(asset_mgr, error);
+		if (toy_is_failed(*error))
+			goto FAIL_OPEN_BATCH;
+	}
+
+	if (!vk_asset_loader->batch_recording) {
+		toy_open_asset_upload_batch(asset_mgr, error);
+		if (toy_is_failed(*error))
+			goto FAIL_OPEN_BATCH;
+	}
+
+	uint32_t image_index = alloc_texture2d_item(asset_mgr, image_width, image_height, error);
 	if (toy_is_failed(*error))
-		goto FAIL_COPY_TO_STAGE_MEMORY;
+		goto FAIL_ALLOC_ITEM;
 
-	toy_unmap_vulkan_stage_memory(
-		vk_asset_loader->vk_alc->device,
-		vk_asset_loader,
-		error);
+	toy_stage_texture2d(asset_mgr, pixels, image_width, image_height, image_index, error);
 	if (toy_is_failed(*error))
-		goto FAIL_UNMAP_STAGE_MEMORY;
+		goto FAIL_STAGE;
 
 	stbi_image_free(pixels);
 	pixels = NULL;
 
-	// Copy stage memory to gpu local memory
-	VkResult vk_err = toy_start_vkcmd_stage_image(vk_asset_loader);
-	if (VK_SUCCESS != vk_err) {
-		toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "Failed to record vkcmd of staging image", error);
-		goto FAIL_START_CMD;
+	// Out of toy_begin_asset_upload_batch(), a sync load is a batch of its own.
+	// In a batch it is registered at once, so later loads of the batch share it
+	if (asset_mgr->upload_batch_open) {
+		*output = toy_finish_texture2d(asset_mgr, image_index, utf8_path);
+		toy_push_asset_upload_batch_item(asset_mgr, *output, TOY_ASSET_KIND_IMAGE);
 	}
-
-	toy_vkcmd_stage_texture_image(
-		vk_asset_loader, &stage_sub_buffer, vk_image, image_width, image_height, 1);
-
-	toy_submit_vkcmd_stage_image(
-		vk_asset_loader->vk_alc->device, vk_asset_loader, error);
-	if (toy_is_failed(*error))
-		goto FAIL_SUBMIT_CMD;
-
-	vk_err = vkWaitForFences(
-		vk_asset_loader->vk_alc->device,
-		1,
-		&vk_asset_loader->fence,
-		VK_TRUE,
-		UINT64_MAX);
-	if (VK_SUCCESS != vk_err) {
-		toy_err_vkerr(TOY_ERROR_OPERATION_FAILED, vk_err, "Wait for asset loading failed", error);
-		goto FAIL_WAIT_SUBMIT;
+	else {
+		toy_flush_asset_upload_batch(asset_mgr, error);
+		if (toy_is_failed(*error))
+			goto FAIL_STAGE;
+		*output = toy_finish_texture2d(asset_mgr, image_index, utf8_path);
+		toy_commit_uploaded_asset(asset_mgr, *output, TOY_ASSET_KIND_IMAGE);
 	}
 
 	toy_ok(error);
 	return;
 
-FAIL_WAIT_SUBMIT:
-FAIL_SUBMIT_CMD:
-FAIL_START_CMD:
-	toy_clear_vulkan_stage_memory(vk_asset_loader);
-FAIL_UNMAP_STAGE_MEMORY:
-FAIL_COPY_TO_STAGE_MEMORY:
-FAIL_MAP_STAGE_MEMORY:
-FAIL_RESET_LOADER:
-	toy_destroy_vulkan_image(vk_asset_loader->vk_alc->device, vk_image, vk_asset_loader->vk_alc->vk_alc_cb_p);
-FAIL_CREATE_IMAGE:
-	toy_raw_free_asset_item(&asset_mgr->asset_pools.image, image_index);
+FAIL_STAGE:
+	toy_free_unstaged_asset_item(asset_mgr, &asset_mgr->asset_pools.image, image_index);
 FAIL_ALLOC_ITEM:
+	if (!asset_mgr->upload_batch_open && vk_asset_loader->batch_recording)
+		toy_cancel_vulkan_stage_batch(vk_asset_loader->vk_alc->device, vk_asset_loader);
+FAIL_OPEN_BATCH:
 	if (NULL != pixels)
 		stbi_image_free(pixels);
 FAIL_DECODE:
@@ -524,6 +971,539 @@ FAIL_LOAD_FILE:
 }
 
 
+// Worker thread, read only file_api of manager
+static void toy_run_asset_load_request (toy_asset_load_job_t* job)
+{
+	toy_asset_load_request_t* request = (toy_asset_load_request_t*)job;
+	toy_allocator_t std_alc = toy_std_alc();
+
+	if (TOY_ASSET_KIND_MESH_PRIMITIVE == request->kind) {
+		toy_ok(&request->error);
+		return;
+	}
+
+	TOY_ASSERT(TOY_ASSET_KIND_IMAGE == request->kind);
+	size_t size_read = 0;
+	void* file_content = toy_load_whole_file(request->path, &request->asset_mgr->file_api, &std_alc, &std_alc, &size_read, &request->error);
+	if (toy_is_failed(request->error))
+		return;
+
+	int image_component_num;
+	request->pixels = stbi_load_from_memory((stbi_uc*)file_content, (int)size_read, &request->width, &request->height, &image_component_num, STBI_rgb_alpha);
+	toy_free_aligned(&std_alc, file_content);
+	if (NULL == request->pixels) {
+		toy_err(TOY_ERROR_OPERATION_FAILED, "Decode texture failed", &request->error);
+		return;
+	}
+	toy_ok(&request->error);
+}
+
+
+// Request leaves manager, callback is skipped when caller has released it
+static void toy_finish_asset_load (
+	toy_asset_manager_t* asset_mgr,
+	toy_asset_load_request_t* request,
+	enum toy_asset_load_state_t state)
+{
+	toy_asset_pool_t* pool = &asset_mgr->asset_pools.load_request;
+	request->stage = TOY_ASSET_LOAD_STAGE_FINISHED;
+	request->state = state;
+	if (toy_is_failed(request->error))
+		toy_log_error(&request->error);
+
+	toy_asset_load_request_t* follower = request->followers;
+	request->followers = NULL;
+	while (NULL != follower) {
+		toy_asset_load_request_t* next = follower->next;
+		follower->next = NULL;
+		if (TOY_ASSET_LOAD_STATE_DONE == state) {
+			toy_add_asset_handle_ref(request->asset, 1);
+			follower->asset = request->asset;
+		}
+		toy_finish_asset_load(asset_mgr, follower, state);
+		follower = next;
+	}
+
+	if (NULL != request->callback && toy_get_asset_ref(pool, request->index) > 1)
+		request->callback(request->user_data, toy_get_asset_handle(pool, request->index), state, request->asset);
+	toy_release_asset_item(pool, request->index);
+}
+
+
+static void toy_push_asset_upload (toy_asset_manager_t* asset_mgr, toy_asset_load_request_t* request)
+{
+	request->stage = TOY_ASSET_LOAD_STAGE_DECODED;
+	request->next = NULL;
+	if (NULL != asset_mgr->upload_tail)
+		asset_mgr->upload_tail->next = request;
+	else
+		asset_mgr->upload_head = request;
+	asset_mgr->upload_tail = request;
+}
+
+
+static toy_asset_load_request_t* toy_pop_asset_upload (toy_asset_manager_t* asset_mgr)
+{
+	toy_asset_load_request_t* request = asset_mgr->upload_head;
+	if (NULL != request) {
+		asset_mgr->upload_head = request->next;
+		if (NULL == asset_mgr->upload_head)
+			asset_mgr->upload_tail = NULL;
+		request->next = NULL;
+	}
+	return request;
+}
+
+
+static void toy_accept_decoded_asset_load (toy_asset_manager_t* asset_mgr, toy_asset_load_request_t* request)
+{
+	if (toy_is_failed(request->error))
+		toy_finish_asset_load(asset_mgr, request, TOY_ASSET_LOAD_STATE_FAILED);
+	else
+		toy_push_asset_upload(asset_mgr, request);
+}
+
+
+// Same path may have been loaded by a sync load after this one was decoded
+static bool toy_share_loaded_asset (toy_asset_manager_t* asset_mgr, toy_asset_load_request_t* request)
+{
+	if (TOY_ASSET_KIND_IMAGE != request->kind)
+		return false;
+
+	toy_asset_handle_t handle = toy_find_asset_by_path(&asset_mgr->registry, TOY_ASSET_KIND_IMAGE, request->path);
+	if (TOY_ASSET_HANDLE_NULL == handle || !toy_ref_registered_asset(handle))
+		return false;
+
+	request->asset = handle;
+	return true;
+}
+
+
+// Bytes a decoded request takes from stage ring at most, blocks are aligned like toy_stage_texture2d() and toy_stage_mesh_primitive()
+static VkDeviceSize toy_get_asset_load_stage_size (const toy_asset_load_request_t* request)
+{
+	if (TOY_ASSET_KIND_IMAGE == request->kind)
+		return toy_get_vulkan_stage_ring_size((VkDeviceSize)request->width * request->height * sizeof(uint32_t), sizeof(uint32_t));
+
+	const toy_host_mesh_primitive_t* primitive = &request->primitive;
+	VkDeviceSize size = toy_get_vulkan_stage_ring_size(primitive->attribute_size, primitive->attribute_size / primitive->vertex_count);
+	if (NULL != primitive->indices)
+		size += toy_get_vulkan_stage_ring_size(primitive->index_size, primitive->index_count > UINT16_MAX ? sizeof(uint32_t) : sizeof(uint16_t));
+	return size;
+}
+
+
+static toy_asset_pool_t* toy_get_asset_load_pool (toy_asset_manager_t* asset_mgr, const toy_asset_load_request_t* request)
+{
+	if (TOY_ASSET_KIND_IMAGE == request->kind)
+		return &asset_mgr->asset_pools.image;
+	TOY_ASSERT(TOY_ASSET_KIND_MESH_PRIMITIVE == request->kind);
+	return &asset_mgr->asset_pools.mesh_primitive;
+}
+
+
+// Alloc item and stage a decoded request into the open stage batch, return true when it joins the batch.
+// Upload serial of request is the batch holding its last copies. When staging fails after alloc, request joins
+// the batch as failed, so copies of other requests are kept and its item is freed after its own copies.
+// Return false when alloc fails, request is finished
+static bool toy_stage_asset_load (toy_asset_manager_t* asset_mgr, toy_asset_load_request_t* request)
+{
+	toy_vulkan_asset_loader_t* vk_asset_loader = &asset_mgr->vk_private.vk_asset_loader;
+	toy_allocator_t std_alc = toy_std_alc();
+
+	if (TOY_ASSET_KIND_IMAGE == request->kind) {
+		request->asset_index = alloc_texture2d_item(asset_mgr, (uint32_t)request->width, (uint32_t)request->height, &request->error);
+		if (toy_is_failed(request->error))
+			goto FAIL_ALLOC_ITEM;
+
+		toy_stage_texture2d(asset_mgr, request->pixels, (uint32_t)request->width, (uint32_t)request->height, request->asset_index, &request->error);
+		if (toy_is_failed(request->error))
+			goto FAIL_STAGE;
+		stbi_image_free(request->pixels);
+		request->pixels = NULL;
+	}
+	else {
+		TOY_ASSERT(TOY_ASSET_KIND_MESH_PRIMITIVE == request->kind);
+		request->asset_index = alloc_mesh_primitive_item(asset_mgr, &request->primitive, &request->error);
+		if (toy_is_failed(request->error))
+			goto FAIL_ALLOC_ITEM;
+
+		toy_stage_mesh_primitive(asset_mgr, &request->primitive, request->asset_index, &request->error);
+		if (toy_is_failed(request->error))
+			goto FAIL_STAGE;
+		toy_free(&std_alc, request->data);
+		request->data = NULL;
+	}
+
+	request->stage = TOY_ASSET_LOAD_STAGE_UPLOADING;
+	request->upload_serial = vk_asset_loader->submit_serial + 1;
+	return true;
+
+FAIL_STAGE:
+	// Part of the copies may be recorded into the batch, or into a full batch which loader has submitted
+	request->stage = TOY_ASSET_LOAD_STAGE_UPLOADING;
+	request->upload_serial = vk_asset_loader->submit_serial + (vk_asset_loader->batch_recording ? 1 : 0);
+	return true;
+FAIL_ALLOC_ITEM:
+	toy_finish_asset_load(asset_mgr, request, TOY_ASSET_LOAD_STATE_FAILED);
+	return false;
+}
+
+
+static void toy_push_asset_uploading (toy_asset_manager_t* asset_mgr, toy_asset_load_request_t* request)
+{
+	request->next = NULL;
+	if (NULL != asset_mgr->uploading_tail)
+		asset_mgr->uploading_tail->next = request;
+	else
+		asset_mgr->uploading_head = request;
+	asset_mgr->uploading_tail = request;
+}
+
+
+// Finish requests whose submits are finished, uploading FIFO is in serial order
+static void toy_end_asset_uploads (toy_asset_manager_t* asset_mgr, uint64_t complete_serial)
+{
+	while (NULL != asset_mgr->uploading_head && asset_mgr->uploading_head->upload_serial <= complete_serial) {
+		toy_asset_load_request_t* request = asset_mgr->uploading_head;
+		asset_mgr->uploading_head = request->next;
+		if (NULL == asset_mgr->uploading_head)
+			asset_mgr->uploading_tail = NULL;
+
+		TOY_ASSERT(TOY_ASSET_LOAD_STAGE_UPLOADING == request->stage);
+		request->next = NULL;
+		if (toy_is_failed(request->error)) {
+			toy_free_asset_item(toy_get_asset_load_pool(asset_mgr, request), request->asset_index);
+			toy_finish_asset_load(asset_mgr, request, TOY_ASSET_LOAD_STATE_FAILED);
+			continue;
+		}
+		if (TOY_ASSET_KIND_IMAGE == request->kind)
+			request->asset = toy_finish_texture2d(asset_mgr, request->asset_index, request->path);
+		else
+			request->asset = toy_finish_mesh_primitive(asset_mgr, request->asset_index);
+		toy_commit_uploaded_asset(asset_mgr, request->asset, (enum toy_asset_kind_t)request->kind);
+		toy_finish_asset_load(asset_mgr, request, TOY_ASSET_LOAD_STATE_DONE);
+	}
+}
+
+
+// Block until every upload is finished. When the wait fails, submits are not known to be finished,
+// requests are failed rather than handing out assets whose data may be missing
+static void toy_wait_asset_upload (toy_asset_manager_t* asset_mgr)
+{
+	if (NULL == asset_mgr->uploading_tail)
+		return;
+
+	toy_vulkan_asset_loader_t* vk_asset_loader = &asset_mgr->vk_private.vk_asset_loader;
+	toy_error_t err;
+	toy_wait_vulkan_stage_submit(vk_asset_loader->vk_alc->device, vk_asset_loader, asset_mgr->uploading_tail->upload_serial, &err);
+	if (toy_is_failed(err)) {
+		toy_log_error(&err);
+		for (toy_asset_load_request_t* request = asset_mgr->uploading_head; NULL != request; request = request->next) {
+			if (!toy_is_failed(request->error))
+				request->error = err;
+		}
+		toy_end_asset_uploads(asset_mgr, UINT64_MAX);
+		return;
+	}
+	toy_end_asset_uploads(asset_mgr, vk_asset_loader->complete_serial);
+}
+
+
+// Stage decoded requests which fit into free space of stage ring and submit them as one batch
+static void toy_submit_asset_uploads (toy_asset_manager_t* asset_mgr)
+{
+	toy_vulkan_asset_loader_t* vk_asset_loader = &asset_mgr->vk_private.vk_asset_loader;
+	VkDevice dev = vk_asset_loader->vk_alc->device;
+	toy_error_t err;
+
+	toy_begin_vulkan_stage_batch(dev, vk_asset_loader, &err);
+	if (toy_is_failed(err)) {
+		toy_log_error(&err);
+		return;
+	}
+
+	VkDeviceSize ring_space = toy_get_vulkan_stage_ring_space(dev, vk_asset_loader, sizeof(uint32_t));
+	toy_asset_load_request_t* staged_head = NULL;
+	toy_asset_load_request_t* staged_tail = NULL;
+	while (NULL != asset_mgr->upload_head && vk_asset_loader->batch_recording) {
+		toy_asset_load_request_t* request = asset_mgr->upload_head;
+		// Released by caller, nobody waits for it
+		if (TOY_ASSET_HANDLE_NULL == request->asset && NULL == request->followers &&
+			toy_get_asset_ref(&asset_mgr->asset_pools.load_request, request->index) <= 1) {
+			toy_pop_asset_upload(asset_mgr);
+			toy_finish_asset_load(asset_mgr, request, TOY_ASSET_LOAD_STATE_FAILED);
+			continue;
+		}
+		if (TOY_ASSET_HANDLE_NULL != request->asset || toy_share_loaded_asset(asset_mgr, request)) {
+			toy_pop_asset_upload(asset_mgr);
+			toy_finish_asset_load(asset_mgr, request, TOY_ASSET_LOAD_STATE_DONE);
+			continue;
+		}
+
+		// Rest is kept for next frames rather than waiting for submits in flight.
+		// A request larger than the whole ring is split by loader, it is staged only when nothing else uses the ring
+		VkDeviceSize stage_size = toy_get_asset_load_stage_size(request);
+		bool is_ring_idle = NULL == staged_head && vk_asset_loader->complete_serial == vk_asset_loader->submit_serial;
+		if (stage_size > ring_space && !(is_ring_idle && stage_size > vk_asset_loader->stage_buffer.size))
+			break;
+		ring_space = ring_space > stage_size ? ring_space - stage_size : 0;
+
+		toy_pop_asset_upload(asset_mgr);
+		if (toy_stage_asset_load(asset_mgr, request)) {
+			if (NULL != staged_tail)
+				staged_tail->next = request;
+			else
+				staged_head = request;
+			staged_tail = request;
+		}
+	}
+
+	if (NULL == staged_head) {
+		if (vk_asset_loader->batch_recording)
+			toy_cancel_vulkan_stage_batch(dev, vk_asset_loader);
+		return;
+	}
+
+	// Staging submits a full batch and begins next one, recording stops when that fails
+	if (!vk_asset_loader->batch_recording) {
+		toy_err(TOY_ERROR_OPERATION_FAILED, "Stage batch of async loads failed", &err);
+	}
+	else if (toy_is_vulkan_stage_batch_empty(vk_asset_loader)) {
+		toy_cancel_vulkan_stage_batch(dev, vk_asset_loader);
+	}
+	else {
+		toy_submit_vulkan_stage_batch(dev, vk_asset_loader, &err);
+		if (toy_is_failed(err) && vk_asset_loader->batch_recording)
+			toy_cancel_vulkan_stage_batch(dev, vk_asset_loader);
+	}
+
+	// Requests whose batches were submitted are kept, the others lost their copies and are failed.
+	// An empty batch only holds requests which failed to stage, their items are freed without waiting for it
+	toy_asset_load_request_t* request = staged_head;
+	while (NULL != request) {
+		toy_asset_load_request_t* next = request->next;
+		if (request->upload_serial > vk_asset_loader->submit_serial) {
+			if (!toy_is_failed(request->error))
+				request->error = err;
+			request->upload_serial = vk_asset_loader->submit_serial;
+		}
+		toy_push_asset_uploading(asset_mgr, request);
+		request = next;
+	}
+}
+
+
+void toy_update_asset_loads (toy_asset_manager_t* asset_mgr)
+{
+	TOY_ASSERT(NULL != asset_mgr);
+	toy_vulkan_asset_loader_t* vk_asset_loader = &asset_mgr->vk_private.vk_asset_loader;
+	toy_error_t err;
+
+	// Submits are not known to be finished when poll fails, wait for them instead
+	uint64_t complete_serial = toy_poll_vulkan_stage_submits(vk_asset_loader->vk_alc->device, vk_asset_loader, &err);
+	if (toy_is_failed(err)) {
+		toy_log_error(&err);
+		toy_wait_asset_upload(asset_mgr);
+	}
+	else {
+		toy_end_asset_uploads(asset_mgr, complete_serial);
+	}
+
+	toy_asset_load_job_t* job = toy_pop_finished_asset_load_job(asset_mgr->load_queue);
+	while (NULL != job) {
+		toy_accept_decoded_asset_load(asset_mgr, (toy_asset_load_request_t*)job);
+		job = toy_pop_finished_asset_load_job(asset_mgr->load_queue);
+	}
+
+	// Sync loads may be staging into loader. Batches in flight are not waited for,
+	// a new one is begun when a submit slot is free
+	if (NULL != asset_mgr->upload_head && !vk_asset_loader->batch_recording && toy_has_free_vulkan_stage_slot(vk_asset_loader))
+		toy_submit_asset_uploads(asset_mgr);
+}
+
+
+// Load queue is destroyed, requests which are not uploaded fail
+static void toy_drop_asset_loads (toy_asset_manager_t* asset_mgr)
+{
+	toy_asset_load_job_t* job = toy_pop_finished_asset_load_job(asset_mgr->load_queue);
+	while (NULL != job) {
+		toy_accept_decoded_asset_load(asset_mgr, (toy_asset_load_request_t*)job);
+		job = toy_pop_finished_asset_load_job(asset_mgr->load_queue);
+	}
+
+	toy_asset_load_request_t* request = toy_pop_asset_upload(asset_mgr);
+	while (NULL != request) {
+		if (TOY_ASSET_HANDLE_NULL != request->asset) {
+			toy_finish_asset_load(asset_mgr, request, TOY_ASSET_LOAD_STATE_DONE);
+		}
+		else {
+			toy_err(TOY_ERROR_OPERATION_FAILED, "Asset manager is destroyed before upload", &request->error);
+			toy_finish_asset_load(asset_mgr, request, TOY_ASSET_LOAD_STATE_FAILED);
+		}
+		request = toy_pop_asset_upload(asset_mgr);
+	}
+}
+
+
+static toy_asset_load_request_t* toy_alloc_asset_load_request (
+	toy_asset_manager_t* asset_mgr,
+	enum toy_asset_kind_t kind,
+	toy_asset_load_callback_fp callback,
+	void* user_data,
+	toy_error_t* error)
+{
+	toy_asset_pool_t* pool = &asset_mgr->asset_pools.load_request;
+	uint32_t index = toy_alloc_asset_item(pool, error);
+	if (toy_is_failed(*error))
+		return NULL;
+
+	toy_asset_load_request_t* request = toy_get_asset_item(pool, index);
+	memset(request, 0, sizeof(*request));
+	request->job.run_fp = toy_run_asset_load_request;
+	request->asset_mgr = asset_mgr;
+	request->index = index;
+	request->kind = (uint32_t)kind;
+	request->stage = TOY_ASSET_LOAD_STAGE_DECODING;
+	request->state = TOY_ASSET_LOAD_STATE_PENDING;
+	request->callback = callback;
+	request->user_data = user_data;
+	request->asset = TOY_ASSET_HANDLE_NULL;
+	toy_ok(&request->error);
+	// One for caller, one for manager until load finishes
+	toy_add_asset_ref(pool, index, 2);
+	return request;
+}
+
+
+toy_asset_handle_t toy_load_texture2d_async (
+	toy_asset_manager_t* asset_mgr,
+	const char* utf8_path,
+	toy_asset_load_callback_fp callback,
+	void* user_data,
+	toy_error_t* error)
+{
+	TOY_ASSERT(NULL != asset_mgr && NULL != utf8_path);
+	toy_allocator_t std_alc = toy_std_alc();
+
+	toy_asset_load_request_t* request = toy_alloc_asset_load_request(asset_mgr, TOY_ASSET_KIND_IMAGE, callback, user_data, error);
+	if (NULL == request)
+		return TOY_ASSET_HANDLE_NULL;
+	toy_asset_handle_t load = toy_get_asset_handle(&asset_mgr->asset_pools.load_request, request->index);
+
+	size_t path_size = strlen(utf8_path) + 1;
+	request->path = toy_alloc(&std_alc, path_size);
+	if (NULL == request->path) {
+		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Failed to alloc path of async load", error);
+		toy_sub_asset_ref(&asset_mgr->asset_pools.load_request, request->index, 1);
+		toy_release_asset_item(&asset_mgr->asset_pools.load_request, request->index);
+		return TOY_ASSET_HANDLE_NULL;
+	}
+	memcpy(request->path, utf8_path, path_size);
+
+	// Loaded one is finished by next toy_update_asset_loads(), so callback is never called inside this function
+	toy_asset_handle_t handle = toy_find_asset_by_path(&asset_mgr->registry, TOY_ASSET_KIND_IMAGE, utf8_path);
+	if (TOY_ASSET_HANDLE_NULL != handle && toy_ref_registered_asset(handle)) {
+		request->asset = handle;
+		toy_push_asset_upload(asset_mgr, request);
+		toy_ok(error);
+		return load;
+	}
+
+	// Path is registered as image only when upload ends, a pending load of it is found by its load path
+	toy_asset_handle_t pending_load = toy_find_asset_by_path(&asset_mgr->registry, TOY_ASSET_KIND_IMAGE_LOAD, utf8_path);
+	toy_asset_load_request_t* leader = TOY_ASSET_HANDLE_NULL != pending_load ? toy_resolve_asset_handle(pending_load) : NULL;
+	if (NULL != leader && TOY_ASSET_LOAD_STAGE_FINISHED != leader->stage) {
+		request->stage = TOY_ASSET_LOAD_STAGE_FOLLOWING;
+		request->next = leader->followers;
+		leader->followers = request;
+	}
+	else {
+		if (!toy_register_asset_path(&asset_mgr->registry, TOY_ASSET_KIND_IMAGE_LOAD, utf8_path, load))
+			toy_log_w("Failed to register path of async load, loads of the same path will read it again");
+		toy_push_asset_load_job(asset_mgr->load_queue, &request->job);
+	}
+
+	toy_ok(error);
+	return load;
+}
+
+
+toy_asset_handle_t toy_load_mesh_primitive_async (
+	toy_asset_manager_t* asset_mgr,
+	const toy_host_mesh_primitive_t* primitive_data,
+	toy_asset_load_callback_fp callback,
+	void* user_data,
+	toy_error_t* error)
+{
+	TOY_ASSERT(NULL != asset_mgr && NULL != primitive_data);
+	toy_allocator_t std_alc = toy_std_alc();
+
+	toy_asset_load_request_t* request = toy_alloc_asset_load_request(asset_mgr, TOY_ASSET_KIND_MESH_PRIMITIVE, callback, user_data, error);
+	if (NULL == request)
+		return TOY_ASSET_HANDLE_NULL;
+	toy_asset_handle_t load = toy_get_asset_handle(&asset_mgr->asset_pools.load_request, request->index);
+
+	// Indices follow attributes, aligned for uint32 indices
+	size_t index_offset = (primitive_data->attribute_size + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+	size_t index_size = NULL != primitive_data->indices ? primitive_data->index_size : 0;
+	request->data = toy_alloc(&std_alc, index_offset + index_size);
+	if (NULL == request->data) {
+		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Failed to alloc data of async load", error);
+		toy_sub_asset_ref(&asset_mgr->asset_pools.load_request, request->index, 1);
+		toy_release_asset_item(&asset_mgr->asset_pools.load_request, request->index);
+		return TOY_ASSET_HANDLE_NULL;
+	}
+	memcpy(request->data, primitive_data->attributes, primitive_data->attribute_size);
+	if (index_size > 0)
+		memcpy((uint8_t*)request->data + index_offset, primitive_data->indices, index_size);
+
+	request->primitive = *primitive_data;
+	request->primitive.attributes = request->data;
+	request->primitive.indices = index_size > 0 ? (uint8_t*)request->data + index_offset : NULL;
+	request->primitive.attr_desc = NULL;
+	toy_push_asset_load_job(asset_mgr->load_queue, &request->job);
+
+	toy_ok(error);
+	return load;
+}
+
+
+enum toy_asset_load_state_t toy_get_asset_load_state (
+	toy_asset_manager_t* asset_mgr,
+	toy_asset_handle_t load,
+	toy_asset_handle_t* output_asset)
+{
+	TOY_ASSERT(NULL != asset_mgr);
+	TOY_ASSERT(toy_is_asset_load_valid(asset_mgr, load) && "Stale asset load handle");
+	toy_asset_load_request_t* request = toy_resolve_asset_handle(load);
+
+	if (NULL != output_asset)
+		*output_asset = TOY_ASSET_LOAD_STATE_DONE == request->state ? request->asset : TOY_ASSET_HANDLE_NULL;
+	return request->state;
+}
+
+
+void toy_release_asset_load (toy_asset_manager_t* asset_mgr, toy_asset_handle_t load)
+{
+	TOY_ASSERT(NULL != asset_mgr);
+	TOY_ASSERT(toy_is_asset_load_valid(asset_mgr, load) && "Stale asset load handle");
+	toy_asset_load_request_t* request = toy_resolve_asset_handle(load);
+	request->is_released = true;
+	toy_release_asset_handle(load);
+}
+
+
+bool toy_is_asset_load_valid (toy_asset_manager_t* asset_mgr, toy_asset_handle_t load)
+{
+	TOY_ASSERT(NULL != asset_mgr);
+	if (toy_get_asset_handle_pool(load) != &asset_mgr->asset_pools.load_request)
+		return false;
+	toy_asset_load_request_t* request = toy_resolve_asset_handle(load);
+	return NULL != request && !request->is_released;
+}
+
+
 uint32_t toy_alloc_material (
 	toy_asset_manager_t* asset_mgr,
 	size_t size,
@@ -533,7 +1513,10 @@ uint32_t toy_alloc_material (
 	if (toy_is_failed(*error))
 		return UINT32_MAX;
 
-	void* data = toy_alloc_aligned(&asset_mgr->alc->list_alc, size, sizeof(void*));
+	// Descriptor set data is small, slab aligns it natively, destroy_material() frees it through the same allocator
+	TOY_ASSERT(size <= TOY_MEMORY_SLAB_MAX_SIZE);
+	toy_allocator_t material_alc = toy_get_tagged_allocator(asset_mgr->alc, &asset_mgr->alc->small_alc, TOY_MEMORY_TAG_ASSET);
+	void* data = toy_alloc_aligned(&material_alc, size, sizeof(void*));
 	if (NULL == data) {
 		toy_raw_free_asset_item(&asset_mgr->asset_pools.material, index);
 		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Alloc material failed", error);
@@ -547,19 +1530,84 @@ uint32_t toy_alloc_material (
 }
 
 
-toy_asset_pool_item_ref_t toy_create_image_sampler (
+uint32_t toy_share_material (
+	toy_asset_manager_t* asset_mgr,
+	uint32_t material_index,
+	size_t size,
+	toy_error_t* error)
+{
+	toy_asset_pool_t* pool = &asset_mgr->asset_pools.material;
+	void* data = *(void**)toy_get_asset_item(pool, material_index);
+	uint64_t content_hash = toy_hash_asset_content(data, size, 0);
+
+	// Compare data, a material differs from another one only in a few handles
+	toy_asset_handle_t handle = toy_find_asset_by_content(&asset_mgr->registry, TOY_ASSET_KIND_MATERIAL, content_hash);
+	// Shared one is referenced before its data is read, so it is not freed meanwhile
+	if (TOY_ASSET_HANDLE_NULL != handle && toy_get_asset_handle_index(handle) != material_index && toy_ref_registered_asset(handle)) {
+		if (0 == memcmp(*(void**)toy_resolve_asset_handle(handle), data, size)) {
+			toy_free_asset_item(pool, material_index);
+			toy_ok(error);
+			return toy_get_asset_handle_index(handle);
+		}
+		toy_release_asset_handle(handle);
+	}
+
+	toy_add_asset_ref(pool, material_index, 1);
+	if (!toy_register_asset_content(&asset_mgr->registry, TOY_ASSET_KIND_MATERIAL, content_hash, toy_get_asset_handle(pool, material_index)))
+		toy_log_w("Failed to register material, it will not be shared");
+	toy_ok(error);
+	return material_index;
+}
+
+
+void toy_set_mesh_residency_priority (
+	toy_asset_manager_t* asset_mgr,
+	uint32_t mesh_index,
+	float priority)
+{
+	TOY_ASSERT(NULL != asset_mgr);
+	toy_mesh_t* mesh = toy_get_asset_item(&asset_mgr->asset_pools.mesh, mesh_index);
+	TOY_ASSERT(NULL != mesh);
+	if (UINT32_MAX != mesh->primitive_index) {
+		toy_set_asset_residency_priority(asset_mgr->residency,
+			toy_get_asset_handle(&asset_mgr->asset_pools.mesh_primitive, mesh->primitive_index), priority);
+	}
+	if (UINT32_MAX == mesh->material_index)
+		return;
+
+	// Image handles of material are laid out as toy_update_vulkan_descriptor_set() reads them
+	toy_vulkan_descriptor_set_data_header_t* material = *(toy_vulkan_descriptor_set_data_header_t**)toy_get_asset_item(
+		&asset_mgr->asset_pools.material, mesh->material_index);
+	const toy_vulkan_descriptor_set_layout_t* desc_set_layout = material->desc_set_layout;
+	for (uint32_t i = 0; i < desc_set_layout->binding_count; ++i) {
+		if (VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER != desc_set_layout->layout_bindings[i].descriptorType)
+			continue;
+		const toy_asset_handle_t* image_handle = (const toy_asset_handle_t*)((uintptr_t)material + material->bindings[i].offset);
+		toy_set_asset_residency_priority(asset_mgr->residency, image_handle[0], priority);
+	}
+}
+
+
+toy_asset_handle_t toy_create_image_sampler (
 	toy_asset_manager_t* asset_mgr,
 	toy_image_sampler_t* sampler_params,
 	toy_error_t* error)
 {
-	toy_asset_pool_item_ref_t ref;
-	ref.pool = NULL;
-	ref.index = UINT32_MAX;
-	ref.next_ref = UINT32_MAX;
+	// Driver limits count of samplers, VkPhysicalDeviceLimits::maxSamplerAllocationCount
+	uint64_t content_hash = toy_hash_asset_content(sampler_params, sizeof(*sampler_params), 0);
+	toy_asset_handle_t handle = toy_find_asset_by_content(&asset_mgr->registry, TOY_ASSET_KIND_IMAGE_SAMPLER, content_hash);
+	if (TOY_ASSET_HANDLE_NULL != handle && toy_ref_registered_asset(handle)) {
+		toy_vulkan_sampler_t* shared_sampler = toy_resolve_asset_handle(handle);
+		if (0 == memcmp(&shared_sampler->params, sampler_params, sizeof(*sampler_params))) {
+			toy_ok(error);
+			return handle;
+		}
+		toy_release_asset_handle(handle);
+	}
 
 	uint32_t index = toy_alloc_asset_item(&asset_mgr->asset_pools.image_sampler, error);
 	if (toy_is_failed(*error))
-		return ref;
+		return TOY_ASSET_HANDLE_NULL;
 	
 	toy_vulkan_sampler_t* vk_sampler = toy_get_asset_item(&asset_mgr->asset_pools.image_sampler, index);
 	TOY_ASSERT(NULL != vk_sampler);
@@ -571,13 +1619,65 @@ toy_asset_pool_item_ref_t toy_create_image_sampler (
 		asset_mgr->vk_private.vk_driver->vk_alc_cb_p,
 		&vk_sampler->handle);
 	if (VK_SUCCESS != vk_err) {
+		toy_raw_free_asset_item(&asset_mgr->asset_pools.image_sampler, index);
 		toy_err(TOY_ERROR_CREATE_OBJECT_FAILED, "toy_create_vulkan_image_sampler failed", error);
-		return ref;
+		return TOY_ASSET_HANDLE_NULL;
 	}
 
-	ref.pool = &asset_mgr->asset_pools.image_sampler;
-	ref.index = index;
-
+	toy_add_asset_ref(&asset_mgr->asset_pools.image_sampler, index, 1);
+	handle = toy_get_asset_handle(&asset_mgr->asset_pools.image_sampler, index);
+	if (!toy_register_asset_content(&asset_mgr->registry, TOY_ASSET_KIND_IMAGE_SAMPLER, content_hash, handle))
+		toy_log_w("Failed to register image sampler, it will not be shared");
 	toy_ok(error);
-	return ref;
+	return handle;
+}
+
+
+void toy_mark_asset_manager_frame (toy_asset_manager_t* asset_mgr)
+{
+	TOY_ASSERT(NULL != asset_mgr);
+
+	for (uint32_t i = 0; i < asset_mgr->pool_count; ++i) {
+		toy_asset_pool_stats_t stats;
+		toy_get_asset_pool_stats(asset_mgr->pools[i], &stats);
+		toy_asset_pool_telemetry_t* telemetry = &asset_mgr->telemetry[i];
+		telemetry->frame_alloc_count = (uint32_t)(stats.alloc_count - telemetry->alloc_count);
+		telemetry->frame_free_count = (uint32_t)(stats.free_count - telemetry->free_count);
+		telemetry->alloc_count = stats.alloc_count;
+		telemetry->free_count = stats.free_count;
+		telemetry->alloc_rate += ((float)telemetry->frame_alloc_count - telemetry->alloc_rate) * TOY_ASSET_TELEMETRY_RATE_WEIGHT;
+		telemetry->free_rate += ((float)telemetry->frame_free_count - telemetry->free_rate) * TOY_ASSET_TELEMETRY_RATE_WEIGHT;
+	}
+}
+
+
+uint32_t toy_get_asset_manager_stats (
+	toy_asset_manager_t* asset_mgr,
+	toy_asset_manager_pool_stats_t output[TOY_ASSET_MANAGER_POOL_MAX])
+{
+	TOY_ASSERT(NULL != asset_mgr && NULL != output);
+
+	for (uint32_t i = 0; i < asset_mgr->pool_count; ++i) {
+		toy_asset_pool_p pool = asset_mgr->pools[i];
+		const toy_asset_pool_telemetry_t* telemetry = &asset_mgr->telemetry[i];
+		output[i].name = NULL != pool->literal_name ? pool->literal_name : "";
+		toy_get_asset_pool_stats(pool, &output[i].pool);
+		output[i].frame_alloc_count = telemetry->frame_alloc_count;
+		output[i].frame_free_count = telemetry->frame_free_count;
+		output[i].alloc_rate = telemetry->alloc_rate;
+		output[i].free_rate = telemetry->free_rate;
+	}
+	return asset_mgr->pool_count;
+}
+
+
+void toy_log_asset_manager_stats (toy_asset_manager_t* asset_mgr)
+{
+	toy_asset_manager_pool_stats_t stats[TOY_ASSET_MANAGER_POOL_MAX];
+	uint32_t count = toy_get_asset_manager_stats(asset_mgr, stats);
+	for (uint32_t i = 0; i < count; ++i) {
+		toy_log_i("[asset] %s: live %u, chunks %u, used %zu bytes, reserved %zu bytes, fragmentation %.2f, alloc %.2f/frame, free %.2f/frame",
+			stats[i].name, stats[i].pool.live_count, stats[i].pool.chunk_count, stats[i].pool.used_bytes, stats[i].pool.reserved_bytes,
+			stats[i].pool.fragmentation, stats[i].alloc_rate, stats[i].free_rate);
+	}
 }
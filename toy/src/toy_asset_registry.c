@@ -0,0 +1,315 @@
+#include "include/toy_asset_registry.h"
+
+#include "toy_assert.h"
+#include <string.h>
+
+
+#define TOY_ASSET_REGISTRY_EMPTY UINT64_C(0)
+#define TOY_ASSET_REGISTRY_HASH_M UINT64_C(0x9E3779B97F4A7C15)
+
+
+static toy_inline uint64_t toy_mix_asset_hash (uint64_t h)
+{
+	h ^= h >> 32;
+	h *= TOY_ASSET_REGISTRY_HASH_M;
+	h ^= h >> 29;
+	return h;
+}
+
+
+uint64_t toy_hash_asset_content (const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* p = (const uint8_t*)data;
+	uint64_t h = seed ^ ((uint64_t)size * TOY_ASSET_REGISTRY_HASH_M);
+
+	// 8 bytes per step, data may be unaligned
+	while (size >= sizeof(uint64_t)) {
+		uint64_t v;
+		memcpy(&v, p, sizeof(v));
+		h = (h ^ toy_mix_asset_hash(v)) * TOY_ASSET_REGISTRY_HASH_M;
+		p += sizeof(uint64_t);
+		size -= sizeof(uint64_t);
+	}
+	uint64_t tail = 0;
+	for (size_t i = 0; i < size; ++i)
+		tail |= (uint64_t)p[i] << (i * 8);
+	h = (h ^ toy_mix_asset_hash(tail)) * TOY_ASSET_REGISTRY_HASH_M;
+
+	return toy_mix_asset_hash(h);
+}
+
+
+// Never TOY_ASSET_REGISTRY_EMPTY
+static toy_inline uint64_t toy_get_asset_registry_key_hash (uint64_t key_hash, enum toy_asset_kind_t kind, bool is_path)
+{
+	uint64_t h = toy_mix_asset_hash(key_hash ^ ((uint64_t)kind << 1 | (is_path ? 1 : 0)) * TOY_ASSET_REGISTRY_HASH_M);
+	return TOY_ASSET_REGISTRY_EMPTY != h ? h : 1;
+}
+
+
+static toy_inline bool toy_is_asset_registry_entry_key (
+	const toy_asset_registry_entry_t* entry,
+	uint64_t hash,
+	enum toy_asset_kind_t kind,
+	const char* utf8_path,
+	uint64_t content_hash)
+{
+	if (entry->hash != hash || entry->kind != (uint32_t)kind)
+		return false;
+	if (NULL != utf8_path)
+		return NULL != entry->path && 0 == strcmp(entry->path, utf8_path);
+	return NULL == entry->path && entry->content_hash == content_hash;
+}
+
+
+void toy_create_asset_registry (
+	const toy_allocator_t* alc,
+	toy_asset_registry_t* output,
+	toy_error_t* error)
+{
+	TOY_ASSERT(NULL != alc && NULL != output);
+
+	output->entries = (toy_asset_registry_entry_t*)toy_alloc(alc, sizeof(toy_asset_registry_entry_t) * TOY_ASSET_REGISTRY_MIN_CAPACITY);
+	if (NULL == output->entries) {
+		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Failed to alloc asset registry", error);
+		return;
+	}
+	for (uint32_t i = 0; i < TOY_ASSET_REGISTRY_MIN_CAPACITY; ++i)
+		output->entries[i].hash = TOY_ASSET_REGISTRY_EMPTY;
+	output->capacity = TOY_ASSET_REGISTRY_MIN_CAPACITY;
+	output->used_count = 0;
+	output->strings = NULL;
+	output->alc = *alc;
+	toy_ok(error);
+}
+
+
+static void toy_free_asset_registry_strings (toy_asset_registry_t* registry, toy_asset_registry_string_block_t* block)
+{
+	while (NULL != block) {
+		toy_asset_registry_string_block_t* next = block->next;
+		toy_free(&registry->alc, block);
+		block = next;
+	}
+}
+
+
+void toy_destroy_asset_registry (toy_asset_registry_t* registry)
+{
+	TOY_ASSERT(NULL != registry);
+
+	toy_free_asset_registry_strings(registry, registry->strings);
+	registry->strings = NULL;
+
+	toy_free(&registry->alc, registry->entries);
+	registry->entries = NULL;
+	registry->capacity = 0;
+	registry->used_count = 0;
+}
+
+
+// Copy path to the first block of strings, add a block when it is full
+static const char* toy_intern_asset_registry_path (
+	toy_asset_registry_t* registry,
+	toy_asset_registry_string_block_t** strings,
+	const char* utf8_path)
+{
+	size_t size = strlen(utf8_path) + 1;
+	toy_asset_registry_string_block_t* block = *strings;
+	if (NULL == block || block->size - block->used < size) {
+		size_t block_size = size > TOY_ASSET_REGISTRY_STRING_BLOCK_SIZE ? size : TOY_ASSET_REGISTRY_STRING_BLOCK_SIZE;
+		block = (toy_asset_registry_string_block_t*)toy_alloc(&registry->alc, sizeof(toy_asset_registry_string_block_t) + block_size);
+		if (NULL == block)
+			return NULL;
+		block->next = *strings;
+		block->used = 0;
+		block->size = block_size;
+		*strings = block;
+	}
+
+	char* ret = (char*)(block + 1) + block->used;
+	memcpy(ret, utf8_path, size);
+	block->used += size;
+	return ret;
+}
+
+
+// Entries of freed items are dropped, paths of live entries are copied to new string blocks and old blocks are freed,
+// so strings of dropped entries are reclaimed
+static bool toy_rehash_asset_registry (toy_asset_registry_t* registry)
+{
+	uint32_t live_count = 0;
+	for (uint32_t i = 0; i < registry->capacity; ++i) {
+		toy_asset_registry_entry_t* entry = &registry->entries[i];
+		if (TOY_ASSET_REGISTRY_EMPTY != entry->hash && NULL != toy_resolve_asset_handle(entry->handle))
+			++live_count;
+	}
+	uint32_t capacity = TOY_ASSET_REGISTRY_MIN_CAPACITY;
+	while ((live_count + 1) * 4 > capacity)
+		capacity *= 2;
+
+	toy_asset_registry_entry_t* entries = (toy_asset_registry_entry_t*)toy_alloc(&registry->alc, sizeof(toy_asset_registry_entry_t) * capacity);
+	if (NULL == entries)
+		return false;
+	for (uint32_t i = 0; i < capacity; ++i)
+		entries[i].hash = TOY_ASSET_REGISTRY_EMPTY;
+
+	toy_asset_registry_string_block_t* strings = NULL;
+	for (uint32_t i = 0; i < registry->capacity; ++i) {
+		toy_asset_registry_entry_t* entry = &registry->entries[i];
+		if (TOY_ASSET_REGISTRY_EMPTY == entry->hash || NULL == toy_resolve_asset_handle(entry->handle))
+			continue;
+		uint32_t index = (uint32_t)entry->hash & (capacity - 1);
+		while (TOY_ASSET_REGISTRY_EMPTY != entries[index].hash)
+			index = (index + 1) & (capacity - 1);
+		entries[index] = *entry;
+		if (NULL != entry->path) {
+			entries[index].path = toy_intern_asset_registry_path(registry, &strings, entry->path);
+			if (NULL == entries[index].path) {
+				toy_free_asset_registry_strings(registry, strings);
+				toy_free(&registry->alc, entries);
+				return false;
+			}
+		}
+	}
+
+	toy_free_asset_registry_strings(registry, registry->strings);
+	registry->strings = strings;
+	toy_free(&registry->alc, registry->entries);
+	registry->entries = entries;
+	registry->capacity = capacity;
+	registry->used_count = live_count;
+	return true;
+}
+
+
+static toy_asset_registry_entry_t* toy_find_asset_registry_entry (
+	toy_asset_registry_t* registry,
+	uint64_t hash,
+	enum toy_asset_kind_t kind,
+	const char* utf8_path,
+	uint64_t content_hash)
+{
+	uint32_t index = (uint32_t)hash & (registry->capacity - 1);
+	while (TOY_ASSET_REGISTRY_EMPTY != registry->entries[index].hash) {
+		toy_asset_registry_entry_t* entry = &registry->entries[index];
+		if (toy_is_asset_registry_entry_key(entry, hash, kind, utf8_path, content_hash))
+			return entry;
+		index = (index + 1) & (registry->capacity - 1);
+	}
+	return NULL;
+}
+
+
+static toy_asset_handle_t toy_find_asset (
+	toy_asset_registry_t* registry,
+	enum toy_asset_kind_t kind,
+	const char* utf8_path,
+	uint64_t content_hash)
+{
+	uint64_t key_hash = NULL != utf8_path ? toy_hash_asset_content(utf8_path, strlen(utf8_path), 0) : content_hash;
+	uint64_t hash = toy_get_asset_registry_key_hash(key_hash, kind, NULL != utf8_path);
+	toy_asset_registry_entry_t* entry = toy_find_asset_registry_entry(registry, hash, kind, utf8_path, content_hash);
+	if (NULL == entry || NULL == toy_resolve_asset_handle(entry->handle))
+		return TOY_ASSET_HANDLE_NULL;
+	return entry->handle;
+}
+
+
+static bool toy_register_asset (
+	toy_asset_registry_t* registry,
+	enum toy_asset_kind_t kind,
+	const char* utf8_path,
+	uint64_t content_hash,
+	toy_asset_handle_t handle)
+{
+	TOY_ASSERT(TOY_ASSET_HANDLE_NULL != handle);
+	uint64_t key_hash = NULL != utf8_path ? toy_hash_asset_content(utf8_path, strlen(utf8_path), 0) : content_hash;
+	uint64_t hash = toy_get_asset_registry_key_hash(key_hash, kind, NULL != utf8_path);
+
+	toy_asset_registry_entry_t* entry = toy_find_asset_registry_entry(registry, hash, kind, utf8_path, content_hash);
+	if (NULL != entry) {
+		entry->handle = handle;
+		return true;
+	}
+
+	// Keep load factor under 1/2, entries of freed items are dropped by rehash
+	if ((registry->used_count + 1) * 2 > registry->capacity && !toy_rehash_asset_registry(registry))
+		return false;
+
+	const char* path = NULL;
+	if (NULL != utf8_path) {
+		path = toy_intern_asset_registry_path(registry, &registry->strings, utf8_path);
+		if (NULL == path)
+			return false;
+	}
+
+	uint32_t index = (uint32_t)hash & (registry->capacity - 1);
+	while (TOY_ASSET_REGISTRY_EMPTY != registry->entries[index].hash)
+		index = (index + 1) & (registry->capacity - 1);
+	entry = &registry->entries[index];
+	++(registry->used_count);
+
+	entry->hash = hash;
+	entry->content_hash = content_hash;
+	entry->path = path;
+	entry->handle = handle;
+	entry->kind = (uint32_t)kind;
+	return true;
+}
+
+
+toy_asset_handle_t toy_find_asset_by_path (
+	toy_asset_registry_t* registry,
+	enum toy_asset_kind_t kind,
+	const char* utf8_path)
+{
+	TOY_ASSERT(NULL != registry && NULL != utf8_path);
+	return toy_find_asset(registry, kind, utf8_path, 0);
+}
+
+
+toy_asset_handle_t toy_find_asset_by_content (
+	toy_asset_registry_t* registry,
+	enum toy_asset_kind_t kind,
+	uint64_t content_hash)
+{
+	TOY_ASSERT(NULL != registry);
+	return toy_find_asset(registry, kind, NULL, content_hash);
+}
+
+
+bool toy_register_asset_path (
+	toy_asset_registry_t* registry,
+	enum toy_asset_kind_t kind,
+	const char* utf8_path,
+	toy_asset_handle_t handle)
+{
+	TOY_ASSERT(NULL != registry && NULL != utf8_path);
+	return toy_register_asset(registry, kind, utf8_path, 0, handle);
+}
+
+
+bool toy_register_asset_content (
+	toy_asset_registry_t* registry,
+	enum toy_asset_kind_t kind,
+	uint64_t content_hash,
+	toy_asset_handle_t handle)
+{
+	TOY_ASSERT(NULL != registry);
+	return toy_register_asset(registry, kind, NULL, content_hash, handle);
+}
+
+
+void toy_unregister_asset (
+	toy_asset_registry_t* registry,
+	toy_asset_handle_t handle)
+{
+	TOY_ASSERT(NULL != registry && TOY_ASSET_HANDLE_NULL != handle);
+	// Entries keep their slots for probing, rehash drops them like entries of freed items
+	for (uint32_t i = 0; i < registry->capacity; ++i) {
+		toy_asset_registry_entry_t* entry = &registry->entries[i];
+		if (TOY_ASSET_REGISTRY_EMPTY != entry->hash && handle == entry->handle)
+			entry->handle = TOY_ASSET_HANDLE_NULL;
+	}
+}
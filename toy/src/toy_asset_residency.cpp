@@ -0,0 +1,436 @@
+#include "include/toy_asset_residency.h"
+
+#include "toy_assert.h"
+#include <cstring>
+#include <mutex>
+#include <new>
+
+
+#define TOY_ASSET_RESIDENCY_NONE UINT32_MAX // End of a list, or an empty slot of map
+
+typedef struct toy_asset_residency_node_t {
+	toy_asset_handle_t handle;
+	uint32_t prev; // LRU list, the head is the most recently released
+	uint32_t next; // Next free node when node is free
+	bool is_cached;
+	float priority;
+	size_t host_bytes;
+	size_t device_bytes;
+}toy_asset_residency_node_t;
+
+// Nodes of tracked items, map is open addressing from handle to node index
+struct toy_asset_residency_t {
+	std::mutex lock;
+	toy_asset_residency_node_t* nodes;
+	uint32_t node_capacity;
+	uint32_t free_node;
+	uint32_t* map;
+	uint32_t map_capacity; // 2^N, at least twice of node_capacity
+	uint32_t lru_head;
+	uint32_t lru_tail;
+	toy_asset_residency_budget_t budget;
+	toy_asset_residency_stats_t pool_stats[TOY_ASSET_POOL_MAX_COUNT];
+	toy_asset_residency_stats_t total_stats;
+	toy_allocator_t alc;
+};
+
+
+static toy_inline uint32_t toy_get_asset_residency_pool_id (toy_asset_handle_t handle)
+{
+	return handle >> (TOY_ASSET_HANDLE_INDEX_BITS + TOY_ASSET_HANDLE_GENERATION_BITS);
+}
+
+
+static toy_inline uint32_t toy_get_asset_residency_slot (toy_asset_residency_p residency, toy_asset_handle_t handle)
+{
+	return (uint32_t)(((uint64_t)handle * 0x9E3779B97F4A7C15ull) >> 32) & (residency->map_capacity - 1);
+}
+
+
+static uint32_t toy_find_asset_residency_slot (toy_asset_residency_p residency, toy_asset_handle_t handle)
+{
+	uint32_t slot = toy_get_asset_residency_slot(residency, handle);
+	while (TOY_ASSET_RESIDENCY_NONE != residency->map[slot]) {
+		if (residency->nodes[residency->map[slot]].handle == handle)
+			return slot;
+		slot = (slot + 1) & (residency->map_capacity - 1);
+	}
+	return TOY_ASSET_RESIDENCY_NONE;
+}
+
+
+static void toy_insert_asset_residency_slot (toy_asset_residency_p residency, uint32_t node_index)
+{
+	uint32_t slot = toy_get_asset_residency_slot(residency, residency->nodes[node_index].handle);
+	while (TOY_ASSET_RESIDENCY_NONE != residency->map[slot])
+		slot = (slot + 1) & (residency->map_capacity - 1);
+	residency->map[slot] = node_index;
+}
+
+
+// Backward shift deletion keeps probe sequences without tombstones
+static void toy_remove_asset_residency_slot (toy_asset_residency_p residency, uint32_t slot)
+{
+	uint32_t mask = residency->map_capacity - 1;
+	uint32_t hole = slot;
+	uint32_t next = (slot + 1) & mask;
+	while (TOY_ASSET_RESIDENCY_NONE != residency->map[next]) {
+		uint32_t home = toy_get_asset_residency_slot(residency, residency->nodes[residency->map[next]].handle);
+		// Move entry back when its home is not in (hole, next]
+		if (((next - home) & mask) >= ((next - hole) & mask)) {
+			residency->map[hole] = residency->map[next];
+			hole = next;
+		}
+		next = (next + 1) & mask;
+	}
+	residency->map[hole] = TOY_ASSET_RESIDENCY_NONE;
+}
+
+
+static bool toy_grow_asset_residency (toy_asset_residency_p residency)
+{
+	uint32_t node_capacity = residency->node_capacity * 2;
+	toy_asset_residency_node_t* nodes = (toy_asset_residency_node_t*)toy_realloc(&residency->alc, residency->nodes,
+		sizeof(toy_asset_residency_node_t) * residency->node_capacity, sizeof(toy_asset_residency_node_t) * node_capacity);
+	if (NULL == nodes)
+		return false;
+	residency->nodes = nodes;
+
+	uint32_t map_capacity = node_capacity * 2;
+	uint32_t* map = (uint32_t*)toy_alloc(&residency->alc, sizeof(uint32_t) * map_capacity);
+	if (NULL == map)
+		return false; // Nodes are bigger but not used, try again next time
+
+	for (uint32_t i = residency->node_capacity; i < node_capacity - 1; ++i)
+		nodes[i].next = i + 1;
+	nodes[node_capacity - 1].next = residency->free_node;
+	residency->free_node = residency->node_capacity;
+
+	for (uint32_t i = 0; i < map_capacity; ++i)
+		map[i] = TOY_ASSET_RESIDENCY_NONE;
+	uint32_t* old_map = residency->map;
+	uint32_t old_map_capacity = residency->map_capacity;
+	residency->map = map;
+	residency->map_capacity = map_capacity;
+	for (uint32_t i = 0; i < old_map_capacity; ++i) {
+		if (TOY_ASSET_RESIDENCY_NONE != old_map[i])
+			toy_insert_asset_residency_slot(residency, old_map[i]);
+	}
+	toy_free(&residency->alc, old_map);
+
+	residency->node_capacity = node_capacity;
+	return true;
+}
+
+
+static void toy_link_asset_residency_lru (toy_asset_residency_p residency, uint32_t node_index)
+{
+	toy_asset_residency_node_t* node = &residency->nodes[node_index];
+	node->prev = TOY_ASSET_RESIDENCY_NONE;
+	node->next = residency->lru_head;
+	if (TOY_ASSET_RESIDENCY_NONE != residency->lru_head)
+		residency->nodes[residency->lru_head].prev = node_index;
+	else
+		residency->lru_tail = node_index;
+	residency->lru_head = node_index;
+}
+
+
+static void toy_unlink_asset_residency_lru (toy_asset_residency_p residency, uint32_t node_index)
+{
+	toy_asset_residency_node_t* node = &residency->nodes[node_index];
+	if (TOY_ASSET_RESIDENCY_NONE != node->prev)
+		residency->nodes[node->prev].next = node->next;
+	else
+		residency->lru_head = node->next;
+	if (TOY_ASSET_RESIDENCY_NONE != node->next)
+		residency->nodes[node->next].prev = node->prev;
+	else
+		residency->lru_tail = node->prev;
+}
+
+
+static void toy_count_asset_residency (
+	toy_asset_residency_stats_t* stats,
+	const toy_asset_residency_node_t* node,
+	bool is_cached,
+	bool is_add)
+{
+	if (is_cached) {
+		stats->cached_host_bytes = is_add ? stats->cached_host_bytes + node->host_bytes : stats->cached_host_bytes - node->host_bytes;
+		stats->cached_device_bytes = is_add ? stats->cached_device_bytes + node->device_bytes : stats->cached_device_bytes - node->device_bytes;
+		stats->cached_count = is_add ? stats->cached_count + 1 : stats->cached_count - 1;
+	}
+	else {
+		stats->host_bytes = is_add ? stats->host_bytes + node->host_bytes : stats->host_bytes - node->host_bytes;
+		stats->device_bytes = is_add ? stats->device_bytes + node->device_bytes : stats->device_bytes - node->device_bytes;
+		stats->item_count = is_add ? stats->item_count + 1 : stats->item_count - 1;
+	}
+}
+
+
+static void toy_set_asset_residency_cached (toy_asset_residency_p residency, uint32_t node_index, bool is_cached)
+{
+	toy_asset_residency_node_t* node = &residency->nodes[node_index];
+	TOY_ASSERT(node->is_cached != is_cached);
+	uint32_t pool_id = toy_get_asset_residency_pool_id(node->handle);
+	if (is_cached)
+		toy_link_asset_residency_lru(residency, node_index);
+	else
+		toy_unlink_asset_residency_lru(residency, node_index);
+	node->is_cached = is_cached;
+	toy_count_asset_residency(&residency->pool_stats[pool_id], node, true, is_cached);
+	toy_count_asset_residency(&residency->total_stats, node, true, is_cached);
+}
+
+
+static toy_inline bool toy_is_asset_residency_over_budget (toy_asset_residency_p residency)
+{
+	return residency->total_stats.host_bytes > residency->budget.host_bytes ||
+		residency->total_stats.device_bytes > residency->budget.device_bytes;
+}
+
+
+// Take a cached item out of LRU, the least recently released one of lowest priority among the oldest ones
+static toy_asset_handle_t toy_pop_asset_residency_victim (toy_asset_residency_p residency, bool is_forced)
+{
+	std::lock_guard<std::mutex> guard(residency->lock);
+	if (TOY_ASSET_RESIDENCY_NONE == residency->lru_tail || (!is_forced && !toy_is_asset_residency_over_budget(residency)))
+		return TOY_ASSET_HANDLE_NULL;
+
+	uint32_t victim = residency->lru_tail;
+	uint32_t node_index = residency->nodes[victim].prev;
+	for (uint32_t i = 1; i < TOY_ASSET_RESIDENCY_EVICT_SCAN && TOY_ASSET_RESIDENCY_NONE != node_index; ++i) {
+		if (residency->nodes[node_index].priority < residency->nodes[victim].priority)
+			victim = node_index;
+		node_index = residency->nodes[node_index].prev;
+	}
+
+	toy_set_asset_residency_cached(residency, victim, false);
+	return residency->nodes[victim].handle;
+}
+
+
+// Free item unless it is referenced again after its release, or released again and GPU may still use it.
+// Such item is cached again when its latest release is collected. is_forced when device is idle
+static bool toy_evict_asset_residency_item (toy_asset_handle_t handle, bool is_forced)
+{
+	toy_asset_pool_p pool = toy_get_asset_handle_pool(handle);
+	if (NULL == pool || NULL == toy_resolve_asset_handle(handle))
+		return false;
+	uint32_t index = toy_get_asset_handle_index(handle);
+	if (0 != toy_get_asset_ref(pool, index))
+		return false;
+	if (!is_forced && !toy_is_asset_release_complete(pool, index))
+		return false;
+	// Loaders may reference it through registry meanwhile, the claim of toy_try_free_asset_item() decides. Untracked when freed
+	return toy_try_free_asset_item(pool, index);
+}
+
+
+TOY_EXTERN_C_START
+
+toy_asset_residency_p toy_create_asset_residency (
+	const toy_asset_residency_budget_t* budget,
+	const toy_allocator_t* alc,
+	toy_error_t* error)
+{
+	TOY_ASSERT(NULL != budget && NULL != alc);
+
+	void* object = toy_alloc_aligned(alc, sizeof(toy_asset_residency_t), alignof(toy_asset_residency_t));
+	if (NULL == object) {
+		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Failed to alloc asset residency", error);
+		return NULL;
+	}
+
+	toy_asset_residency_p residency = new (object) toy_asset_residency_t();
+	residency->alc = *alc;
+	residency->budget = *budget;
+	memset(residency->pool_stats, 0, sizeof(residency->pool_stats));
+	memset(&residency->total_stats, 0, sizeof(residency->total_stats));
+	residency->lru_head = TOY_ASSET_RESIDENCY_NONE;
+	residency->lru_tail = TOY_ASSET_RESIDENCY_NONE;
+
+	residency->node_capacity = 256;
+	residency->map_capacity = residency->node_capacity * 2;
+	residency->nodes = (toy_asset_residency_node_t*)toy_alloc(alc, sizeof(toy_asset_residency_node_t) * residency->node_capacity);
+	residency->map = (uint32_t*)toy_alloc(alc, sizeof(uint32_t) * residency->map_capacity);
+	if (NULL == residency->nodes || NULL == residency->map) {
+		toy_free(alc, residency->nodes);
+		toy_free(alc, residency->map);
+		residency->~toy_asset_residency_t();
+		toy_free_aligned(alc, object);
+		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Failed to alloc asset residency nodes", error);
+		return NULL;
+	}
+
+	for (uint32_t i = 0; i < residency->node_capacity - 1; ++i)
+		residency->nodes[i].next = i + 1;
+	residency->nodes[residency->node_capacity - 1].next = TOY_ASSET_RESIDENCY_NONE;
+	residency->free_node = 0;
+	for (uint32_t i = 0; i < residency->map_capacity; ++i)
+		residency->map[i] = TOY_ASSET_RESIDENCY_NONE;
+
+	toy_ok(error);
+	return residency;
+}
+
+
+void toy_destroy_asset_residency (toy_asset_residency_p residency)
+{
+	TOY_ASSERT(NULL != residency);
+	TOY_ASSERT(TOY_ASSET_RESIDENCY_NONE == residency->lru_head && "Flush cached assets before destroy");
+
+	toy_allocator_t alc = residency->alc;
+	toy_free(&alc, residency->map);
+	toy_free(&alc, residency->nodes);
+	residency->~toy_asset_residency_t();
+	toy_free_aligned(&alc, residency);
+}
+
+
+void toy_set_asset_residency_budget (
+	toy_asset_residency_p residency,
+	const toy_asset_residency_budget_t* budget)
+{
+	TOY_ASSERT(NULL != residency && NULL != budget);
+	std::lock_guard<std::mutex> guard(residency->lock);
+	residency->budget = *budget;
+}
+
+
+bool toy_track_asset_residency (
+	toy_asset_residency_p residency,
+	toy_asset_handle_t handle,
+	size_t host_bytes,
+	size_t device_bytes)
+{
+	TOY_ASSERT(NULL != residency && TOY_ASSET_HANDLE_NULL != handle);
+	std::lock_guard<std::mutex> guard(residency->lock);
+	TOY_ASSERT(TOY_ASSET_RESIDENCY_NONE == toy_find_asset_residency_slot(residency, handle));
+
+	if (TOY_ASSET_RESIDENCY_NONE == residency->free_node && !toy_grow_asset_residency(residency))
+		return false;
+
+	uint32_t node_index = residency->free_node;
+	toy_asset_residency_node_t* node = &residency->nodes[node_index];
+	residency->free_node = node->next;
+	node->handle = handle;
+	node->prev = TOY_ASSET_RESIDENCY_NONE;
+	node->next = TOY_ASSET_RESIDENCY_NONE;
+	node->is_cached = false;
+	node->priority = 0.0f;
+	node->host_bytes = host_bytes;
+	node->device_bytes = device_bytes;
+	toy_insert_asset_residency_slot(residency, node_index);
+
+	uint32_t pool_id = toy_get_asset_residency_pool_id(handle);
+	toy_count_asset_residency(&residency->pool_stats[pool_id], node, false, true);
+	toy_count_asset_residency(&residency->total_stats, node, false, true);
+	return true;
+}
+
+
+void toy_untrack_asset_residency (toy_asset_residency_p residency, toy_asset_handle_t handle)
+{
+	TOY_ASSERT(NULL != residency);
+	std::lock_guard<std::mutex> guard(residency->lock);
+	uint32_t slot = toy_find_asset_residency_slot(residency, handle);
+	if (TOY_ASSET_RESIDENCY_NONE == slot)
+		return;
+
+	uint32_t node_index = residency->map[slot];
+	toy_asset_residency_node_t* node = &residency->nodes[node_index];
+	if (node->is_cached)
+		toy_set_asset_residency_cached(residency, node_index, false);
+
+	uint32_t pool_id = toy_get_asset_residency_pool_id(handle);
+	toy_count_asset_residency(&residency->pool_stats[pool_id], node, false, false);
+	toy_count_asset_residency(&residency->total_stats, node, false, false);
+
+	toy_remove_asset_residency_slot(residency, slot);
+	node->handle = TOY_ASSET_HANDLE_NULL;
+	node->next = residency->free_node;
+	residency->free_node = node_index;
+}
+
+
+bool toy_cache_released_asset (toy_asset_residency_p residency, toy_asset_handle_t handle)
+{
+	TOY_ASSERT(NULL != residency);
+	std::lock_guard<std::mutex> guard(residency->lock);
+	uint32_t slot = toy_find_asset_residency_slot(residency, handle);
+	if (TOY_ASSET_RESIDENCY_NONE == slot)
+		return false;
+
+	// Released again after it was referenced from cache, move it to the head
+	uint32_t node_index = residency->map[slot];
+	if (residency->nodes[node_index].is_cached)
+		toy_set_asset_residency_cached(residency, node_index, false);
+	toy_set_asset_residency_cached(residency, node_index, true);
+	return true;
+}
+
+
+void toy_reuse_cached_asset (toy_asset_residency_p residency, toy_asset_handle_t handle)
+{
+	TOY_ASSERT(NULL != residency);
+	std::lock_guard<std::mutex> guard(residency->lock);
+	uint32_t slot = toy_find_asset_residency_slot(residency, handle);
+	if (TOY_ASSET_RESIDENCY_NONE == slot)
+		return;
+
+	uint32_t node_index = residency->map[slot];
+	if (residency->nodes[node_index].is_cached)
+		toy_set_asset_residency_cached(residency, node_index, false);
+}
+
+
+void toy_set_asset_residency_priority (
+	toy_asset_residency_p residency,
+	toy_asset_handle_t handle,
+	float priority)
+{
+	TOY_ASSERT(NULL != residency);
+	std::lock_guard<std::mutex> guard(residency->lock);
+	uint32_t slot = toy_find_asset_residency_slot(residency, handle);
+	if (TOY_ASSET_RESIDENCY_NONE != slot)
+		residency->nodes[residency->map[slot]].priority = priority;
+}
+
+
+uint32_t toy_trim_asset_residency (toy_asset_residency_p residency)
+{
+	TOY_ASSERT(NULL != residency);
+	// Lock is not held while freeing, toy_free_asset_item() untracks the item
+	uint32_t freed_count = 0;
+	toy_asset_handle_t handle;
+	while (TOY_ASSET_HANDLE_NULL != (handle = toy_pop_asset_residency_victim(residency, false))) {
+		if (toy_evict_asset_residency_item(handle, false))
+			++freed_count;
+	}
+	return freed_count;
+}
+
+
+void toy_flush_asset_residency (toy_asset_residency_p residency)
+{
+	TOY_ASSERT(NULL != residency);
+	toy_asset_handle_t handle;
+	while (TOY_ASSET_HANDLE_NULL != (handle = toy_pop_asset_residency_victim(residency, true)))
+		toy_evict_asset_residency_item(handle, true);
+}
+
+
+void toy_get_asset_residency_stats (
+	toy_asset_residency_p residency,
+	uint32_t pool_id,
+	toy_asset_residency_stats_t* output)
+{
+	TOY_ASSERT(NULL != residency && NULL != output);
+	TOY_ASSERT(TOY_ASSET_POOL_ID_NONE == pool_id || pool_id < TOY_ASSET_POOL_MAX_COUNT);
+	std::lock_guard<std::mutex> guard(residency->lock);
+	*output = TOY_ASSET_POOL_ID_NONE == pool_id ? residency->total_stats : residency->pool_stats[pool_id];
+}
+
+TOY_EXTERN_C_END
@@ -0,0 +1,740 @@
+#include "include/toy_bench.h"
+
+#include "toy_assert.h"
+#include "include/toy_memory.h"
+#include "include/toy_memory_thread_cache.h"
+#include "include/toy_memory_concurrent_pool.h"
+#include "include/toy_asset.h"
+#include "include/toy_asset_load_queue.h"
+#include "include/toy_log.h"
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define TOY_BENCH_THREAD_MAX 8
+#define TOY_BENCH_CONTENTION_THREAD_MAX 16
+#define TOY_BENCH_BATCH_SIZE 64 // Blocks alive at once per thread
+
+
+// Deterministic sizes and orders, every run of a benchmark sees the same sequence
+struct toy_bench_random_t {
+	uint64_t state;
+
+	uint32_t next () {
+		state = state * UINT64_C(6364136223846793005) + UINT64_C(1442695040888963407);
+		return (uint32_t)(state >> 33);
+	}
+
+	uint32_t next (uint32_t bound) {
+		return next() % bound;
+	}
+};
+
+
+static uint64_t toy_get_bench_ns ()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+static void toy_get_bench_memory_config (
+	enum toy_memory_list_strategy_t list_strategy,
+	bool thread_cache,
+	toy_memory_config_t* output)
+{
+	output->stack_size = 8 * 1024 * 1024; // 8M
+	output->buddy_size = 64 * 1024 * 1024; // 64M
+	output->list_size = 64 * 1024 * 1024; // 64M
+	output->chunk_count = 256;
+	output->list_strategy = list_strategy;
+	output->thread_cache = thread_cache;
+	output->frame_size = 0;
+	output->concurrent_chunk_count = 0;
+	output->virtual_memory = true;
+	output->reserve_size = (size_t)1 << (sizeof(void*) >= 8 ? 32 : 28); // 4G, 256M on 32-bit
+	output->chunk_large_page = false;
+	output->trace_path = NULL;
+}
+
+
+// Thread cache: batches of small blocks allocated and freed in shuffled order on every thread
+
+struct toy_bench_thread_cache_target_t {
+	const char* name;
+	const toy_allocator_t* alc; // NULL for malloc
+	std::mutex* lock; // Taken around every call when alc is not thread-safe
+	size_t block_size; // 0 for random sizes
+};
+
+static void toy_run_bench_thread_cache_worker (
+	const toy_bench_thread_cache_target_t* target,
+	uint32_t seed,
+	uint32_t rounds)
+{
+	toy_bench_random_t rng = { seed };
+	void* blocks[TOY_BENCH_BATCH_SIZE];
+	for (uint32_t round = 0; round < rounds; ++round) {
+		for (uint32_t i = 0; i < TOY_BENCH_BATCH_SIZE; ++i) {
+			size_t size = target->block_size > 0 ? target->block_size : 16 + rng.next(1024 - 16);
+			if (NULL == target->alc)
+				blocks[i] = malloc(size);
+			else if (NULL != target->lock) {
+				std::lock_guard<std::mutex> guard(*target->lock);
+				blocks[i] = toy_alloc(target->alc, size);
+			}
+			else
+				blocks[i] = toy_alloc(target->alc, size);
+			TOY_ASSERT(NULL != blocks[i]);
+			*(uint8_t*)blocks[i] = (uint8_t)i;
+		}
+		for (uint32_t i = TOY_BENCH_BATCH_SIZE; i > 1; --i) {
+			uint32_t j = rng.next(i);
+			void* block = blocks[j];
+			blocks[j] = blocks[i - 1];
+			blocks[i - 1] = block;
+		}
+		for (uint32_t i = 0; i < TOY_BENCH_BATCH_SIZE; ++i) {
+			if (NULL == target->alc)
+				free(blocks[i]);
+			else if (NULL != target->lock) {
+				std::lock_guard<std::mutex> guard(*target->lock);
+				toy_free(target->alc, blocks[i]);
+			}
+			else
+				toy_free(target->alc, blocks[i]);
+		}
+	}
+	toy_flush_memory_thread_cache();
+}
+
+
+static void toy_run_bench_thread_cache_target (
+	const char* bench,
+	const toy_bench_thread_cache_target_t* target,
+	uint32_t max_thread_count)
+{
+	const uint32_t rounds = 20000;
+	for (uint32_t thread_count = 1; thread_count <= max_thread_count; thread_count *= 2) {
+		std::vector<std::thread> threads;
+		uint64_t start = toy_get_bench_ns();
+		for (uint32_t i = 0; i < thread_count; ++i)
+			threads.emplace_back(toy_run_bench_thread_cache_worker, target, i + 1, rounds);
+		for (std::thread& thread : threads)
+			thread.join();
+		uint64_t ns = toy_get_bench_ns() - start;
+
+		double ops = 2.0 * TOY_BENCH_BATCH_SIZE * rounds * thread_count;
+		toy_log_i("[bench] %s %-16s %2u threads: %8.2f Mops/s, %6.1f ns/op per thread",
+			bench, target->name, thread_count, ops * 1000.0 / (double)ns, (double)ns * thread_count / ops);
+	}
+}
+
+
+static bool toy_run_bench_thread_cache ()
+{
+	toy_memory_config_t config;
+	toy_get_bench_memory_config(TOY_MEMORY_LIST_STRATEGY_TLSF, true, &config);
+	toy_memory_allocator_t* cached_alc = toy_create_memory_allocator(&config);
+	toy_get_bench_memory_config(TOY_MEMORY_LIST_STRATEGY_TLSF, false, &config);
+	toy_memory_allocator_t* plain_alc = toy_create_memory_allocator(&config);
+	if (NULL == cached_alc || NULL == plain_alc) {
+		toy_log_e("[bench] Create memory allocator for thread_cache failed");
+		if (NULL != cached_alc)
+			toy_destroy_memory_allocator(cached_alc);
+		if (NULL != plain_alc)
+			toy_destroy_memory_allocator(plain_alc);
+		return false;
+	}
+
+	// Without cache, list_alc is only usable by one thread, or by many behind one lock
+	std::mutex lock;
+	toy_bench_thread_cache_target_t targets[] = {
+		{ "list single", &plain_alc->list_alc, NULL, 0 },
+		{ "list locked", &plain_alc->list_alc, &lock, 0 },
+		{ "list cached", &cached_alc->list_alc, NULL, 0 },
+		{ "buddy cached", &cached_alc->buddy_alc, NULL, 0 },
+		{ "malloc", NULL, NULL, 0 },
+	};
+	for (size_t i = 0; i < sizeof(targets) / sizeof(targets[0]); ++i) {
+		bool is_single = &plain_alc->list_alc == targets[i].alc && NULL == targets[i].lock;
+		toy_run_bench_thread_cache_target("thread_cache", &targets[i], is_single ? 1 : TOY_BENCH_THREAD_MAX);
+	}
+
+	toy_destroy_memory_allocator(cached_alc);
+	toy_destroy_memory_allocator(plain_alc);
+	return true;
+}
+
+
+// Concurrent pool: same batches as thread_cache on blocks of one size, every thread hits the same free list head
+static bool toy_run_bench_concurrent_pool ()
+{
+	const size_t block_size = 1024;
+	toy_allocator_t std_alc = toy_std_alc();
+	toy_memory_concurrent_pool_p pool = toy_create_memory_concurrent_pool(
+		block_size, TOY_BENCH_CONTENTION_THREAD_MAX * TOY_BENCH_BATCH_SIZE, 0, &std_alc);
+	if (NULL == pool) {
+		toy_log_e("[bench] Create concurrent pool failed");
+		return false;
+	}
+	toy_allocator_t pool_alc;
+	toy_get_memory_concurrent_pool_alc(pool, &pool_alc);
+
+	toy_memory_pool_chain_t chain;
+	toy_allocator_t chain_alc;
+	toy_create_memory_pools(block_size * TOY_BENCH_CONTENTION_THREAD_MAX * TOY_BENCH_BATCH_SIZE, block_size, &chain, &chain_alc);
+	if (NULL == chain.pools) {
+		toy_log_e("[bench] Create memory pools failed");
+		toy_destroy_memory_concurrent_pool(pool, &std_alc);
+		return false;
+	}
+
+	// Pools of toy_memory.h are only usable by many threads behind one lock
+	std::mutex lock;
+	toy_bench_thread_cache_target_t targets[] = {
+		{ "treiber", &pool_alc, NULL, block_size },
+		{ "pools locked", &chain_alc, &lock, block_size },
+		{ "malloc", NULL, NULL, block_size },
+	};
+	for (size_t i = 0; i < sizeof(targets) / sizeof(targets[0]); ++i)
+		toy_run_bench_thread_cache_target("concurrent_pool", &targets[i], TOY_BENCH_CONTENTION_THREAD_MAX);
+
+	TOY_ASSERT(0 == toy_get_concurrent_pool_allocated_count(pool));
+	toy_destroy_memory_pools(&chain);
+	toy_destroy_memory_concurrent_pool(pool, &std_alc);
+	return true;
+}
+
+
+// Allocation trace shared by every allocator of a benchmark: sizes are log-uniform with rare big blocks,
+// most blocks die young and the others are freed in random order, which scatters free memory
+
+struct toy_bench_op_t {
+	uint32_t slot; // Index of live block
+	uint32_t size; // 0 for free
+};
+
+static void toy_make_bench_trace (
+	uint32_t op_count,
+	uint32_t max_live_count,
+	uint32_t max_size_shift,
+	std::vector<toy_bench_op_t>* output)
+{
+	toy_bench_random_t rng = { 0x70795452414345 };
+	std::vector<uint32_t> live_slots;
+	std::vector<uint32_t> free_slots;
+	output->clear();
+	output->reserve(op_count);
+	for (uint32_t i = 0; i < op_count; ++i) {
+		bool is_alloc = live_slots.empty() ||
+			(live_slots.size() < max_live_count && rng.next(100) < 52);
+		if (!is_alloc) {
+			// Recent blocks are freed more often
+			uint32_t index = rng.next(4) > 0 && live_slots.size() > 16 ?
+				(uint32_t)live_slots.size() - 1 - rng.next(16) : rng.next((uint32_t)live_slots.size());
+			uint32_t slot = live_slots[index];
+			live_slots.erase(live_slots.begin() + index);
+			free_slots.push_back(slot);
+			output->push_back({ slot, 0 });
+			continue;
+		}
+
+		uint32_t shift = 4 + rng.next(rng.next(64) > 0 ? 10 : max_size_shift - 4 + 1);
+		uint32_t size = (UINT32_C(1) << shift) + rng.next(UINT32_C(1) << shift);
+		uint32_t slot;
+		if (free_slots.empty())
+			slot = (uint32_t)(live_slots.size() + free_slots.size());
+		else {
+			slot = free_slots.back();
+			free_slots.pop_back();
+		}
+		live_slots.push_back(slot);
+		output->push_back({ slot, size });
+	}
+	// Leave nothing alive
+	while (!live_slots.empty()) {
+		output->push_back({ live_slots.back(), 0 });
+		live_slots.pop_back();
+	}
+}
+
+
+static uint32_t toy_get_bench_trace_slot_count (const std::vector<toy_bench_op_t>& trace)
+{
+	uint32_t ret = 0;
+	for (const toy_bench_op_t& op : trace) {
+		if (op.slot >= ret)
+			ret = op.slot + 1;
+	}
+	return ret;
+}
+
+
+// Nanoseconds at percentile of sorted latencies
+static uint64_t toy_get_bench_percentile (const std::vector<uint32_t>& sorted, double percentile)
+{
+	if (sorted.empty())
+		return 0;
+	size_t index = (size_t)(percentile / 100.0 * (double)(sorted.size() - 1) + 0.5);
+	return sorted[index];
+}
+
+
+static void toy_log_bench_latency (const char* bench, const char* name, const char* op, std::vector<uint32_t>* latencies)
+{
+	std::sort(latencies->begin(), latencies->end());
+	toy_log_i("[bench] %s %-10s %-5s ns: p50 %4llu, p90 %4llu, p99 %5llu, p99.9 %6llu, max %7llu",
+		bench, name, op,
+		(unsigned long long)toy_get_bench_percentile(*latencies, 50.0),
+		(unsigned long long)toy_get_bench_percentile(*latencies, 90.0),
+		(unsigned long long)toy_get_bench_percentile(*latencies, 99.0),
+		(unsigned long long)toy_get_bench_percentile(*latencies, 99.9),
+		(unsigned long long)(latencies->empty() ? 0 : latencies->back()));
+}
+
+
+typedef float (*toy_bench_fragmentation_fp)(toy_memory_allocator_t* alc);
+
+static float toy_get_bench_list_fragmentation (toy_memory_allocator_t* alc)
+{
+	toy_memory_free_info_t info;
+	if (NULL != alc->tlsf)
+		toy_get_memory_tlsf_free_info(alc->tlsf, &info);
+	else
+		toy_get_memory_list_free_info(alc->lists.lists, &info);
+	return toy_get_memory_fragmentation(&info);
+}
+
+
+struct toy_bench_trace_result_t {
+	uint32_t failed_count;
+	float peak_fragmentation; // Sampled every 1024 operations
+	float mean_fragmentation;
+	size_t footprint_growth;
+};
+
+// Replay trace on alc, latency of each alloc and free is measured
+static void toy_run_bench_trace (
+	const std::vector<toy_bench_op_t>& trace,
+	toy_memory_allocator_t* alc,
+	const toy_allocator_t* target_alc,
+	toy_bench_fragmentation_fp fragmentation_fp,
+	std::vector<uint32_t>* alloc_latencies,
+	std::vector<uint32_t>* free_latencies,
+	toy_bench_trace_result_t* output)
+{
+	std::vector<void*> blocks(toy_get_bench_trace_slot_count(trace), NULL);
+	alloc_latencies->clear();
+	free_latencies->clear();
+	memset(output, 0, sizeof(*output));
+	size_t start_footprint = toy_get_memory_footprint(alc);
+	double fragmentation_sum = 0.0;
+	uint32_t sample_count = 0;
+
+	for (size_t i = 0; i < trace.size(); ++i) {
+		const toy_bench_op_t& op = trace[i];
+		if (0 != op.size) {
+			uint64_t start = toy_get_bench_ns();
+			void* block = toy_alloc(target_alc, op.size);
+			alloc_latencies->push_back((uint32_t)(toy_get_bench_ns() - start));
+			if (NULL == block)
+				++(output->failed_count);
+			else
+				*(uint8_t*)block = (uint8_t)i;
+			blocks[op.slot] = block;
+		}
+		else if (NULL != blocks[op.slot]) {
+			uint64_t start = toy_get_bench_ns();
+			toy_free(target_alc, blocks[op.slot]);
+			free_latencies->push_back((uint32_t)(toy_get_bench_ns() - start));
+			blocks[op.slot] = NULL;
+		}
+
+		if (0 == (i & 1023)) {
+			float fragmentation = fragmentation_fp(alc);
+			fragmentation_sum += fragmentation;
+			++sample_count;
+			if (fragmentation > output->peak_fragmentation)
+				output->peak_fragmentation = fragmentation;
+		}
+	}
+
+	output->mean_fragmentation = sample_count > 0 ? (float)(fragmentation_sum / sample_count) : 0.0f;
+	output->footprint_growth = toy_get_memory_footprint(alc) - start_footprint;
+}
+
+
+// TLSF and first-fit list on the same trace
+static bool toy_run_bench_list ()
+{
+	std::vector<toy_bench_op_t> trace;
+	toy_make_bench_trace(400000, 4000, 20, &trace);
+
+	struct {
+		const char* name;
+		enum toy_memory_list_strategy_t strategy;
+	} runs[] = {
+		{ "tlsf", TOY_MEMORY_LIST_STRATEGY_TLSF },
+		{ "first_fit", TOY_MEMORY_LIST_STRATEGY_FIRST_FIT },
+	};
+
+	std::vector<uint32_t> alloc_latencies;
+	std::vector<uint32_t> free_latencies;
+	for (size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); ++i) {
+		toy_memory_config_t config;
+		toy_get_bench_memory_config(runs[i].strategy, false, &config);
+		toy_memory_allocator_t* alc = toy_create_memory_allocator(&config);
+		if (NULL == alc) {
+			toy_log_e("[bench] Create memory allocator for list %s failed", runs[i].name);
+			return false;
+		}
+
+		toy_bench_trace_result_t result;
+		toy_run_bench_trace(trace, alc, &alc->list_alc, toy_get_bench_list_fragmentation, &alloc_latencies, &free_latencies, &result);
+		toy_log_bench_latency("list", runs[i].name, "alloc", &alloc_latencies);
+		toy_log_bench_latency("list", runs[i].name, "free", &free_latencies);
+		toy_log_i("[bench] list %-10s fragmentation mean %.3f, peak %.3f, footprint +%zu bytes, failed %u",
+			runs[i].name, result.mean_fragmentation, result.peak_fragmentation, result.footprint_growth, result.failed_count);
+
+		toy_destroy_memory_allocator(alc);
+	}
+	return true;
+}
+
+// Peak bytes taken by live blocks of trace up to max_size when each block takes block_size_fp(size)
+static size_t toy_get_bench_trace_peak_bytes (
+	const std::vector<toy_bench_op_t>& trace,
+	uint32_t max_size,
+	size_t (*block_size_fp)(uint32_t size))
+{
+	std::vector<size_t> sizes(toy_get_bench_trace_slot_count(trace), 0);
+	size_t live = 0;
+	size_t ret = 0;
+	for (const toy_bench_op_t& op : trace) {
+		if (0 != op.size) {
+			sizes[op.slot] = op.size <= max_size ? block_size_fp(op.size) : 0;
+			live += sizes[op.slot];
+			if (live > ret)
+				ret = live;
+		}
+		else {
+			live -= sizes[op.slot];
+			sizes[op.slot] = 0;
+		}
+	}
+	return ret;
+}
+
+
+static size_t toy_get_bench_buddy_block_size (uint32_t size)
+{
+	return (size_t)1 << (size <= 128 ? 7 : toy_fls(size - 1));
+}
+
+
+// Buddy before block states moved to side table: 24-byte header and 8-byte footer in every block
+static size_t toy_get_bench_inline_buddy_block_size (uint32_t size)
+{
+	return toy_get_bench_buddy_block_size(size + 32);
+}
+
+
+static float toy_get_bench_buddy_fragmentation (toy_memory_allocator_t* alc)
+{
+	toy_memory_free_info_t info;
+	toy_get_memory_buddy_free_info(&alc->buddy, &info);
+	return toy_get_memory_fragmentation(&info);
+}
+
+
+// Many small and medium blocks alive in buddy_alc, freed in random order
+static bool toy_run_bench_buddy ()
+{
+	std::vector<toy_bench_op_t> trace;
+	toy_make_bench_trace(1000000, 8000, 12, &trace);
+
+	toy_memory_config_t config;
+	toy_get_bench_memory_config(TOY_MEMORY_LIST_STRATEGY_TLSF, false, &config);
+	toy_memory_allocator_t* alc = toy_create_memory_allocator(&config);
+	if (NULL == alc) {
+		toy_log_e("[bench] Create memory allocator for buddy failed");
+		return false;
+	}
+
+	std::vector<uint32_t> alloc_latencies;
+	std::vector<uint32_t> free_latencies;
+	toy_bench_trace_result_t result;
+	toy_run_bench_trace(trace, alc, &alc->buddy_alc, toy_get_bench_buddy_fragmentation, &alloc_latencies, &free_latencies, &result);
+	toy_log_bench_latency("buddy", "bitmap", "alloc", &alloc_latencies);
+	toy_log_bench_latency("buddy", "bitmap", "free", &free_latencies);
+	toy_log_i("[bench] buddy bitmap     fragmentation mean %.3f, peak %.3f, footprint +%zu bytes, failed %u",
+		result.mean_fragmentation, result.peak_fragmentation, result.footprint_growth, result.failed_count);
+
+	// Bytes taken by blocks of each layout, for all blocks and for small ones where the header matters most
+	const uint32_t max_sizes[] = { UINT32_MAX, 256 };
+	for (size_t i = 0; i < sizeof(max_sizes) / sizeof(max_sizes[0]); ++i) {
+		size_t requested = toy_get_bench_trace_peak_bytes(trace, max_sizes[i], [](uint32_t size) { return (size_t)size; });
+		size_t side_table = toy_get_bench_trace_peak_bytes(trace, max_sizes[i], toy_get_bench_buddy_block_size);
+		size_t inline_header = toy_get_bench_trace_peak_bytes(trace, max_sizes[i], toy_get_bench_inline_buddy_block_size);
+		toy_log_i("[bench] buddy peak live of blocks up to %u bytes: requested %zu, side table layout %zu (%.2fx), inline header layout %zu (%.2fx)",
+			max_sizes[i], requested, side_table, (double)side_table / (double)requested, inline_header, (double)inline_header / (double)requested);
+	}
+
+	toy_destroy_memory_allocator(alc);
+	return true;
+}
+
+
+// 1M asset items allocated in steps, then freed and allocated in random order.
+// Free stack keeps alloc and free O(1), ns/op must not grow with live count
+static bool toy_run_bench_asset_pool ()
+{
+	const uint32_t item_count = 1000000;
+	const uint32_t step_count = 4;
+
+	toy_allocator_t std_alc = toy_std_alc();
+	toy_asset_pool_t pool;
+	toy_error_t err;
+	toy_init_asset_pool(64, sizeof(void*), 0, NULL, &std_alc, &std_alc, NULL, "bench", &pool, &err);
+	if (toy_is_failed(err)) {
+		toy_log_e("[bench] asset_pool init failed: %s", err.error_msg);
+		return false;
+	}
+
+	bool ret = true;
+	toy_bench_random_t rng = { 13 };
+	std::vector<uint32_t> indices(item_count);
+	uint32_t live_count = 0;
+
+	for (uint32_t step = 0; step < step_count && ret; ++step) {
+		uint32_t step_end = (step + 1) * item_count / step_count;
+		uint32_t step_start = live_count;
+		uint64_t start = toy_get_bench_ns();
+		for (; live_count < step_end; ++live_count) {
+			indices[live_count] = toy_alloc_asset_item(&pool, &err);
+			if (toy_unlikely(toy_is_failed(err))) {
+				toy_log_e("[bench] asset_pool alloc failed at %u live items: %s", live_count, err.error_msg);
+				ret = false;
+				break;
+			}
+		}
+		uint64_t ns = toy_get_bench_ns() - start;
+		toy_log_i("[bench] asset_pool alloc live %7u..%7u: %.1f ns/op",
+			step_start, live_count, (double)ns / (double)(live_count - step_start + (live_count == step_start ? 1 : 0)));
+	}
+
+	// Random mix at 1M live, frees hit chunks all over the pool
+	std::vector<uint32_t> alloc_latencies;
+	std::vector<uint32_t> free_latencies;
+	alloc_latencies.reserve(item_count);
+	free_latencies.reserve(item_count);
+	for (uint32_t op = 0; op < item_count && ret; ++op) {
+		if (live_count > 0 && (live_count == item_count || 0 == rng.next(2))) {
+			std::swap(indices[rng.next(live_count)], indices[live_count - 1]);
+			uint64_t start = toy_get_bench_ns();
+			toy_raw_free_asset_item(&pool, indices[live_count - 1]);
+			free_latencies.push_back((uint32_t)(toy_get_bench_ns() - start));
+			--live_count;
+		}
+		else {
+			uint64_t start = toy_get_bench_ns();
+			indices[live_count] = toy_alloc_asset_item(&pool, &err);
+			alloc_latencies.push_back((uint32_t)(toy_get_bench_ns() - start));
+			if (toy_unlikely(toy_is_failed(err))) {
+				toy_log_e("[bench] asset_pool alloc failed at %u live items: %s", live_count, err.error_msg);
+				ret = false;
+				break;
+			}
+			++live_count;
+		}
+	}
+	toy_log_bench_latency("asset_pool", "random", "alloc", &alloc_latencies);
+	toy_log_bench_latency("asset_pool", "random", "free", &free_latencies);
+
+	toy_asset_pool_stats_t stats;
+	toy_get_asset_pool_stats(&pool, &stats);
+	toy_log_i("[bench] asset_pool random     live %u, chunks %u, fragmentation %.3f",
+		stats.live_count, stats.chunk_count, stats.fragmentation);
+
+	// Rest freed in random order
+	uint32_t free_count = live_count;
+	uint64_t start = toy_get_bench_ns();
+	while (live_count > 0) {
+		std::swap(indices[rng.next(live_count)], indices[live_count - 1]);
+		toy_raw_free_asset_item(&pool, indices[live_count - 1]);
+		--live_count;
+	}
+	uint64_t ns = toy_get_bench_ns() - start;
+	toy_log_i("[bench] asset_pool free  live %7u..0: %.1f ns/op", free_count, (double)ns / (double)(free_count > 0 ? free_count : 1));
+
+	toy_destroy_asset_pool(&std_alc, &pool);
+	return ret;
+}
+
+
+// Asset pool items allocated and freed by load queue workers at once, like loads which create their items off the owner thread.
+// Each item is stamped by its job, a block handed to two threads or a stale handle which resolves shows up as a wrong stamp
+
+struct toy_bench_asset_pool_job_t {
+	toy_asset_load_job_t job; // First member, job pointer is cast back
+	toy_asset_pool_p pool;
+	uint32_t job_id;
+	uint32_t round_count;
+	uint32_t error_count;
+	uint64_t ns;
+};
+
+struct toy_bench_asset_pool_item_t {
+	uint32_t job_id;
+	uint32_t slot;
+};
+
+static void toy_run_bench_asset_pool_job (toy_asset_load_job_t* load_job)
+{
+	toy_bench_asset_pool_job_t* job = (toy_bench_asset_pool_job_t*)load_job;
+	toy_bench_random_t rng = { job->job_id + 1 };
+	toy_asset_handle_t handles[TOY_BENCH_BATCH_SIZE];
+	toy_error_t err;
+
+	uint64_t start = toy_get_bench_ns();
+	for (uint32_t round = 0; round < job->round_count; ++round) {
+		uint32_t alive_count = 0;
+		for (uint32_t i = 0; i < TOY_BENCH_BATCH_SIZE; ++i) {
+			uint32_t index = toy_alloc_asset_item(job->pool, &err);
+			if (toy_unlikely(toy_is_failed(err))) {
+				++(job->error_count);
+				break;
+			}
+			toy_bench_asset_pool_item_t* item = (toy_bench_asset_pool_item_t*)toy_get_asset_item(job->pool, index);
+			item->job_id = job->job_id;
+			item->slot = i;
+			handles[alive_count++] = toy_get_asset_handle(job->pool, index);
+		}
+
+		for (uint32_t i = alive_count; i > 0; --i) {
+			std::swap(handles[rng.next(i)], handles[i - 1]);
+			toy_asset_handle_t handle = handles[i - 1];
+			toy_bench_asset_pool_item_t* item = (toy_bench_asset_pool_item_t*)toy_resolve_asset_handle(handle);
+			if (toy_unlikely(NULL == item || item->job_id != job->job_id)) {
+				++(job->error_count);
+				continue;
+			}
+			toy_raw_free_asset_item(job->pool, toy_get_asset_handle_index(handle));
+			if (toy_unlikely(NULL != toy_resolve_asset_handle(handle)))
+				++(job->error_count);
+		}
+	}
+	job->ns = toy_get_bench_ns() - start;
+}
+
+
+static bool toy_run_bench_asset_pool_load_queue ()
+{
+	const uint32_t job_count = TOY_BENCH_CONTENTION_THREAD_MAX * 4;
+	const uint32_t round_count = 2000;
+
+	toy_allocator_t std_alc = toy_std_alc();
+	toy_error_t err;
+	toy_asset_pool_t pool;
+	toy_init_asset_pool(sizeof(toy_bench_asset_pool_item_t), alignof(toy_bench_asset_pool_item_t), 0, NULL,
+		&std_alc, &std_alc, NULL, "bench threads", &pool, &err);
+	if (toy_is_failed(err)) {
+		toy_log_e("[bench] asset_pool_load_queue init failed: %s", err.error_msg);
+		return false;
+	}
+
+	toy_asset_load_queue_p queue = toy_create_asset_load_queue(TOY_BENCH_CONTENTION_THREAD_MAX, &std_alc, &err);
+	if (toy_is_failed(err)) {
+		toy_log_e("[bench] asset_pool_load_queue create queue failed: %s", err.error_msg);
+		toy_destroy_asset_pool(&std_alc, &pool);
+		return false;
+	}
+
+	std::vector<toy_bench_asset_pool_job_t> jobs(job_count);
+	uint64_t start = toy_get_bench_ns();
+	for (uint32_t i = 0; i < job_count; ++i) {
+		jobs[i].job.next = NULL;
+		jobs[i].job.run_fp = toy_run_bench_asset_pool_job;
+		jobs[i].pool = &pool;
+		jobs[i].job_id = i;
+		jobs[i].round_count = round_count;
+		jobs[i].error_count = 0;
+		jobs[i].ns = 0;
+		toy_push_asset_load_job(queue, &jobs[i].job);
+	}
+	toy_join_asset_load_queue(queue);
+	uint64_t ns = toy_get_bench_ns() - start;
+	toy_destroy_asset_load_queue(queue);
+
+	uint32_t error_count = 0;
+	uint64_t job_ns = 0;
+	for (uint32_t i = 0; i < job_count; ++i) {
+		error_count += jobs[i].error_count;
+		job_ns += jobs[i].ns;
+	}
+
+	uint64_t op_count = (uint64_t)job_count * round_count * TOY_BENCH_BATCH_SIZE * 2;
+	toy_asset_pool_stats_t stats;
+	toy_get_asset_pool_stats(&pool, &stats);
+	toy_log_i("[bench] asset_pool_load_queue %u workers: %.1f ns/op per thread, %.1f ns/op total, chunks %u",
+		TOY_BENCH_CONTENTION_THREAD_MAX, (double)job_ns / (double)op_count, (double)ns / (double)op_count, stats.chunk_count);
+
+	bool ret = true;
+	if (0 != error_count || 0 != stats.live_count || stats.alloc_count != stats.free_count ||
+		stats.alloc_count != op_count / 2) {
+		toy_log_e("[bench] asset_pool_load_queue %u errors, live %u, alloc %llu, free %llu",
+			error_count, stats.live_count, (unsigned long long)stats.alloc_count, (unsigned long long)stats.free_count);
+		ret = false;
+	}
+
+	toy_destroy_asset_pool(&std_alc, &pool);
+	return ret;
+}
+
+
+struct toy_bench_t {
+	const char* name;
+	bool (*run_fp)();
+};
+
+static const toy_bench_t s_benches[] = {
+	{ "thread_cache", toy_run_bench_thread_cache },
+	{ "concurrent_pool", toy_run_bench_concurrent_pool },
+	{ "list", toy_run_bench_list },
+	{ "buddy", toy_run_bench_buddy },
+	{ "asset_pool", toy_run_bench_asset_pool },
+	{ "asset_pool_load_queue", toy_run_bench_asset_pool_load_queue },
+};
+
+
+TOY_EXTERN_C_START
+
+int toy_run_bench_main (const char* name)
+{
+	TOY_ASSERT(NULL != name);
+
+	bool is_all = 0 == strcmp(name, "all");
+	bool found = false;
+	int ret = EXIT_SUCCESS;
+	for (size_t i = 0; i < sizeof(s_benches) / sizeof(s_benches[0]); ++i) {
+		if (!is_all && 0 != strcmp(name, s_benches[i].name))
+			continue;
+		found = true;
+		if (!s_benches[i].run_fp())
+			ret = EXIT_FAILURE;
+	}
+
+	if (!found) {
+		toy_log_e("[bench] Unknown benchmark %s", name);
+		return EXIT_FAILURE;
+	}
+	return ret;
+}
+
+TOY_EXTERN_C_END
@@ -3,14 +3,45 @@
 #include "toy_assert.h"
 #include "include/toy_log.h"
 #include "include/toy_file.h"
+#include "include/toy_asset_manager.h"
 #include <string.h>
 
 #pragma comment(lib, "libs/lua.lib")
 
 
-lua_State* toy_lua_new_vm ()
+static void* toy_lua_alloc (void* ud, void* ptr, size_t osize, size_t nsize)
 {
-	lua_State* vm = luaL_newstate();
+	const toy_allocator_t* alc = (const toy_allocator_t*)ud;
+	if (0 == nsize) {
+		if (NULL != ptr)
+			toy_free(alc, ptr);
+		return NULL;
+	}
+
+	// osize is the type of object when ptr is NULL
+	return toy_realloc(alc, ptr, NULL != ptr ? osize : 0, nsize);
+}
+
+
+static int toy_lua_panic (lua_State* lua_vm)
+{
+	const char* msg = lua_tostring(lua_vm, -1);
+	toy_log_e("LUA panic: %s", NULL != msg ? msg : "error object is not a string");
+	return 0;
+}
+
+
+lua_State* toy_lua_new_vm (const toy_allocator_t* alc)
+{
+	lua_State* vm = NULL;
+	if (NULL != alc) {
+		vm = lua_newstate(toy_lua_alloc, (void*)alc);
+		if (NULL != vm)
+			lua_atpanic(vm, toy_lua_panic);
+	}
+	else {
+		vm = luaL_newstate();
+	}
 	if (NULL == vm)
 		return NULL;
 
@@ -221,3 +252,137 @@ void toy_lua_rawget_string (lua_State* lua_vm, const char* key, char* dst, size_
 	dst[dst_size - 1] = '\0';
 	lua_pop(lua_vm, 1);
 }
+
+
+static void toy_lua_set_integer_field (lua_State* lua_vm, const char* key, lua_Integer value)
+{
+	lua_pushinteger(lua_vm, value);
+	lua_setfield(lua_vm, -2, key);
+}
+
+
+static void toy_lua_set_number_field (lua_State* lua_vm, const char* key, lua_Number value)
+{
+	lua_pushnumber(lua_vm, value);
+	lua_setfield(lua_vm, -2, key);
+}
+
+
+static toy_asset_manager_t* toy_lua_get_asset_manager (lua_State* L)
+{
+	return (toy_asset_manager_t*)lua_touserdata(L, lua_upvalueindex(1));
+}
+
+
+static int toy_luacf_asset_stats (lua_State* L)
+{
+	toy_asset_manager_t* asset_mgr = toy_lua_get_asset_manager(L);
+	toy_asset_manager_pool_stats_t stats[TOY_ASSET_MANAGER_POOL_MAX];
+	uint32_t count = toy_get_asset_manager_stats(asset_mgr, stats);
+
+	lua_createtable(L, 0, count);
+	for (uint32_t i = 0; i < count; ++i) {
+		lua_createtable(L, 0, 11);
+		toy_lua_set_integer_field(L, "live", stats[i].pool.live_count);
+		toy_lua_set_integer_field(L, "chunks", stats[i].pool.chunk_count);
+		toy_lua_set_integer_field(L, "used_bytes", (lua_Integer)stats[i].pool.used_bytes);
+		toy_lua_set_integer_field(L, "reserved_bytes", (lua_Integer)stats[i].pool.reserved_bytes);
+		toy_lua_set_number_field(L, "fragmentation", stats[i].pool.fragmentation);
+		toy_lua_set_integer_field(L, "alloc_count", (lua_Integer)stats[i].pool.alloc_count);
+		toy_lua_set_integer_field(L, "free_count", (lua_Integer)stats[i].pool.free_count);
+		toy_lua_set_integer_field(L, "frame_alloc", stats[i].frame_alloc_count);
+		toy_lua_set_integer_field(L, "frame_free", stats[i].frame_free_count);
+		toy_lua_set_number_field(L, "alloc_rate", stats[i].alloc_rate);
+		toy_lua_set_number_field(L, "free_rate", stats[i].free_rate);
+		lua_setfield(L, -2, stats[i].name);
+	}
+	return 1;
+}
+
+
+// toy_load_texture_async(path) returns load handle, or nil and error message
+static int toy_luacf_load_texture_async (lua_State* L)
+{
+	const char* path = luaL_checkstring(L, 1);
+	toy_error_t err;
+	toy_asset_handle_t load = toy_load_texture2d_async(toy_lua_get_asset_manager(L), path, NULL, NULL, &err);
+	if (toy_is_failed(err)) {
+		lua_pushnil(L);
+		lua_pushstring(L, err.error_msg);
+		return 2;
+	}
+	lua_pushinteger(L, load);
+	return 1;
+}
+
+
+// Raise error when argument is not a load handle which script still holds, C functions only assert it
+static toy_asset_handle_t toy_lua_check_asset_load (lua_State* L, int arg, toy_asset_manager_t* asset_mgr)
+{
+	lua_Integer value = luaL_checkinteger(L, arg);
+	if (value < 0 || value > UINT32_MAX || !toy_is_asset_load_valid(asset_mgr, (toy_asset_handle_t)value))
+		luaL_error(L, "Invalid or released asset load handle: %I", value);
+	return (toy_asset_handle_t)value;
+}
+
+
+// toy_get_asset_load(load) returns "pending", "done" or "failed", and asset handle when done
+static int toy_luacf_get_asset_load (lua_State* L)
+{
+	toy_asset_manager_t* asset_mgr = toy_lua_get_asset_manager(L);
+	toy_asset_handle_t load = toy_lua_check_asset_load(L, 1, asset_mgr);
+	toy_asset_handle_t asset;
+	enum toy_asset_load_state_t state = toy_get_asset_load_state(asset_mgr, load, &asset);
+	switch (state) {
+	case TOY_ASSET_LOAD_STATE_DONE:
+		lua_pushliteral(L, "done");
+		lua_pushinteger(L, asset);
+		return 2;
+	case TOY_ASSET_LOAD_STATE_FAILED:
+		lua_pushliteral(L, "failed");
+		return 1;
+	default:
+		lua_pushliteral(L, "pending");
+		return 1;
+	}
+}
+
+
+static int toy_luacf_release_asset_load (lua_State* L)
+{
+	toy_asset_manager_t* asset_mgr = toy_lua_get_asset_manager(L);
+	toy_asset_handle_t load = toy_lua_check_asset_load(L, 1, asset_mgr);
+	toy_release_asset_load(asset_mgr, load);
+	return 0;
+}
+
+
+static int toy_luacf_open_asset_manager (lua_State* L)
+{
+	static const luaL_Reg asset_funcs[] = {
+		{ "toy_asset_stats", toy_luacf_asset_stats },
+		{ "toy_load_texture_async", toy_luacf_load_texture_async },
+		{ "toy_get_asset_load", toy_luacf_get_asset_load },
+		{ "toy_release_asset_load", toy_luacf_release_asset_load },
+		{ NULL, NULL }
+	};
+	lua_pushglobaltable(L);
+	lua_pushvalue(L, 1);
+	luaL_setfuncs(L, asset_funcs, 1);
+	return 0;
+}
+
+int toy_lua_open_asset_manager (lua_State* lua_vm, toy_asset_manager_t* asset_mgr)
+{
+	TOY_ASSERT(NULL != asset_mgr);
+	lua_pushcfunction(lua_vm, toy_luacf_open_asset_manager);
+	lua_pushlightuserdata(lua_vm, asset_mgr);
+	int err = lua_pcall(lua_vm, 1, 0, 0);
+	if (LUA_OK != err && LUA_TSTRING == lua_type(lua_vm, -1))
+	{
+		const char* msg = lua_tostring(lua_vm, -1);
+		toy_log_e("toy_lua_open_asset_manager: %s", msg);
+		lua_pop(lua_vm, 1);
+	}
+	return err;
+}
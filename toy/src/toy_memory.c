@@ -1,5 +1,11 @@
 #include "include/toy_memory.h"
 #include "toy_assert.h"
+#include "include/toy_log.h"
+#include <stddef.h>
+#include <stdlib.h>
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
 
 
 static toy_aligned_p toy_padding_L (uintptr_t raw_ptr, size_t alignment) {
@@ -27,6 +33,60 @@ static void* toy_unpadding_L (toy_aligned_p mem) {
 }
 
 
+// Segment of growable pools and lists, aligned to its size (2^N)
+static void* toy_alloc_memory_segment (size_t segment_size) {
+	TOY_ASSERT((segment_size & (segment_size - 1)) == 0);
+#if defined(_MSC_VER)
+	return _aligned_malloc(segment_size, segment_size);
+#else
+	return aligned_alloc(segment_size, segment_size);
+#endif
+}
+
+
+static void toy_free_memory_segment (void* segment) {
+#if defined(_MSC_VER)
+	_aligned_free(segment);
+#else
+	free(segment);
+#endif
+}
+
+
+// Take segment from vm of chain while it has room, then from heap
+static void* toy_alloc_chain_segment (
+	toy_memory_vm_t* vm,
+	uintptr_t* vm_top,
+	size_t segment_size)
+{
+	if (NULL != vm && segment_size <= vm->base + vm->size - *vm_top) {
+		if (toy_commit_memory_vm(vm, *vm_top, segment_size)) {
+			void* segment = (void*)*vm_top;
+			*vm_top += segment_size;
+			return segment;
+		}
+	}
+	return toy_alloc_memory_segment(segment_size);
+}
+
+
+static void toy_free_chain_segment (
+	toy_memory_vm_t* vm,
+	void* segment)
+{
+	// Segments in vm are released with vm
+	if (NULL == vm || !toy_is_memory_in_vm(vm, (uintptr_t)segment))
+		toy_free_memory_segment(segment);
+}
+
+
+static size_t toy_get_memory_segment_size (size_t size) {
+	if (size <= sizeof(void*))
+		return sizeof(void*);
+	return (size_t)1 << toy_fls(size - 1);
+}
+
+
 void toy_init_memory_stack (
 	void* memory,
 	size_t memory_size,
@@ -38,6 +98,33 @@ void toy_init_memory_stack (
 	output->size = memory_size;
 	output->left_top = output->bottom;
 	output->right_top = output->bottom + output->size;
+	output->overflow_alc.ctx = NULL;
+	output->overflow_alc.alloc = NULL;
+	output->overflow_alc.free = NULL;
+	output->overflow_alc.ext = NULL;
+	output->overflow_L = NULL;
+	output->overflow_R = NULL;
+	output->vm = NULL;
+	output->commit_L = output->bottom + output->size;
+	output->commit_R = output->bottom;
+}
+
+
+void toy_set_stack_overflow_allocator (
+	toy_memory_stack_t* stack,
+	const toy_allocator_t* overflow_alc)
+{
+	TOY_ASSERT(NULL != stack);
+	TOY_ASSERT(NULL == stack->overflow_L && NULL == stack->overflow_R);
+	if (NULL != overflow_alc) {
+		stack->overflow_alc = *overflow_alc;
+	}
+	else {
+		stack->overflow_alc.ctx = NULL;
+		stack->overflow_alc.alloc = NULL;
+		stack->overflow_alc.free = NULL;
+		stack->overflow_alc.ext = NULL;
+	}
 }
 
 
@@ -62,11 +149,32 @@ static toy_memory_stack_p toy_alloc_memory_stack (
 }
 
 
+// Stack header takes the head of vm, the rest is committed on demand
+static toy_memory_stack_p toy_alloc_memory_stack_vm (toy_memory_vm_t* vm)
+{
+	TOY_ASSERT(NULL != vm);
+
+	if (toy_unlikely(vm->size <= sizeof(toy_memory_stack_t)))
+		return NULL;
+	if (!toy_commit_memory_vm(vm, vm->base, sizeof(toy_memory_stack_t)))
+		return NULL;
+
+	toy_memory_stack_p stack = (toy_memory_stack_p)vm->base;
+	uintptr_t stack_memory = vm->base + sizeof(toy_memory_stack_t);
+	toy_init_memory_stack((void*)stack_memory, vm->size - sizeof(toy_memory_stack_t), stack);
+	stack->vm = vm;
+	stack->commit_L = vm->base + vm->granule_size;
+	stack->commit_R = vm->base + vm->size;
+	return stack;
+}
+
+
 static void toy_free_memory_stack (
 	toy_memory_stack_p stack,
 	const toy_allocator_t* alc)
 {
 	TOY_ASSERT(NULL != stack && NULL != alc);
+	toy_clear_stack(stack);
 	toy_free(alc, toy_unpadding_L(stack));
 }
 
@@ -83,48 +191,192 @@ toy_inline bool toy_is_stack_empty (toy_memory_stack_t* stack)
 }
 
 
-void* toy_stack_alloc_L (
+toy_inline bool toy_is_stack_memory (toy_memory_stack_t* stack, uintptr_t ptr)
+{
+	return ptr >= stack->bottom && ptr < stack->bottom + stack->size;
+}
+
+
+// Commit left side up to top
+static bool toy_commit_stack_L (toy_memory_stack_t* stack, uintptr_t top)
+{
+	uintptr_t commit_top = (top + stack->vm->granule_size - 1) & ~(uintptr_t)(stack->vm->granule_size - 1);
+	if (!toy_commit_memory_vm(stack->vm, stack->commit_L, commit_top - stack->commit_L))
+		return false;
+	stack->commit_L = commit_top;
+	return true;
+}
+
+
+// Commit right side down to top
+static bool toy_commit_stack_R (toy_memory_stack_t* stack, uintptr_t top)
+{
+	uintptr_t commit_top = top & ~(uintptr_t)(stack->vm->granule_size - 1);
+	if (!toy_commit_memory_vm(stack->vm, commit_top, stack->commit_R - commit_top))
+		return false;
+	stack->commit_R = commit_top;
+	return true;
+}
+
+
+// Fallback when stack is full, block is linked to list and released by free or rollback
+static void* toy_stack_alloc_overflow (
 	toy_memory_stack_t* stack,
-	size_t size)
+	size_t size,
+	size_t alignment,
+	toy_memory_stack_overflow_t** list)
+{
+	if (NULL == stack->overflow_alc.alloc)
+		return NULL;
+
+	if (alignment < sizeof(void*))
+		alignment = sizeof(void*);
+	if (toy_unlikely(size > SIZE_MAX - sizeof(toy_memory_stack_overflow_t) - alignment))
+		return NULL;
+
+	uintptr_t memory = (uintptr_t)toy_alloc(&stack->overflow_alc, size + sizeof(toy_memory_stack_overflow_t) + alignment - 1);
+	if (toy_unlikely(NULL == (void*)memory))
+		return NULL;
+
+	uintptr_t ret = (memory + sizeof(toy_memory_stack_overflow_t) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	toy_memory_stack_overflow_t* block = (toy_memory_stack_overflow_t*)(ret - sizeof(toy_memory_stack_overflow_t));
+	block->memory = (void*)memory;
+	block->next = *list;
+	*list = block;
+	return (void*)ret;
+}
+
+
+static void toy_stack_free_overflow (
+	toy_memory_stack_t* stack,
+	void* memory,
+	toy_memory_stack_overflow_t** list)
+{
+	toy_memory_stack_overflow_t* block = (toy_memory_stack_overflow_t*)((uintptr_t)memory - sizeof(toy_memory_stack_overflow_t));
+	// Stack memory is freed in LIFO order, so is overflow memory
+	TOY_ASSERT(*list == block);
+	*list = block->next;
+	toy_free(&stack->overflow_alc, block->memory);
+}
+
+
+static void toy_stack_rollback_overflow (
+	toy_memory_stack_t* stack,
+	toy_memory_stack_overflow_t* until,
+	toy_memory_stack_overflow_t** list)
+{
+	while (*list != until) {
+		TOY_ASSERT(NULL != *list);
+		toy_memory_stack_overflow_t* block = *list;
+		*list = block->next;
+		toy_free(&stack->overflow_alc, block->memory);
+	}
+}
+
+
+void* toy_stack_alloc_aligned_L (
+	toy_memory_stack_t* stack,
+	size_t size,
+	size_t alignment)
 {
 	TOY_ASSERT(NULL != stack);
-	if (0 == size || size > toy_get_stack_unused_size(stack))
+	// assert alignment is 2^N
+	TOY_ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+	if (toy_unlikely(0 == size))
 		return NULL;
 
-	uintptr_t ret = stack->left_top;
-	stack->left_top += size;
+	uintptr_t ret = (stack->left_top + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	if (ret < stack->left_top || ret > stack->right_top || size > stack->right_top - ret)
+		return toy_stack_alloc_overflow(stack, size, alignment, &stack->overflow_L);
+	// Never true without vm, commit_L is the end of stack
+	if (toy_unlikely(ret + size > stack->commit_L) && !toy_commit_stack_L(stack, ret + size))
+		return toy_stack_alloc_overflow(stack, size, alignment, &stack->overflow_L);
+
+	stack->left_top = ret + size;
 	return (void*)ret;
 }
 
 
+void* toy_stack_alloc_L (
+	toy_memory_stack_t* stack,
+	size_t size)
+{
+	return toy_stack_alloc_aligned_L(stack, size, TOY_MEMORY_STACK_ALIGNMENT);
+}
+
+
 void toy_stack_free_L (
 	toy_memory_stack_t* stack,
 	void* memory)
 {
+	if (toy_unlikely(!toy_is_stack_memory(stack, (uintptr_t)memory))) {
+		toy_stack_free_overflow(stack, memory, &stack->overflow_L);
+		return;
+	}
 	TOY_ASSERT(((uintptr_t)memory < stack->left_top) && ((uintptr_t)memory >= stack->bottom));
 	stack->left_top = (uintptr_t)memory;
 }
 
 
-void* toy_stack_alloc_R (
+bool toy_stack_resize_L (
 	toy_memory_stack_t* stack,
-	size_t size)
+	void* memory,
+	size_t old_size,
+	size_t new_size)
 {
-	TOY_ASSERT(NULL != stack);
-	if (toy_unlikely(0 == size || size > stack->size))
-		return NULL;
+	TOY_ASSERT(NULL != stack && NULL != memory);
+	uintptr_t ptr = (uintptr_t)memory;
+	if (!toy_is_stack_memory(stack, ptr) || ptr + old_size != stack->left_top || 0 == new_size)
+		return false;
+	if (new_size > stack->right_top - ptr)
+		return false;
+	if (toy_unlikely(ptr + new_size > stack->commit_L) && !toy_commit_stack_L(stack, ptr + new_size))
+		return false;
+	stack->left_top = ptr + new_size;
+	return true;
+}
 
-	// make sure stack->right_top - size - sizeof(uintptr_t) >= 0
-	if (stack->right_top < size + sizeof(uintptr_t))
-		return NULL;
 
-	const size_t alignment = sizeof(uintptr_t);
-	uintptr_t ret = stack->right_top - size;
-	ret = ret & (~(alignment - 1));
+// Return aligned address of size bytes below right top, and reserve header bytes below it
+static uintptr_t toy_stack_take_R (
+	toy_memory_stack_t* stack,
+	size_t size,
+	size_t alignment,
+	size_t header)
+{
+	if (toy_unlikely(size > toy_get_stack_unused_size(stack)))
+		return (uintptr_t)NULL;
+
+	// stack->right_top - size >= stack->left_top > 0
+	uintptr_t ret = (stack->right_top - size) & ~(uintptr_t)(alignment - 1);
+	if (ret < stack->left_top || ret - stack->left_top < header)
+		return (uintptr_t)NULL;
+	// Never true without vm, commit_R is the bottom of stack
+	if (toy_unlikely(ret - header < stack->commit_R) && !toy_commit_stack_R(stack, ret - header))
+		return (uintptr_t)NULL;
+	return ret;
+}
+
 
-	if (ret < sizeof(uintptr_t) || ret - sizeof(uintptr_t) < stack->left_top)
+void* toy_stack_alloc_aligned_R (
+	toy_memory_stack_t* stack,
+	size_t size,
+	size_t alignment)
+{
+	TOY_ASSERT(NULL != stack);
+	// assert alignment is 2^N
+	TOY_ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+	if (toy_unlikely(0 == size))
 		return NULL;
 
+	// Keep saved top aligned
+	if (alignment < sizeof(uintptr_t))
+		alignment = sizeof(uintptr_t);
+
+	uintptr_t ret = toy_stack_take_R(stack, size, alignment, sizeof(uintptr_t));
+	if (toy_unlikely((uintptr_t)NULL == ret))
+		return toy_stack_alloc_overflow(stack, size, alignment, &stack->overflow_R);
+
 	uintptr_t new_top = ret - sizeof(uintptr_t);
 	uintptr_t* top_ptr = (uintptr_t*)new_top;
 	*top_ptr = stack->right_top;
@@ -134,11 +386,23 @@ void* toy_stack_alloc_R (
 }
 
 
+void* toy_stack_alloc_R (
+	toy_memory_stack_t* stack,
+	size_t size)
+{
+	return toy_stack_alloc_aligned_R(stack, size, TOY_MEMORY_STACK_ALIGNMENT);
+}
+
+
 void toy_stack_free_R (
 	toy_memory_stack_t* stack,
 	void* memory)
 {
 	uintptr_t ptr = (uintptr_t)memory;
+	if (toy_unlikely(!toy_is_stack_memory(stack, ptr))) {
+		toy_stack_free_overflow(stack, memory, &stack->overflow_R);
+		return;
+	}
 	TOY_ASSERT(ptr >= (sizeof(uintptr_t) + stack->right_top));
 
 	uintptr_t right_top = *((uintptr_t*)(ptr - sizeof(uintptr_t)));
@@ -147,6 +411,69 @@ void toy_stack_free_R (
 }
 
 
+void* toy_stack_push_R (
+	toy_memory_stack_t* stack,
+	size_t size,
+	size_t alignment)
+{
+	TOY_ASSERT(NULL != stack);
+	// assert alignment is 2^N
+	TOY_ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+	if (toy_unlikely(0 == size))
+		return NULL;
+
+	uintptr_t ret = toy_stack_take_R(stack, size, alignment, 0);
+	if (toy_unlikely((uintptr_t)NULL == ret))
+		return toy_stack_alloc_overflow(stack, size, alignment, &stack->overflow_R);
+
+	stack->right_top = ret;
+	return (void*)ret;
+}
+
+
+void toy_rollback_stack_L (
+	toy_memory_stack_t* stack,
+	toy_memory_stack_marker_t marker)
+{
+	TOY_ASSERT(NULL != stack);
+	TOY_ASSERT(marker.top >= stack->bottom && marker.top <= stack->left_top);
+	toy_stack_rollback_overflow(stack, marker.overflow, &stack->overflow_L);
+	stack->left_top = marker.top;
+}
+
+
+void toy_rollback_stack_R (
+	toy_memory_stack_t* stack,
+	toy_memory_stack_marker_t marker)
+{
+	TOY_ASSERT(NULL != stack);
+	TOY_ASSERT(marker.top >= stack->right_top && marker.top <= stack->bottom + stack->size);
+	toy_stack_rollback_overflow(stack, marker.overflow, &stack->overflow_R);
+	stack->right_top = marker.top;
+}
+
+
+void toy_clear_stack_L (toy_memory_stack_t* stack)
+{
+	toy_stack_rollback_overflow(stack, NULL, &stack->overflow_L);
+	stack->left_top = stack->bottom;
+}
+
+
+void toy_clear_stack_R (toy_memory_stack_t* stack)
+{
+	toy_stack_rollback_overflow(stack, NULL, &stack->overflow_R);
+	stack->right_top = stack->bottom + stack->size;
+}
+
+
+void toy_clear_stack (toy_memory_stack_t* stack)
+{
+	toy_clear_stack_L(stack);
+	toy_clear_stack_R(stack);
+}
+
+
 
 static toy_inline uintptr_t toy_get_memory_pool_block_addr (
 	toy_memory_pool_p pool,
@@ -169,41 +496,25 @@ void toy_init_memory_pool (
 	TOY_ASSERT(alignment == 0 || ((uintptr_t)memory % alignment) == 0);
 
 	output->next = NULL;
+	output->next_available = NULL;
 	output->alignment = alignment;
 	output->block_size = block_size;
 	output->block_count = block_count;
 	output->next_free_block_index = 0;
 	output->allocated_block_count = 0;
+	output->fresh_block_index = 0;
 	output->block_area = (uintptr_t)memory;
 	output->size = memory_size;
-
-	for (uint32_t i = 0; i < output->block_count; ++i) {
-		uint32_t* next_index_ptr = (uint32_t*)toy_get_memory_pool_block_addr(output, i);
-		*next_index_ptr = i + 1;
-	}
 }
 
 
-static toy_memory_pool_p toy_alloc_memory_pool (
-	size_t memory_size,
-	size_t block_size,
-	const toy_allocator_t* alc)
+// Blocks of 2^N size are aligned to their size
+static size_t toy_get_memory_pool_alignment (size_t block_size)
 {
-	TOY_ASSERT(NULL != alc);
-	TOY_ASSERT(block_size >= sizeof(uint32_t));
-
-	if (toy_unlikely(memory_size <= sizeof(toy_memory_pool_t) + sizeof(uint16_t)))
-		return NULL;
-
-	uintptr_t memory = (uintptr_t)toy_alloc(alc, memory_size);
-	if (toy_unlikely(NULL == (void*)memory))
-		return NULL;
-
-	toy_memory_pool_p pool = toy_padding_L(memory, sizeof(void*));
-
-	uintptr_t block_memory = (uintptr_t)pool + sizeof(toy_memory_pool_t);
 	size_t alignment;
-	if (block_size >= sizeof(float) * 16)
+	if ((block_size & (block_size - 1)) == 0)
+		alignment = block_size;
+	else if (block_size >= sizeof(float) * 16)
 		alignment = sizeof(float) * 16;
 	else if (block_size >= sizeof(float) * 4)
 		alignment = sizeof(float) * 4;
@@ -211,14 +522,33 @@ static toy_memory_pool_p toy_alloc_memory_pool (
 		alignment = sizeof(float) * 2;
 	else
 		alignment = sizeof(void*);
-	size_t padding = alignment - (block_memory & (alignment - 1));
-	block_memory = block_memory + padding;
+	if (alignment < sizeof(void*))
+		alignment = sizeof(void*);
+	return alignment;
+}
+
+
+// Pool header takes the head of segment
+static toy_memory_pool_p toy_alloc_memory_pool (
+	toy_memory_pool_chain_p chain)
+{
+	size_t segment_size = chain->segment_size;
+	size_t block_size = chain->block_size;
+	TOY_ASSERT(block_size >= sizeof(uint32_t));
+
+	size_t alignment = toy_get_memory_pool_alignment(block_size);
+	size_t header_size = (sizeof(toy_memory_pool_t) + alignment - 1) & ~(alignment - 1);
 
-	if (toy_unlikely(block_memory + block_size > memory + memory_size)) {
-		toy_free(alc, (void*)memory);
+	if (toy_unlikely(header_size + block_size > segment_size))
 		return NULL;
-	}
-	size_t block_memory_size = (uintptr_t)memory + memory_size - block_memory;
+
+	uintptr_t memory = (uintptr_t)toy_alloc_chain_segment(chain->vm, &chain->vm_top, segment_size);
+	if (toy_unlikely(NULL == (void*)memory))
+		return NULL;
+
+	toy_memory_pool_p pool = (toy_memory_pool_p)memory;
+	uintptr_t block_memory = memory + header_size;
+	size_t block_memory_size = segment_size - header_size;
 	uint64_t block_count = block_memory_size / block_size;
 	TOY_ASSERT(block_count < UINT32_MAX);
 	toy_init_memory_pool((toy_aligned_p)block_memory, block_memory_size, block_size, (uint32_t)block_count, alignment, pool);
@@ -226,12 +556,10 @@ static toy_memory_pool_p toy_alloc_memory_pool (
 }
 
 
-static void toy_free_memory_pool (
-	toy_memory_pool_p pool,
-	const toy_allocator_t* alc)
+static void toy_free_memory_pool (toy_memory_pool_chain_p chain, toy_memory_pool_p pool)
 {
-	TOY_ASSERT(NULL != pool && NULL != alc);
-	toy_free(alc, toy_unpadding_L(pool));
+	TOY_ASSERT(NULL != pool);
+	toy_free_chain_segment(chain->vm, pool);
 }
 
 
@@ -246,19 +574,23 @@ void* toy_pool_block_alloc (toy_memory_pool_p pool, size_t size)
 
 	uint32_t* next_index_ptr = (uint32_t*)toy_get_memory_pool_block_addr(pool, pool->next_free_block_index);
 
-	pool->next_free_block_index = *next_index_ptr;
+	// Free list ends at the first fresh block, link fresh blocks lazily so their pages are untouched
+	if (pool->next_free_block_index == pool->fresh_block_index)
+		pool->next_free_block_index = ++(pool->fresh_block_index);
+	else
+		pool->next_free_block_index = *next_index_ptr;
 	++(pool->allocated_block_count);
 
 	return next_index_ptr;
 }
 
 
+// block may point into the block, see toy_pools_alloc_aligned()
 void toy_pool_block_free (toy_memory_pool_p pool, void* block)
 {
 	TOY_ASSERT(pool->allocated_block_count > 0);
 	uintptr_t ptr = (uintptr_t)block;
 	TOY_ASSERT(ptr >= pool->block_area && ptr < (pool->block_area + pool->block_size * pool->block_count));
-	TOY_ASSERT((ptr - pool->block_area) % pool->block_size == 0);
 
 	uint32_t block_index = (uint32_t)((ptr - pool->block_area) / pool->block_size);
 	uint32_t* next_index_ptr = (uint32_t*)toy_get_memory_pool_block_addr(pool, block_index);
@@ -269,30 +601,76 @@ void toy_pool_block_free (toy_memory_pool_p pool, void* block)
 
 
 
-#define TOY_MEMORY_AVAIL_TAG_BIT (UINT64_C(1) << 63)
+// Free block links are stored in the free block itself, allocated blocks have no header
+typedef struct toy_buddy_free_block_t {
+	struct toy_buddy_free_block_t* prev;
+	struct toy_buddy_free_block_t* next;
+}toy_buddy_free_block_t, * toy_buddy_free_block_p;
+
+// Each byte of block_states describes one smallest block,
+// the byte of the first smallest block in a block holds the order and tag of the whole block
+#define TOY_MEMORY_BUDDY_STATE_ORDER_MASK 0x3f
+#define TOY_MEMORY_BUDDY_STATE_FREE 0x40
+#define TOY_MEMORY_BUDDY_STATE_USED 0x80
+
+
+static toy_inline uint8_t* toy_get_buddy_block_state (toy_memory_buddy_t* buddy, uintptr_t block) {
+	return &buddy->block_states[(block - buddy->memory) >> buddy->shift];
+}
+
+
+static toy_inline void toy_push_buddy_free_block (
+	toy_memory_buddy_t* buddy,
+	int order,
+	uintptr_t block)
+{
+	toy_buddy_free_block_p free_block = (toy_buddy_free_block_p)block;
+	toy_buddy_free_block_p head = (toy_buddy_free_block_p)buddy->heads[order];
+	free_block->prev = NULL;
+	free_block->next = head;
+	if (NULL != head)
+		head->prev = free_block;
+	buddy->heads[order] = block;
+	buddy->order_bitmap |= UINT32_C(1) << order;
+	*toy_get_buddy_block_state(buddy, block) = (uint8_t)(order | TOY_MEMORY_BUDDY_STATE_FREE);
+}
+
 
-typedef struct toy_buddy_block_header_t {
-	struct toy_buddy_block_header_t* prev;
-	struct toy_buddy_block_header_t* next;
-	uint64_t size; // use the highest bit as tag, 0-unused, 1-used
-}toy_buddy_block_header_t, * toy_buddy_block_header_p;
+static toy_inline void toy_remove_buddy_free_block (
+	toy_memory_buddy_t* buddy,
+	int order,
+	uintptr_t block)
+{
+	toy_buddy_free_block_p free_block = (toy_buddy_free_block_p)block;
+	if (NULL != free_block->next)
+		free_block->next->prev = free_block->prev;
+	if (NULL != free_block->prev)
+		free_block->prev->next = free_block->next;
+	else
+		buddy->heads[order] = (uintptr_t)free_block->next;
+	if ((uintptr_t)NULL == buddy->heads[order])
+		buddy->order_bitmap &= ~(UINT32_C(1) << order);
+}
 
 
-typedef struct toy_buddy_block_footer_t {
-	uint64_t size; // use the highest bit as tag, 0-unused, 1-used
-}toy_buddy_block_footer_t, * toy_buddy_block_footer_p;
+// Commit free block header, the block itself is committed when allocated
+static toy_inline bool toy_commit_buddy_free_block (toy_memory_buddy_t* buddy, uintptr_t block) {
+	return NULL == buddy->vm || toy_commit_memory_vm(buddy->vm, block, sizeof(toy_buddy_free_block_t));
+}
 
 
 void toy_init_buddy_allocator (
 	toy_aligned_p memory,
 	size_t memory_size,
 	uint32_t order_shift,
+	toy_memory_vm_t* vm,
 	toy_memory_buddy_t* output)
 {
 	TOY_ASSERT(order_shift > 6 && order_shift < 32);
 	// assert memory_size is 2^N
 	TOY_ASSERT(NULL != memory && memory_size > (UINT64_C(1) << order_shift));
 	TOY_ASSERT((memory_size & (memory_size - 1)) == 0);
+	TOY_ASSERT(memory_size < (UINT64_C(1) << TOY_MEMORY_BUDDY_ORDER_MAX));
 
 	// assert memory is aligned as sizeof(void*)
 	TOY_ASSERT(0 == ((uintptr_t)memory & (sizeof(void*) - 1)));
@@ -301,171 +679,201 @@ void toy_init_buddy_allocator (
 	output->size = memory_size;
 	output->shift = order_shift;
 	output->max_order = toy_fls(memory_size);
-	for (int i = 0; i < TOY_MEMORY_BUDDY_ORDER_MAX; ++i) {
+	output->order_bitmap = 0;
+	for (int i = 0; i < TOY_MEMORY_BUDDY_ORDER_MAX; ++i)
 		output->heads[i] = (uintptr_t)NULL;
-		if ((UINT64_C(1) << i) == memory_size) {
-			toy_buddy_block_header_p header = (toy_buddy_block_header_p)memory;
-			header->prev = NULL;
-			header->next = NULL;
-			header->size = memory_size;
-			toy_buddy_block_footer_p footer = (toy_buddy_block_footer_p)((uintptr_t)memory + header->size - sizeof(toy_buddy_block_footer_t));
-			footer->size = memory_size;
-			output->heads[i] = (uintptr_t)header;
-		}
+	output->vm = vm;
+
+	// Block state table takes the tail smallest blocks, which are never freed
+	const size_t block_size = (size_t)1 << order_shift;
+	const size_t state_count = memory_size >> order_shift;
+	const size_t state_size = (state_count + block_size - 1) & ~(block_size - 1);
+	const uintptr_t limit = output->memory + memory_size - state_size;
+	output->block_states = (uint8_t*)limit;
+	if (NULL != vm && !toy_commit_memory_vm(vm, limit, state_size)) {
+		// Nothing is available
+		output->max_order = 0;
+		return;
+	}
+	for (size_t i = (limit - output->memory) >> order_shift; i < state_count; ++i)
+		output->block_states[i] = (uint8_t)(order_shift | TOY_MEMORY_BUDDY_STATE_USED);
+
+	// Cover the rest with the biggest aligned blocks
+	uintptr_t block = output->memory;
+	int order = output->max_order - 1;
+	while (block < limit) {
+		while ((block - output->memory) & (((size_t)1 << order) - 1) || block + ((size_t)1 << order) > limit)
+			--order;
+		if (!toy_commit_buddy_free_block(output, block))
+			break;
+		toy_push_buddy_free_block(output, order, block);
+		block += (size_t)1 << order;
 	}
 }
 
 
-static int toy_break_buddy_block (
+void* toy_buddy_alloc (
 	toy_memory_buddy_t* buddy,
-	int order,
-	size_t dst_size)
+	size_t size)
 {
-	TOY_ASSERT((UINT64_C(1) << order) >= dst_size);
-	while ((UINT64_C(1) << (order - 1)) > dst_size) {
-		if (order - 1 < buddy->shift)
-			break;
-
-		toy_buddy_block_header_t* left = (toy_buddy_block_header_t*)buddy->heads[order];
-		size_t order_size = UINT64_C(1) << (order - 1);
-
-		toy_buddy_block_header_t* right = (toy_buddy_block_header_t*)((uintptr_t)left + order_size);
-		right->size = order_size;
-		left->size = order_size;
+	if (toy_unlikely(0 == size))
+		return NULL;
 
-		toy_buddy_block_footer_p left_footer = (toy_buddy_block_footer_p)((uintptr_t)left + order_size - sizeof(toy_buddy_block_footer_t));
-		left_footer->size = order_size;
-		toy_buddy_block_footer_p right_footer = (toy_buddy_block_footer_p)((uintptr_t)right + order_size - sizeof(toy_buddy_block_footer_t));
-		right_footer->size = order_size;
+	int order = size <= ((size_t)1 << buddy->shift) ? buddy->shift : toy_fls(size - 1);
+	if (toy_unlikely(order >= buddy->max_order))
+		return NULL;
 
-		buddy->heads[order] = (uintptr_t)(left->next);
-		if (NULL != left->next)
-			left->next->prev = NULL;
-		left->next = (toy_buddy_block_header_t*)buddy->heads[order - 1];
-		right->next = left;
-		left->prev = right;
-		buddy->heads[order - 1] = (uintptr_t)right;
-		right->prev = NULL;
+	// Smallest non-empty order that fits
+	uint32_t order_map = buddy->order_bitmap & (~UINT32_C(0) << order);
+	if (0 == order_map)
+		return NULL;
+	int i = toy_ffs(order_map) - 1;
+
+	uintptr_t block = buddy->heads[i];
+	if (NULL != buddy->vm) {
+		// Commit the block and headers of right halves before touching anything
+		if (!toy_commit_memory_vm(buddy->vm, block, (size_t)1 << order))
+			return NULL;
+		for (int j = order; j < i; ++j) {
+			if (!toy_commit_buddy_free_block(buddy, block + ((size_t)1 << j)))
+				return NULL;
+		}
+	}
+	toy_remove_buddy_free_block(buddy, i, block);
 
-		--order;
+	// Break block, keep left half and give right half back
+	while (i > order) {
+		--i;
+		toy_push_buddy_free_block(buddy, i, block + ((size_t)1 << i));
 	}
 
-	return order;
+	*toy_get_buddy_block_state(buddy, block) = (uint8_t)(order | TOY_MEMORY_BUDDY_STATE_USED);
+	return (void*)block;
 }
 
 
-void* toy_buddy_alloc (
+void toy_buddy_free (
 	toy_memory_buddy_t* buddy,
-	size_t size)
+	void* memory)
 {
-	size_t real_size = sizeof(toy_buddy_block_header_t) + size + sizeof(toy_buddy_block_footer_t);
-
-	for (int i = buddy->shift; i < buddy->max_order; ++i) {
-		if ((UINT64_C(1) << i) < real_size || (uintptr_t)NULL == buddy->heads[i])
-			continue;
+	if (NULL == memory)
+		return;
 
-		int order = toy_break_buddy_block(buddy, i, real_size);
+	uintptr_t block = (uintptr_t)memory;
+	TOY_ASSERT(block >= buddy->memory && block < (uintptr_t)buddy->block_states);
 
-		toy_buddy_block_header_p header = (toy_buddy_block_header_p)buddy->heads[order];
-		buddy->heads[order] = (uintptr_t)header->next;
-		if (NULL != header->next)
-			header->next->prev = NULL;
+	uint8_t* state = toy_get_buddy_block_state(buddy, block);
+	TOY_ASSERT(*state & TOY_MEMORY_BUDDY_STATE_USED);
+	int order = *state & TOY_MEMORY_BUDDY_STATE_ORDER_MASK;
+	TOY_ASSERT(0 == ((block - buddy->memory) & (((size_t)1 << order) - 1)));
 
-		toy_buddy_block_footer_p footer = (toy_buddy_block_footer_p)((uintptr_t)header + header->size - sizeof(toy_buddy_block_footer_t));
-		header->size |= TOY_MEMORY_AVAIL_TAG_BIT;
-		footer->size |= TOY_MEMORY_AVAIL_TAG_BIT;
+	// Merge with buddy block while it is free as a whole
+	while (order + 1 < buddy->max_order) {
+		uintptr_t buddy_block = buddy->memory + ((block - buddy->memory) ^ ((size_t)1 << order));
+		if (*toy_get_buddy_block_state(buddy, buddy_block) != (uint8_t)(order | TOY_MEMORY_BUDDY_STATE_FREE))
+			break;
 
-		uintptr_t ret = (uintptr_t)header + sizeof(toy_buddy_block_header_t);
-		return (void*)ret;
+		toy_remove_buddy_free_block(buddy, order, buddy_block);
+		if (buddy_block < block)
+			block = buddy_block;
+		++order;
 	}
 
-	return NULL;
+	toy_push_buddy_free_block(buddy, order, block);
 }
 
 
-static void toy_merge_buddy_block (
+void* toy_buddy_alloc_aligned (
 	toy_memory_buddy_t* buddy,
-	int order,
-	toy_buddy_block_header_p header,
-	toy_buddy_block_footer_p footer)
-{
-	TOY_ASSERT(order < TOY_MEMORY_BUDDY_ORDER_MAX);
-	TOY_ASSERT(NULL != header && NULL != footer);
-	TOY_ASSERT(header->size == footer->size);
-	while (order < TOY_MEMORY_BUDDY_ORDER_MAX - 1) {
-		uintptr_t offset = (uintptr_t)header - buddy->memory;
-
-		size_t mask = (UINT64_C(1) << (order + 1)) - 1;
-		size_t mod = offset & mask;
-		TOY_ASSERT((mod & (mod - 1)) == 0); // assert mod is 2^N
-		toy_buddy_block_header_p buddy_header;
-		toy_buddy_block_footer_p buddy_footer;
-		if (!!mod) { // buddy block is left one
-			if ((uintptr_t)header <= buddy->memory)
-				break;
-			buddy_footer = (toy_buddy_block_footer_p)((uintptr_t)header - sizeof(toy_buddy_block_footer_t));
-			if (buddy_footer->size != header->size)
-				break;
-
-			buddy_header = (toy_buddy_block_header_p)((uintptr_t)header - buddy_footer->size);
-			header = buddy_header;
-		}
-		else { // buddy block is right one
-			if (offset + header->size >= buddy->memory + buddy->size)
-				break;
-			buddy_header = (toy_buddy_block_header_p)((uintptr_t)header + header->size);
-			if (buddy_header->size != header->size)
-				break;
-
-			buddy_footer = (toy_buddy_block_footer_p)((uintptr_t)buddy_header + buddy_header->size - sizeof(toy_buddy_block_footer_t));
-			footer = buddy_footer;
-		}
+	size_t size,
+	size_t alignment)
+{
+	// assert alignment is 2^N
+	TOY_ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+	// Blocks are aligned to their size from the base of buddy memory
+	uintptr_t base_alignment = buddy->memory & (~buddy->memory + 1);
+	if (toy_unlikely(alignment > base_alignment))
+		return NULL;
+	return toy_buddy_alloc(buddy, size > alignment ? size : alignment);
+}
 
-		TOY_ASSERT(buddy_header->size == buddy_footer->size);
 
-		if (NULL != buddy_header->next)
-			buddy_header->next->prev = buddy_header->prev;
-		if (NULL != buddy_header->prev)
-			buddy_header->prev->next = buddy_header->next;
-		if (buddy->heads[order] == (uintptr_t)buddy_header)
-			buddy->heads[order] = (uintptr_t)buddy_header->next;
+bool toy_buddy_resize (
+	toy_memory_buddy_t* buddy,
+	void* memory,
+	size_t old_size,
+	size_t new_size)
+{
+	TOY_ASSERT(NULL != memory);
+	if (toy_unlikely(0 == new_size))
+		return false;
+
+	uintptr_t block = (uintptr_t)memory;
+	uint8_t* state = toy_get_buddy_block_state(buddy, block);
+	TOY_ASSERT(*state & TOY_MEMORY_BUDDY_STATE_USED);
+	int order = *state & TOY_MEMORY_BUDDY_STATE_ORDER_MASK;
+	int new_order = new_size <= ((size_t)1 << buddy->shift) ? buddy->shift : toy_fls(new_size - 1);
+
+	if (new_order <= order) {
+		// Give right halves back, their buddies are still used so nothing is merged
+		while (order > new_order) {
+			--order;
+			toy_push_buddy_free_block(buddy, order, block + ((size_t)1 << order));
+		}
+		*state = (uint8_t)(order | TOY_MEMORY_BUDDY_STATE_USED);
+		return true;
+	}
 
-		size_t order_size = UINT64_C(1) << (++order);
-		header->size = order_size;
-		footer->size = order_size;
+	// Grow when block is the left half of every bigger block on the way and each right half is free as a whole
+	if (new_order >= buddy->max_order || 0 != ((block - buddy->memory) & (((size_t)1 << new_order) - 1)))
+		return false;
+	for (int i = order; i < new_order; ++i) {
+		if (*toy_get_buddy_block_state(buddy, block + ((size_t)1 << i)) != (uint8_t)(i | TOY_MEMORY_BUDDY_STATE_FREE))
+			return false;
 	}
+	if (NULL != buddy->vm && !toy_commit_memory_vm(buddy->vm, block, (size_t)1 << new_order))
+		return false;
 
-	header->next = (toy_buddy_block_header_p)buddy->heads[order];
-	header->prev = NULL;
-	if ((uintptr_t)NULL != buddy->heads[order])
-		((toy_buddy_block_header_p)(buddy->heads[order]))->prev = header;
-	buddy->heads[order] = (uintptr_t)header;
+	for (int i = order; i < new_order; ++i)
+		toy_remove_buddy_free_block(buddy, i, block + ((size_t)1 << i));
+	*state = (uint8_t)(new_order | TOY_MEMORY_BUDDY_STATE_USED);
+	return true;
 }
 
 
-void toy_buddy_free (
+size_t toy_get_buddy_usable_size (
 	toy_memory_buddy_t* buddy,
 	void* memory)
 {
-	uintptr_t ptr = (uintptr_t)memory;
-	TOY_ASSERT((ptr < (uintptr_t)(buddy->memory) + buddy->size) && (ptr > (uintptr_t)(buddy->memory)));
+	uint8_t state = *toy_get_buddy_block_state(buddy, (uintptr_t)memory);
+	TOY_ASSERT(state & TOY_MEMORY_BUDDY_STATE_USED);
+	return (size_t)1 << (state & TOY_MEMORY_BUDDY_STATE_ORDER_MASK);
+}
+
 
-	toy_buddy_block_header_p header = (toy_buddy_block_header_p)(ptr - sizeof(toy_buddy_block_header_t));
+void toy_reset_buddy_allocator (toy_memory_buddy_t* buddy)
+{
+	toy_init_buddy_allocator((toy_aligned_p)buddy->memory, buddy->size, buddy->shift, buddy->vm, buddy);
+}
 
-	const size_t block_size = header->size & ~TOY_MEMORY_AVAIL_TAG_BIT;
-	toy_buddy_block_footer_p footer = (toy_buddy_block_footer_p)((uintptr_t)header + block_size - sizeof(toy_buddy_block_footer_t));
-	TOY_ASSERT(footer->size == header->size);
-	header->size = block_size;
-	footer->size = block_size;
 
-	for (int i = buddy->shift; i < buddy->max_order; ++i) {
-		if ((UINT64_C(1) << i) == header->size) {
-			toy_merge_buddy_block(buddy, i, header, footer);
-			return;
+void toy_get_memory_buddy_free_info (toy_memory_buddy_p buddy, toy_memory_free_info_t* output)
+{
+	output->total_free_size = 0;
+	output->largest_free_size = 0;
+	output->free_block_count = 0;
+
+	uint32_t order_map = buddy->order_bitmap;
+	while (0 != order_map) {
+		int order = toy_ffs(order_map) - 1;
+		order_map &= order_map - 1;
+		for (toy_buddy_free_block_p block = (toy_buddy_free_block_p)buddy->heads[order]; NULL != block; block = block->next) {
+			output->total_free_size += (size_t)1 << order;
+			++(output->free_block_count);
 		}
+		output->largest_free_size = (size_t)1 << order;
 	}
-
-	TOY_ASSERT(0);
 }
 
 
@@ -494,39 +902,36 @@ void toy_init_memory_list (
 	header->size = memory_size - padding;
 
 	output->next = NULL;
+	output->next_available = NULL;
 	output->memory = (uintptr_t)memory;
 	output->size = memory_size;
 	output->free_list = (uintptr_t)header;
 }
 
 
-static toy_memory_list_p toy_alloc_memory_list (
-	size_t memory_size,
-	toy_allocator_t* alc)
+// List header takes the head of segment
+static toy_memory_list_p toy_alloc_memory_list (toy_memory_list_chain_p chain)
 {
-	TOY_ASSERT(NULL != alc);
-
-	if (toy_unlikely(memory_size <= sizeof(toy_memory_list_t) + sizeof(uint16_t)))
+	size_t segment_size = chain->segment_size;
+	if (toy_unlikely(segment_size <= sizeof(toy_memory_list_t) + sizeof(toy_memory_list_chunk_header_t)))
 		return NULL;
 
-	uintptr_t memory = (uintptr_t)toy_alloc(alc, memory_size);
+	uintptr_t memory = (uintptr_t)toy_alloc_chain_segment(chain->vm, &chain->vm_top, segment_size);
 	if (toy_unlikely(NULL == (void*)memory))
 		return NULL;
 
-	toy_memory_list_p list = toy_padding_L(memory, sizeof(void*));
-	uintptr_t list_memory = (uintptr_t)list + sizeof(toy_memory_list_t);
-	size_t list_memory_size = memory + memory_size - list_memory;
+	toy_memory_list_p list = (toy_memory_list_p)memory;
+	uintptr_t list_memory = memory + sizeof(toy_memory_list_t);
+	size_t list_memory_size = segment_size - sizeof(toy_memory_list_t);
 	toy_init_memory_list((void*)list_memory, list_memory_size, list);
 	return list;
 }
 
 
-static void toy_free_memory_list (
-	toy_memory_list_p list,
-	toy_allocator_t* alc)
+static void toy_free_memory_list (toy_memory_list_chain_p chain, toy_memory_list_p list)
 {
-	TOY_ASSERT(NULL != list && NULL != alc);
-	toy_free(alc, toy_unpadding_L(list));
+	TOY_ASSERT(NULL != list);
+	toy_free_chain_segment(chain->vm, list);
 }
 
 
@@ -610,106 +1015,854 @@ void toy_list_chunk_free (toy_memory_list_p list, toy_aligned_p memory)
 
 
 
-#include <stdlib.h>
-static void* toy_std_alloc (void* ctx, size_t size_in_byte) { return malloc(size_in_byte); }
-static void toy_std_free (void* ctx, void* mem) { free(mem); }
+// TLSF block, the user memory starts right after "size".
+// "prev_physical" is stored in the last word of previous block, valid only when previous block is free.
+// "next_free" and "prev_free" are valid only when this block is free.
+typedef struct toy_memory_tlsf_block_t {
+	struct toy_memory_tlsf_block_t* prev_physical;
+	size_t size; // user memory size, use the lowest 2 bits as tag: bit0-this block is free, bit1-prev block is free
+	struct toy_memory_tlsf_block_t* next_free;
+	struct toy_memory_tlsf_block_t* prev_free;
+}toy_memory_tlsf_block_t, *toy_memory_tlsf_block_p;
 
-toy_allocator_t toy_std_alc () {
+#define TOY_MEMORY_TLSF_ALIGNMENT sizeof(uint64_t)
+#define TOY_MEMORY_TLSF_BLOCK_FREE_BIT ((size_t)1)
+#define TOY_MEMORY_TLSF_PREV_FREE_BIT ((size_t)2)
+#define TOY_MEMORY_TLSF_SIZE_MASK (~(TOY_MEMORY_TLSF_BLOCK_FREE_BIT | TOY_MEMORY_TLSF_PREV_FREE_BIT))
+#define TOY_MEMORY_TLSF_OVERHEAD sizeof(size_t)
+#define TOY_MEMORY_TLSF_USER_OFFSET (offsetof(toy_memory_tlsf_block_t, size) + sizeof(size_t))
+#define TOY_MEMORY_TLSF_BLOCK_MIN (sizeof(toy_memory_tlsf_block_t) - sizeof(toy_memory_tlsf_block_p))
+#define TOY_MEMORY_TLSF_BLOCK_MAX (((size_t)1 << (TOY_MEMORY_TLSF_FL_MAX - 1)) - 1)
+#define TOY_MEMORY_TLSF_SMALL_BLOCK ((size_t)1 << TOY_MEMORY_TLSF_FL_SHIFT)
+
+
+static toy_inline size_t toy_get_tlsf_block_size (const toy_memory_tlsf_block_p block) {
+	return block->size & TOY_MEMORY_TLSF_SIZE_MASK;
+}
+
+static toy_inline void* toy_get_tlsf_block_memory (const toy_memory_tlsf_block_p block) {
+	return (void*)((uintptr_t)block + TOY_MEMORY_TLSF_USER_OFFSET);
+}
+
+static toy_inline toy_memory_tlsf_block_p toy_get_tlsf_block (const void* memory) {
+	return (toy_memory_tlsf_block_p)((uintptr_t)memory - TOY_MEMORY_TLSF_USER_OFFSET);
+}
+
+static toy_inline toy_memory_tlsf_block_p toy_get_tlsf_next_block (const toy_memory_tlsf_block_p block) {
+	return (toy_memory_tlsf_block_p)((uintptr_t)toy_get_tlsf_block_memory(block) + toy_get_tlsf_block_size(block) - TOY_MEMORY_TLSF_OVERHEAD);
+}
+
+// Link next physical block back to this one, return next physical block
+static toy_inline toy_memory_tlsf_block_p toy_link_tlsf_next_block (toy_memory_tlsf_block_p block) {
+	toy_memory_tlsf_block_p next = toy_get_tlsf_next_block(block);
+	next->prev_physical = block;
+	return next;
+}
+
+
+static void toy_tlsf_mapping (size_t size, int* fl, int* sl)
+{
+	if (size < TOY_MEMORY_TLSF_SMALL_BLOCK) {
+		*fl = 0;
+		*sl = (int)(size / (TOY_MEMORY_TLSF_SMALL_BLOCK / TOY_MEMORY_TLSF_SL_COUNT));
+	}
+	else {
+		int f = toy_fls(size) - 1;
+		*sl = (int)(size >> (f - TOY_MEMORY_TLSF_SL_COUNT_LOG2)) ^ (1 << TOY_MEMORY_TLSF_SL_COUNT_LOG2);
+		*fl = f - (TOY_MEMORY_TLSF_FL_SHIFT - 1);
+	}
+}
+
+
+// Round size up to next list, every block in that list is big enough
+static void toy_tlsf_mapping_search (size_t size, int* fl, int* sl)
+{
+	if (size >= TOY_MEMORY_TLSF_SMALL_BLOCK)
+		size += ((size_t)1 << (toy_fls(size) - 1 - TOY_MEMORY_TLSF_SL_COUNT_LOG2)) - 1;
+	toy_tlsf_mapping(size, fl, sl);
+}
+
+
+static void toy_insert_tlsf_free_block (toy_memory_tlsf_t* tlsf, toy_memory_tlsf_block_p block)
+{
+	int fl, sl;
+	toy_tlsf_mapping(toy_get_tlsf_block_size(block), &fl, &sl);
+	TOY_ASSERT(fl < TOY_MEMORY_TLSF_FL_COUNT);
+
+	toy_memory_tlsf_block_p head = (toy_memory_tlsf_block_p)tlsf->heads[fl][sl];
+	block->next_free = head;
+	block->prev_free = NULL;
+	if (NULL != head)
+		head->prev_free = block;
+	tlsf->heads[fl][sl] = (uintptr_t)block;
+	tlsf->fl_bitmap |= UINT32_C(1) << fl;
+	tlsf->sl_bitmap[fl] |= UINT32_C(1) << sl;
+}
+
+
+static void toy_remove_tlsf_free_block (toy_memory_tlsf_t* tlsf, toy_memory_tlsf_block_p block)
+{
+	int fl, sl;
+	toy_tlsf_mapping(toy_get_tlsf_block_size(block), &fl, &sl);
+
+	if (NULL != block->next_free)
+		block->next_free->prev_free = block->prev_free;
+	if (NULL != block->prev_free)
+		block->prev_free->next_free = block->next_free;
+
+	if ((uintptr_t)block == tlsf->heads[fl][sl]) {
+		tlsf->heads[fl][sl] = (uintptr_t)block->next_free;
+		if (NULL == block->next_free) {
+			tlsf->sl_bitmap[fl] &= ~(UINT32_C(1) << sl);
+			if (0 == tlsf->sl_bitmap[fl])
+				tlsf->fl_bitmap &= ~(UINT32_C(1) << fl);
+		}
+	}
+}
+
+
+void toy_init_memory_tlsf (toy_memory_tlsf_t* output)
+{
+	output->fl_bitmap = 0;
+	for (int i = 0; i < TOY_MEMORY_TLSF_FL_COUNT; ++i) {
+		output->sl_bitmap[i] = 0;
+		for (int j = 0; j < TOY_MEMORY_TLSF_SL_COUNT; ++j)
+			output->heads[i][j] = (uintptr_t)NULL;
+	}
+	output->regions = NULL;
+	output->region_size = 0;
+	output->vm = NULL;
+	output->vm_top = (uintptr_t)NULL;
+}
+
+
+// memory must be aligned as sizeof(void*), caller owns memory
+bool toy_add_memory_tlsf_region (
+	toy_memory_tlsf_t* tlsf,
+	void* memory,
+	size_t memory_size)
+{
+	TOY_ASSERT(NULL != tlsf && NULL != memory);
+	// assert memory is aligned as sizeof(void*)
+	TOY_ASSERT(0 == ((uintptr_t)memory & (sizeof(void*) - 1)));
+
+	// Leave space for block size and the sentinel block size
+	size_t size = (memory_size & ~(TOY_MEMORY_TLSF_ALIGNMENT - 1));
+	if (toy_unlikely(size < 2 * TOY_MEMORY_TLSF_OVERHEAD + TOY_MEMORY_TLSF_BLOCK_MIN))
+		return false;
+	size -= 2 * TOY_MEMORY_TLSF_OVERHEAD;
+	if (size > TOY_MEMORY_TLSF_BLOCK_MAX)
+		size = TOY_MEMORY_TLSF_BLOCK_MAX & ~(TOY_MEMORY_TLSF_ALIGNMENT - 1);
+
+	// "prev_physical" of first block is outside of memory, it is never accessed
+	toy_memory_tlsf_block_p block = (toy_memory_tlsf_block_p)((uintptr_t)memory - TOY_MEMORY_TLSF_OVERHEAD);
+	block->size = size | TOY_MEMORY_TLSF_BLOCK_FREE_BIT;
+	toy_insert_tlsf_free_block(tlsf, block);
+
+	// Zero-sized used sentinel, stop merging at the end of region
+	toy_memory_tlsf_block_p sentinel = toy_link_tlsf_next_block(block);
+	sentinel->size = TOY_MEMORY_TLSF_PREV_FREE_BIT;
+	return true;
+}
+
+
+// Size of user memory of a block
+static toy_inline size_t toy_adjust_tlsf_size (size_t size) {
+	size = (size + TOY_MEMORY_TLSF_ALIGNMENT - 1) & ~(TOY_MEMORY_TLSF_ALIGNMENT - 1);
+	return size < TOY_MEMORY_TLSF_BLOCK_MIN ? TOY_MEMORY_TLSF_BLOCK_MIN : size;
+}
+
+
+// Give the tail of a used block beyond size back as a free block, size is adjusted
+static void toy_trim_tlsf_used_block (
+	toy_memory_tlsf_t* tlsf,
+	toy_memory_tlsf_block_p block,
+	size_t size)
+{
+	size_t block_size = toy_get_tlsf_block_size(block);
+	if (block_size < size + sizeof(toy_memory_tlsf_block_t))
+		return;
+
+	toy_memory_tlsf_block_p remaining = (toy_memory_tlsf_block_p)((uintptr_t)toy_get_tlsf_block_memory(block) + size - TOY_MEMORY_TLSF_OVERHEAD);
+	remaining->size = (block_size - size - TOY_MEMORY_TLSF_OVERHEAD) | TOY_MEMORY_TLSF_BLOCK_FREE_BIT;
+	block->size = size | (block->size & TOY_MEMORY_TLSF_PREV_FREE_BIT);
+
+	// Unlike a split in alloc, next block of a used block may be free
+	toy_memory_tlsf_block_p next = toy_get_tlsf_next_block(remaining);
+	if (next->size & TOY_MEMORY_TLSF_BLOCK_FREE_BIT) {
+		toy_remove_tlsf_free_block(tlsf, next);
+		remaining->size += toy_get_tlsf_block_size(next) + TOY_MEMORY_TLSF_OVERHEAD;
+	}
+	toy_link_tlsf_next_block(remaining)->size |= TOY_MEMORY_TLSF_PREV_FREE_BIT;
+	toy_insert_tlsf_free_block(tlsf, remaining);
+}
+
+
+void* toy_tlsf_alloc (
+	toy_memory_tlsf_t* tlsf,
+	size_t size)
+{
+	if (toy_unlikely(0 == size || size > TOY_MEMORY_TLSF_BLOCK_MAX / 2))
+		return NULL;
+
+	size = toy_adjust_tlsf_size(size);
+
+	int fl, sl;
+	toy_tlsf_mapping_search(size, &fl, &sl);
+
+	uint32_t sl_map = tlsf->sl_bitmap[fl] & (~UINT32_C(0) << sl);
+	if (0 == sl_map) {
+		uint32_t fl_map = tlsf->fl_bitmap & (~UINT32_C(0) << (fl + 1));
+		if (0 == fl_map)
+			return NULL;
+		fl = toy_ffs(fl_map) - 1;
+		sl_map = tlsf->sl_bitmap[fl];
+	}
+	sl = toy_ffs(sl_map) - 1;
+
+	toy_memory_tlsf_block_p block = (toy_memory_tlsf_block_p)tlsf->heads[fl][sl];
+	TOY_ASSERT(NULL != block && toy_get_tlsf_block_size(block) >= size);
+
+	// Commit user memory and header of the remaining part, headers of existing blocks are committed
+	if (NULL != tlsf->vm && toy_is_memory_in_vm(tlsf->vm, (uintptr_t)block)) {
+		uintptr_t end = (uintptr_t)toy_get_tlsf_block_memory(block) + size - TOY_MEMORY_TLSF_OVERHEAD + sizeof(toy_memory_tlsf_block_t);
+		if (!toy_commit_memory_vm(tlsf->vm, (uintptr_t)block, end - (uintptr_t)block))
+			return NULL;
+	}
+	toy_remove_tlsf_free_block(tlsf, block);
+
+	size_t block_size = toy_get_tlsf_block_size(block);
+	if (block_size >= size + sizeof(toy_memory_tlsf_block_t)) {
+		// Too much space, split this block, the remaining part is still free
+		toy_memory_tlsf_block_p remaining = (toy_memory_tlsf_block_p)((uintptr_t)toy_get_tlsf_block_memory(block) + size - TOY_MEMORY_TLSF_OVERHEAD);
+		remaining->size = (block_size - size - TOY_MEMORY_TLSF_OVERHEAD) | TOY_MEMORY_TLSF_BLOCK_FREE_BIT;
+		block->size = size | (block->size & TOY_MEMORY_TLSF_PREV_FREE_BIT);
+		toy_link_tlsf_next_block(remaining)->size |= TOY_MEMORY_TLSF_PREV_FREE_BIT;
+		toy_insert_tlsf_free_block(tlsf, remaining);
+	}
+	else {
+		block->size &= ~TOY_MEMORY_TLSF_BLOCK_FREE_BIT;
+		toy_get_tlsf_next_block(block)->size &= ~TOY_MEMORY_TLSF_PREV_FREE_BIT;
+	}
+
+	return toy_get_tlsf_block_memory(block);
+}
+
+
+void toy_tlsf_free (
+	toy_memory_tlsf_t* tlsf,
+	void* memory)
+{
+	if (NULL == memory)
+		return;
+
+	toy_memory_tlsf_block_p block = toy_get_tlsf_block(memory);
+	TOY_ASSERT(0 == (block->size & TOY_MEMORY_TLSF_BLOCK_FREE_BIT));
+
+	// Merge previous free block
+	if (block->size & TOY_MEMORY_TLSF_PREV_FREE_BIT) {
+		toy_memory_tlsf_block_p prev = block->prev_physical;
+		TOY_ASSERT(prev->size & TOY_MEMORY_TLSF_BLOCK_FREE_BIT);
+		toy_remove_tlsf_free_block(tlsf, prev);
+		prev->size += toy_get_tlsf_block_size(block) + TOY_MEMORY_TLSF_OVERHEAD;
+		block = prev;
+	}
+	else {
+		block->size |= TOY_MEMORY_TLSF_BLOCK_FREE_BIT;
+	}
+
+	// Merge next free block
+	toy_memory_tlsf_block_p next = toy_get_tlsf_next_block(block);
+	if (next->size & TOY_MEMORY_TLSF_BLOCK_FREE_BIT) {
+		toy_remove_tlsf_free_block(tlsf, next);
+		block->size += toy_get_tlsf_block_size(next) + TOY_MEMORY_TLSF_OVERHEAD;
+	}
+
+	next = toy_link_tlsf_next_block(block);
+	next->size |= TOY_MEMORY_TLSF_PREV_FREE_BIT;
+	toy_insert_tlsf_free_block(tlsf, block);
+}
+
+
+void* toy_tlsf_alloc_aligned (
+	toy_memory_tlsf_t* tlsf,
+	size_t size,
+	size_t alignment)
+{
+	// assert alignment is 2^N
+	TOY_ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+	if (alignment <= TOY_MEMORY_TLSF_ALIGNMENT)
+		return toy_tlsf_alloc(tlsf, size);
+	if (toy_unlikely(0 == size || size > TOY_MEMORY_TLSF_BLOCK_MAX / 2 - alignment))
+		return NULL;
+
+	// Leading gap must be big enough to be a free block
+	size = toy_adjust_tlsf_size(size);
+	uintptr_t memory = (uintptr_t)toy_tlsf_alloc(tlsf, size + alignment + sizeof(toy_memory_tlsf_block_t));
+	if (NULL == (void*)memory)
+		return NULL;
+
+	toy_memory_tlsf_block_p block = toy_get_tlsf_block((void*)memory);
+	uintptr_t ret = (memory + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	if (ret != memory) {
+		while (ret - memory < sizeof(toy_memory_tlsf_block_t))
+			ret += alignment;
+
+		// Cut leading gap as a block and free it, it merges with previous free block
+		size_t gap = ret - memory;
+		toy_memory_tlsf_block_p aligned_block = toy_get_tlsf_block((void*)ret);
+		aligned_block->size = toy_get_tlsf_block_size(block) - gap;
+		block->size = (gap - TOY_MEMORY_TLSF_OVERHEAD) | (block->size & TOY_MEMORY_TLSF_PREV_FREE_BIT);
+		toy_tlsf_free(tlsf, (void*)memory);
+		block = aligned_block;
+	}
+
+	toy_trim_tlsf_used_block(tlsf, block, size);
+	return (void*)ret;
+}
+
+
+bool toy_tlsf_resize (
+	toy_memory_tlsf_t* tlsf,
+	void* memory,
+	size_t old_size,
+	size_t new_size)
+{
+	TOY_ASSERT(NULL != memory);
+	if (toy_unlikely(0 == new_size || new_size > TOY_MEMORY_TLSF_BLOCK_MAX / 2))
+		return false;
+
+	new_size = toy_adjust_tlsf_size(new_size);
+	toy_memory_tlsf_block_p block = toy_get_tlsf_block(memory);
+	TOY_ASSERT(0 == (block->size & TOY_MEMORY_TLSF_BLOCK_FREE_BIT));
+	size_t block_size = toy_get_tlsf_block_size(block);
+
+	if (new_size > block_size) {
+		// Take next free block when both of them are big enough
+		toy_memory_tlsf_block_p next = toy_get_tlsf_next_block(block);
+		if (0 == (next->size & TOY_MEMORY_TLSF_BLOCK_FREE_BIT) ||
+			block_size + TOY_MEMORY_TLSF_OVERHEAD + toy_get_tlsf_block_size(next) < new_size)
+			return false;
+		if (NULL != tlsf->vm && toy_is_memory_in_vm(tlsf->vm, (uintptr_t)block)) {
+			uintptr_t end = (uintptr_t)memory + new_size - TOY_MEMORY_TLSF_OVERHEAD + sizeof(toy_memory_tlsf_block_t);
+			if (!toy_commit_memory_vm(tlsf->vm, (uintptr_t)next, end - (uintptr_t)next))
+				return false;
+		}
+
+		toy_remove_tlsf_free_block(tlsf, next);
+		block->size += toy_get_tlsf_block_size(next) + TOY_MEMORY_TLSF_OVERHEAD;
+		toy_get_tlsf_next_block(block)->size &= ~TOY_MEMORY_TLSF_PREV_FREE_BIT;
+	}
+
+	toy_trim_tlsf_used_block(tlsf, block, new_size);
+	return true;
+}
+
+
+size_t toy_get_tlsf_usable_size (void* memory)
+{
+	TOY_ASSERT(NULL != memory);
+	return toy_get_tlsf_block_size(toy_get_tlsf_block(memory));
+}
+
+
+
+void toy_get_memory_list_free_info (toy_memory_list_p lists, toy_memory_free_info_t* output)
+{
+	output->total_free_size = 0;
+	output->largest_free_size = 0;
+	output->free_block_count = 0;
+
+	for (toy_memory_list_p list = lists; NULL != list; list = list->next) {
+		toy_memory_list_chunk_header_t* chunk = (toy_memory_list_chunk_header_t*)list->free_list;
+		while (NULL != chunk) {
+			size_t size = chunk->size - sizeof(toy_memory_list_chunk_header_t);
+			output->total_free_size += size;
+			if (size > output->largest_free_size)
+				output->largest_free_size = size;
+			++(output->free_block_count);
+			chunk = chunk->next;
+		}
+	}
+}
+
+
+void toy_get_memory_tlsf_free_info (toy_memory_tlsf_p tlsf, toy_memory_free_info_t* output)
+{
+	output->total_free_size = 0;
+	output->largest_free_size = 0;
+	output->free_block_count = 0;
+
+	for (int i = 0; i < TOY_MEMORY_TLSF_FL_COUNT; ++i) {
+		if (0 == tlsf->sl_bitmap[i])
+			continue;
+		for (int j = 0; j < TOY_MEMORY_TLSF_SL_COUNT; ++j) {
+			toy_memory_tlsf_block_p block = (toy_memory_tlsf_block_p)tlsf->heads[i][j];
+			while (NULL != block) {
+				size_t size = toy_get_tlsf_block_size(block);
+				output->total_free_size += size;
+				if (size > output->largest_free_size)
+					output->largest_free_size = size;
+				++(output->free_block_count);
+				block = block->next_free;
+			}
+		}
+	}
+}
+
+
+
+static void* toy_std_alloc (void* ctx, size_t size_in_byte) { return malloc(size_in_byte); }
+static void toy_std_free (void* ctx, void* mem) { free(mem); }
+
+toy_allocator_t toy_std_alc () {
 	toy_allocator_t std_alc;
 	std_alc.ctx = NULL;
 	std_alc.alloc = toy_std_alloc;
 	std_alc.free = toy_std_free;
+	std_alc.ext = NULL;
 	return std_alc;
 }
 
 
-static void* toy_pools_alloc (toy_memory_pool_p* pools, size_t block_size)
+// vm is optional, it must be aligned to segment size
+static bool toy_create_memory_pool_chain (
+	size_t pool_size,
+	size_t block_size,
+	toy_memory_vm_t* vm,
+	toy_memory_pool_chain_t* output)
 {
-	TOY_ASSERT(NULL != pools && NULL != *pools);
-	toy_memory_pool_p pool = *pools;
-	do {
-		void* ret = toy_pool_block_alloc(pool, block_size);
-		if (NULL != ret)
-			return ret;
-		pool = pool->next;
-	} while (NULL != pool);
+	output->segment_size = toy_get_memory_segment_size(pool_size);
+	output->block_size = block_size;
+	output->vm = vm;
+	output->vm_top = NULL != vm ? vm->base : (uintptr_t)NULL;
+	output->pools = toy_alloc_memory_pool(output);
+	output->available_pools = output->pools;
+	return NULL != output->pools;
+}
 
-	// Create new pool
-	toy_allocator_t std_alc;
-	std_alc.ctx = NULL;
-	std_alc.alloc = toy_std_alloc;
-	std_alc.free = toy_std_free;
-	size_t memory_size = (*pools)->size + sizeof(toy_memory_pool_t) + sizeof(void*);
-	pool = toy_alloc_memory_pool(memory_size, (*pools)->block_size, &std_alc);
-	if (NULL == pool)
+
+static void toy_free_memory_pool_chain (toy_memory_pool_chain_t* chain)
+{
+	toy_memory_pool_p pool = chain->pools;
+	while (NULL != pool) {
+		toy_memory_pool_p next_pool = pool->next;
+		toy_free_memory_pool(chain, pool);
+		pool = next_pool;
+	}
+	chain->pools = NULL;
+	chain->available_pools = NULL;
+}
+
+
+static void* toy_pools_alloc (toy_memory_pool_chain_p chain, size_t block_size)
+{
+	TOY_ASSERT(NULL != chain);
+	if (toy_unlikely(0 == block_size || block_size > chain->block_size))
 		return NULL;
 
-	// Add pool as last one
-	while (NULL != *pools)
-		pools = &((*pools)->next);
-	*pools = pool;
+	toy_memory_pool_p pool = chain->available_pools;
+	if (NULL == pool) {
+		// All pools are full, create new pool
+		pool = toy_alloc_memory_pool(chain);
+		if (NULL == pool)
+			return NULL;
+		pool->next = chain->pools;
+		chain->pools = pool;
+		chain->available_pools = pool;
+	}
 
-	return toy_pool_block_alloc(pool, block_size);
+	void* ret = toy_pool_block_alloc(pool, block_size);
+	TOY_ASSERT(NULL != ret);
+	if (toy_memory_is_pool_full(pool)) {
+		chain->available_pools = pool->next_available;
+		pool->next_available = NULL;
+	}
+	return ret;
 }
 
 
-static void toy_pools_free (toy_memory_pool_p* pools, void* mem)
+static void toy_pools_free (toy_memory_pool_chain_p chain, void* mem)
 {
-	TOY_ASSERT(NULL != pools && NULL != *pools);
-	toy_memory_pool_p pool = *pools;
-	do {
-		if (toy_is_memory_in_pool(mem, pool)) {
-			toy_pool_block_free(pool, mem);
-			return;
-		}
-		pool = pool->next;
-	} while (NULL != pool);
-	TOY_ASSERT(0);
+	TOY_ASSERT(NULL != chain && NULL != mem);
+	toy_memory_pool_p pool = toy_get_memory_pool_owner(mem, chain);
+	TOY_ASSERT(toy_is_memory_in_pool(mem, pool));
+
+	bool was_full = toy_memory_is_pool_full(pool);
+	toy_pool_block_free(pool, mem);
+	if (was_full) {
+		pool->next_available = chain->available_pools;
+		chain->available_pools = pool;
+	}
 }
 
 
-static void* toy_lists_alloc (toy_memory_list_p* lists, size_t size_in_byte)
+// Alignment above the one of blocks is served by an offset in the block when the size still fits,
+// free finds the block from any address in it
+static void* toy_pools_alloc_aligned (toy_memory_pool_chain_p chain, size_t size, size_t alignment)
 {
-	TOY_ASSERT(NULL != lists && NULL != *lists);
-	toy_memory_list_p list = *lists;
-	do {
-		void* ret = toy_list_chunk_alloc(list, size_in_byte);
+	TOY_ASSERT(NULL != chain);
+	// assert alignment is 2^N
+	TOY_ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+	size_t block_alignment = toy_get_memory_pool_alignment(chain->block_size);
+	size_t padding = alignment > block_alignment ? alignment - block_alignment : 0;
+	if (toy_unlikely(0 == size || size + padding > chain->block_size))
+		return NULL;
+
+	uintptr_t block = (uintptr_t)toy_pools_alloc(chain, chain->block_size);
+	if (NULL == (void*)block)
+		return NULL;
+	return (void*)((block + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+
+static size_t toy_pools_usable_size (toy_memory_pool_chain_p chain, void* mem)
+{
+	toy_memory_pool_p pool = toy_get_memory_pool_owner(mem, chain);
+	return chain->block_size - ((uintptr_t)mem - pool->block_area) % chain->block_size;
+}
+
+
+// Every pool is empty again, pools are kept
+static void toy_reset_pools (toy_memory_pool_chain_p chain)
+{
+	TOY_ASSERT(NULL != chain);
+	for (toy_memory_pool_p pool = chain->pools; NULL != pool; pool = pool->next) {
+		pool->next_free_block_index = 0;
+		pool->allocated_block_count = 0;
+		pool->fresh_block_index = 0;
+		pool->next_available = pool->next;
+	}
+	chain->available_pools = chain->pools;
+}
+
+
+// vm is optional, it must be aligned to segment size
+static bool toy_create_memory_list_chain (
+	size_t list_size,
+	toy_memory_vm_t* vm,
+	toy_memory_list_chain_t* output)
+{
+	output->segment_size = toy_get_memory_segment_size(list_size);
+	output->vm = vm;
+	output->vm_top = NULL != vm ? vm->base : (uintptr_t)NULL;
+	output->lists = toy_alloc_memory_list(output);
+	output->available_lists = output->lists;
+	return NULL != output->lists;
+}
+
+
+static void toy_free_memory_list_chain (toy_memory_list_chain_t* chain)
+{
+	toy_memory_list_p list = chain->lists;
+	while (NULL != list) {
+		toy_memory_list_p next_list = list->next;
+		toy_free_memory_list(chain, list);
+		list = next_list;
+	}
+	chain->lists = NULL;
+	chain->available_lists = NULL;
+}
+
+
+static void* toy_list_chain_alloc_impl (toy_memory_list_p* list_p, size_t size_in_byte)
+{
+	toy_memory_list_p list = *list_p;
+	void* ret = toy_list_chunk_alloc(list, size_in_byte);
+	if (NULL != ret && (uintptr_t)NULL == list->free_list) {
+		// List is full, remove it from available lists
+		*list_p = list->next_available;
+		list->next_available = NULL;
+	}
+	return ret;
+}
+
+
+static void* toy_lists_alloc (toy_memory_list_chain_p chain, size_t size_in_byte)
+{
+	TOY_ASSERT(NULL != chain);
+	toy_memory_list_p* list_p = &chain->available_lists;
+	while (NULL != *list_p) {
+		void* ret = toy_list_chain_alloc_impl(list_p, size_in_byte);
 		if (NULL != ret)
 			return ret;
-		list = list->next;
-	} while (NULL != list);
+		list_p = &((*list_p)->next_available);
+	}
 
-	// Create new pool
-	toy_allocator_t std_alc = toy_std_alc();
-	size_t memory_size = (*lists)->size + sizeof(void*);
-	list = toy_alloc_memory_list(memory_size, &std_alc);
+	// Create new list
+	toy_memory_list_p list = toy_alloc_memory_list(chain);
 	if (NULL == list)
 		return NULL;
+	list->next = chain->lists;
+	chain->lists = list;
+	list->next_available = chain->available_lists;
+	chain->available_lists = list;
 
-	// Add pool as last one
-	while (NULL != *lists)
-		lists = &((*lists)->next);
-	*lists = list;
+	return toy_list_chain_alloc_impl(&chain->available_lists, size_in_byte);
+}
 
-	return toy_list_chunk_alloc(list, size_in_byte);
+
+static void toy_lists_free (toy_memory_list_chain_p chain, void* mem)
+{
+	TOY_ASSERT(NULL != chain && NULL != mem);
+	toy_memory_list_p list = toy_get_memory_list_owner(mem, chain);
+	TOY_ASSERT(toy_is_memory_in_list(mem, list));
+
+	bool was_full = (uintptr_t)NULL == list->free_list;
+	toy_list_chunk_free(list, mem);
+	if (was_full) {
+		list->next_available = chain->available_lists;
+		chain->available_lists = list;
+	}
+}
+
+
+static size_t toy_lists_usable_size (toy_memory_list_chain_p chain, void* mem)
+{
+	toy_memory_list_chunk_header_t* header = (toy_memory_list_chunk_header_t*)((uintptr_t)mem - sizeof(toy_memory_list_chunk_header_t));
+	return header->size - sizeof(toy_memory_list_chunk_header_t);
 }
 
 
-static void toy_lists_free (toy_memory_list_p* lists, void* mem)
+// Every list becomes one free chunk again, lists are kept
+static void toy_reset_lists (toy_memory_list_chain_p chain)
+{
+	TOY_ASSERT(NULL != chain);
+	for (toy_memory_list_p list = chain->lists; NULL != list; list = list->next) {
+		toy_memory_list_p next = list->next;
+		toy_init_memory_list((void*)list->memory, list->size, list);
+		list->next = next;
+		list->next_available = next;
+	}
+	chain->available_lists = chain->lists;
+}
+
+
+static bool toy_alloc_memory_tlsf_region (
+	toy_memory_tlsf_p tlsf,
+	size_t region_size,
+	toy_allocator_t* alc)
 {
-	TOY_ASSERT(NULL != lists && NULL != *lists);
-	toy_memory_list_p list = *lists;
-	do {
-		if (toy_is_memory_in_list(mem, list)) {
-			toy_list_chunk_free(list, mem);
-			return;
+	TOY_ASSERT(NULL != tlsf && NULL != alc);
+
+	if (toy_unlikely(region_size <= sizeof(toy_memory_tlsf_region_t)))
+		return false;
+
+	toy_memory_vm_t* vm = tlsf->vm;
+	if (NULL != vm) {
+		region_size = (region_size + vm->granule_size - 1) & ~(vm->granule_size - 1);
+		// Keep sentinel in the last granule
+		if (region_size > TOY_MEMORY_TLSF_BLOCK_MAX)
+			region_size = TOY_MEMORY_TLSF_BLOCK_MAX & ~(vm->granule_size - 1);
+		if (region_size <= vm->base + vm->size - tlsf->vm_top) {
+			// Commit region header, the first block header and the sentinel, the rest is committed on demand
+			uintptr_t memory = tlsf->vm_top;
+			if (!toy_commit_memory_vm(vm, memory, vm->granule_size) ||
+				!toy_commit_memory_vm(vm, memory + region_size - vm->granule_size, vm->granule_size))
+				return false;
+			tlsf->vm_top += region_size;
+
+			toy_memory_tlsf_region_t* region = (toy_memory_tlsf_region_t*)memory;
+			region->size = region_size;
+			if (!toy_add_memory_tlsf_region(tlsf, region + 1, region_size - sizeof(toy_memory_tlsf_region_t)))
+				return false;
+			region->next = tlsf->regions;
+			tlsf->regions = region;
+			return true;
 		}
-		list = list->next;
-	} while (NULL != list);
-	TOY_ASSERT(0);
+	}
+
+	toy_memory_tlsf_region_t* region = toy_alloc_aligned(alc, region_size, sizeof(void*));
+	if (toy_unlikely(NULL == region))
+		return false;
+
+	region->size = region_size;
+	if (!toy_add_memory_tlsf_region(tlsf, region + 1, region_size - sizeof(toy_memory_tlsf_region_t))) {
+		toy_free_aligned(alc, region);
+		return false;
+	}
+	region->next = tlsf->regions;
+	tlsf->regions = region;
+	return true;
+}
+
+
+static void toy_free_memory_tlsf_regions (
+	toy_memory_tlsf_p tlsf,
+	toy_allocator_t* alc)
+{
+	toy_memory_tlsf_region_t* region = tlsf->regions;
+	while (NULL != region) {
+		toy_memory_tlsf_region_t* next_region = region->next;
+		// Regions in vm are released with vm
+		if (NULL == tlsf->vm || !toy_is_memory_in_vm(tlsf->vm, (uintptr_t)region))
+			toy_free_aligned(alc, region);
+		region = next_region;
+	}
+	tlsf->regions = NULL;
+}
+
+
+// Create new region, big enough for an allocation of size_in_byte
+static bool toy_grow_memory_tlsf (toy_memory_tlsf_p tlsf, size_t size_in_byte)
+{
+	toy_allocator_t std_alc = toy_std_alc();
+	size_t region_size = tlsf->region_size;
+	size_t min_size = sizeof(toy_memory_tlsf_region_t) + size_in_byte * 2 + TOY_MEMORY_TLSF_SMALL_BLOCK;
+	if (region_size < min_size)
+		region_size = min_size;
+	return toy_alloc_memory_tlsf_region(tlsf, region_size, &std_alc);
+}
+
+
+static void* toy_tlsfs_alloc (toy_memory_tlsf_p tlsf, size_t size_in_byte)
+{
+	TOY_ASSERT(NULL != tlsf);
+	void* ret = toy_tlsf_alloc(tlsf, size_in_byte);
+	if (NULL != ret || 0 == size_in_byte)
+		return ret;
+
+	if (!toy_grow_memory_tlsf(tlsf, size_in_byte))
+		return NULL;
+	return toy_tlsf_alloc(tlsf, size_in_byte);
+}
+
+
+static void toy_tlsfs_free (toy_memory_tlsf_p tlsf, void* mem)
+{
+	TOY_ASSERT(NULL != tlsf);
+	toy_tlsf_free(tlsf, mem);
+}
+
+
+static void* toy_tlsfs_alloc_aligned (toy_memory_tlsf_p tlsf, size_t size_in_byte, size_t alignment)
+{
+	TOY_ASSERT(NULL != tlsf);
+	void* ret = toy_tlsf_alloc_aligned(tlsf, size_in_byte, alignment);
+	if (NULL != ret || 0 == size_in_byte)
+		return ret;
+
+	if (!toy_grow_memory_tlsf(tlsf, size_in_byte + alignment + TOY_MEMORY_TLSF_SMALL_BLOCK))
+		return NULL;
+	return toy_tlsf_alloc_aligned(tlsf, size_in_byte, alignment);
+}
+
+
+static bool toy_tlsfs_resize (toy_memory_tlsf_p tlsf, void* mem, size_t old_size, size_t new_size)
+{
+	TOY_ASSERT(NULL != tlsf);
+	return toy_tlsf_resize(tlsf, mem, old_size, new_size);
+}
+
+
+static size_t toy_tlsfs_usable_size (toy_memory_tlsf_p tlsf, void* mem)
+{
+	return toy_get_tlsf_usable_size(mem);
+}
+
+
+// Every region becomes one free block again, regions are kept
+static void toy_reset_tlsfs (toy_memory_tlsf_p tlsf)
+{
+	TOY_ASSERT(NULL != tlsf);
+	tlsf->fl_bitmap = 0;
+	for (int i = 0; i < TOY_MEMORY_TLSF_FL_COUNT; ++i) {
+		tlsf->sl_bitmap[i] = 0;
+		for (int j = 0; j < TOY_MEMORY_TLSF_SL_COUNT; ++j)
+			tlsf->heads[i][j] = (uintptr_t)NULL;
+	}
+	for (toy_memory_tlsf_region_t* region = tlsf->regions; NULL != region; region = region->next) {
+		bool added = toy_add_memory_tlsf_region(tlsf, region + 1, region->size - sizeof(toy_memory_tlsf_region_t));
+		TOY_ASSERT(added);
+		(void)added;
+	}
+}
+
+
+// Optional operations of backends, right side of stack can not grow in place as its memory grows downward
+static const toy_allocator_ext_t s_stack_ext_L = {
+	(toy_resize_fp)toy_stack_resize_L,
+	NULL,
+	(toy_alloc_native_aligned_fp)toy_stack_alloc_aligned_L,
+	(toy_reset_fp)toy_clear_stack_L,
+};
+
+static const toy_allocator_ext_t s_stack_ext_R = {
+	NULL,
+	NULL,
+	(toy_alloc_native_aligned_fp)toy_stack_alloc_aligned_R,
+	(toy_reset_fp)toy_clear_stack_R,
+};
+
+static const toy_allocator_ext_t s_pools_ext = {
+	NULL,
+	(toy_usable_size_fp)toy_pools_usable_size,
+	(toy_alloc_native_aligned_fp)toy_pools_alloc_aligned,
+	(toy_reset_fp)toy_reset_pools,
+};
+
+static const toy_allocator_ext_t s_buddy_ext = {
+	(toy_resize_fp)toy_buddy_resize,
+	(toy_usable_size_fp)toy_get_buddy_usable_size,
+	(toy_alloc_native_aligned_fp)toy_buddy_alloc_aligned,
+	(toy_reset_fp)toy_reset_buddy_allocator,
+};
+
+static const toy_allocator_ext_t s_tlsfs_ext = {
+	(toy_resize_fp)toy_tlsfs_resize,
+	(toy_usable_size_fp)toy_tlsfs_usable_size,
+	(toy_alloc_native_aligned_fp)toy_tlsfs_alloc_aligned,
+	(toy_reset_fp)toy_reset_tlsfs,
+};
+
+// Chunks of first fit list have no room for alignment padding
+static const toy_allocator_ext_t s_lists_ext = {
+	NULL,
+	(toy_usable_size_fp)toy_lists_usable_size,
+	NULL,
+	(toy_reset_fp)toy_reset_lists,
+};
+
+static const toy_allocator_ext_t s_slab_ext = {
+	NULL,
+	(toy_usable_size_fp)toy_get_slab_usable_size,
+	(toy_alloc_native_aligned_fp)toy_slab_alloc_aligned,
+	(toy_reset_fp)toy_clear_memory_slab,
+};
+
+
+#define TOY_MEMORY_FRAME_ARENA_SIZE (64 * 1024) // Max size of per-thread sub-arena of frame_alc
+
+
+// Return vm when reserved, or NULL to use heap
+static toy_memory_vm_t* toy_reserve_backend_vm (
+	const toy_memory_config_t* config,
+	size_t size,
+	size_t alignment,
+	bool large_page,
+	toy_memory_vm_t* vm)
+{
+	vm->base = (uintptr_t)NULL;
+	vm->size = 0;
+	vm->commit_bitmap = NULL;
+	if (!config->virtual_memory)
+		return NULL;
+	if (!toy_reserve_memory_vm(size, alignment, large_page, vm)) {
+		toy_log_w("[memory] Reserve %zu bytes failed, use heap", size);
+		return NULL;
+	}
+	return vm;
 }
 
 
+static void toy_release_backend_vms (toy_memory_allocator_t* alc)
+{
+	toy_release_memory_vm(&alc->chunk_pool_vm);
+	toy_release_memory_vm(&alc->list_vm);
+	toy_release_memory_vm(&alc->buddy_vm);
+	toy_release_memory_vm(&alc->stack_vm);
+}
+
 toy_memory_allocator_t* toy_create_memory_allocator (toy_memory_config_t* config)
 {
 	toy_allocator_t std_alc = toy_std_alc();
@@ -718,48 +1871,201 @@ toy_memory_allocator_t* toy_create_memory_allocator (toy_memory_config_t* config
 	if (NULL == alc)
 		goto FAIL_ALC;
 
-	alc->stack = toy_alloc_memory_stack(config->stack_size, &std_alc);
+	// Backends use heap until their vm is reserved
+	alc->stack_vm.base = (uintptr_t)NULL;
+	alc->buddy_vm.base = (uintptr_t)NULL;
+	alc->list_vm.base = (uintptr_t)NULL;
+	alc->chunk_pool_vm.base = (uintptr_t)NULL;
+
+	alc->stack = NULL;
+	if (NULL != toy_reserve_backend_vm(config, config->stack_size, sizeof(void*), false, &alc->stack_vm))
+		alc->stack = toy_alloc_memory_stack_vm(&alc->stack_vm);
+	if (NULL == alc->stack)
+		alc->stack = toy_alloc_memory_stack(config->stack_size, &std_alc);
 	if (NULL == alc->stack)
 		goto FAIL_STACK;
 	alc->stack_alc_L.ctx = alc->stack;
 	alc->stack_alc_L.alloc = (toy_alloc_fp)toy_stack_alloc_L;
 	alc->stack_alc_L.free = (toy_free_fp)toy_stack_free_L;
+	alc->stack_alc_L.ext = &s_stack_ext_L;
 	alc->stack_alc_R.ctx = alc->stack;
 	alc->stack_alc_R.alloc = (toy_alloc_fp)toy_stack_alloc_R;
 	alc->stack_alc_R.free = (toy_free_fp)toy_stack_free_R;
+	alc->stack_alc_R.ext = &s_stack_ext_R;
 
+	// Large pages which can not be committed on demand are limited to the first pool
 	size_t chunk_pool_size = TOY_MEMORY_CHUNK_SIZE * config->chunk_count;
-	alc->chunk_pools = toy_alloc_memory_pool(chunk_pool_size, TOY_MEMORY_CHUNK_SIZE, &std_alc);
-	if (NULL == alc->chunk_pools)
+	size_t chunk_segment_size = toy_get_memory_segment_size(chunk_pool_size);
+	size_t chunk_reserve_size = config->reserve_size > chunk_segment_size ? config->reserve_size : chunk_segment_size;
+	if (config->chunk_large_page && !TOY_MEMORY_VM_LAZY_LARGE_PAGE)
+		chunk_reserve_size = chunk_segment_size;
+	toy_memory_vm_t* chunk_pool_vm = toy_reserve_backend_vm(
+		config, chunk_reserve_size, chunk_segment_size, config->chunk_large_page, &alc->chunk_pool_vm);
+	if (!toy_create_memory_pool_chain(chunk_pool_size, TOY_MEMORY_CHUNK_SIZE, chunk_pool_vm, &alc->chunk_pools))
 		goto FAIL_CHUNK_POOL;
 	alc->chunk_pool_alc.ctx = &alc->chunk_pools;
 	alc->chunk_pool_alc.alloc = (toy_alloc_fp)toy_pools_alloc;
 	alc->chunk_pool_alc.free = (toy_free_fp)toy_pools_free;
+	alc->chunk_pool_alc.ext = &s_pools_ext;
 
-	toy_aligned_p buddy_memory = toy_alloc_aligned(&std_alc, config->buddy_size, sizeof(void*));
+	toy_memory_vm_t* buddy_vm = toy_reserve_backend_vm(config, config->buddy_size, sizeof(void*), false, &alc->buddy_vm);
+	toy_aligned_p buddy_memory;
+	if (NULL != buddy_vm)
+		buddy_memory = (toy_aligned_p)buddy_vm->base;
+	else
+		buddy_memory = toy_alloc_aligned(&std_alc, config->buddy_size, TOY_MEMORY_CHUNK_SIZE); // Limit of toy_buddy_alloc_aligned()
 	if (NULL == buddy_memory)
 		goto FAIL_BUDDY;
-	toy_init_buddy_allocator(buddy_memory, config->buddy_size, 7, &alc->buddy);
+	toy_init_buddy_allocator(buddy_memory, config->buddy_size, 7, buddy_vm, &alc->buddy);
 	alc->buddy_alc.ctx = &alc->buddy;
 	alc->buddy_alc.alloc = (toy_alloc_fp)toy_buddy_alloc;
 	alc->buddy_alc.free = (toy_free_fp)toy_buddy_free;
+	alc->buddy_alc.ext = &s_buddy_ext;
+
+	alc->lists.lists = NULL;
+	alc->lists.available_lists = NULL;
+	alc->lists.vm = NULL;
+	alc->tlsf = NULL;
+	size_t list_segment_size = toy_get_memory_segment_size(config->list_size);
+	size_t list_reserve_size = config->reserve_size > list_segment_size ? config->reserve_size : list_segment_size;
+	toy_memory_vm_t* list_vm = toy_reserve_backend_vm(config, list_reserve_size, list_segment_size, false, &alc->list_vm);
+	if (TOY_MEMORY_LIST_STRATEGY_TLSF == config->list_strategy) {
+		alc->tlsf = toy_alloc_aligned(&std_alc, sizeof(toy_memory_tlsf_t), sizeof(void*));
+		if (NULL == alc->tlsf)
+			goto FAIL_LIST;
+		toy_init_memory_tlsf(alc->tlsf);
+		alc->tlsf->region_size = config->list_size;
+		if (NULL != list_vm) {
+			alc->tlsf->vm = list_vm;
+			alc->tlsf->vm_top = list_vm->base;
+		}
+		if (!toy_alloc_memory_tlsf_region(alc->tlsf, config->list_size, &std_alc)) {
+			toy_free_aligned(&std_alc, alc->tlsf);
+			goto FAIL_LIST;
+		}
+		alc->list_alc.ctx = alc->tlsf;
+		alc->list_alc.alloc = (toy_alloc_fp)toy_tlsfs_alloc;
+		alc->list_alc.free = (toy_free_fp)toy_tlsfs_free;
+		alc->list_alc.ext = &s_tlsfs_ext;
+	}
+	else {
+		if (!toy_create_memory_list_chain(config->list_size, list_vm, &alc->lists))
+			goto FAIL_LIST;
+		alc->list_alc.ctx = &alc->lists;
+		alc->list_alc.alloc = (toy_alloc_fp)toy_lists_alloc;
+		alc->list_alc.free = (toy_free_fp)toy_lists_free;
+		alc->list_alc.ext = &s_lists_ext;
+	}
+
+	alc->list_cache = NULL;
+	alc->buddy_cache = NULL;
+	alc->chunk_pool_cache = NULL;
+	if (config->thread_cache) {
+		alc->list_cache = toy_create_memory_thread_cache(&alc->list_alc, 0, &alc->list_alc);
+		if (NULL == alc->list_cache)
+			goto FAIL_LIST_CACHE;
+		alc->buddy_cache = toy_create_memory_thread_cache(&alc->buddy_alc, 0, &alc->buddy_alc);
+		if (NULL == alc->buddy_cache)
+			goto FAIL_BUDDY_CACHE;
+		alc->chunk_pool_cache = toy_create_memory_thread_cache(&alc->chunk_pool_alc, TOY_MEMORY_CHUNK_SIZE, &alc->chunk_pool_alc);
+		if (NULL == alc->chunk_pool_cache)
+			goto FAIL_CHUNK_POOL_CACHE;
+	}
+
+	// Pages are taken through chunk_pool_alc, so they are thread-safe with thread cache
+	toy_init_memory_slab(&alc->chunk_pool_alc, &alc->small);
+	alc->small_alc.ctx = &alc->small;
+	alc->small_alc.alloc = (toy_alloc_fp)toy_slab_alloc;
+	alc->small_alc.free = (toy_free_fp)toy_slab_free;
+	alc->small_alc.ext = &s_slab_ext;
+
+	alc->frame = NULL;
+	if (config->frame_size > 0) {
+		size_t arena_size = config->frame_size / 16 < TOY_MEMORY_FRAME_ARENA_SIZE ? config->frame_size / 16 : TOY_MEMORY_FRAME_ARENA_SIZE;
+		alc->frame = toy_create_memory_frame_allocator(config->frame_size, arena_size, &std_alc);
+		if (NULL == alc->frame)
+			goto FAIL_FRAME;
+		toy_get_memory_frame_alc(alc->frame, &alc->frame_alc);
+	}
 
-	alc->lists = toy_alloc_memory_list(config->list_size, &std_alc);
-	if (NULL == alc->lists)
-		goto FAIL_LIST;
-	alc->list_alc.ctx = &alc->lists;
-	alc->list_alc.alloc = (toy_alloc_fp)toy_lists_alloc;
-	alc->list_alc.free = (toy_free_fp)toy_lists_free;
+	alc->concurrent_chunks = NULL;
+	if (config->concurrent_chunk_count > 0) {
+		alc->concurrent_chunks = toy_create_memory_concurrent_pool(
+			TOY_MEMORY_CHUNK_SIZE, (uint32_t)config->concurrent_chunk_count, 0, &std_alc);
+		if (NULL == alc->concurrent_chunks)
+			goto FAIL_CONCURRENT_CHUNK;
+		// malloc is thread-safe as well
+		toy_set_concurrent_pool_overflow_allocator(alc->concurrent_chunks, &std_alc);
+		toy_get_memory_concurrent_pool_alc(alc->concurrent_chunks, &alc->concurrent_chunk_alc);
+	}
+
+#if TOY_DEBUG_MEMORY
+	// Sources are added in the order of toy_get_memory_source_alc()
+	alc->profile = toy_create_memory_profile();
+	if (NULL == alc->profile)
+		goto FAIL_PROFILE;
+	for (uint32_t i = 0; i < TOY_MEMORY_SOURCE_COUNT; ++i) {
+		toy_allocator_t* source_alc = toy_get_memory_source_alc(alc, i);
+		toy_add_memory_profile_source(alc->profile, toy_get_memory_source_name(i), source_alc, source_alc);
+	}
+#endif
+
+	// Trace is the outermost wrapper, allocations are recorded as the caller sees them
+	alc->trace = NULL;
+	if (NULL != config->trace_path) {
+		toy_error_t err;
+		alc->trace = toy_create_memory_trace(config->trace_path, &err);
+		if (NULL == alc->trace) {
+			toy_log_w("[memory] Create memory trace %s failed, tracing is disabled", config->trace_path);
+		}
+		else {
+			for (uint32_t i = 0; i < TOY_MEMORY_SOURCE_COUNT; ++i) {
+				toy_allocator_t* source_alc = toy_get_memory_source_alc(alc, i);
+				toy_add_memory_trace_source(alc->trace, toy_get_memory_source_name(i), source_alc, source_alc);
+			}
+		}
+	}
 
 	return alc;
 
+#if TOY_DEBUG_MEMORY
+FAIL_PROFILE:
+	if (NULL != alc->concurrent_chunks)
+		toy_destroy_memory_concurrent_pool(alc->concurrent_chunks, &std_alc);
+#endif
+FAIL_CONCURRENT_CHUNK:
+	if (NULL != alc->frame)
+		toy_destroy_memory_frame_allocator(alc->frame, &std_alc);
+FAIL_FRAME:
+	toy_clear_memory_slab(&alc->small);
+	if (NULL != alc->chunk_pool_cache)
+		toy_destroy_memory_thread_cache(alc->chunk_pool_cache);
+FAIL_CHUNK_POOL_CACHE:
+	if (NULL != alc->buddy_cache)
+		toy_destroy_memory_thread_cache(alc->buddy_cache);
+FAIL_BUDDY_CACHE:
+	if (NULL != alc->list_cache)
+		toy_destroy_memory_thread_cache(alc->list_cache);
+FAIL_LIST_CACHE:
+	if (NULL != alc->tlsf) {
+		toy_free_memory_tlsf_regions(alc->tlsf, &std_alc);
+		toy_free_aligned(&std_alc, alc->tlsf);
+	}
+	else {
+		toy_free_memory_list_chain(&alc->lists);
+	}
 FAIL_LIST:
-	toy_free_aligned(&std_alc, buddy_memory);
+	if (NULL == buddy_vm)
+		toy_free_aligned(&std_alc, buddy_memory);
 FAIL_BUDDY:
-	toy_free_memory_pool(alc->chunk_pools, &std_alc);
+	toy_free_memory_pool_chain(&alc->chunk_pools);
 FAIL_CHUNK_POOL:
-	toy_free_memory_stack(alc->stack, &std_alc);
+	if (NULL != alc->stack->vm)
+		toy_clear_stack(alc->stack);
+	else
+		toy_free_memory_stack(alc->stack, &std_alc);
 FAIL_STACK:
+	toy_release_backend_vms(alc);
 	toy_free_aligned(&std_alc, alc);
 FAIL_ALC:
 	return NULL;
@@ -772,31 +2078,184 @@ void toy_destroy_memory_allocator (toy_memory_allocator_t* alc)
 
 	toy_allocator_t std_alc = toy_std_alc();
 
-	toy_memory_list_p list = alc->lists;
-	while (NULL != list) {
-		toy_memory_list_p next_list = (toy_memory_list_p)(list->next);
-		toy_free_memory_list(list, &std_alc);
-		list = next_list;
+	if (NULL != alc->trace)
+		toy_destroy_memory_trace(alc->trace);
+
+#if TOY_DEBUG_MEMORY
+	size_t leak_count = toy_report_memory_profile_leaks(alc->profile);
+	if (leak_count > 0)
+		toy_log_w("[memory] %zu allocations are not freed before destroying memory allocator", leak_count);
+	toy_destroy_memory_profile(alc->profile);
+#endif
+
+	if (NULL != alc->concurrent_chunks)
+		toy_destroy_memory_concurrent_pool(alc->concurrent_chunks, &std_alc);
+	if (NULL != alc->frame)
+		toy_destroy_memory_frame_allocator(alc->frame, &std_alc);
+
+	toy_clear_memory_slab(&alc->small);
+
+	if (NULL != alc->chunk_pool_cache)
+		toy_destroy_memory_thread_cache(alc->chunk_pool_cache);
+	if (NULL != alc->buddy_cache)
+		toy_destroy_memory_thread_cache(alc->buddy_cache);
+	if (NULL != alc->list_cache)
+		toy_destroy_memory_thread_cache(alc->list_cache);
+
+	toy_free_memory_list_chain(&alc->lists);
+	if (NULL != alc->tlsf) {
+		toy_free_memory_tlsf_regions(alc->tlsf, &std_alc);
+		toy_free_aligned(&std_alc, alc->tlsf);
 	}
 
-	toy_free_aligned(&std_alc, (toy_aligned_p)(alc->buddy.memory));
+	if (NULL == alc->buddy.vm)
+		toy_free_aligned(&std_alc, (toy_aligned_p)(alc->buddy.memory));
 
-	toy_memory_pool_p pool = alc->chunk_pools;
-	while (NULL != pool) {
-		toy_memory_pool_p next_pool = pool->next;
-		toy_free_memory_pool(pool, &std_alc);
-		pool = next_pool;
-	}
+	toy_free_memory_pool_chain(&alc->chunk_pools);
 
-	toy_free_memory_stack(alc->stack, &std_alc);
+	if (NULL != alc->stack->vm)
+		toy_clear_stack(alc->stack);
+	else
+		toy_free_memory_stack(alc->stack, &std_alc);
+
+	toy_release_backend_vms(alc);
 
 	toy_free_aligned(&std_alc, alc);
 }
 
 
+static const char* s_memory_source_names[TOY_MEMORY_SOURCE_COUNT] = {
+	"stack_L",
+	"stack_R",
+	"list",
+	"buddy",
+	"chunk_pool",
+	"small",
+};
+
+
+const char* toy_get_memory_source_name (uint32_t source)
+{
+	TOY_ASSERT(source < TOY_MEMORY_SOURCE_COUNT);
+	return s_memory_source_names[source];
+}
+
+
+toy_allocator_t* toy_get_memory_source_alc (
+	toy_memory_allocator_t* alc,
+	uint32_t source)
+{
+	switch (source) {
+	case TOY_MEMORY_SOURCE_STACK_L:
+		return &alc->stack_alc_L;
+	case TOY_MEMORY_SOURCE_STACK_R:
+		return &alc->stack_alc_R;
+	case TOY_MEMORY_SOURCE_LIST:
+		return &alc->list_alc;
+	case TOY_MEMORY_SOURCE_BUDDY:
+		return &alc->buddy_alc;
+	case TOY_MEMORY_SOURCE_CHUNK_POOL:
+		return &alc->chunk_pool_alc;
+	default:
+		TOY_ASSERT(TOY_MEMORY_SOURCE_SMALL == source);
+		return &alc->small_alc;
+	}
+}
+
+
+static uint32_t toy_get_memory_source (
+	toy_memory_allocator_t* alc,
+	const toy_allocator_t* base_alc)
+{
+	for (uint32_t i = 0; i < TOY_MEMORY_SOURCE_COUNT - 1; ++i) {
+		if (toy_get_memory_source_alc(alc, i) == base_alc)
+			return i;
+	}
+	TOY_ASSERT(&alc->small_alc == base_alc);
+	return TOY_MEMORY_SOURCE_COUNT - 1;
+}
+
+
+toy_allocator_t toy_get_tagged_allocator (
+	toy_memory_allocator_t* alc,
+	const toy_allocator_t* base_alc,
+	enum toy_memory_tag_t tag)
+{
+	uint32_t source = toy_get_memory_source(alc, base_alc);
+	toy_allocator_t ret;
+#if TOY_DEBUG_MEMORY
+	toy_get_memory_profile_allocator(alc->profile, source, tag, &ret);
+	if (NULL != alc->trace)
+		toy_get_memory_trace_allocator(alc->trace, source, tag, &ret, &ret);
+#else
+	ret = *base_alc;
+	if (NULL != alc->trace)
+		toy_get_memory_trace_allocator(alc->trace, source, tag, NULL, &ret);
+#endif
+	return ret;
+}
+
+
+static size_t toy_get_vm_footprint (const toy_memory_vm_t* vm)
+{
+	return toy_is_memory_vm_reserved(vm) ? vm->committed_size : 0;
+}
+
+
+size_t toy_get_memory_footprint (toy_memory_allocator_t* alc)
+{
+	size_t footprint = toy_get_vm_footprint(&alc->stack_vm) + toy_get_vm_footprint(&alc->buddy_vm) +
+		toy_get_vm_footprint(&alc->list_vm) + toy_get_vm_footprint(&alc->chunk_pool_vm);
+
+	// Backends outside of vm are allocated from heap at full size
+	if (NULL == alc->stack->vm)
+		footprint += sizeof(toy_memory_stack_t) + alc->stack->size;
+	if (NULL == alc->buddy.vm)
+		footprint += alc->buddy.size;
+	for (toy_memory_list_p list = alc->lists.lists; NULL != list; list = list->next) {
+		if (NULL == alc->lists.vm || !toy_is_memory_in_vm(alc->lists.vm, (uintptr_t)list))
+			footprint += alc->lists.segment_size;
+	}
+	if (NULL != alc->tlsf) {
+		for (toy_memory_tlsf_region_t* region = alc->tlsf->regions; NULL != region; region = region->next) {
+			if (NULL == alc->tlsf->vm || !toy_is_memory_in_vm(alc->tlsf->vm, (uintptr_t)region))
+				footprint += region->size;
+		}
+	}
+	for (toy_memory_pool_p pool = alc->chunk_pools.pools; NULL != pool; pool = pool->next) {
+		if (NULL == alc->chunk_pools.vm || !toy_is_memory_in_vm(alc->chunk_pools.vm, (uintptr_t)pool))
+			footprint += alc->chunk_pools.segment_size;
+	}
+	return footprint;
+}
+
+
+#if TOY_DEBUG_MEMORY
+void toy_get_memory_stats (
+	toy_memory_allocator_t* alc,
+	const toy_allocator_t* base_alc,
+	enum toy_memory_tag_t tag,
+	toy_memory_stats_t* output)
+{
+	toy_get_memory_profile_stats(alc->profile, toy_get_memory_source(alc, base_alc), tag, output);
+}
+
+
+void toy_mark_memory_frame (toy_memory_allocator_t* alc)
+{
+	toy_mark_memory_profile_frame(alc->profile);
+}
+
+
+void toy_dump_memory_stats (toy_memory_allocator_t* alc)
+{
+	toy_dump_memory_profile(alc->profile);
+}
+#endif
+
+
 toy_memory_stack_p toy_create_memory_stack (
 	size_t stack_size,
-	toy_memory_allocator_t* alc, // Just for future profile
 	toy_allocator_t* output_alc_L,
 	toy_allocator_t* output_alc_R)
 {
@@ -810,56 +2269,45 @@ toy_memory_stack_p toy_create_memory_stack (
 		output_alc_L->ctx = stack;
 		output_alc_L->alloc = (toy_alloc_fp)toy_stack_alloc_L;
 		output_alc_L->free = (toy_free_fp)toy_stack_free_L;
+		output_alc_L->ext = &s_stack_ext_L;
 	}
 	if (NULL != output_alc_R) {
 		output_alc_R->ctx = stack;
 		output_alc_R->alloc = (toy_alloc_fp)toy_stack_alloc_R;
 		output_alc_R->free = (toy_free_fp)toy_stack_free_R;
+		output_alc_R->ext = &s_stack_ext_R;
 	}
 	return stack;
 }
 
 
-void toy_destroy_memory_stack (
-	toy_memory_stack_p stack,
-	toy_memory_allocator_t* alc) // Just for future profile
+void toy_destroy_memory_stack (toy_memory_stack_p stack)
 {
 	toy_allocator_t std_alc = toy_std_alc();
 	toy_free_memory_stack(stack, &std_alc);
 }
 
 
+// pool_size is rounded up to 2^N, output_chain->pools is NULL when failed
 void toy_create_memory_pools (
 	size_t pool_size,
 	size_t block_size,
-	toy_memory_allocator_t* alc, // Just for future profile
-	toy_memory_pool_p* output_pools,
+	toy_memory_pool_chain_t* output_chain,
 	toy_allocator_t* output_alc)
 {
-	TOY_ASSERT(NULL != output_pools && NULL != output_alc);
+	TOY_ASSERT(NULL != output_chain && NULL != output_alc);
 
-	toy_allocator_t std_alc = toy_std_alc();
-
-	*output_pools = toy_alloc_memory_pool(pool_size, block_size, &std_alc);
-	if (NULL == *output_pools)
+	if (!toy_create_memory_pool_chain(pool_size, block_size, NULL, output_chain))
 		return;
 
-	output_alc->ctx = output_pools;
+	output_alc->ctx = output_chain;
 	output_alc->alloc = (toy_alloc_fp)toy_pools_alloc;
 	output_alc->free = (toy_free_fp)toy_pools_free;
+	output_alc->ext = &s_pools_ext;
 }
 
 
-void toy_destroy_memory_pools (
-	toy_memory_pool_p pools,
-	toy_memory_allocator_t* alc) // Just for future profile
+void toy_destroy_memory_pools (toy_memory_pool_chain_t* chain)
 {
-	toy_allocator_t std_alc = toy_std_alc();
-
-	toy_memory_pool_p pool = pools;
-	while (NULL != pool) {
-		toy_memory_pool_p next_pool = pool->next;
-		toy_free_memory_pool(pool, &std_alc);
-		pool = next_pool;
-	}
+	toy_free_memory_pool_chain(chain);
 }
@@ -0,0 +1,199 @@
+#include "include/toy_memory_concurrent_pool.h"
+
+#include "toy_assert.h"
+#include <atomic>
+#include <new>
+
+
+#define TOY_MEMORY_CONCURRENT_POOL_END UINT32_MAX // Index of empty stack
+#define TOY_MEMORY_CONCURRENT_POOL_CACHE_LINE 64
+
+// head: high 32 bits are ABA tag, low 32 bits are the index of the first free block
+struct toy_memory_concurrent_pool_t {
+	toy_alignas(TOY_MEMORY_CONCURRENT_POOL_CACHE_LINE) std::atomic<uint64_t> head;
+	toy_alignas(TOY_MEMORY_CONCURRENT_POOL_CACHE_LINE) std::atomic<uint32_t> allocated_block_count;
+
+	toy_allocator_t overflow_alc; // overflow_alc.alloc is NULL when overflow is disabled
+	size_t block_size;
+	size_t alignment;
+	uint32_t block_count;
+	uintptr_t block_area;
+	size_t size; // size of block_area
+};
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "Next index is stored in free block as atomic");
+
+
+static toy_inline uint64_t toy_pack_concurrent_pool_head (uint64_t tag, uint32_t index)
+{
+	return (tag << 32) | index;
+}
+
+
+// Next index is read by other threads while the block may be taken, so it is accessed atomically
+static toy_inline std::atomic<uint32_t>* toy_get_concurrent_pool_next_index (
+	toy_memory_concurrent_pool_p pool,
+	uint32_t block_index)
+{
+	return reinterpret_cast<std::atomic<uint32_t>*>(pool->block_area + block_index * pool->block_size);
+}
+
+
+TOY_EXTERN_C_START
+
+toy_memory_concurrent_pool_p toy_create_memory_concurrent_pool (
+	size_t block_size,
+	uint32_t block_count,
+	size_t alignment,
+	const toy_allocator_t* alc)
+{
+	TOY_ASSERT(NULL != alc);
+	TOY_ASSERT(block_count > 0 && block_count < TOY_MEMORY_CONCURRENT_POOL_END);
+	TOY_ASSERT(block_size >= sizeof(uint32_t));
+	// assert alignment is 2^N
+	TOY_ASSERT((alignment & (alignment - 1)) == 0);
+
+	if (alignment < sizeof(void*))
+		alignment = sizeof(void*);
+	// Blocks must keep next index aligned
+	block_size = (block_size + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+
+	size_t object_alignment = alignment > TOY_MEMORY_CONCURRENT_POOL_CACHE_LINE ? alignment : TOY_MEMORY_CONCURRENT_POOL_CACHE_LINE;
+	size_t header_size = (sizeof(toy_memory_concurrent_pool_t) + alignment - 1) & ~(alignment - 1);
+	void* memory = toy_alloc_aligned(alc, header_size + block_size * block_count, object_alignment);
+	if (NULL == memory)
+		return NULL;
+
+	toy_memory_concurrent_pool_p pool = new (memory) toy_memory_concurrent_pool_t();
+	pool->block_size = block_size;
+	pool->alignment = alignment;
+	pool->block_count = block_count;
+	pool->block_area = (uintptr_t)memory + header_size;
+	pool->size = block_size * block_count;
+	pool->overflow_alc.ctx = NULL;
+	pool->overflow_alc.alloc = NULL;
+	pool->overflow_alc.free = NULL;
+	pool->overflow_alc.ext = NULL;
+	for (uint32_t i = 0; i < block_count - 1; ++i)
+		toy_get_concurrent_pool_next_index(pool, i)->store(i + 1, std::memory_order_relaxed);
+	toy_get_concurrent_pool_next_index(pool, block_count - 1)->store(TOY_MEMORY_CONCURRENT_POOL_END, std::memory_order_relaxed);
+	pool->allocated_block_count.store(0, std::memory_order_relaxed);
+	pool->head.store(toy_pack_concurrent_pool_head(0, 0), std::memory_order_release);
+	return pool;
+}
+
+
+void toy_destroy_memory_concurrent_pool (
+	toy_memory_concurrent_pool_p pool,
+	const toy_allocator_t* alc)
+{
+	TOY_ASSERT(NULL != pool && NULL != alc);
+	pool->~toy_memory_concurrent_pool_t();
+	toy_free_aligned(alc, pool);
+}
+
+
+void toy_set_concurrent_pool_overflow_allocator (
+	toy_memory_concurrent_pool_p pool,
+	const toy_allocator_t* overflow_alc)
+{
+	TOY_ASSERT(NULL != pool);
+	if (NULL == overflow_alc) {
+		pool->overflow_alc.ctx = NULL;
+		pool->overflow_alc.alloc = NULL;
+		pool->overflow_alc.free = NULL;
+		pool->overflow_alc.ext = NULL;
+	}
+	else {
+		TOY_ASSERT(NULL != overflow_alc->alloc && NULL != overflow_alc->free);
+		pool->overflow_alc = *overflow_alc;
+	}
+}
+
+
+void* toy_concurrent_pool_block_alloc (toy_memory_concurrent_pool_p pool, size_t size)
+{
+	if (0 == size || size > pool->block_size)
+		return NULL;
+
+	uint64_t head = pool->head.load(std::memory_order_acquire);
+	uint32_t index;
+	uint64_t new_head;
+	do {
+		index = (uint32_t)head;
+		if (TOY_MEMORY_CONCURRENT_POOL_END == index) {
+			if (NULL == pool->overflow_alc.alloc)
+				return NULL;
+			return toy_alloc_aligned(&pool->overflow_alc, pool->block_size, pool->alignment);
+		}
+		// Block may be taken by another thread after head is read, then tag changes and CAS fails
+		uint32_t next_index = toy_get_concurrent_pool_next_index(pool, index)->load(std::memory_order_relaxed);
+		new_head = toy_pack_concurrent_pool_head((head >> 32) + 1, next_index);
+	} while (!pool->head.compare_exchange_weak(head, new_head, std::memory_order_acquire, std::memory_order_acquire));
+
+	pool->allocated_block_count.fetch_add(1, std::memory_order_relaxed);
+	return (void*)(pool->block_area + index * pool->block_size);
+}
+
+
+void toy_concurrent_pool_block_free (toy_memory_concurrent_pool_p pool, void* block)
+{
+	uintptr_t ptr = (uintptr_t)block;
+	if (ptr < pool->block_area || ptr >= pool->block_area + pool->size) {
+		TOY_ASSERT(NULL != pool->overflow_alc.free);
+		toy_free_aligned(&pool->overflow_alc, block);
+		return;
+	}
+	TOY_ASSERT((ptr - pool->block_area) % pool->block_size == 0);
+
+	uint32_t index = (uint32_t)((ptr - pool->block_area) / pool->block_size);
+	std::atomic<uint32_t>* next_index = toy_get_concurrent_pool_next_index(pool, index);
+	uint64_t head = pool->head.load(std::memory_order_relaxed);
+	uint64_t new_head;
+	do {
+		next_index->store((uint32_t)head, std::memory_order_relaxed);
+		new_head = toy_pack_concurrent_pool_head((head >> 32) + 1, index);
+	} while (!pool->head.compare_exchange_weak(head, new_head, std::memory_order_release, std::memory_order_relaxed));
+
+	TOY_ASSERT(pool->allocated_block_count.load(std::memory_order_relaxed) > 0);
+	pool->allocated_block_count.fetch_sub(1, std::memory_order_relaxed);
+}
+
+
+bool toy_is_memory_in_concurrent_pool (void* memory, toy_memory_concurrent_pool_p pool)
+{
+	return ((uintptr_t)memory >= pool->block_area) &&
+		((uintptr_t)memory < pool->block_area + pool->block_size * pool->block_count);
+}
+
+
+uint32_t toy_get_concurrent_pool_allocated_count (toy_memory_concurrent_pool_p pool)
+{
+	return pool->allocated_block_count.load(std::memory_order_relaxed);
+}
+
+
+static void* toy_concurrent_pool_alc_alloc (void* ctx, size_t size)
+{
+	return toy_concurrent_pool_block_alloc((toy_memory_concurrent_pool_p)ctx, size);
+}
+
+
+static void toy_concurrent_pool_alc_free (void* ctx, void* mem)
+{
+	if (NULL != mem)
+		toy_concurrent_pool_block_free((toy_memory_concurrent_pool_p)ctx, mem);
+}
+
+
+void toy_get_memory_concurrent_pool_alc (
+	toy_memory_concurrent_pool_p pool,
+	toy_allocator_t* output_alc)
+{
+	output_alc->ctx = pool;
+	output_alc->alloc = toy_concurrent_pool_alc_alloc;
+	output_alc->free = toy_concurrent_pool_alc_free;
+	output_alc->ext = NULL;
+}
+
+TOY_EXTERN_C_END
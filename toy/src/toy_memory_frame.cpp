@@ -0,0 +1,198 @@
+#include "include/toy_memory_frame.h"
+
+#include "toy_assert.h"
+#include "include/toy_memory.h"
+#include <atomic>
+#include <mutex>
+#include <new>
+
+
+struct toy_memory_frame_allocator_t {
+	toy_memory_stack_t frames[TOY_CONCURRENT_FRAME_MAX];
+	std::mutex lock; // Guard frames[]
+	std::atomic<uint64_t> serial; // Unique serial of current frame, sub-arenas of other serials are stale
+	uint32_t frame_index;
+	uint32_t slot;
+	size_t arena_size;
+	void* memory;
+};
+
+struct toy_memory_frame_arena_t {
+	uint64_t serial;
+	uintptr_t top;
+	uintptr_t end;
+};
+
+
+static std::mutex s_frame_registry_lock;
+static toy_memory_frame_allocator_p s_frame_allocators[TOY_MEMORY_FRAME_ALLOCATOR_MAX];
+static std::atomic<uint64_t> s_frame_serial(0);
+
+static thread_local toy_memory_frame_arena_t s_frame_arenas[TOY_MEMORY_FRAME_ALLOCATOR_MAX] = {};
+
+
+static toy_inline uintptr_t toy_align_frame_address (uintptr_t address, size_t alignment)
+{
+	return (address + alignment - 1) & ~(uintptr_t)(alignment - 1);
+}
+
+
+// Take memory from current frame stack under lock
+static uintptr_t toy_frame_stack_alloc (
+	toy_memory_frame_allocator_p frame_alc,
+	size_t size,
+	size_t alignment)
+{
+	std::lock_guard<std::mutex> guard(frame_alc->lock);
+	toy_memory_stack_t* stack = &frame_alc->frames[frame_alc->frame_index];
+	uintptr_t ret = toy_align_frame_address(stack->left_top, alignment);
+	if (ret + size > stack->right_top)
+		return (uintptr_t)NULL;
+	stack->left_top = ret + size;
+	return ret;
+}
+
+
+TOY_EXTERN_C_START
+
+toy_memory_frame_allocator_p toy_create_memory_frame_allocator (
+	size_t frame_size,
+	size_t arena_size,
+	const toy_allocator_t* alc)
+{
+	TOY_ASSERT(NULL != alc && frame_size > 0 && arena_size > 0 && arena_size <= frame_size);
+
+	frame_size = toy_align_frame_address(frame_size, TOY_MEMORY_FRAME_ALIGNMENT);
+	arena_size = toy_align_frame_address(arena_size, TOY_MEMORY_FRAME_ALIGNMENT);
+
+	toy_allocator_t std_alc = toy_std_alc();
+	void* object = toy_alloc_aligned(&std_alc, sizeof(toy_memory_frame_allocator_t), sizeof(void*));
+	if (NULL == object)
+		goto FAIL_OBJECT;
+
+	toy_memory_frame_allocator_p frame_alc;
+	frame_alc = new (object) toy_memory_frame_allocator_t();
+	frame_alc->memory = toy_alloc_aligned(alc, frame_size * TOY_CONCURRENT_FRAME_MAX, TOY_MEMORY_FRAME_ALIGNMENT);
+	if (NULL == frame_alc->memory)
+		goto FAIL_MEMORY;
+
+	for (uint32_t i = 0; i < TOY_CONCURRENT_FRAME_MAX; ++i)
+		toy_init_memory_stack((void*)((uintptr_t)frame_alc->memory + frame_size * i), frame_size, &frame_alc->frames[i]);
+	// Same as swapchain, first frame begins slot 0
+	frame_alc->frame_index = TOY_CONCURRENT_FRAME_MAX - 1;
+	frame_alc->arena_size = arena_size;
+	frame_alc->serial.store(++s_frame_serial, std::memory_order_relaxed);
+
+	{
+		std::lock_guard<std::mutex> guard(s_frame_registry_lock);
+		uint32_t slot = 0;
+		while (slot < TOY_MEMORY_FRAME_ALLOCATOR_MAX && NULL != s_frame_allocators[slot])
+			++slot;
+		if (slot >= TOY_MEMORY_FRAME_ALLOCATOR_MAX)
+			goto FAIL_SLOT;
+		frame_alc->slot = slot;
+		s_frame_allocators[slot] = frame_alc;
+	}
+
+	return frame_alc;
+
+FAIL_SLOT:
+	toy_free_aligned(alc, frame_alc->memory);
+FAIL_MEMORY:
+	frame_alc->~toy_memory_frame_allocator_t();
+	toy_free_aligned(&std_alc, object);
+FAIL_OBJECT:
+	return NULL;
+}
+
+
+void toy_destroy_memory_frame_allocator (
+	toy_memory_frame_allocator_p frame_alc,
+	const toy_allocator_t* alc)
+{
+	TOY_ASSERT(NULL != frame_alc && NULL != alc);
+
+	{
+		std::lock_guard<std::mutex> guard(s_frame_registry_lock);
+		TOY_ASSERT(s_frame_allocators[frame_alc->slot] == frame_alc);
+		s_frame_allocators[frame_alc->slot] = NULL;
+	}
+
+	toy_allocator_t std_alc = toy_std_alc();
+	toy_free_aligned(alc, frame_alc->memory);
+	frame_alc->~toy_memory_frame_allocator_t();
+	toy_free_aligned(&std_alc, frame_alc);
+}
+
+
+void toy_begin_memory_frame (toy_memory_frame_allocator_p frame_alc, uint32_t frame_index)
+{
+	TOY_ASSERT(frame_index < TOY_CONCURRENT_FRAME_MAX);
+	std::lock_guard<std::mutex> guard(frame_alc->lock);
+	frame_alc->frame_index = frame_index;
+	toy_clear_stack(&frame_alc->frames[frame_alc->frame_index]);
+	// Sub-arenas of all threads become stale, they are in previous frame stack
+	frame_alc->serial.store(++s_frame_serial, std::memory_order_release);
+}
+
+
+uint32_t toy_get_memory_frame_index (toy_memory_frame_allocator_p frame_alc)
+{
+	return frame_alc->frame_index;
+}
+
+
+void* toy_frame_alloc (
+	toy_memory_frame_allocator_p frame_alc,
+	size_t size,
+	size_t alignment)
+{
+	TOY_ASSERT(NULL != frame_alc);
+	// assert alignment is 2^N
+	TOY_ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+	if (toy_unlikely(0 == size))
+		return NULL;
+
+	// Big allocations go to frame stack directly
+	if (size + alignment > frame_alc->arena_size / 4)
+		return (void*)toy_frame_stack_alloc(frame_alc, size, alignment);
+
+	toy_memory_frame_arena_t* arena = &s_frame_arenas[frame_alc->slot];
+	uint64_t serial = frame_alc->serial.load(std::memory_order_acquire);
+	uintptr_t ret = toy_align_frame_address(arena->top, alignment);
+	if (toy_unlikely(arena->serial != serial || ret + size > arena->end)) {
+		uintptr_t arena_memory = toy_frame_stack_alloc(frame_alc, frame_alc->arena_size, TOY_MEMORY_FRAME_ALIGNMENT);
+		if ((uintptr_t)NULL == arena_memory)
+			return (void*)toy_frame_stack_alloc(frame_alc, size, alignment);
+		arena->serial = serial;
+		arena->end = arena_memory + frame_alc->arena_size;
+		ret = toy_align_frame_address(arena_memory, alignment);
+	}
+	arena->top = ret + size;
+	return (void*)ret;
+}
+
+
+static void* toy_frame_alc_alloc (void* ctx, size_t size)
+{
+	return toy_frame_alloc((toy_memory_frame_allocator_p)ctx, size, TOY_MEMORY_FRAME_ALIGNMENT);
+}
+
+
+static void toy_frame_alc_free (void* ctx, void* mem)
+{
+	// Released by toy_begin_memory_frame()
+}
+
+
+void toy_get_memory_frame_alc (
+	toy_memory_frame_allocator_p frame_alc,
+	toy_allocator_t* output_alc)
+{
+	output_alc->ctx = frame_alc;
+	output_alc->alloc = toy_frame_alc_alloc;
+	output_alc->free = toy_frame_alc_free;
+	output_alc->ext = NULL;
+}
+
+TOY_EXTERN_C_END
@@ -0,0 +1,454 @@
+#include "include/toy_memory_profile.h"
+
+#if TOY_DEBUG_MEMORY
+
+#include "toy_assert.h"
+#include "include/toy_memory.h"
+#include "include/toy_log.h"
+#include <cstring>
+#include <mutex>
+#include <new>
+
+
+#define TOY_MEMORY_PROFILE_EMPTY ((uintptr_t)0)
+#define TOY_MEMORY_PROFILE_DELETED ((uintptr_t)1)
+#define TOY_MEMORY_PROFILE_MIN_CAPACITY 1024
+
+// Live allocation, kept in an open addressing hash table keyed by address
+struct toy_memory_profile_record_t {
+	uintptr_t address;
+	size_t size;
+	uint32_t source;
+	uint32_t tag;
+};
+
+struct toy_memory_profile_view_t {
+	toy_memory_profile_p profile;
+	uint32_t source;
+	uint32_t tag;
+};
+
+struct toy_memory_profile_source_t {
+	const char* name;
+	toy_allocator_t backing_alc;
+	toy_allocator_ext_t ext; // Operations which backing_alc supports
+	toy_memory_stats_t total;
+	toy_memory_stats_t tags[TOY_MEMORY_TAG_COUNT];
+	toy_memory_profile_view_t views[TOY_MEMORY_TAG_COUNT];
+};
+
+struct toy_memory_profile_t {
+	std::mutex lock;
+	uint32_t source_count;
+	toy_memory_profile_source_t sources[TOY_MEMORY_PROFILE_SOURCE_MAX];
+
+	toy_memory_profile_record_t* records;
+	size_t capacity; // 2^N
+	size_t used_count; // Live and deleted records
+};
+
+
+static const char* s_memory_tag_names[TOY_MEMORY_TAG_COUNT] = {
+	"unknown",
+	"asset",
+	"scene",
+	"render",
+	"lua",
+};
+
+
+static toy_inline size_t toy_hash_memory_profile_address (uintptr_t address, size_t capacity)
+{
+	return (size_t)(((uint64_t)address >> 4) * UINT64_C(0x9E3779B97F4A7C15) >> 32) & (capacity - 1);
+}
+
+
+static bool toy_rehash_memory_profile (toy_memory_profile_p profile, size_t capacity)
+{
+	toy_allocator_t std_alc = toy_std_alc();
+	toy_memory_profile_record_t* records = (toy_memory_profile_record_t*)toy_alloc_aligned(
+		&std_alc, sizeof(toy_memory_profile_record_t) * capacity, sizeof(void*));
+	if (NULL == records)
+		return false;
+	for (size_t i = 0; i < capacity; ++i)
+		records[i].address = TOY_MEMORY_PROFILE_EMPTY;
+
+	size_t used_count = 0;
+	for (size_t i = 0; i < profile->capacity; ++i) {
+		toy_memory_profile_record_t* record = &profile->records[i];
+		if (record->address <= TOY_MEMORY_PROFILE_DELETED)
+			continue;
+		size_t index = toy_hash_memory_profile_address(record->address, capacity);
+		while (TOY_MEMORY_PROFILE_EMPTY != records[index].address)
+			index = (index + 1) & (capacity - 1);
+		records[index] = *record;
+		++used_count;
+	}
+
+	if (NULL != profile->records)
+		toy_free_aligned(&std_alc, profile->records);
+	profile->records = records;
+	profile->capacity = capacity;
+	profile->used_count = used_count;
+	return true;
+}
+
+
+static bool toy_insert_memory_profile_record (
+	toy_memory_profile_p profile,
+	const toy_memory_profile_record_t* record)
+{
+	// Keep load factor under 1/2, deleted records included
+	if ((profile->used_count + 1) * 2 > profile->capacity) {
+		size_t live_count = 0;
+		for (uint32_t i = 0; i < profile->source_count; ++i)
+			live_count += profile->sources[i].total.live_count;
+		size_t capacity = profile->capacity;
+		while ((live_count + 1) * 4 > capacity)
+			capacity *= 2;
+		if (!toy_rehash_memory_profile(profile, capacity))
+			return false;
+	}
+
+	size_t index = toy_hash_memory_profile_address(record->address, profile->capacity);
+	while (profile->records[index].address > TOY_MEMORY_PROFILE_DELETED) {
+		TOY_ASSERT(profile->records[index].address != record->address);
+		index = (index + 1) & (profile->capacity - 1);
+	}
+	if (TOY_MEMORY_PROFILE_EMPTY == profile->records[index].address)
+		++(profile->used_count);
+	profile->records[index] = *record;
+	return true;
+}
+
+
+static toy_memory_profile_record_t* toy_find_memory_profile_record (
+	toy_memory_profile_p profile,
+	uintptr_t address)
+{
+	size_t index = toy_hash_memory_profile_address(address, profile->capacity);
+	while (TOY_MEMORY_PROFILE_EMPTY != profile->records[index].address) {
+		if (address == profile->records[index].address)
+			return &profile->records[index];
+		index = (index + 1) & (profile->capacity - 1);
+	}
+	return NULL;
+}
+
+
+static void toy_count_memory_alloc (toy_memory_stats_t* stats, size_t size)
+{
+	stats->live_bytes += size;
+	if (stats->live_bytes > stats->peak_bytes)
+		stats->peak_bytes = stats->live_bytes;
+	++(stats->live_count);
+	++(stats->alloc_count);
+	++(stats->frame_alloc_count);
+	stats->frame_alloc_bytes += size;
+
+	int bucket = toy_fls(size - 1);
+	if (bucket >= TOY_MEMORY_HISTOGRAM_SIZE)
+		bucket = TOY_MEMORY_HISTOGRAM_SIZE - 1;
+	++(stats->histogram[bucket]);
+}
+
+
+static void toy_count_memory_free (toy_memory_stats_t* stats, size_t size)
+{
+	TOY_ASSERT(stats->live_bytes >= size && stats->live_count > 0);
+	stats->live_bytes -= size;
+	--(stats->live_count);
+	++(stats->free_count);
+}
+
+
+static void toy_count_memory_resize (toy_memory_stats_t* stats, size_t old_size, size_t new_size)
+{
+	TOY_ASSERT(stats->live_bytes >= old_size);
+	stats->live_bytes = stats->live_bytes - old_size + new_size;
+	if (stats->live_bytes > stats->peak_bytes)
+		stats->peak_bytes = stats->live_bytes;
+}
+
+
+// Record mem which is just allocated from backing allocator
+static void* toy_track_memory_profile_alloc (
+	toy_memory_profile_view_t* view,
+	void* mem,
+	size_t size)
+{
+	toy_memory_profile_p profile = view->profile;
+	toy_memory_profile_source_t* source = &profile->sources[view->source];
+
+	std::lock_guard<std::mutex> guard(profile->lock);
+	if (NULL == mem) {
+		++(source->total.failed_count);
+		++(source->tags[view->tag].failed_count);
+		return NULL;
+	}
+
+	toy_memory_profile_record_t record;
+	record.address = (uintptr_t)mem;
+	record.size = size;
+	record.source = view->source;
+	record.tag = view->tag;
+	if (!toy_insert_memory_profile_record(profile, &record)) {
+		toy_free(&source->backing_alc, mem);
+		++(source->total.failed_count);
+		++(source->tags[view->tag].failed_count);
+		return NULL;
+	}
+
+	toy_count_memory_alloc(&source->total, size);
+	toy_count_memory_alloc(&source->tags[view->tag], size);
+	return mem;
+}
+
+
+TOY_EXTERN_C_START
+
+static void* toy_memory_profile_alloc (void* ctx, size_t size)
+{
+	toy_memory_profile_view_t* view = (toy_memory_profile_view_t*)ctx;
+	toy_memory_profile_source_t* source = &view->profile->sources[view->source];
+	return toy_track_memory_profile_alloc(view, toy_alloc(&source->backing_alc, size), size);
+}
+
+
+static void toy_memory_profile_free (void* ctx, void* mem)
+{
+	if (NULL == mem)
+		return;
+
+	toy_memory_profile_view_t* view = (toy_memory_profile_view_t*)ctx;
+	toy_memory_profile_p profile = view->profile;
+	toy_memory_profile_source_t* source = &profile->sources[view->source];
+
+	{
+		std::lock_guard<std::mutex> guard(profile->lock);
+		toy_memory_profile_record_t* record = toy_find_memory_profile_record(profile, (uintptr_t)mem);
+		TOY_ASSERT(NULL != record && record->source == view->source);
+		if (NULL != record) {
+			// Count to the tag of allocation, it may be freed through another tagged allocator
+			toy_count_memory_free(&source->total, record->size);
+			toy_count_memory_free(&source->tags[record->tag], record->size);
+			record->address = TOY_MEMORY_PROFILE_DELETED;
+		}
+	}
+
+	toy_free(&source->backing_alc, mem);
+}
+
+
+static void* toy_memory_profile_alloc_aligned (void* ctx, size_t size, size_t alignment)
+{
+	toy_memory_profile_view_t* view = (toy_memory_profile_view_t*)ctx;
+	toy_memory_profile_source_t* source = &view->profile->sources[view->source];
+	void* mem = source->backing_alc.ext->alloc_aligned(source->backing_alc.ctx, size, alignment);
+	return toy_track_memory_profile_alloc(view, mem, size);
+}
+
+
+static bool toy_memory_profile_resize (void* ctx, void* mem, size_t old_size, size_t new_size)
+{
+	toy_memory_profile_view_t* view = (toy_memory_profile_view_t*)ctx;
+	toy_memory_profile_p profile = view->profile;
+	toy_memory_profile_source_t* source = &profile->sources[view->source];
+	if (!toy_resize(&source->backing_alc, mem, old_size, new_size))
+		return false;
+
+	std::lock_guard<std::mutex> guard(profile->lock);
+	toy_memory_profile_record_t* record = toy_find_memory_profile_record(profile, (uintptr_t)mem);
+	TOY_ASSERT(NULL != record && record->source == view->source);
+	if (NULL != record) {
+		toy_count_memory_resize(&source->total, record->size, new_size);
+		toy_count_memory_resize(&source->tags[record->tag], record->size, new_size);
+		record->size = new_size;
+	}
+	return true;
+}
+
+
+static size_t toy_memory_profile_usable_size (void* ctx, void* mem)
+{
+	toy_memory_profile_view_t* view = (toy_memory_profile_view_t*)ctx;
+	return toy_get_usable_size(&view->profile->sources[view->source].backing_alc, mem);
+}
+
+
+// Every live allocation of the source is freed
+static void toy_memory_profile_reset (void* ctx)
+{
+	toy_memory_profile_view_t* view = (toy_memory_profile_view_t*)ctx;
+	toy_memory_profile_p profile = view->profile;
+	toy_memory_profile_source_t* source = &profile->sources[view->source];
+	toy_reset_allocator(&source->backing_alc);
+
+	std::lock_guard<std::mutex> guard(profile->lock);
+	for (size_t i = 0; i < profile->capacity; ++i) {
+		toy_memory_profile_record_t* record = &profile->records[i];
+		if (record->address <= TOY_MEMORY_PROFILE_DELETED || record->source != view->source)
+			continue;
+		toy_count_memory_free(&source->total, record->size);
+		toy_count_memory_free(&source->tags[record->tag], record->size);
+		record->address = TOY_MEMORY_PROFILE_DELETED;
+	}
+}
+
+
+toy_memory_profile_p toy_create_memory_profile (void)
+{
+	toy_allocator_t std_alc = toy_std_alc();
+	void* memory = toy_alloc_aligned(&std_alc, sizeof(toy_memory_profile_t), sizeof(void*));
+	if (NULL == memory)
+		return NULL;
+
+	toy_memory_profile_p profile = new (memory) toy_memory_profile_t();
+	profile->source_count = 0;
+	profile->records = NULL;
+	profile->capacity = 0;
+	profile->used_count = 0;
+	if (!toy_rehash_memory_profile(profile, TOY_MEMORY_PROFILE_MIN_CAPACITY)) {
+		profile->~toy_memory_profile_t();
+		toy_free_aligned(&std_alc, memory);
+		return NULL;
+	}
+	return profile;
+}
+
+
+void toy_destroy_memory_profile (toy_memory_profile_p profile)
+{
+	TOY_ASSERT(NULL != profile);
+
+	toy_allocator_t std_alc = toy_std_alc();
+	toy_free_aligned(&std_alc, profile->records);
+	profile->~toy_memory_profile_t();
+	toy_free_aligned(&std_alc, profile);
+}
+
+
+uint32_t toy_add_memory_profile_source (
+	toy_memory_profile_p profile,
+	const char* name,
+	const toy_allocator_t* backing_alc,
+	toy_allocator_t* output_alc)
+{
+	TOY_ASSERT(NULL != profile && NULL != backing_alc && NULL != output_alc);
+
+	std::lock_guard<std::mutex> guard(profile->lock);
+	if (profile->source_count >= TOY_MEMORY_PROFILE_SOURCE_MAX)
+		return UINT32_MAX;
+
+	uint32_t index = (profile->source_count)++;
+	toy_memory_profile_source_t* source = &profile->sources[index];
+	memset(source, 0, sizeof(*source));
+	source->name = name;
+	source->backing_alc = *backing_alc;
+	const toy_allocator_ext_t* backing_ext = backing_alc->ext;
+	if (NULL != backing_ext) {
+		source->ext.resize = NULL != backing_ext->resize ? toy_memory_profile_resize : NULL;
+		source->ext.usable_size = NULL != backing_ext->usable_size ? toy_memory_profile_usable_size : NULL;
+		source->ext.alloc_aligned = NULL != backing_ext->alloc_aligned ? toy_memory_profile_alloc_aligned : NULL;
+		source->ext.reset = NULL != backing_ext->reset ? toy_memory_profile_reset : NULL;
+	}
+	for (uint32_t i = 0; i < TOY_MEMORY_TAG_COUNT; ++i) {
+		source->views[i].profile = profile;
+		source->views[i].source = index;
+		source->views[i].tag = i;
+	}
+
+	output_alc->ctx = &source->views[TOY_MEMORY_TAG_UNKNOWN];
+	output_alc->alloc = toy_memory_profile_alloc;
+	output_alc->free = toy_memory_profile_free;
+	output_alc->ext = &source->ext;
+	return index;
+}
+
+
+void toy_get_memory_profile_allocator (
+	toy_memory_profile_p profile,
+	uint32_t source,
+	enum toy_memory_tag_t tag,
+	toy_allocator_t* output_alc)
+{
+	TOY_ASSERT(NULL != profile && source < profile->source_count && tag < TOY_MEMORY_TAG_COUNT);
+	output_alc->ctx = &profile->sources[source].views[tag];
+	output_alc->alloc = toy_memory_profile_alloc;
+	output_alc->free = toy_memory_profile_free;
+	output_alc->ext = &profile->sources[source].ext;
+}
+
+
+void toy_get_memory_profile_stats (
+	toy_memory_profile_p profile,
+	uint32_t source,
+	enum toy_memory_tag_t tag,
+	toy_memory_stats_t* output)
+{
+	TOY_ASSERT(NULL != profile && source < profile->source_count && tag <= TOY_MEMORY_TAG_COUNT);
+	std::lock_guard<std::mutex> guard(profile->lock);
+	if (TOY_MEMORY_TAG_COUNT == tag)
+		*output = profile->sources[source].total;
+	else
+		*output = profile->sources[source].tags[tag];
+}
+
+
+void toy_mark_memory_profile_frame (toy_memory_profile_p profile)
+{
+	std::lock_guard<std::mutex> guard(profile->lock);
+	for (uint32_t i = 0; i < profile->source_count; ++i) {
+		toy_memory_profile_source_t* source = &profile->sources[i];
+		source->total.frame_alloc_count = 0;
+		source->total.frame_alloc_bytes = 0;
+		for (uint32_t j = 0; j < TOY_MEMORY_TAG_COUNT; ++j) {
+			source->tags[j].frame_alloc_count = 0;
+			source->tags[j].frame_alloc_bytes = 0;
+		}
+	}
+}
+
+
+void toy_dump_memory_profile (toy_memory_profile_p profile)
+{
+	std::lock_guard<std::mutex> guard(profile->lock);
+	for (uint32_t i = 0; i < profile->source_count; ++i) {
+		toy_memory_profile_source_t* source = &profile->sources[i];
+		const toy_memory_stats_t* total = &source->total;
+		toy_log_i("[memory] %s: live %zu bytes (%zu blocks), peak %zu bytes, alloc %llu, free %llu, failed %llu, frame alloc %llu (%zu bytes)",
+			source->name, total->live_bytes, total->live_count, total->peak_bytes,
+			(unsigned long long)total->alloc_count, (unsigned long long)total->free_count, (unsigned long long)total->failed_count,
+			(unsigned long long)total->frame_alloc_count, total->frame_alloc_bytes);
+
+		for (uint32_t j = 0; j < TOY_MEMORY_TAG_COUNT; ++j) {
+			const toy_memory_stats_t* stats = &source->tags[j];
+			if (0 == stats->alloc_count)
+				continue;
+			toy_log_i("[memory]   %s: live %zu bytes (%zu blocks), peak %zu bytes, alloc %llu",
+				s_memory_tag_names[j], stats->live_bytes, stats->live_count, stats->peak_bytes,
+				(unsigned long long)stats->alloc_count);
+		}
+	}
+}
+
+
+size_t toy_report_memory_profile_leaks (toy_memory_profile_p profile)
+{
+	std::lock_guard<std::mutex> guard(profile->lock);
+	size_t leak_count = 0;
+	for (size_t i = 0; i < profile->capacity; ++i) {
+		const toy_memory_profile_record_t* record = &profile->records[i];
+		if (record->address <= TOY_MEMORY_PROFILE_DELETED)
+			continue;
+		toy_log_w("[memory] leak: %p, %zu bytes, %s, %s",
+			(void*)record->address, record->size,
+			profile->sources[record->source].name, s_memory_tag_names[record->tag]);
+		++leak_count;
+	}
+	return leak_count;
+}
+
+TOY_EXTERN_C_END
+
+#endif // TOY_DEBUG_MEMORY
@@ -0,0 +1,236 @@
+#include "include/toy_memory_slab.h"
+
+#include "toy_assert.h"
+
+
+static uint32_t toy_get_memory_slab_class_size (uint32_t size_class)
+{
+	if (size_class < 8)
+		return (size_class + 1) * TOY_MEMORY_SLAB_MIN_SIZE;
+	uint32_t shift = 7 + (size_class - 8) / 4;
+	return (UINT32_C(1) << shift) + ((size_class - 8) % 4 + 1) * (UINT32_C(1) << (shift - 2));
+}
+
+
+static toy_inline uint32_t toy_get_memory_slab_class (toy_memory_slab_t* slab, size_t size)
+{
+	if (size <= TOY_MEMORY_SLAB_SMALL_TABLE_SIZE * 16)
+		return slab->small_class_table[(size - 1) >> 4];
+	return slab->large_class_table[(size - 1) >> 7];
+}
+
+
+void toy_init_memory_slab (
+	const toy_allocator_t* page_alc,
+	toy_memory_slab_t* output)
+{
+	TOY_ASSERT(NULL != page_alc && NULL != output);
+	TOY_ASSERT(toy_get_memory_slab_class_size(TOY_MEMORY_SLAB_CLASS_COUNT - 1) == TOY_MEMORY_SLAB_MAX_SIZE);
+	TOY_ASSERT(sizeof(toy_memory_slab_page_t) <= TOY_MEMORY_SLAB_PAGE_HEADER_SIZE);
+
+	output->page_alc = *page_alc;
+	output->page_count = 0;
+	for (uint32_t i = 0; i < TOY_MEMORY_SLAB_CLASS_COUNT; ++i) {
+		toy_memory_slab_class_t* size_class = &output->classes[i];
+		size_class->available_pages = NULL;
+		size_class->full_pages = NULL;
+		size_class->block_size = toy_get_memory_slab_class_size(i);
+		size_class->block_count = (TOY_MEMORY_SLAB_PAGE_SIZE - TOY_MEMORY_SLAB_PAGE_HEADER_SIZE) / size_class->block_size;
+	}
+
+	// The smallest class which holds the biggest size of each table entry
+	uint32_t size_class = 0;
+	for (uint32_t i = 0; i < TOY_MEMORY_SLAB_SMALL_TABLE_SIZE; ++i) {
+		while (output->classes[size_class].block_size < (i + 1) * 16)
+			++size_class;
+		output->small_class_table[i] = (uint8_t)size_class;
+	}
+	size_class = 0;
+	for (uint32_t i = 0; i < TOY_MEMORY_SLAB_LARGE_TABLE_SIZE; ++i) {
+		while (output->classes[size_class].block_size < (i + 1) * 128)
+			++size_class;
+		output->large_class_table[i] = (uint8_t)size_class;
+	}
+}
+
+
+static void toy_free_memory_slab_pages (toy_memory_slab_t* slab, toy_memory_slab_page_p page)
+{
+	while (NULL != page) {
+		toy_memory_slab_page_p next = page->next;
+		toy_free(&slab->page_alc, page);
+		--(slab->page_count);
+		page = next;
+	}
+}
+
+
+void toy_clear_memory_slab (toy_memory_slab_t* slab)
+{
+	TOY_ASSERT(NULL != slab);
+	for (uint32_t i = 0; i < TOY_MEMORY_SLAB_CLASS_COUNT; ++i) {
+		toy_free_memory_slab_pages(slab, slab->classes[i].available_pages);
+		toy_free_memory_slab_pages(slab, slab->classes[i].full_pages);
+		slab->classes[i].available_pages = NULL;
+		slab->classes[i].full_pages = NULL;
+	}
+	TOY_ASSERT(0 == slab->page_count);
+}
+
+
+static toy_inline void toy_link_memory_slab_page (toy_memory_slab_page_p* head, toy_memory_slab_page_p page)
+{
+	page->prev = NULL;
+	page->next = *head;
+	if (NULL != *head)
+		(*head)->prev = page;
+	*head = page;
+}
+
+
+static toy_inline void toy_unlink_memory_slab_page (toy_memory_slab_page_p* head, toy_memory_slab_page_p page)
+{
+	if (NULL != page->prev)
+		page->prev->next = page->next;
+	else
+		*head = page->next;
+	if (NULL != page->next)
+		page->next->prev = page->prev;
+}
+
+
+static toy_memory_slab_page_p toy_alloc_memory_slab_page (toy_memory_slab_t* slab, uint32_t size_class)
+{
+	toy_memory_slab_page_p page = toy_alloc(&slab->page_alc, TOY_MEMORY_SLAB_PAGE_SIZE);
+	if (toy_unlikely(NULL == page))
+		return NULL;
+	TOY_ASSERT(toy_get_memory_slab_page(page) == page);
+
+	page->free_blocks = NULL;
+	page->fresh_block = (uintptr_t)page + TOY_MEMORY_SLAB_PAGE_HEADER_SIZE;
+	page->allocated_block_count = 0;
+	page->size_class = size_class;
+	toy_link_memory_slab_page(&slab->classes[size_class].available_pages, page);
+	++(slab->page_count);
+	return page;
+}
+
+
+static void* toy_slab_alloc_class (
+	toy_memory_slab_t* slab,
+	uint32_t size_class)
+{
+	toy_memory_slab_class_t* slab_class = &slab->classes[size_class];
+	toy_memory_slab_page_p page = slab_class->available_pages;
+	if (NULL == page) {
+		page = toy_alloc_memory_slab_page(slab, size_class);
+		if (NULL == page)
+			return NULL;
+	}
+
+	void* block = page->free_blocks;
+	if (NULL != block) {
+		page->free_blocks = *(void**)block;
+	}
+	else {
+		block = (void*)page->fresh_block;
+		page->fresh_block += slab_class->block_size;
+	}
+
+	if (++(page->allocated_block_count) == slab_class->block_count) {
+		toy_unlink_memory_slab_page(&slab_class->available_pages, page);
+		toy_link_memory_slab_page(&slab_class->full_pages, page);
+	}
+	return block;
+}
+
+
+void* toy_slab_alloc (
+	toy_memory_slab_t* slab,
+	size_t size)
+{
+	TOY_ASSERT(NULL != slab);
+	if (toy_unlikely(0 == size || size > TOY_MEMORY_SLAB_MAX_SIZE))
+		return NULL;
+	return toy_slab_alloc_class(slab, toy_get_memory_slab_class(slab, size));
+}
+
+
+// Blocks start at page header end, so a block is aligned as the lowest set bit of its block size.
+// Bigger alignment is served by an offset in a bigger block, free finds the block from any address in it
+void* toy_slab_alloc_aligned (
+	toy_memory_slab_t* slab,
+	size_t size,
+	size_t alignment)
+{
+	TOY_ASSERT(NULL != slab);
+	// assert alignment is 2^N
+	TOY_ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+	size_t block_alignment = alignment;
+	if (alignment > TOY_MEMORY_SLAB_PAGE_HEADER_SIZE) {
+		size += alignment - TOY_MEMORY_SLAB_PAGE_HEADER_SIZE;
+		block_alignment = TOY_MEMORY_SLAB_PAGE_HEADER_SIZE;
+	}
+	if (toy_unlikely(0 == size || size > TOY_MEMORY_SLAB_MAX_SIZE))
+		return NULL;
+
+	// The biggest class is a multiple of TOY_MEMORY_SLAB_PAGE_HEADER_SIZE
+	uint32_t size_class = toy_get_memory_slab_class(slab, size);
+	while (0 != (slab->classes[size_class].block_size & (block_alignment - 1)))
+		++size_class;
+	uintptr_t block = (uintptr_t)toy_slab_alloc_class(slab, size_class);
+	if (NULL == (void*)block)
+		return NULL;
+	return (void*)((block + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+
+// Start of the block which memory points into
+static toy_inline uintptr_t toy_get_memory_slab_block (
+	toy_memory_slab_page_p page,
+	const toy_memory_slab_class_t* slab_class,
+	void* memory)
+{
+	uintptr_t blocks = (uintptr_t)page + TOY_MEMORY_SLAB_PAGE_HEADER_SIZE;
+	return blocks + ((uintptr_t)memory - blocks) / slab_class->block_size * slab_class->block_size;
+}
+
+
+size_t toy_get_slab_usable_size (
+	toy_memory_slab_t* slab,
+	void* memory)
+{
+	TOY_ASSERT(NULL != slab && NULL != memory);
+	toy_memory_slab_page_p page = toy_get_memory_slab_page(memory);
+	TOY_ASSERT(page->size_class < TOY_MEMORY_SLAB_CLASS_COUNT);
+	const toy_memory_slab_class_t* slab_class = &slab->classes[page->size_class];
+	return slab_class->block_size - ((uintptr_t)memory - toy_get_memory_slab_block(page, slab_class, memory));
+}
+
+
+void toy_slab_free (
+	toy_memory_slab_t* slab,
+	void* memory)
+{
+	TOY_ASSERT(NULL != slab && NULL != memory);
+
+	toy_memory_slab_page_p page = toy_get_memory_slab_page(memory);
+	TOY_ASSERT(page->size_class < TOY_MEMORY_SLAB_CLASS_COUNT && page->allocated_block_count > 0);
+	toy_memory_slab_class_t* slab_class = &slab->classes[page->size_class];
+	memory = (void*)toy_get_memory_slab_block(page, slab_class, memory);
+
+	if (page->allocated_block_count == slab_class->block_count) {
+		toy_unlink_memory_slab_page(&slab_class->full_pages, page);
+		toy_link_memory_slab_page(&slab_class->available_pages, page);
+	}
+
+	*(void**)memory = page->free_blocks;
+	page->free_blocks = memory;
+
+	// Keep one empty page per class, so a class does not take and return a page repeatedly
+	if (0 == --(page->allocated_block_count) && (NULL != page->prev || NULL != page->next)) {
+		toy_unlink_memory_slab_page(&slab_class->available_pages, page);
+		toy_free(&slab->page_alc, page);
+		--(slab->page_count);
+	}
+}
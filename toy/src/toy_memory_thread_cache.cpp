@@ -0,0 +1,413 @@
+#include "include/toy_memory_thread_cache.h"
+
+#include "toy_assert.h"
+#include "include/toy_memory.h"
+#include <mutex>
+#include <new>
+
+
+// Prefix of each variable size block, toy_free() has no size and backing allocator
+// can not be asked for it without its lock. Keep pointer alignment of backing allocator.
+// Cached blocks store their class index, large blocks store flag and offset from the backing allocation
+typedef uint64_t toy_memory_thread_cache_block_header_t;
+#define TOY_MEMORY_THREAD_CACHE_LARGE_BLOCK (UINT64_C(1) << 63)
+
+struct toy_memory_thread_cache_t {
+	toy_allocator_t backing_alc;
+	toy_allocator_ext_t ext; // Operations of output allocator, by what backing_alc supports
+	size_t block_size; // 0 for variable size
+	uint32_t slot;
+	uint32_t generation;
+	std::mutex lock; // Guard backing_alc
+};
+
+struct toy_memory_thread_cache_bin_t {
+	uint32_t count;
+	void* blocks[TOY_MEMORY_THREAD_CACHE_MAGAZINE_SIZE];
+};
+
+struct toy_memory_thread_cache_slot_t {
+	toy_memory_thread_cache_p cache; // May be dangling, check generation in registry first
+	uint32_t index; // Index of registry
+	uint32_t generation;
+	toy_memory_thread_cache_bin_t bins[TOY_MEMORY_THREAD_CACHE_CLASS_COUNT];
+};
+
+
+// Class 0 is 2^MIN_SHIFT bytes, then CLASS_STEPS classes split each (2^(shift - 1), 2^shift]
+static inline size_t toy_get_memory_thread_cache_class_size (uint32_t class_index)
+{
+	if (0 == class_index)
+		return (size_t)1 << TOY_MEMORY_THREAD_CACHE_MIN_SHIFT;
+	uint32_t shift = TOY_MEMORY_THREAD_CACHE_MIN_SHIFT + (class_index - 1) / TOY_MEMORY_THREAD_CACHE_CLASS_STEPS;
+	size_t step = (size_t)1 << (shift - TOY_MEMORY_THREAD_CACHE_CLASS_STEPS_SHIFT);
+	return ((size_t)1 << shift) + step * ((class_index - 1) % TOY_MEMORY_THREAD_CACHE_CLASS_STEPS + 1);
+}
+
+
+// real_size includes block header and is not bigger than 2^MAX_SHIFT
+static inline uint32_t toy_get_memory_thread_cache_class (size_t real_size)
+{
+	if (real_size <= ((size_t)1 << TOY_MEMORY_THREAD_CACHE_MIN_SHIFT))
+		return 0;
+	int shift = toy_fls(real_size - 1) - 1; // 2^shift < real_size <= 2^(shift + 1)
+	int step_shift = shift - TOY_MEMORY_THREAD_CACHE_CLASS_STEPS_SHIFT;
+	size_t step = ((real_size - ((size_t)1 << shift)) + ((size_t)1 << step_shift) - 1) >> step_shift;
+	return (uint32_t)((shift - TOY_MEMORY_THREAD_CACHE_MIN_SHIFT) * TOY_MEMORY_THREAD_CACHE_CLASS_STEPS) + (uint32_t)step;
+}
+
+
+static std::mutex s_registry_lock;
+static toy_memory_thread_cache_p s_caches[TOY_MEMORY_THREAD_CACHE_MAX];
+static uint32_t s_generations[TOY_MEMORY_THREAD_CACHE_MAX];
+
+
+static void toy_return_memory_thread_cache_blocks (
+	toy_memory_thread_cache_p cache,
+	toy_memory_thread_cache_bin_t* bin,
+	uint32_t count)
+{
+	TOY_ASSERT(count <= bin->count);
+	std::lock_guard<std::mutex> guard(cache->lock);
+	for (uint32_t i = 0; i < count; ++i)
+		toy_free(&cache->backing_alc, bin->blocks[--(bin->count)]);
+}
+
+
+static void toy_flush_memory_thread_cache_slot (toy_memory_thread_cache_slot_t* slot)
+{
+	std::lock_guard<std::mutex> guard(s_registry_lock);
+	// The cache may be destroyed (and the slot reused) already, drop blocks of a dead cache
+	if (s_caches[slot->index] == slot->cache && s_generations[slot->index] == slot->generation) {
+		for (uint32_t i = 0; i < TOY_MEMORY_THREAD_CACHE_CLASS_COUNT; ++i) {
+			if (slot->bins[i].count > 0)
+				toy_return_memory_thread_cache_blocks(slot->cache, &slot->bins[i], slot->bins[i].count);
+		}
+	}
+	for (uint32_t i = 0; i < TOY_MEMORY_THREAD_CACHE_CLASS_COUNT; ++i)
+		slot->bins[i].count = 0;
+}
+
+
+struct toy_memory_thread_cache_local_t {
+	toy_memory_thread_cache_slot_t* slots[TOY_MEMORY_THREAD_CACHE_MAX];
+
+	~toy_memory_thread_cache_local_t () {
+		toy_allocator_t std_alc = toy_std_alc();
+		for (uint32_t i = 0; i < TOY_MEMORY_THREAD_CACHE_MAX; ++i) {
+			if (NULL == slots[i])
+				continue;
+			toy_flush_memory_thread_cache_slot(slots[i]);
+			toy_free_aligned(&std_alc, slots[i]);
+			slots[i] = NULL;
+		}
+	}
+};
+
+static thread_local toy_memory_thread_cache_local_t s_local = {};
+
+
+static toy_memory_thread_cache_slot_t* toy_get_memory_thread_cache_slot (toy_memory_thread_cache_p cache)
+{
+	toy_memory_thread_cache_slot_t* slot = s_local.slots[cache->slot];
+	if (toy_likely(NULL != slot && slot->cache == cache && slot->generation == cache->generation))
+		return slot;
+
+	if (NULL == slot) {
+		toy_allocator_t std_alc = toy_std_alc();
+		slot = (toy_memory_thread_cache_slot_t*)toy_alloc_aligned(&std_alc, sizeof(toy_memory_thread_cache_slot_t), sizeof(void*));
+		if (NULL == slot)
+			return NULL;
+		slot->index = cache->slot;
+		s_local.slots[cache->slot] = slot;
+	}
+
+	// Slot of a destroyed cache, its blocks are gone with the backing memory
+	slot->cache = cache;
+	slot->generation = cache->generation;
+	for (uint32_t i = 0; i < TOY_MEMORY_THREAD_CACHE_CLASS_COUNT; ++i)
+		slot->bins[i].count = 0;
+	return slot;
+}
+
+
+static bool toy_refill_memory_thread_cache_bin (
+	toy_memory_thread_cache_p cache,
+	toy_memory_thread_cache_bin_t* bin,
+	size_t block_size)
+{
+	std::lock_guard<std::mutex> guard(cache->lock);
+	while (bin->count < TOY_MEMORY_THREAD_CACHE_MAGAZINE_SIZE / 2) {
+		void* block = toy_alloc(&cache->backing_alc, block_size);
+		if (NULL == block)
+			break;
+		bin->blocks[(bin->count)++] = block;
+	}
+	return bin->count > 0;
+}
+
+
+static void* toy_memory_thread_cache_pop (
+	toy_memory_thread_cache_p cache,
+	uint32_t class_index,
+	size_t block_size)
+{
+	toy_memory_thread_cache_slot_t* slot = toy_get_memory_thread_cache_slot(cache);
+	if (toy_unlikely(NULL == slot)) {
+		std::lock_guard<std::mutex> guard(cache->lock);
+		return toy_alloc(&cache->backing_alc, block_size);
+	}
+
+	toy_memory_thread_cache_bin_t* bin = &slot->bins[class_index];
+	if (0 == bin->count && !toy_refill_memory_thread_cache_bin(cache, bin, block_size))
+		return NULL;
+	return bin->blocks[--(bin->count)];
+}
+
+
+static void toy_memory_thread_cache_push (
+	toy_memory_thread_cache_p cache,
+	uint32_t class_index,
+	void* block)
+{
+	toy_memory_thread_cache_slot_t* slot = toy_get_memory_thread_cache_slot(cache);
+	if (toy_unlikely(NULL == slot)) {
+		std::lock_guard<std::mutex> guard(cache->lock);
+		toy_free(&cache->backing_alc, block);
+		return;
+	}
+
+	toy_memory_thread_cache_bin_t* bin = &slot->bins[class_index];
+	if (bin->count >= TOY_MEMORY_THREAD_CACHE_MAGAZINE_SIZE)
+		toy_return_memory_thread_cache_blocks(cache, bin, TOY_MEMORY_THREAD_CACHE_MAGAZINE_SIZE / 2);
+	bin->blocks[(bin->count)++] = block;
+}
+
+
+TOY_EXTERN_C_START
+
+static void* toy_memory_thread_cache_alloc_fixed (void* ctx, size_t size)
+{
+	toy_memory_thread_cache_p cache = (toy_memory_thread_cache_p)ctx;
+	if (0 == size || size > cache->block_size)
+		return NULL;
+	return toy_memory_thread_cache_pop(cache, 0, cache->block_size);
+}
+
+
+static void toy_memory_thread_cache_free_fixed (void* ctx, void* mem)
+{
+	toy_memory_thread_cache_push((toy_memory_thread_cache_p)ctx, 0, mem);
+}
+
+
+static void* toy_memory_thread_cache_alloc_aligned_fixed (void* ctx, size_t size, size_t alignment)
+{
+	// Every block of backing allocator has the same size, so aligned blocks are cached like the others
+	toy_memory_thread_cache_p cache = (toy_memory_thread_cache_p)ctx;
+	if (0 == size || size > cache->block_size)
+		return NULL;
+	std::lock_guard<std::mutex> guard(cache->lock);
+	return cache->backing_alc.ext->alloc_aligned(cache->backing_alc.ctx, cache->block_size, alignment);
+}
+
+
+static void* toy_memory_thread_cache_alloc_large (
+	toy_memory_thread_cache_p cache,
+	size_t size,
+	size_t alignment)
+{
+	toy_memory_thread_cache_block_header_t* header;
+	size_t offset = alignment > sizeof(toy_memory_thread_cache_block_header_t) ? alignment : sizeof(toy_memory_thread_cache_block_header_t);
+	{
+		std::lock_guard<std::mutex> guard(cache->lock);
+		uintptr_t raw = (uintptr_t)(alignment > sizeof(toy_memory_thread_cache_block_header_t) ?
+			cache->backing_alc.ext->alloc_aligned(cache->backing_alc.ctx, size + offset, alignment) :
+			toy_alloc(&cache->backing_alc, size + offset));
+		if (0 == raw)
+			return NULL;
+		header = (toy_memory_thread_cache_block_header_t*)(raw + offset) - 1;
+	}
+	*header = TOY_MEMORY_THREAD_CACHE_LARGE_BLOCK | offset;
+	return header + 1;
+}
+
+
+static void* toy_memory_thread_cache_alloc (void* ctx, size_t size)
+{
+	toy_memory_thread_cache_p cache = (toy_memory_thread_cache_p)ctx;
+	if (0 == size)
+		return NULL;
+
+	size_t real_size = size + sizeof(toy_memory_thread_cache_block_header_t);
+	if (real_size > ((size_t)1 << TOY_MEMORY_THREAD_CACHE_MAX_SHIFT))
+		return toy_memory_thread_cache_alloc_large(cache, size, 0);
+
+	uint32_t class_index = toy_get_memory_thread_cache_class(real_size);
+	toy_memory_thread_cache_block_header_t* header = (toy_memory_thread_cache_block_header_t*)toy_memory_thread_cache_pop(
+		cache, class_index, toy_get_memory_thread_cache_class_size(class_index));
+	if (NULL == header)
+		return NULL;
+	*header = class_index;
+	return header + 1;
+}
+
+
+// Cached blocks keep alignment of block header
+static void* toy_memory_thread_cache_alloc_aligned (void* ctx, size_t size, size_t alignment)
+{
+	if (alignment <= sizeof(toy_memory_thread_cache_block_header_t))
+		return toy_memory_thread_cache_alloc(ctx, size);
+	if (0 == size)
+		return NULL;
+	return toy_memory_thread_cache_alloc_large((toy_memory_thread_cache_p)ctx, size, alignment);
+}
+
+
+static void toy_memory_thread_cache_free (void* ctx, void* mem)
+{
+	toy_memory_thread_cache_p cache = (toy_memory_thread_cache_p)ctx;
+	if (NULL == mem)
+		return;
+
+	toy_memory_thread_cache_block_header_t* header = (toy_memory_thread_cache_block_header_t*)mem - 1;
+	if (*header & TOY_MEMORY_THREAD_CACHE_LARGE_BLOCK) {
+		uintptr_t raw = (uintptr_t)mem - (uintptr_t)(*header & ~TOY_MEMORY_THREAD_CACHE_LARGE_BLOCK);
+		std::lock_guard<std::mutex> guard(cache->lock);
+		toy_free(&cache->backing_alc, (void*)raw);
+		return;
+	}
+
+	TOY_ASSERT(*header < TOY_MEMORY_THREAD_CACHE_CLASS_COUNT);
+	toy_memory_thread_cache_push(cache, (uint32_t)*header, header);
+}
+
+
+static size_t toy_memory_thread_cache_usable_size_fixed (void* ctx, void* mem)
+{
+	return ((toy_memory_thread_cache_p)ctx)->block_size;
+}
+
+
+static bool toy_memory_thread_cache_resize_fixed (void* ctx, void* mem, size_t old_size, size_t new_size)
+{
+	return 0 != new_size && new_size <= ((toy_memory_thread_cache_p)ctx)->block_size;
+}
+
+
+static size_t toy_memory_thread_cache_usable_size (void* ctx, void* mem)
+{
+	toy_memory_thread_cache_p cache = (toy_memory_thread_cache_p)ctx;
+	toy_memory_thread_cache_block_header_t* header = (toy_memory_thread_cache_block_header_t*)mem - 1;
+	if (0 == (*header & TOY_MEMORY_THREAD_CACHE_LARGE_BLOCK))
+		return toy_get_memory_thread_cache_class_size((uint32_t)*header) - sizeof(toy_memory_thread_cache_block_header_t);
+
+	size_t offset = (size_t)(*header & ~TOY_MEMORY_THREAD_CACHE_LARGE_BLOCK);
+	size_t usable_size;
+	{
+		std::lock_guard<std::mutex> guard(cache->lock);
+		usable_size = toy_get_usable_size(&cache->backing_alc, (uint8_t*)mem - offset);
+	}
+	return usable_size > offset ? usable_size - offset : 0;
+}
+
+
+// Cached blocks are resized within their size class, large blocks by backing allocator
+static bool toy_memory_thread_cache_resize (void* ctx, void* mem, size_t old_size, size_t new_size)
+{
+	toy_memory_thread_cache_p cache = (toy_memory_thread_cache_p)ctx;
+	if (0 == new_size)
+		return false;
+
+	toy_memory_thread_cache_block_header_t* header = (toy_memory_thread_cache_block_header_t*)mem - 1;
+	if (0 == (*header & TOY_MEMORY_THREAD_CACHE_LARGE_BLOCK))
+		return new_size + sizeof(toy_memory_thread_cache_block_header_t) <= toy_get_memory_thread_cache_class_size((uint32_t)*header);
+
+	size_t offset = (size_t)(*header & ~TOY_MEMORY_THREAD_CACHE_LARGE_BLOCK);
+	std::lock_guard<std::mutex> guard(cache->lock);
+	return toy_resize(&cache->backing_alc, (uint8_t*)mem - offset, old_size + offset, new_size + offset);
+}
+
+
+toy_memory_thread_cache_p toy_create_memory_thread_cache (
+	const toy_allocator_t* backing_alc,
+	size_t block_size,
+	toy_allocator_t* output_alc)
+{
+	TOY_ASSERT(NULL != backing_alc && NULL != output_alc);
+
+	toy_allocator_t std_alc = toy_std_alc();
+	void* memory = toy_alloc_aligned(&std_alc, sizeof(toy_memory_thread_cache_t), sizeof(void*));
+	if (NULL == memory)
+		return NULL;
+	toy_memory_thread_cache_p cache = new (memory) toy_memory_thread_cache_t();
+	cache->backing_alc = *backing_alc;
+	cache->block_size = block_size;
+
+	const toy_allocator_ext_t* backing_ext = backing_alc->ext;
+	bool has_aligned = NULL != backing_ext && NULL != backing_ext->alloc_aligned;
+	if (0 == block_size) {
+		cache->ext.resize = toy_memory_thread_cache_resize;
+		cache->ext.usable_size = toy_memory_thread_cache_usable_size;
+		cache->ext.alloc_aligned = has_aligned ? toy_memory_thread_cache_alloc_aligned : NULL;
+	}
+	else {
+		cache->ext.resize = toy_memory_thread_cache_resize_fixed;
+		cache->ext.usable_size = toy_memory_thread_cache_usable_size_fixed;
+		cache->ext.alloc_aligned = has_aligned ? toy_memory_thread_cache_alloc_aligned_fixed : NULL;
+	}
+	cache->ext.reset = NULL;
+
+	{
+		std::lock_guard<std::mutex> guard(s_registry_lock);
+		uint32_t slot = 0;
+		while (slot < TOY_MEMORY_THREAD_CACHE_MAX && NULL != s_caches[slot])
+			++slot;
+		if (slot >= TOY_MEMORY_THREAD_CACHE_MAX) {
+			cache->~toy_memory_thread_cache_t();
+			toy_free_aligned(&std_alc, memory);
+			return NULL;
+		}
+		cache->slot = slot;
+		cache->generation = ++(s_generations[slot]);
+		s_caches[slot] = cache;
+	}
+
+	output_alc->ctx = cache;
+	output_alc->alloc = 0 == block_size ? toy_memory_thread_cache_alloc : toy_memory_thread_cache_alloc_fixed;
+	output_alc->free = 0 == block_size ? toy_memory_thread_cache_free : toy_memory_thread_cache_free_fixed;
+	output_alc->ext = &cache->ext;
+	return cache;
+}
+
+
+void toy_destroy_memory_thread_cache (toy_memory_thread_cache_p cache)
+{
+	TOY_ASSERT(NULL != cache);
+
+	toy_memory_thread_cache_slot_t* slot = s_local.slots[cache->slot];
+	if (NULL != slot && slot->cache == cache && slot->generation == cache->generation)
+		toy_flush_memory_thread_cache_slot(slot);
+
+	{
+		std::lock_guard<std::mutex> guard(s_registry_lock);
+		TOY_ASSERT(s_caches[cache->slot] == cache);
+		s_caches[cache->slot] = NULL;
+		++(s_generations[cache->slot]);
+	}
+
+	toy_allocator_t std_alc = toy_std_alc();
+	cache->~toy_memory_thread_cache_t();
+	toy_free_aligned(&std_alc, cache);
+}
+
+
+void toy_flush_memory_thread_cache (void)
+{
+	for (uint32_t i = 0; i < TOY_MEMORY_THREAD_CACHE_MAX; ++i) {
+		if (NULL != s_local.slots[i] && NULL != s_local.slots[i]->cache)
+			toy_flush_memory_thread_cache_slot(s_local.slots[i]);
+	}
+}
+
+TOY_EXTERN_C_END
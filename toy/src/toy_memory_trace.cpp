@@ -0,0 +1,705 @@
+#include "include/toy_memory_trace.h"
+
+#include "toy_assert.h"
+#include "include/toy_memory.h"
+#include "include/toy_file.h"
+#include "include/toy_log.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <new>
+#include <string.h>
+#include <stdlib.h>
+#include <unordered_map>
+#include <vector>
+
+
+#define TOY_MEMORY_TRACE_NAME_MAX 64 // Max length of source name in replay, terminator included
+#define TOY_MEMORY_REPLAY_SAMPLE_INTERVAL 1024 // Operations between fragmentation samples
+
+struct toy_memory_trace_view_t {
+	toy_memory_trace_p trace;
+	toy_allocator_t backing_alc; // Written under lock before is_bound is set, then read without lock
+	std::atomic<bool> is_bound;
+	uint32_t source;
+	uint32_t tag;
+};
+
+struct toy_memory_trace_source_t {
+	toy_allocator_t backing_alc;
+	toy_allocator_ext_t ext; // Operations which backing_alc supports
+	toy_memory_trace_view_t views[TOY_MEMORY_TAG_COUNT];
+};
+
+struct toy_memory_trace_t {
+	std::mutex lock;
+	toy_file_t file;
+	bool write_failed;
+	std::chrono::steady_clock::time_point start_time;
+
+	uint32_t source_count;
+	toy_memory_trace_source_t sources[TOY_MEMORY_TRACE_SOURCE_MAX];
+
+	uint32_t record_count; // Buffered records
+	toy_memory_trace_record_t records[TOY_MEMORY_TRACE_BUFFER_SIZE];
+};
+
+static_assert(sizeof(toy_memory_trace_record_t) == 32, "Record layout is part of file format");
+
+static std::atomic<uint16_t> s_memory_trace_thread_count(0);
+static thread_local uint16_t s_memory_trace_thread = 0; // 0 when not assigned
+
+
+static uint16_t toy_get_memory_trace_thread ()
+{
+	if (0 == s_memory_trace_thread)
+		s_memory_trace_thread = s_memory_trace_thread_count.fetch_add(1, std::memory_order_relaxed) + 1;
+	return s_memory_trace_thread;
+}
+
+
+// Caller holds lock
+static void toy_write_memory_trace_records (toy_memory_trace_p trace)
+{
+	if (0 == trace->record_count)
+		return;
+	if (!trace->write_failed) {
+		size_t count = fwrite(trace->records, sizeof(toy_memory_trace_record_t), trace->record_count, trace->file.handle);
+		if (count != trace->record_count) {
+			trace->write_failed = true;
+			toy_log_w("[memory] Write memory trace failed, following records are dropped");
+		}
+	}
+	trace->record_count = 0;
+}
+
+
+// Caller holds lock
+static toy_memory_trace_record_t* toy_push_memory_trace_record (toy_memory_trace_p trace)
+{
+	if (trace->record_count >= TOY_MEMORY_TRACE_BUFFER_SIZE)
+		toy_write_memory_trace_records(trace);
+	toy_memory_trace_record_t* record = &trace->records[(trace->record_count)++];
+	memset(record, 0, sizeof(*record));
+	return record;
+}
+
+
+static void toy_record_memory_trace (
+	toy_memory_trace_view_t* view,
+	enum toy_memory_trace_op_t op,
+	void* mem,
+	size_t size,
+	size_t alignment)
+{
+	toy_memory_trace_p trace = view->trace;
+	uint16_t thread = toy_get_memory_trace_thread();
+
+	std::lock_guard<std::mutex> guard(trace->lock);
+	// Time is taken in lock to keep records sorted
+	uint64_t time = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - trace->start_time).count();
+	toy_memory_trace_record_t* record = toy_push_memory_trace_record(trace);
+	record->address = (uint64_t)(uintptr_t)mem;
+	record->time = time;
+	record->size = size > UINT32_MAX ? UINT32_MAX : (uint32_t)size;
+	record->op = (uint8_t)op;
+	record->tag = (uint8_t)view->tag;
+	record->source = (uint8_t)view->source;
+	record->alignment_log2 = (uint8_t)(0 == alignment ? 0 : toy_ffs(alignment) - 1);
+	record->thread = thread;
+}
+
+
+TOY_EXTERN_C_START
+
+static void* toy_memory_trace_alloc (void* ctx, size_t size)
+{
+	toy_memory_trace_view_t* view = (toy_memory_trace_view_t*)ctx;
+	void* mem = toy_alloc(&view->backing_alc, size);
+	toy_record_memory_trace(view, TOY_MEMORY_TRACE_OP_ALLOC, mem, size, 0);
+	return mem;
+}
+
+
+static void toy_memory_trace_free (void* ctx, void* mem)
+{
+	if (NULL == mem)
+		return;
+
+	// Record before free, otherwise another thread may record the same address allocated again first
+	toy_memory_trace_view_t* view = (toy_memory_trace_view_t*)ctx;
+	toy_record_memory_trace(view, TOY_MEMORY_TRACE_OP_FREE, mem, 0, 0);
+	toy_free(&view->backing_alc, mem);
+}
+
+
+static void* toy_memory_trace_alloc_aligned (void* ctx, size_t size, size_t alignment)
+{
+	toy_memory_trace_view_t* view = (toy_memory_trace_view_t*)ctx;
+	void* mem = view->backing_alc.ext->alloc_aligned(view->backing_alc.ctx, size, alignment);
+	toy_record_memory_trace(view, TOY_MEMORY_TRACE_OP_ALLOC, mem, size, alignment);
+	return mem;
+}
+
+
+static bool toy_memory_trace_resize (void* ctx, void* mem, size_t old_size, size_t new_size)
+{
+	toy_memory_trace_view_t* view = (toy_memory_trace_view_t*)ctx;
+	if (!toy_resize(&view->backing_alc, mem, old_size, new_size))
+		return false;
+	toy_record_memory_trace(view, TOY_MEMORY_TRACE_OP_RESIZE, mem, new_size, 0);
+	return true;
+}
+
+
+static size_t toy_memory_trace_usable_size (void* ctx, void* mem)
+{
+	return toy_get_usable_size(&((toy_memory_trace_view_t*)ctx)->backing_alc, mem);
+}
+
+
+static void toy_memory_trace_reset (void* ctx)
+{
+	toy_memory_trace_view_t* view = (toy_memory_trace_view_t*)ctx;
+	toy_record_memory_trace(view, TOY_MEMORY_TRACE_OP_RESET, NULL, 0, 0);
+	toy_reset_allocator(&view->backing_alc);
+}
+
+
+toy_memory_trace_p toy_create_memory_trace (const char* utf8_path, toy_error_t* error)
+{
+	TOY_ASSERT(NULL != utf8_path && NULL != error);
+
+	toy_allocator_t std_alc = toy_std_alc();
+	toy_memory_trace_p trace = NULL;
+	toy_memory_trace_header_t header;
+	void* memory = toy_alloc_aligned(&std_alc, sizeof(toy_memory_trace_t), sizeof(void*));
+	if (NULL == memory) {
+		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Failed to alloc memory trace", error);
+		goto FAIL_ALLOC;
+	}
+
+	trace = new (memory) toy_memory_trace_t();
+	trace->write_failed = false;
+	trace->start_time = std::chrono::steady_clock::now();
+	trace->source_count = 0;
+	trace->record_count = 0;
+
+	toy_open_file(NULL, utf8_path, "wb", &trace->file, error);
+	if (toy_is_failed(*error))
+		goto FAIL_FILE;
+
+	header.magic = TOY_MEMORY_TRACE_MAGIC;
+	header.version = TOY_MEMORY_TRACE_VERSION;
+	header.record_size = sizeof(toy_memory_trace_record_t);
+	header.reserved = 0;
+	if (1 != fwrite(&header, sizeof(header), 1, trace->file.handle)) {
+		toy_err(TOY_ERROR_FILE_WRITE_FAILED, "Failed to write memory trace header", error);
+		goto FAIL_HEADER;
+	}
+
+	toy_ok(error);
+	return trace;
+
+FAIL_HEADER:
+	toy_close_file(&trace->file);
+FAIL_FILE:
+	trace->~toy_memory_trace_t();
+	toy_free_aligned(&std_alc, memory);
+FAIL_ALLOC:
+	return NULL;
+}
+
+
+void toy_destroy_memory_trace (toy_memory_trace_p trace)
+{
+	TOY_ASSERT(NULL != trace);
+
+	toy_flush_memory_trace(trace);
+	toy_close_file(&trace->file);
+
+	toy_allocator_t std_alc = toy_std_alc();
+	trace->~toy_memory_trace_t();
+	toy_free_aligned(&std_alc, trace);
+}
+
+
+void toy_flush_memory_trace (toy_memory_trace_p trace)
+{
+	TOY_ASSERT(NULL != trace);
+
+	std::lock_guard<std::mutex> guard(trace->lock);
+	toy_write_memory_trace_records(trace);
+	fflush(trace->file.handle);
+}
+
+
+uint32_t toy_add_memory_trace_source (
+	toy_memory_trace_p trace,
+	const char* name,
+	const toy_allocator_t* backing_alc,
+	toy_allocator_t* output_alc)
+{
+	TOY_ASSERT(NULL != trace && NULL != name && NULL != backing_alc && NULL != output_alc);
+
+	std::lock_guard<std::mutex> guard(trace->lock);
+	if (trace->source_count >= TOY_MEMORY_TRACE_SOURCE_MAX)
+		return UINT32_MAX;
+
+	uint32_t index = (trace->source_count)++;
+	toy_memory_trace_source_t* source = &trace->sources[index];
+	source->backing_alc = *backing_alc;
+	const toy_allocator_ext_t* backing_ext = backing_alc->ext;
+	source->ext.resize = NULL != backing_ext && NULL != backing_ext->resize ? toy_memory_trace_resize : NULL;
+	source->ext.usable_size = NULL != backing_ext && NULL != backing_ext->usable_size ? toy_memory_trace_usable_size : NULL;
+	source->ext.alloc_aligned = NULL != backing_ext && NULL != backing_ext->alloc_aligned ? toy_memory_trace_alloc_aligned : NULL;
+	source->ext.reset = NULL != backing_ext && NULL != backing_ext->reset ? toy_memory_trace_reset : NULL;
+	for (uint32_t i = 0; i < TOY_MEMORY_TAG_COUNT; ++i) {
+		source->views[i].trace = trace;
+		source->views[i].backing_alc = *backing_alc;
+		// Output of this call is the view of unknown tag, the others are bound by toy_get_memory_trace_allocator()
+		source->views[i].is_bound.store(TOY_MEMORY_TAG_UNKNOWN == i, std::memory_order_relaxed);
+		source->views[i].source = index;
+		source->views[i].tag = i;
+	}
+
+	// Name is written to following records, so replay can map sources by name
+	size_t name_length = strlen(name);
+	toy_memory_trace_record_t* record = toy_push_memory_trace_record(trace);
+	record->op = TOY_MEMORY_TRACE_OP_SOURCE;
+	record->source = (uint8_t)index;
+	record->size = (uint32_t)name_length;
+	for (size_t offset = 0; offset < name_length; offset += sizeof(toy_memory_trace_record_t)) {
+		size_t length = name_length - offset;
+		if (length > sizeof(toy_memory_trace_record_t))
+			length = sizeof(toy_memory_trace_record_t);
+		memcpy(toy_push_memory_trace_record(trace), name + offset, length);
+	}
+
+	output_alc->ctx = &source->views[TOY_MEMORY_TAG_UNKNOWN];
+	output_alc->alloc = toy_memory_trace_alloc;
+	output_alc->free = toy_memory_trace_free;
+	output_alc->ext = &source->ext;
+	return index;
+}
+
+
+void toy_get_memory_trace_allocator (
+	toy_memory_trace_p trace,
+	uint32_t source,
+	enum toy_memory_tag_t tag,
+	const toy_allocator_t* backing_alc,
+	toy_allocator_t* output_alc)
+{
+	TOY_ASSERT(NULL != trace && source < trace->source_count && tag < TOY_MEMORY_TAG_COUNT);
+
+	toy_memory_trace_view_t* view = &trace->sources[source].views[tag];
+	if (!view->is_bound.load(std::memory_order_acquire)) {
+		// Backing allocator of a view is bound before the view is handed out, alloc and free of other threads
+		// read it after they got the view through this call
+		std::lock_guard<std::mutex> guard(trace->lock);
+		if (!view->is_bound.load(std::memory_order_relaxed)) {
+			if (NULL != backing_alc)
+				view->backing_alc = *backing_alc;
+			view->is_bound.store(true, std::memory_order_release);
+		}
+	}
+	// Tagged backing allocator of a source is always the same one
+	TOY_ASSERT(NULL == backing_alc || (view->backing_alc.ctx == backing_alc->ctx && view->backing_alc.alloc == backing_alc->alloc));
+
+	output_alc->ctx = view;
+	output_alc->alloc = toy_memory_trace_alloc;
+	output_alc->free = toy_memory_trace_free;
+	output_alc->ext = &trace->sources[source].ext;
+}
+
+
+struct toy_memory_replay_allocation_t {
+	void* memory;
+	size_t size;
+	uint32_t source;
+	size_t alignment; // 0 when allocated by alloc()
+};
+
+struct toy_memory_replay_source_t {
+	char name[TOY_MEMORY_TRACE_NAME_MAX];
+	const toy_allocator_t* alc; // NULL when source is not replayed
+	bool lifo; // Stack source, memory above an allocation is released with it
+	std::vector<uint64_t> live_stack; // Recorded addresses of live allocations of lifo source, oldest first
+};
+
+struct toy_memory_replay_t {
+	toy_memory_replay_source_t sources[TOY_MEMORY_TRACE_SOURCE_MAX];
+	std::unordered_map<uint64_t, toy_memory_replay_allocation_t> allocations; // Keyed by recorded address
+	size_t live_bytes;
+	bool list_replayed;
+	bool buddy_replayed;
+	toy_memory_replay_report_t* report;
+};
+
+
+// Only backends which allocations are replayed on are sampled
+static float toy_sample_memory_fragmentation (
+	toy_memory_allocator_t* alc,
+	bool list,
+	bool buddy)
+{
+	toy_memory_free_info_t info;
+	float ret = 0.0f;
+	if (list) {
+		if (NULL != alc->tlsf)
+			toy_get_memory_tlsf_free_info(alc->tlsf, &info);
+		else
+			toy_get_memory_list_free_info(alc->lists.lists, &info);
+		ret = toy_get_memory_fragmentation(&info);
+	}
+	if (buddy) {
+		toy_get_memory_buddy_free_info(&alc->buddy, &info);
+		float fragmentation = toy_get_memory_fragmentation(&info);
+		if (fragmentation > ret)
+			ret = fragmentation;
+	}
+	return ret;
+}
+
+
+// Free one replayed allocation, it must be in replay->allocations
+static void toy_replay_memory_free (toy_memory_replay_t* replay, uint64_t address)
+{
+	auto it = replay->allocations.find(address);
+	TOY_ASSERT(it != replay->allocations.end());
+	const toy_allocator_t* alc = replay->sources[it->second.source].alc;
+
+	auto begin_time = std::chrono::steady_clock::now();
+	if (0 != it->second.alignment)
+		toy_free_aligned(alc, it->second.memory);
+	else
+		toy_free(alc, it->second.memory);
+	replay->report->free_ns += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - begin_time).count();
+	++(replay->report->free_count);
+
+	replay->live_bytes -= it->second.size;
+	replay->allocations.erase(it);
+}
+
+
+// Release allocations of lifo source down to address, address included
+static void toy_replay_memory_pop (
+	toy_memory_replay_t* replay,
+	toy_memory_replay_source_t* source,
+	uint64_t address)
+{
+	while (!source->live_stack.empty()) {
+		uint64_t top = source->live_stack.back();
+		source->live_stack.pop_back();
+		toy_replay_memory_free(replay, top);
+		if (top == address)
+			break;
+	}
+}
+
+
+static void toy_replay_memory_release (toy_memory_replay_t* replay, uint64_t address)
+{
+	auto it = replay->allocations.find(address);
+	if (it == replay->allocations.end())
+		return;
+	toy_memory_replay_source_t* source = &replay->sources[it->second.source];
+	if (source->lifo)
+		toy_replay_memory_pop(replay, source, address);
+	else
+		toy_replay_memory_free(replay, address);
+}
+
+
+// Resize in place, otherwise move it like toy_realloc(), memory of lifo source can not move
+static void toy_replay_memory_resize (
+	toy_memory_replay_t* replay,
+	toy_memory_replay_source_t* source,
+	uint64_t address,
+	size_t new_size)
+{
+	auto it = replay->allocations.find(address);
+	if (it == replay->allocations.end())
+		return;
+	toy_memory_replay_allocation_t* allocation = &it->second;
+	toy_memory_replay_report_t* report = replay->report;
+
+	auto begin_time = std::chrono::steady_clock::now();
+	bool resized = toy_resize(source->alc, allocation->memory, allocation->size, new_size);
+	if (!resized && !source->lifo) {
+		void* mem = 0 != allocation->alignment ?
+			toy_alloc_aligned(source->alc, new_size, allocation->alignment) : toy_alloc(source->alc, new_size);
+		if (NULL != mem) {
+			memcpy(mem, allocation->memory, allocation->size < new_size ? allocation->size : new_size);
+			if (0 != allocation->alignment)
+				toy_free_aligned(source->alc, allocation->memory);
+			else
+				toy_free(source->alc, allocation->memory);
+			allocation->memory = mem;
+			resized = true;
+		}
+	}
+	report->alloc_ns += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - begin_time).count();
+	++(report->resize_count);
+	if (!resized) {
+		++(report->failed_count);
+		return;
+	}
+
+	replay->live_bytes = replay->live_bytes - allocation->size + new_size;
+	allocation->size = new_size;
+	if (replay->live_bytes > report->peak_live_bytes)
+		report->peak_live_bytes = replay->live_bytes;
+}
+
+
+// Free every live allocation of source one by one, replay target may not support reset
+static void toy_replay_memory_reset (
+	toy_memory_replay_t* replay,
+	uint32_t source_index)
+{
+	toy_memory_replay_source_t* source = &replay->sources[source_index];
+	if (source->lifo) {
+		if (!source->live_stack.empty())
+			toy_replay_memory_pop(replay, source, source->live_stack.front());
+		return;
+	}
+
+	std::vector<uint64_t> addresses;
+	for (const auto& allocation : replay->allocations) {
+		if (allocation.second.source == source_index)
+			addresses.push_back(allocation.first);
+	}
+	for (uint64_t address : addresses)
+		toy_replay_memory_free(replay, address);
+}
+
+
+bool toy_replay_memory_trace (
+	const void* trace_data,
+	size_t trace_size,
+	struct toy_memory_allocator_t* alc,
+	const toy_allocator_t* target_alc,
+	toy_memory_replay_report_t* output)
+{
+	TOY_ASSERT(NULL != trace_data && NULL != alc && NULL != output);
+
+	const toy_memory_trace_header_t* header = (const toy_memory_trace_header_t*)trace_data;
+	if (trace_size < sizeof(toy_memory_trace_header_t) ||
+		TOY_MEMORY_TRACE_MAGIC != header->magic ||
+		TOY_MEMORY_TRACE_VERSION != header->version ||
+		sizeof(toy_memory_trace_record_t) != header->record_size) {
+		toy_log_w("[memory] Invalid memory trace");
+		return false;
+	}
+
+	memset(output, 0, sizeof(*output));
+	size_t begin_footprint = toy_get_memory_footprint(alc);
+
+	toy_memory_replay_t replay;
+	for (uint32_t i = 0; i < TOY_MEMORY_TRACE_SOURCE_MAX; ++i) {
+		replay.sources[i].name[0] = '\0';
+		replay.sources[i].alc = NULL;
+		replay.sources[i].lifo = false;
+	}
+	replay.live_bytes = 0;
+	replay.list_replayed = false;
+	replay.buddy_replayed = false;
+	replay.report = output;
+
+	const toy_memory_trace_record_t* records = (const toy_memory_trace_record_t*)(header + 1);
+	size_t record_count = (trace_size - sizeof(toy_memory_trace_header_t)) / sizeof(toy_memory_trace_record_t);
+	uint64_t op_count = 0;
+	for (size_t i = 0; i < record_count; ++i) {
+		const toy_memory_trace_record_t* record = &records[i];
+		if (record->source >= TOY_MEMORY_TRACE_SOURCE_MAX)
+			continue;
+		toy_memory_replay_source_t* source = &replay.sources[record->source];
+
+		if (TOY_MEMORY_TRACE_OP_SOURCE == record->op) {
+			size_t name_record_count = (record->size + sizeof(toy_memory_trace_record_t) - 1) / sizeof(toy_memory_trace_record_t);
+			if (name_record_count > record_count - i - 1)
+				break;
+			size_t name_length = record->size < TOY_MEMORY_TRACE_NAME_MAX - 1 ? record->size : TOY_MEMORY_TRACE_NAME_MAX - 1;
+			memcpy(source->name, record + 1, name_length);
+			source->name[name_length] = '\0';
+			i += name_record_count;
+
+			source->lifo = 0 == strncmp(source->name, "stack", 5);
+			source->alc = target_alc;
+			for (uint32_t j = 0; NULL == target_alc && j < TOY_MEMORY_SOURCE_COUNT; ++j) {
+				if (0 == strcmp(source->name, toy_get_memory_source_name(j))) {
+					source->alc = toy_get_memory_source_alc(alc, j);
+					break;
+				}
+			}
+			if (NULL == source->alc)
+				toy_log_w("[memory] Source %s of memory trace has no allocator to replay", source->name);
+			replay.list_replayed |= source->alc == &alc->list_alc;
+			replay.buddy_replayed |= source->alc == &alc->buddy_alc;
+			continue;
+		}
+
+		if (NULL == source->alc)
+			continue;
+
+		if (TOY_MEMORY_TRACE_OP_ALLOC == record->op) {
+			// Failed in recorded session
+			if (0 == record->address)
+				continue;
+			// Address is taken again, the last allocation at it was released by stack rollback without free
+			toy_replay_memory_release(&replay, record->address);
+
+			size_t alignment = 0 == record->alignment_log2 ? 0 : (size_t)1 << record->alignment_log2;
+			auto begin_time = std::chrono::steady_clock::now();
+			void* mem = 0 != alignment ? toy_alloc_aligned(source->alc, record->size, alignment) : toy_alloc(source->alc, record->size);
+			output->alloc_ns += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - begin_time).count();
+			++(output->alloc_count);
+			if (NULL == mem) {
+				++(output->failed_count);
+				continue;
+			}
+
+			toy_memory_replay_allocation_t allocation;
+			allocation.memory = mem;
+			allocation.size = record->size;
+			allocation.source = record->source;
+			allocation.alignment = alignment;
+			replay.allocations.emplace(record->address, allocation);
+			if (source->lifo)
+				source->live_stack.push_back(record->address);
+			replay.live_bytes += record->size;
+			if (replay.live_bytes > output->peak_live_bytes)
+				output->peak_live_bytes = replay.live_bytes;
+		}
+		else if (TOY_MEMORY_TRACE_OP_FREE == record->op) {
+			toy_replay_memory_release(&replay, record->address);
+		}
+		else if (TOY_MEMORY_TRACE_OP_RESIZE == record->op) {
+			toy_replay_memory_resize(&replay, source, record->address, record->size);
+		}
+		else if (TOY_MEMORY_TRACE_OP_RESET == record->op) {
+			toy_replay_memory_reset(&replay, record->source);
+		}
+
+		if (0 == (++op_count % TOY_MEMORY_REPLAY_SAMPLE_INTERVAL)) {
+			float fragmentation = toy_sample_memory_fragmentation(alc, replay.list_replayed, replay.buddy_replayed);
+			if (fragmentation > output->peak_fragmentation)
+				output->peak_fragmentation = fragmentation;
+		}
+	}
+
+	// Sample before leftovers are released, footprint never shrinks
+	float fragmentation = toy_sample_memory_fragmentation(alc, replay.list_replayed, replay.buddy_replayed);
+	if (fragmentation > output->peak_fragmentation)
+		output->peak_fragmentation = fragmentation;
+	output->footprint_growth = toy_get_memory_footprint(alc) - begin_footprint;
+
+	// Allocations alive at the end of trace, they are not counted in report
+	toy_memory_replay_report_t leftover_report = *output;
+	replay.report = &leftover_report;
+	for (uint32_t i = 0; i < TOY_MEMORY_TRACE_SOURCE_MAX; ++i) {
+		if (replay.sources[i].lifo && !replay.sources[i].live_stack.empty())
+			toy_replay_memory_pop(&replay, &replay.sources[i], replay.sources[i].live_stack.front());
+	}
+	while (!replay.allocations.empty())
+		toy_replay_memory_free(&replay, replay.allocations.begin()->first);
+
+	return true;
+}
+
+
+static void toy_get_memory_replay_config (
+	enum toy_memory_list_strategy_t list_strategy,
+	toy_memory_config_t* output)
+{
+	output->stack_size = 32 * 1024 * 1024; // 32M
+	output->buddy_size = 64 * 1024 * 1024; // 64M
+	output->list_size = 64 * 1024 * 1024; // 64M
+	output->chunk_count = 256;
+	output->list_strategy = list_strategy;
+	output->thread_cache = false; // Trace is replayed on one thread
+	output->frame_size = 0;
+	output->concurrent_chunk_count = 0;
+	output->virtual_memory = true;
+	output->reserve_size = (size_t)1 << (sizeof(void*) >= 8 ? 32 : 28); // 4G, 256M on 32-bit
+	output->chunk_large_page = false;
+	output->trace_path = NULL;
+}
+
+
+static void toy_log_memory_replay_report (const char* name, const toy_memory_replay_report_t* report)
+{
+	toy_log_i("[memory] Replay %s: alloc %llu (%.1f ns/op), free %llu (%.1f ns/op), resize %llu, failed %llu, "
+		"peak live %zu bytes, footprint +%zu bytes, peak fragmentation %.3f",
+		name,
+		(unsigned long long)report->alloc_count,
+		report->alloc_count + report->resize_count > 0 ? (double)report->alloc_ns / (double)(report->alloc_count + report->resize_count) : 0.0,
+		(unsigned long long)report->free_count,
+		report->free_count > 0 ? (double)report->free_ns / (double)report->free_count : 0.0,
+		(unsigned long long)report->resize_count,
+		(unsigned long long)report->failed_count,
+		report->peak_live_bytes,
+		report->footprint_growth,
+		(double)report->peak_fragmentation);
+}
+
+
+int toy_replay_memory_trace_main (const char* utf8_path)
+{
+	TOY_ASSERT(NULL != utf8_path);
+
+	toy_allocator_t std_alc = toy_std_alc();
+	toy_file_interface_t file_api = toy_std_file_interface();
+	toy_error_t err;
+	size_t trace_size = 0;
+	toy_aligned_p trace_data = toy_load_whole_file(utf8_path, &file_api, &std_alc, &std_alc, &trace_size, &err);
+	if (NULL == trace_data) {
+		toy_log_e("[memory] Load memory trace %s failed", utf8_path);
+		return EXIT_FAILURE;
+	}
+
+	// Replay with sources on their own backends, then the whole trace on every general backend,
+	// chunk pools only serve blocks of TOY_MEMORY_CHUNK_SIZE
+	struct {
+		const char* name;
+		enum toy_memory_list_strategy_t list_strategy;
+		uint32_t source; // UINT32_MAX to map sources by name
+	} runs[] = {
+		{ "recorded", TOY_MEMORY_LIST_STRATEGY_TLSF, UINT32_MAX },
+		{ "tlsf", TOY_MEMORY_LIST_STRATEGY_TLSF, TOY_MEMORY_SOURCE_LIST },
+		{ "first_fit", TOY_MEMORY_LIST_STRATEGY_FIRST_FIT, TOY_MEMORY_SOURCE_LIST },
+		{ "buddy", TOY_MEMORY_LIST_STRATEGY_TLSF, TOY_MEMORY_SOURCE_BUDDY },
+	};
+
+	int ret = EXIT_SUCCESS;
+	for (size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); ++i) {
+		toy_memory_config_t config;
+		toy_get_memory_replay_config(runs[i].list_strategy, &config);
+		toy_memory_allocator_t* alc = toy_create_memory_allocator(&config);
+		if (NULL == alc) {
+			toy_log_e("[memory] Create memory allocator for replay %s failed", runs[i].name);
+			ret = EXIT_FAILURE;
+			continue;
+		}
+
+		const toy_allocator_t* target_alc = UINT32_MAX == runs[i].source ? NULL : toy_get_memory_source_alc(alc, runs[i].source);
+		toy_memory_replay_report_t report;
+		if (toy_replay_memory_trace(trace_data, trace_size, alc, target_alc, &report))
+			toy_log_memory_replay_report(runs[i].name, &report);
+		else
+			ret = EXIT_FAILURE;
+
+		toy_destroy_memory_allocator(alc);
+	}
+
+	toy_free_aligned(&std_alc, trace_data);
+	return ret;
+}
+
+TOY_EXTERN_C_END
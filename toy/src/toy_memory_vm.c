@@ -0,0 +1,191 @@
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS and MADV_HUGEPAGE
+#endif
+#include "include/toy_memory_vm.h"
+
+#include "toy_assert.h"
+#include "include/toy_allocator.h"
+#include "include/toy_log.h"
+#include <stdlib.h>
+
+#if TOY_OS_WINDOWS
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+
+size_t toy_get_memory_page_size (void)
+{
+#if TOY_OS_WINDOWS
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwPageSize;
+#else
+	return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+
+size_t toy_get_memory_large_page_size (void)
+{
+#if TOY_OS_WINDOWS
+	return GetLargePageMinimum();
+#elif defined(MADV_HUGEPAGE) && (defined(__x86_64__) || defined(__aarch64__))
+	// Transparent huge page
+	return 2 * 1024 * 1024;
+#else
+	return 0;
+#endif
+}
+
+
+static uintptr_t toy_os_reserve_memory (size_t size, bool large_page)
+{
+#if TOY_OS_WINDOWS
+	if (large_page)
+		return (uintptr_t)VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+	return (uintptr_t)VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+	void* memory = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	return MAP_FAILED == memory ? (uintptr_t)NULL : (uintptr_t)memory;
+#endif
+}
+
+
+static void toy_os_release_memory (uintptr_t memory, size_t size)
+{
+#if TOY_OS_WINDOWS
+	VirtualFree((void*)memory, 0, MEM_RELEASE);
+#else
+	munmap((void*)memory, size);
+#endif
+}
+
+
+static bool toy_os_commit_memory (uintptr_t memory, size_t size, bool large_page)
+{
+#if TOY_OS_WINDOWS
+	return NULL != VirtualAlloc((void*)memory, size, MEM_COMMIT, PAGE_READWRITE);
+#else
+	if (0 != mprotect((void*)memory, size, PROT_READ | PROT_WRITE))
+		return false;
+#	if defined(MADV_HUGEPAGE)
+	if (large_page)
+		madvise((void*)memory, size, MADV_HUGEPAGE);
+#	endif
+	return true;
+#endif
+}
+
+
+bool toy_reserve_memory_vm (
+	size_t size,
+	size_t alignment,
+	bool large_page,
+	toy_memory_vm_t* output)
+{
+	TOY_ASSERT(NULL != output && size > 0);
+	// assert alignment is 2^N
+	TOY_ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+	output->base = (uintptr_t)NULL;
+	output->size = 0;
+
+	size_t granule_size = toy_get_memory_page_size();
+	if (granule_size < TOY_MEMORY_VM_GRANULE_SIZE)
+		granule_size = TOY_MEMORY_VM_GRANULE_SIZE;
+	if (large_page) {
+		size_t large_page_size = toy_get_memory_large_page_size();
+		if (0 == large_page_size)
+			large_page = false;
+		else if (large_page_size > granule_size)
+			granule_size = large_page_size;
+	}
+	if (alignment < granule_size)
+		alignment = granule_size;
+
+	size = (size + granule_size - 1) & ~(granule_size - 1);
+	size_t raw_size = alignment > granule_size ? size + alignment : size;
+	uintptr_t raw_base = toy_os_reserve_memory(raw_size, large_page && !TOY_MEMORY_VM_LAZY_LARGE_PAGE);
+	if ((uintptr_t)NULL == raw_base && large_page && !TOY_MEMORY_VM_LAZY_LARGE_PAGE) {
+		toy_log_w("[memory] Large pages are not available, use normal pages");
+		return toy_reserve_memory_vm(size, alignment, false, output);
+	}
+	if ((uintptr_t)NULL == raw_base)
+		return false;
+
+	output->base = (raw_base + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	output->size = size;
+	output->raw_base = raw_base;
+	output->raw_size = raw_size;
+	output->granule_size = granule_size;
+	output->large_page = large_page;
+
+	if (large_page && !TOY_MEMORY_VM_LAZY_LARGE_PAGE) {
+		output->committed_size = raw_size;
+		output->commit_bitmap = NULL;
+		return true;
+	}
+
+	size_t granule_count = size / granule_size;
+	output->committed_size = 0;
+	output->commit_bitmap = (uint64_t*)calloc((granule_count + 63) / 64, sizeof(uint64_t));
+	if (NULL == output->commit_bitmap) {
+		toy_os_release_memory(raw_base, raw_size);
+		output->base = (uintptr_t)NULL;
+		output->size = 0;
+		return false;
+	}
+	return true;
+}
+
+
+void toy_release_memory_vm (toy_memory_vm_t* vm)
+{
+	TOY_ASSERT(NULL != vm);
+	if (!toy_is_memory_vm_reserved(vm))
+		return;
+
+	toy_os_release_memory(vm->raw_base, vm->raw_size);
+	free(vm->commit_bitmap);
+	vm->commit_bitmap = NULL;
+	vm->base = (uintptr_t)NULL;
+	vm->size = 0;
+	vm->committed_size = 0;
+}
+
+
+bool toy_commit_memory_vm (
+	toy_memory_vm_t* vm,
+	uintptr_t address,
+	size_t size)
+{
+	TOY_ASSERT(NULL != vm);
+	TOY_ASSERT(toy_is_memory_in_vm(vm, address) && size <= vm->base + vm->size - address);
+	if (NULL == vm->commit_bitmap || 0 == size)
+		return true;
+
+	const int shift = toy_ffs(vm->granule_size) - 1;
+	size_t first = (address - vm->base) >> shift;
+	size_t last = (address + size - 1 - vm->base) >> shift;
+	size_t i = first;
+	while (i <= last) {
+		if (vm->commit_bitmap[i / 64] & (UINT64_C(1) << (i % 64))) {
+			++i;
+			continue;
+		}
+
+		// Commit the whole run of uncommitted granules with one call
+		size_t end = i + 1;
+		while (end <= last && 0 == (vm->commit_bitmap[end / 64] & (UINT64_C(1) << (end % 64))))
+			++end;
+		if (!toy_os_commit_memory(vm->base + (i << shift), (end - i) << shift, vm->large_page))
+			return false;
+		vm->committed_size += (end - i) << shift;
+		for (; i < end; ++i)
+			vm->commit_bitmap[i / 64] |= UINT64_C(1) << (i % 64);
+	}
+	return true;
+}
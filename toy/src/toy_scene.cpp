@@ -10,7 +10,8 @@ toy_scene_t* toy_create_scene (
 	toy_memory_allocator_t* alc,
 	toy_error_t* error)
 {
-	toy_scene_t* scene = reinterpret_cast<toy_scene_t*>(toy_alloc_aligned(&alc->list_alc, sizeof(toy_scene_t), sizeof(void*)));
+	toy_allocator_t scene_alc = toy_get_tagged_allocator(alc, &alc->list_alc, TOY_MEMORY_TAG_SCENE);
+	toy_scene_t* scene = reinterpret_cast<toy_scene_t*>(toy_alloc_aligned(&scene_alc, sizeof(toy_scene_t), sizeof(void*)));
 	if (NULL == scene) {
 		toy_err(TOY_ERROR_MEMORY_HOST_ALLOCATION_FAILED, "Alloc scene failed", error);
 		goto FAIL_ALLOC;
@@ -25,6 +26,8 @@ toy_scene_t* toy_create_scene (
 	memset(scene->inst_matrices, 0, sizeof(scene->inst_matrices));
 
 	scene->alc = alc;
+	TOY_ASSERT(NULL != alc->concurrent_chunks);
+	scene->chunk_alc = &alc->concurrent_chunk_alc;
 
 	return scene;
 